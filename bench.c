@@ -0,0 +1,1152 @@
+#include "bench.h"
+#include "billboard.h"
+#include "debugdraw.h"
+#include "drawbatch.h"
+#include "generator.h"
+#include "gpumemory.h"
+#include "hierarchy.h"
+#include "particles.h"
+#include "simulation.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#define BENCH_WARMUP_FRAMES (10)
+#define BENCH_FRAMES (120)
+#define BENCH_FRAME_DT (0.0166666666667f)
+#define BENCH_VERTEX_INSTANCES (1000000)
+#define BENCH_BLEND_INSTANCES (200000)
+#define BENCH_BLEND_OPACITY (0.5f)
+#define BENCH_ANIMATED_INSTANCES (1000000)
+#define BENCH_OCCLUSION_INSTANCES (1000000)
+#define BENCH_LIT_INSTANCES (100000)
+#define BENCH_SOFTWARE_INSTANCES (100000)
+#define BENCH_SPARSE_INSTANCES (4000000)
+#define BENCH_SPARSE_CHANGES (4096)
+#define BENCH_FLOCK_AGENTS (1000000)
+#define BENCH_FLOCK_TICKS (30)
+#define BENCH_FLOCK_DT (0.0333333333333f)
+#define BENCH_HIERARCHY_GROUPS (250000)
+#define BENCH_HIERARCHY_TICKS (30)
+#define BENCH_DEBUG_LINES (100000)
+#define BENCH_DEBUG_BOXES (1000)
+#define BENCH_BATCH_SETS (512)
+#define BENCH_BATCH_INSTANCES (256)
+#define BENCH_BATCH_TARGET_SIZE (256)
+#define BENCH_GPU_MEMORY_OBJECTS (4096)
+#define BENCH_GPU_MEMORY_CHURN (256)
+#define BENCH_GPU_MEMORY_MAX_SIZE (65536)
+#define BENCH_GENERATOR_INSTANCES (100000000)
+#define BENCH_GENERATOR_CHECK (1000003)
+#define BENCH_PARTICLES_RATE (1000000.0f)
+#define BENCH_PARTICLES_EMITTERS (4)
+#define BENCH_PARTICLES_LIFE (2.0f)
+#define BENCH_MATH_VALUES (1048576)
+#define BENCH_MATH_ROUNDS (8)
+
+typedef bool (*BenchFunc)(SBI_Simulation* state);
+
+typedef struct {
+  const char* name;
+  BenchFunc run;
+} BenchEntry;
+
+static bool bench_billboard_modes(SBI_Simulation* state);
+static bool bench_billboard_transparency(SBI_Simulation* state);
+static bool bench_billboard_animation(SBI_Simulation* state);
+static bool bench_billboard_occlusion(SBI_Simulation* state);
+static bool bench_billboard_lights(SBI_Simulation* state);
+static bool bench_billboard_sparse(SBI_Simulation* state);
+static bool bench_software_raster(SBI_Simulation* state);
+static bool bench_flock(SBI_Simulation* state);
+static bool bench_hierarchy(SBI_Simulation* state);
+static bool bench_debug_draw(SBI_Simulation* state);
+static bool bench_draw_batch(SBI_Simulation* state);
+static bool bench_gpu_memory(SBI_Simulation* state);
+static bool bench_particles(SBI_Simulation* state);
+static bool bench_generator(SBI_Simulation* state);
+static bool bench_xmath(SBI_Simulation* state);
+
+static const BenchEntry bench_entries[] = {
+    {"billboard-modes", bench_billboard_modes},
+    {"billboard-transparency", bench_billboard_transparency},
+    {"billboard-animation", bench_billboard_animation},
+    {"billboard-occlusion", bench_billboard_occlusion},
+    {"billboard-lights", bench_billboard_lights},
+    {"billboard-sparse", bench_billboard_sparse},
+    {"software-raster", bench_software_raster},
+    {"flock", bench_flock},
+    {"hierarchy", bench_hierarchy},
+    {"debug-draw", bench_debug_draw},
+    {"draw-batch", bench_draw_batch},
+    {"gpu-memory", bench_gpu_memory},
+    {"particles", bench_particles},
+    {"generator", bench_generator},
+    {"xmath", bench_xmath},
+};
+
+bool SBI_BenchRun(SBI_Simulation* state, const char* name) {
+  for (Uint32 i = 0; i < SDL_arraysize(bench_entries); i++) {
+    if (SDL_strcmp(bench_entries[i].name, name) == 0) {
+      SDL_Log("Running benchmark: %s", name);
+      return bench_entries[i].run(state);
+    }
+  }
+
+  SDL_Log("Unknown benchmark: %s", name);
+  for (Uint32 i = 0; i < SDL_arraysize(bench_entries); i++) {
+    SDL_Log("  %s", bench_entries[i].name);
+  }
+  return false;
+}
+
+// Average milliseconds per frame, the render waits on its fence so this
+// includes the GPU time of the frame
+static double bench_render_frames(SBI_Simulation* state) {
+  for (Uint32 i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+    if (!SBI_SimulationRender(state, BENCH_FRAME_DT)) {
+      return -1.0;
+    }
+  }
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (Uint32 i = 0; i < BENCH_FRAMES; i++) {
+    if (!SBI_SimulationRender(state, BENCH_FRAME_DT)) {
+      return -1.0;
+    }
+  }
+  Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+  return (double)elapsed * 1000.0 /
+         (double)SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+}
+
+// Tiny quads keep the raster cost negligible so the frame is vertex bound
+static bool bench_billboard_modes(SBI_Simulation* state) {
+  static const char* mode_names[SBI_BILLBOARD_MODE_COUNT] = {
+      "spherical",
+      "cylindrical",
+      "screen",
+      "fixed-scale",
+  };
+
+  double baseline = 0.0;
+  for (Uint32 mode = 0; mode < SBI_BILLBOARD_MODE_COUNT; mode++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_VERTEX_INSTANCES);
+    options.mode = mode;
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+
+    for (Uint64 i = 0; i < state->billboard.instances_count; i++) {
+      state->billboard.instances[i][3] = 0.0005f;
+    }
+    SBI_BillboardMarkDirty(&state->billboard, SBI_BILLBOARD_STREAM_POSITION, 0,
+                           state->billboard.instances_count);
+
+    double ms = bench_render_frames(state);
+    if (ms < 0.0) {
+      return false;
+    }
+
+    if (mode == SBI_BILLBOARD_SPHERICAL) {
+      baseline = ms;
+    }
+    SDL_Log("%-12s %d instances: %.3f ms/frame (%.2fx)", mode_names[mode],
+            BENCH_VERTEX_INSTANCES, ms, baseline / ms);
+  }
+
+  return true;
+}
+
+// Overlapping half transparent quads, the sorted blend pays a CPU sort and
+// a full upload every frame while OIT pays a second render pass
+static bool bench_billboard_transparency(SBI_Simulation* state) {
+  static const SBI_BillboardBlend blends[] = {
+      SBI_BILLBOARD_BLEND_SORTED,
+      SBI_BILLBOARD_BLEND_OIT,
+  };
+  static const char* blend_names[] = {
+      "sorted",
+      "oit",
+  };
+
+  if (state->oit.resolve_pipeline == NULL &&
+      !SBI_OITLoad(&state->oit, state->device, state->window)) {
+    return false;
+  }
+
+  double baseline = 0.0;
+  for (Uint32 i = 0; i < SDL_arraysize(blends); i++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_BLEND_INSTANCES);
+    options.mode = state->billboard_mode;
+    options.blend = blends[i];
+    options.opacity = BENCH_BLEND_OPACITY;
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+
+    double ms = bench_render_frames(state);
+    if (ms < 0.0) {
+      return false;
+    }
+
+    if (i == 0) {
+      baseline = ms;
+    }
+    SDL_Log("%-8s %d instances: %.3f ms/frame (%.2fx)", blend_names[i],
+            BENCH_BLEND_INSTANCES, ms, baseline / ms);
+  }
+
+  return true;
+}
+
+// Sprite sheet animation evaluated on the GPU against the same static set,
+// after the first frame neither of them uploads anything
+static bool bench_billboard_animation(SBI_Simulation* state) {
+  static const char* set_names[] = {
+      "static",
+      "animated",
+  };
+
+  double baseline = 0.0;
+  for (Uint32 i = 0; i < SDL_arraysize(set_names); i++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_ANIMATED_INSTANCES);
+    options.mode = state->billboard_mode;
+    options.animated = i == 1;
+    options.atlas_columns = BILLBOARD_ATLAS_COLUMNS;
+    options.atlas_rows = BILLBOARD_ATLAS_ROWS;
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+
+    double ms = bench_render_frames(state);
+    if (ms < 0.0) {
+      return false;
+    }
+
+    // Whatever is left dirty would be uploaded by the next frame
+    Uint64 dirty_bytes = 0;
+    for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+      SBI_BillboardStreamBuffer* stream = &state->billboard.streams[s];
+      if (stream->dirty_end > stream->dirty_begin) {
+        dirty_bytes += (stream->dirty_end - stream->dirty_begin) *
+                       stream->stride;
+      }
+    }
+
+    if (i == 0) {
+      baseline = ms;
+    }
+    SDL_Log("%-8s %d instances: %.3f ms/frame (%.2fx), %ld bytes dirty",
+            set_names[i], BENCH_ANIMATED_INSTANCES, ms, baseline / ms,
+            dirty_bytes);
+  }
+
+  return true;
+}
+
+// A dense opaque cloud drawn whole against the same cloud culled by the
+// depth pyramid, only the culled set pays for a depth target
+static bool bench_billboard_occlusion(SBI_Simulation* state) {
+  static const char* cull_names[] = {
+      "unculled",
+      "hi-z",
+  };
+
+  if (state->views_count > 1) {
+    SDL_Log("Occlusion culling needs a single view");
+    return false;
+  }
+
+  if (state->hiz.cull_pipeline == NULL &&
+      !SBI_HiZLoad(&state->hiz, state->device)) {
+    return false;
+  }
+
+  double baseline = 0.0;
+  for (Uint32 i = 0; i < SDL_arraysize(cull_names); i++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_OCCLUSION_INSTANCES);
+    options.depth_test = i == 1;
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+
+    state->occlusion = i == 1;
+    double ms = bench_render_frames(state);
+    state->occlusion = false;
+    if (ms < 0.0) {
+      return false;
+    }
+
+    if (i == 0) {
+      baseline = ms;
+      SDL_Log("%-8s %d instances: %.3f ms/frame (%.2fx)", cull_names[i],
+              BENCH_OCCLUSION_INSTANCES, ms, baseline / ms);
+      continue;
+    }
+
+    SBI_HiZStats stats = {0};
+    if (!SBI_HiZReadStats(&state->hiz, &stats)) {
+      return false;
+    }
+    SDL_Log("%-8s %d instances: %.3f ms/frame (%.2fx), %u early, %u late, "
+            "%u occluded",
+            cull_names[i], BENCH_OCCLUSION_INSTANCES, ms, baseline / ms,
+            stats.drawn_early, stats.drawn_late,
+            stats.occluded);
+  }
+
+  return true;
+}
+
+// The same set unlit and lit by a growing number of clustered lights, the
+// frame includes the binning pass
+static bool bench_billboard_lights(SBI_Simulation* state) {
+  static const Uint32 lights_counts[] = {0, 256, 1024, SBI_LIGHTS_MAX};
+
+  if (state->views_count > 1) {
+    SDL_Log("Lights need a single view");
+    return false;
+  }
+
+  double baseline = 0.0;
+  for (Uint32 i = 0; i < SDL_arraysize(lights_counts); i++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_LIT_INSTANCES);
+    options.mode = state->billboard_mode;
+
+    SBI_LightsDestroy(&state->lights);
+    state->lights_count = lights_counts[i];
+    if (state->lights_count > 0) {
+      if (!SBI_LightsLoad(&state->lights, state->device,
+                          state->lights_count)) {
+        return false;
+      }
+      options.lights = &state->lights;
+    }
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+    SBI_SimulationPlaceLights(state);
+
+    double ms = bench_render_frames(state);
+    if (ms < 0.0) {
+      return false;
+    }
+
+    if (i == 0) {
+      baseline = ms;
+    }
+    SDL_Log("%4u lights %d instances: %.3f ms/frame (%.2fx)",
+            lights_counts[i], BENCH_LIT_INSTANCES, ms, baseline / ms);
+  }
+
+  return true;
+}
+
+// Frames of the software rasterizer, opaque quads stop at the first
+// covering layer while half transparent ones are blended several deep
+// A few thousand instances spread over a large set move every frame, the
+// ranged upload covers most of the set while the scatter only sends them
+static bool bench_billboard_sparse(SBI_Simulation* state) {
+  static const char* upload_names[] = {
+      "ranged",
+      "sparse",
+  };
+
+  double baseline = 0.0;
+  for (Uint32 u = 0; u < SDL_arraysize(upload_names); u++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_SPARSE_INSTANCES);
+    options.mode = state->billboard_mode;
+    options.sparse_capacity = u == 1 ? SBI_BILLBOARD_SPARSE_CAPACITY : 0;
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
+                           options)) {
+      return false;
+    }
+
+    // Same changes for both uploads
+    SDL_srand(BENCH_SPARSE_CHANGES);
+    Uint64 uploaded_bytes = 0;
+    Uint64 start = 0;
+    for (Uint32 f = 0; f < BENCH_WARMUP_FRAMES + BENCH_FRAMES; f++) {
+      if (f == BENCH_WARMUP_FRAMES) {
+        uploaded_bytes = 0;
+        start = SDL_GetPerformanceCounter();
+      }
+
+      for (Uint32 i = 0; i < BENCH_SPARSE_CHANGES; i++) {
+        Uint64 index = SDL_rand(BENCH_SPARSE_INSTANCES);
+        state->billboard.instances[index][1] += SDL_randf() - 0.5f;
+        SBI_BillboardMarkDirty(&state->billboard,
+                               SBI_BILLBOARD_STREAM_POSITION, index, 1);
+      }
+
+      if (!SBI_SimulationRender(state, BENCH_FRAME_DT)) {
+        return false;
+      }
+      uploaded_bytes += state->billboard.uploaded_bytes;
+    }
+    double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+                (double)SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+
+    if (u == 0) {
+      baseline = ms;
+    }
+    SDL_Log("%-6s %d changes of %d: %.3f ms/frame (%.2fx), %.1f KB/frame",
+            upload_names[u], BENCH_SPARSE_CHANGES, BENCH_SPARSE_INSTANCES, ms,
+            baseline / ms,
+            (double)uploaded_bytes / BENCH_FRAMES / 1024.0);
+  }
+
+  return true;
+}
+
+static bool bench_software_raster(SBI_Simulation* state) {
+  static const SBI_BillboardBlend blends[] = {
+      SBI_BILLBOARD_BLEND_UNSORTED,
+      SBI_BILLBOARD_BLEND_SORTED,
+  };
+  static const char* blend_names[] = {
+      "opaque",
+      "sorted",
+  };
+
+  if (!state->software) {
+    SDL_Log("The software rasterizer needs --software");
+    return false;
+  }
+
+  for (Uint32 i = 0; i < SDL_arraysize(blends); i++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_SOFTWARE_INSTANCES);
+    options.mode = state->billboard_mode;
+    options.blend = blends[i];
+    if (blends[i] == SBI_BILLBOARD_BLEND_SORTED) {
+      options.opacity = BENCH_BLEND_OPACITY;
+    }
+
+    SBI_BillboardDestroy(&state->billboard);
+    if (!SBI_BillboardLoad(&state->billboard, NULL, state->window, options)) {
+      return false;
+    }
+
+    double ms = bench_render_frames(state);
+    if (ms < 0.0) {
+      return false;
+    }
+    SDL_Log("%-6s %d instances, %d workers: %.3f ms/frame", blend_names[i],
+            BENCH_SOFTWARE_INSTANCES, state->soft_raster.pool.workers_count,
+            ms);
+  }
+
+  return true;
+}
+
+// Ticks of a large flock against the budget of the fixed update rate
+static bool bench_flock(SBI_Simulation* state) {
+  SBI_Flock flock = {0};
+  SBI_Vec4* instances =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * BENCH_FLOCK_AGENTS);
+  if (instances == NULL ||
+      !SBI_FlockLoad(&flock, SBI_FlockDefaultOptions(BENCH_FLOCK_AGENTS))) {
+    SDL_aligned_free(instances);
+    SBI_FlockDestroy(&flock);
+    return false;
+  }
+  SBI_FlockSpawn(&flock, instances);
+
+  // Let the agents gather before timing, a spread flock has few neighbours
+  for (Uint32 i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+    SBI_FlockUpdate(&flock, instances, BENCH_FLOCK_DT);
+  }
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (Uint32 i = 0; i < BENCH_FLOCK_TICKS; i++) {
+    SBI_FlockUpdate(&flock, instances, BENCH_FLOCK_DT);
+  }
+  Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+  double ms = (double)elapsed * 1000.0 /
+              (double)SDL_GetPerformanceFrequency() / BENCH_FLOCK_TICKS;
+  SDL_Log("flock %d agents, %d workers: %.3f ms/tick (budget %.3f ms)",
+          BENCH_FLOCK_AGENTS, flock.jobs.workers_count, ms,
+          BENCH_FLOCK_DT * 1000.0);
+
+  SBI_FlockDestroy(&flock);
+  SDL_aligned_free(instances);
+  return true;
+}
+
+// Ticks of a million nodes in groups of a moving root and three attached
+// children, every root is set each tick so the whole tree is composed
+static bool bench_hierarchy(SBI_Simulation* state) {
+  Uint32 nodes_count = BENCH_HIERARCHY_GROUPS * ATTACHED_NODES;
+  SBI_Hierarchy hierarchy = {0};
+  Uint32* parents = SDL_malloc(sizeof(Uint32) * nodes_count);
+  if (parents == NULL) {
+    return false;
+  }
+  for (Uint32 n = 0; n < nodes_count; n += ATTACHED_NODES) {
+    parents[n] = SBI_HIERARCHY_NO_PARENT;
+    parents[n + 1] = n;
+    parents[n + 2] = n;
+    parents[n + 3] = n + 1;
+  }
+  bool loaded = SBI_HierarchyLoad(&hierarchy, parents, nodes_count, 0);
+  SDL_free(parents);
+  if (!loaded) {
+    SBI_HierarchyDestroy(&hierarchy);
+    return false;
+  }
+
+  SBI_Billboard billboard = {0};
+  billboard.instances = SDL_aligned_alloc(16, sizeof(SBI_Vec4) * nodes_count);
+  billboard.instances_count = nodes_count;
+  if (billboard.instances == NULL) {
+    SBI_HierarchyDestroy(&hierarchy);
+    return false;
+  }
+
+  SBI_ALIGN_VEC3 SBI_Vec3 up = {0.0f, 1.0f, 0.0f};
+  SBI_ALIGN_XFORM SBI_XForm child = {0.0f, 0.0f, 0.0f, 1.0f, 0.5f,
+                                     1.5f, 0.0f, 0.5f, 0.5f, 0.5f};
+  for (Uint32 n = 0; n < nodes_count; n++) {
+    if (n % ATTACHED_NODES != 0) {
+      SBI_HierarchySetLocal(&hierarchy, n, child);
+    }
+  }
+
+  SBI_ALIGN_XFORM SBI_XForm root = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                    0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+  Uint64 elapsed = 0;
+  for (Uint32 i = 0; i < BENCH_WARMUP_FRAMES + BENCH_HIERARCHY_TICKS; i++) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 n = 0; n < nodes_count; n += ATTACHED_NODES) {
+      float angle = (float)i * BENCH_FLOCK_DT + (float)n * 0.01f;
+      SBI_QuatMakeAxisAngle(up, angle, root);
+      root[4] = SDL_cosf(angle);
+      root[6] = SDL_sinf(angle);
+      SBI_HierarchySetLocal(&hierarchy, n, root);
+    }
+    SBI_HierarchyUpdate(&hierarchy);
+    SBI_HierarchyExport(&hierarchy, &billboard, 0);
+    if (i >= BENCH_WARMUP_FRAMES) {
+      elapsed += SDL_GetPerformanceCounter() - start;
+    }
+  }
+
+  // The set has no streams, the export only writes its instances
+  double ms = (double)elapsed * 1000.0 /
+              (double)SDL_GetPerformanceFrequency() / BENCH_HIERARCHY_TICKS;
+  SDL_Log("hierarchy %d nodes in %d levels, %d workers: %.3f ms/tick "
+          "(budget %.3f ms)",
+          nodes_count, hierarchy.levels_count, hierarchy.pool.workers_count,
+          ms, BENCH_FLOCK_DT * 1000.0);
+
+  SBI_HierarchyDestroy(&hierarchy);
+  SDL_aligned_free(billboard.instances);
+  return true;
+}
+
+// CPU cost of appending and uploading a frame of debug lines, the last
+// of them are boxes so both appends are covered
+static bool bench_debug_draw(SBI_Simulation* state) {
+  SBI_DebugDraw debug = {0};
+  if (!SBI_DebugDrawLoad(&debug, state->device, &state->gpu_memory,
+                         state->window, SBI_DEBUG_DRAW_CAPACITY)) {
+    SBI_DebugDrawDestroy(&debug);
+    return false;
+  }
+
+  Uint32 lines_count = BENCH_DEBUG_LINES - BENCH_DEBUG_BOXES * 12;
+  Uint64 append_ticks = 0;
+  Uint64 upload_ticks = 0;
+  for (Uint32 f = 0; f < BENCH_WARMUP_FRAMES + BENCH_FRAMES; f++) {
+    SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(state->device);
+    if (cmd_buf == NULL) {
+      SBI_DebugDrawDestroy(&debug);
+      return false;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 i = 0; i < lines_count; i++) {
+      float x = (float)(i % 1000) * 0.1f;
+      float z = (float)(i / 1000) * 0.1f;
+      SBI_ALIGN_VEC3 SBI_Vec3 a = {x, 0.0f, z};
+      SBI_ALIGN_VEC3 SBI_Vec3 b = {x, 1.0f, z};
+      SBI_DebugDrawLine(&debug, a, b, SBI_DEBUG_COLOR(255, 255, 255, 255),
+                        SBI_DEBUG_DRAW_DEPTH);
+    }
+    for (Uint32 i = 0; i < BENCH_DEBUG_BOXES; i++) {
+      float x = (float)i;
+      SBI_ALIGN_VEC3 SBI_Vec3 min = {x, 0.0f, -1.0f};
+      SBI_ALIGN_VEC3 SBI_Vec3 max = {x + 0.5f, 0.5f, -0.5f};
+      SBI_DebugDrawAABB(&debug, min, max, SBI_DEBUG_COLOR(255, 0, 0, 255),
+                        SBI_DEBUG_DRAW_OVERLAY);
+    }
+    Uint64 appended = SDL_GetPerformanceCounter();
+    bool uploaded = SBI_DebugDrawUpload(&debug, cmd_buf);
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+    SBI_GPUMemoryEndFrame(&state->gpu_memory, fence);
+    if (fence == NULL || !uploaded) {
+      SBI_DebugDrawDestroy(&debug);
+      return false;
+    }
+    if (f >= BENCH_WARMUP_FRAMES) {
+      append_ticks += appended - start;
+      upload_ticks += end - appended;
+    }
+  }
+
+  double ms_per_tick = 1000.0 / (double)SDL_GetPerformanceFrequency();
+  SDL_Log("debug-draw %d lines: %.3f ms append, %.3f ms upload per frame",
+          BENCH_DEBUG_LINES, (double)append_ticks * ms_per_tick / BENCH_FRAMES,
+          (double)upload_ticks * ms_per_tick / BENCH_FRAMES);
+
+  SBI_DebugDrawDestroy(&debug);
+  return true;
+}
+
+// Size between one alignment unit and BENCH_GPU_MEMORY_MAX_SIZE
+static Uint32 bench_gpu_memory_size(void) {
+  return SBI_GPU_MEMORY_ALIGNMENT +
+         (Uint32)SDL_rand(BENCH_GPU_MEMORY_MAX_SIZE - SBI_GPU_MEMORY_ALIGNMENT);
+}
+
+// Record one frame of the layers into target, drawn one by one or through
+// the batch. Returns the milliseconds spent recording, negative on failure.
+static double bench_draw_batch_frame(SBI_Simulation* state,
+                                     SBI_Billboard* sets,
+                                     SBI_DrawBatch* batch,
+                                     bool batched,
+                                     SDL_GPUTexture* target,
+                                     Uint32* draws_count) {
+  SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(state->device);
+  if (cmd_buf == NULL) {
+    SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+    return -1.0;
+  }
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (Uint32 s = 0; s < BENCH_BATCH_SETS; s++) {
+    SBI_BillboardUpload(&sets[s], cmd_buf);
+  }
+  if (batched) {
+    SBI_DrawBatchBegin(batch);
+    for (Uint32 s = 0; s < BENCH_BATCH_SETS; s++) {
+      SBI_DrawBatchAdd(batch, &sets[s]);
+    }
+    SBI_DrawBatchPrepare(batch, cmd_buf);
+  }
+
+  SDL_GPUColorTargetInfo color_target_info = {
+      .texture = target,
+      .clear_color = (SDL_FColor){0.2f, 0.2f, 0.2f, 1.0f},
+      .load_op = SDL_GPU_LOADOP_CLEAR,
+      .store_op = SDL_GPU_STOREOP_STORE,
+  };
+  SDL_GPURenderPass* render_pass =
+      SDL_BeginGPURenderPass(cmd_buf, &color_target_info, 1, NULL);
+  SBI_View* view = &state->views[0];
+  if (batched) {
+    SBI_DrawBatchDraw(batch, view->camera.proj, view->camera.view,
+                      view->position, cmd_buf, render_pass);
+    *draws_count = batch->draws_count;
+  } else {
+    *draws_count = 0;
+    for (Uint32 s = 0; s < BENCH_BATCH_SETS; s++) {
+      SBI_BillboardDraw(&sets[s], view->camera.proj, view->camera.view,
+                        view->position, cmd_buf, render_pass);
+      *draws_count += sets[s].draws_count;
+    }
+  }
+  SDL_EndGPURenderPass(render_pass);
+  Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+  if (fence == NULL) {
+    SDL_Log("Failed to submit command buffer: %s", SDL_GetError());
+    return -1.0;
+  }
+  SDL_WaitForGPUFences(state->device, true, &fence, 1);
+  SDL_ReleaseGPUFence(state->device, fence);
+  return (double)elapsed * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Hundreds of small layers in four materials (two modes, two opacities),
+// recorded with a draw per layer and then through the batch
+static bool bench_draw_batch(SBI_Simulation* state) {
+  if (state->software) {
+    SDL_Log("Batching needs the GPU");
+    return false;
+  }
+
+  SBI_Billboard* sets = SDL_calloc(BENCH_BATCH_SETS, sizeof(SBI_Billboard));
+  if (sets == NULL) {
+    SDL_Log("Could not allocate memory for %d sets", BENCH_BATCH_SETS);
+    return false;
+  }
+  SDL_GPUTextureCreateInfo target_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SDL_GetGPUSwapchainTextureFormat(state->device, state->window),
+      .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
+      .width = BENCH_BATCH_TARGET_SIZE,
+      .height = BENCH_BATCH_TARGET_SIZE,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  SDL_GPUTexture* target =
+      SDL_CreateGPUTexture(state->device, &target_create_info);
+  SBI_DrawBatch batch = {0};
+  bool result = target != NULL &&
+                SBI_DrawBatchLoad(&batch, state->device,
+                                  BENCH_BATCH_SETS * BENCH_BATCH_INSTANCES);
+
+  for (Uint32 s = 0; result && s < BENCH_BATCH_SETS; s++) {
+    SBI_BillboardOptions options =
+        SBI_BillboardDefaultOptions(BENCH_BATCH_INSTANCES);
+    options.mode = s % 2 == 0 ? SBI_BILLBOARD_SPHERICAL
+                              : SBI_BILLBOARD_CYLINDRICAL;
+    options.opacity = s % 4 < 2 ? 1.0f : 0.5f;
+    options.generator.seed = s;
+    result = SBI_BillboardLoad(&sets[s], state->device, state->window,
+                               options);
+  }
+
+  static const char* path_names[2] = {"per set", "batched"};
+  double per_set_ms = 0.0;
+  for (Uint32 path = 0; result && path < 2; path++) {
+    double record_ms = 0.0;
+    Uint32 draws_count = 0;
+    for (Uint32 i = 0; result && i < BENCH_WARMUP_FRAMES + BENCH_FRAMES;
+         i++) {
+      double ms = bench_draw_batch_frame(state, sets, &batch, path == 1,
+                                         target, &draws_count);
+      result = ms >= 0.0;
+      record_ms += i >= BENCH_WARMUP_FRAMES ? ms : 0.0;
+    }
+    record_ms /= BENCH_FRAMES;
+    if (path == 0) {
+      per_set_ms = record_ms;
+    }
+    SDL_Log("draw-batch %s, %d sets: %d draws, %.3f ms record (%.2fx)",
+            path_names[path], BENCH_BATCH_SETS, draws_count, record_ms,
+            record_ms > 0.0 ? per_set_ms / record_ms : 0.0);
+  }
+
+  for (Uint32 s = 0; s < BENCH_BATCH_SETS; s++) {
+    SBI_BillboardDestroy(&sets[s]);
+  }
+  SBI_DrawBatchDestroy(&batch);
+  SDL_ReleaseGPUTexture(state->device, target);
+  SDL_free(sets);
+  return result;
+}
+
+// CPU cost of replacing a share of the objects every frame, suballocated
+// from shared blocks against a buffer created per object
+static bool bench_gpu_memory(SBI_Simulation* state) {
+  SBI_GPUMemory memory = {0};
+  SBI_GPUAllocation* allocations =
+      SDL_calloc(BENCH_GPU_MEMORY_OBJECTS, sizeof(SBI_GPUAllocation));
+  SDL_GPUBuffer** buffers =
+      SDL_calloc(BENCH_GPU_MEMORY_OBJECTS, sizeof(SDL_GPUBuffer*));
+  bool ok = allocations != NULL && buffers != NULL &&
+            SBI_GPUMemoryLoad(&memory, state->device,
+                              SBI_GPUMemoryDefaultOptions());
+  if (!ok) {
+    SDL_Log("Could not allocate memory for the GPU memory benchmark");
+  }
+
+  SDL_srand(BENCH_GPU_MEMORY_OBJECTS);
+  for (Uint32 i = 0; ok && i < BENCH_GPU_MEMORY_OBJECTS; i++) {
+    ok = SBI_GPUMemoryAlloc(&memory, SBI_GPU_POOL_STORAGE,
+                            bench_gpu_memory_size(), &allocations[i]);
+  }
+
+  // Nothing is drawn, frames without fences retire after the frame lag
+  Uint64 suballocate_ticks = 0;
+  for (Uint32 f = 0; ok && f < BENCH_WARMUP_FRAMES + BENCH_FRAMES; f++) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 c = 0; ok && c < BENCH_GPU_MEMORY_CHURN; c++) {
+      SBI_GPUAllocation* allocation =
+          &allocations[SDL_rand(BENCH_GPU_MEMORY_OBJECTS)];
+      SBI_GPUMemoryFree(&memory, allocation);
+      ok = SBI_GPUMemoryAlloc(&memory, SBI_GPU_POOL_STORAGE,
+                              bench_gpu_memory_size(), allocation);
+    }
+    SBI_GPUMemoryEndFrame(&memory, NULL);
+    if (f >= BENCH_WARMUP_FRAMES) {
+      suballocate_ticks += SDL_GetPerformanceCounter() - start;
+    }
+  }
+
+  SBI_GPUMemoryStats stats = {0};
+  SBI_GPUMemoryGetStats(&memory, SBI_GPU_POOL_STORAGE, &stats);
+
+  Uint64 create_ticks = 0;
+  for (Uint32 f = 0; ok && f < BENCH_WARMUP_FRAMES + BENCH_FRAMES; f++) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 c = 0; ok && c < BENCH_GPU_MEMORY_CHURN; c++) {
+      SDL_GPUBuffer** buffer = &buffers[SDL_rand(BENCH_GPU_MEMORY_OBJECTS)];
+      SDL_GPUBufferCreateInfo buffer_create_info = {
+          .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+          .size = bench_gpu_memory_size(),
+      };
+      SDL_ReleaseGPUBuffer(state->device, *buffer);
+      *buffer = SDL_CreateGPUBuffer(state->device, &buffer_create_info);
+      ok = *buffer != NULL;
+    }
+    if (f >= BENCH_WARMUP_FRAMES) {
+      create_ticks += SDL_GetPerformanceCounter() - start;
+    }
+  }
+
+  if (ok) {
+    double ms_per_tick = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    SDL_Log("gpu-memory %d objects, %d replaced per frame: %.3f ms "
+            "suballocated, %.3f ms with a buffer each",
+            BENCH_GPU_MEMORY_OBJECTS, BENCH_GPU_MEMORY_CHURN,
+            (double)suballocate_ticks * ms_per_tick / BENCH_FRAMES,
+            (double)create_ticks * ms_per_tick / BENCH_FRAMES);
+    SDL_Log("gpu-memory %d blocks, %.1f MB reserved, %.1f MB allocated, "
+            "%.1f MB pending, %d free ranges, fragmentation %.2f",
+            stats.blocks_count, (double)stats.reserved_bytes / 1048576.0,
+            (double)stats.allocated_bytes / 1048576.0,
+            (double)stats.pending_bytes / 1048576.0, stats.free_ranges_count,
+            stats.fragmentation);
+  }
+
+  if (buffers != NULL) {
+    for (Uint32 i = 0; i < BENCH_GPU_MEMORY_OBJECTS; i++) {
+      SDL_ReleaseGPUBuffer(state->device, buffers[i]);
+    }
+  }
+  SBI_GPUMemoryDestroy(&memory);
+  SDL_free(buffers);
+  SDL_free(allocations);
+  return ok;
+}
+
+// Compute passes of a million spawns per second, timed once the alive list
+// reached its steady size so frees and spawns balance
+static bool bench_particles(SBI_Simulation* state) {
+  if (state->software) {
+    SDL_Log("Particles need the GPU");
+    return false;
+  }
+
+  SBI_Particles particles = {0};
+  Uint32 capacity =
+      (Uint32)(BENCH_PARTICLES_RATE * BENCH_PARTICLES_LIFE * 1.25f) +
+      SBI_PARTICLES_GROUP_SIZE;
+  if (!SBI_ParticlesLoad(&particles, state->device, capacity)) {
+    return false;
+  }
+  for (Uint32 e = 0; e < BENCH_PARTICLES_EMITTERS; e++) {
+    SBI_ParticleEmitter emitter = {
+        .position = {(float)e * 4.0f, 0.0f, 0.0f},
+        .radius = 0.5f,
+        .velocity = {0.0f, 6.0f, 0.0f},
+        .spread = 2.0f,
+        .rate = BENCH_PARTICLES_RATE / BENCH_PARTICLES_EMITTERS,
+        .life_min = BENCH_PARTICLES_LIFE * 0.5f,
+        .life_max = BENCH_PARTICLES_LIFE,
+        .scale = 0.05f,
+        .gravity = 4.0f,
+        .color = 0xFFFFFFFF,
+    };
+    SBI_ParticlesAddEmitter(&particles, &emitter);
+  }
+
+  Uint32 fill_frames = (Uint32)(BENCH_PARTICLES_LIFE / BENCH_FRAME_DT);
+  Uint64 start = 0;
+  for (Uint32 i = 0; i < fill_frames + BENCH_FRAMES; i++) {
+    if (i == fill_frames) {
+      start = SDL_GetPerformanceCounter();
+    }
+
+    SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(state->device);
+    if (cmd_buf == NULL) {
+      SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+      SBI_ParticlesDestroy(&particles);
+      return false;
+    }
+    SBI_ParticlesUpdate(&particles, BENCH_FRAME_DT, cmd_buf);
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+    if (fence == NULL) {
+      SDL_Log("Failed to submit command buffer: %s", SDL_GetError());
+      SBI_ParticlesDestroy(&particles);
+      return false;
+    }
+    SDL_WaitForGPUFences(state->device, true, &fence, 1);
+    SDL_ReleaseGPUFence(state->device, fence);
+  }
+  Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+  double ms = (double)elapsed * 1000.0 /
+              (double)SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+
+  SBI_ParticlesStats stats = {0};
+  if (!SBI_ParticlesReadStats(&particles, &stats)) {
+    SBI_ParticlesDestroy(&particles);
+    return false;
+  }
+  SDL_Log("particles %.0f/s: %.3f ms/frame, %d alive, %d free of %d",
+          BENCH_PARTICLES_RATE, ms, stats.alive, stats.free, stats.capacity);
+
+  SBI_ParticlesDestroy(&particles);
+  return true;
+}
+
+// Generation of a hundred million instances of each scene over every core,
+// then a smaller count is generated again on a single worker and compared
+// bit for bit to check the output does not depend on the split
+static bool bench_generator(SBI_Simulation* state) {
+  (void)state;
+  SBI_JobPool pool;
+  SBI_JobPool serial;
+  bool loaded = SBI_JobPoolLoad(&pool, 0);
+  loaded = SBI_JobPoolLoad(&serial, 1) && loaded;
+  SBI_Vec4* instances =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * BENCH_GENERATOR_INSTANCES);
+  Uint32* colors = SDL_malloc(sizeof(Uint32) * BENCH_GENERATOR_INSTANCES);
+  SBI_Vec4* check =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * BENCH_GENERATOR_CHECK);
+  bool result = loaded && instances != NULL && colors != NULL && check != NULL;
+  if (!result) {
+    SDL_Log("Could not allocate memory for %d instances",
+            BENCH_GENERATOR_INSTANCES);
+  }
+
+  for (Uint32 kind = 0; result && kind < SBI_GENERATOR_COUNT; kind++) {
+    SBI_GeneratorOptions options = SBI_GeneratorDefaultOptions(kind);
+
+    // Fault the pages in first so only the generation is timed
+    SBI_GeneratorRun(&options, &pool, instances, colors,
+                     BENCH_GENERATOR_INSTANCES);
+    Uint64 start = SDL_GetPerformanceCounter();
+    SBI_GeneratorRun(&options, &pool, instances, colors,
+                     BENCH_GENERATOR_INSTANCES);
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    double ms =
+        (double)elapsed * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    SBI_GeneratorRun(&options, &serial, check, NULL, BENCH_GENERATOR_CHECK);
+    bool same = SDL_memcmp(instances, check,
+                           sizeof(SBI_Vec4) * BENCH_GENERATOR_CHECK) == 0;
+    SDL_Log("generator %s %d instances, %d workers: %.3f ms (%.2f ns each), "
+            "%s with 1 worker",
+            SBI_GeneratorKindName(kind), BENCH_GENERATOR_INSTANCES,
+            pool.workers_count, ms, ms * 1e6 / BENCH_GENERATOR_INSTANCES,
+            same ? "same" : "DIFFERENT");
+    result = same;
+  }
+
+  SDL_aligned_free(check);
+  SDL_free(colors);
+  SDL_aligned_free(instances);
+  SBI_JobPoolDestroy(&serial);
+  SBI_JobPoolDestroy(&pool);
+  return result;
+}
+
+// Inputs and outputs of a math kernel, normalize reads x as packed vec3s
+typedef struct {
+  const float* x;
+  const float* y;
+  float* dest;
+  float* scratch;
+  Uint64 count;
+} BenchMathData;
+
+typedef void (*BenchMathReference)(const BenchMathData* data);
+typedef void (*BenchMathBatch)(const BenchMathData* data, SBI_MathTier tier);
+
+typedef struct {
+  const char* name;
+  float x_min;
+  float x_max;
+  float y_min;
+  float y_max;
+  bool log_scale;
+  BenchMathReference reference;
+  BenchMathBatch batch;
+} BenchMathKernel;
+
+static void bench_libm_sin(const BenchMathData* data) {
+  for (Uint64 i = 0; i < data->count; i++) {
+    data->dest[i] = SDL_sinf(data->x[i]);
+    data->scratch[i] = SDL_cosf(data->x[i]);
+  }
+}
+
+static void bench_libm_exp(const BenchMathData* data) {
+  for (Uint64 i = 0; i < data->count; i++) {
+    data->dest[i] = SDL_expf(data->x[i]);
+  }
+}
+
+static void bench_libm_log(const BenchMathData* data) {
+  for (Uint64 i = 0; i < data->count; i++) {
+    data->dest[i] = SDL_logf(data->x[i]);
+  }
+}
+
+static void bench_libm_pow(const BenchMathData* data) {
+  for (Uint64 i = 0; i < data->count; i++) {
+    data->dest[i] = SDL_powf(data->x[i], data->y[i]);
+  }
+}
+
+static void bench_libm_normalize(const BenchMathData* data) {
+  for (Uint64 i = 0; i + 2 < data->count; i += 3) {
+    const float* v = &data->x[i];
+    float len = SDL_sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    data->dest[i] = v[0] * inv;
+    data->dest[i + 1] = v[1] * inv;
+    data->dest[i + 2] = v[2] * inv;
+  }
+}
+
+static void bench_batch_sin(const BenchMathData* data, SBI_MathTier tier) {
+  SBI_SinCosBatch(data->x, data->dest, data->scratch, data->count, tier);
+}
+
+static void bench_batch_exp(const BenchMathData* data, SBI_MathTier tier) {
+  SBI_ExpBatch(data->x, data->dest, data->count, tier);
+}
+
+static void bench_batch_log(const BenchMathData* data, SBI_MathTier tier) {
+  SBI_LogBatch(data->x, data->dest, data->count, tier);
+}
+
+static void bench_batch_pow(const BenchMathData* data, SBI_MathTier tier) {
+  SBI_PowBatch(data->x, data->y, data->dest, data->count, tier);
+}
+
+static void bench_batch_normalize(const BenchMathData* data,
+                                  SBI_MathTier tier) {
+  SBI_Vec3NormalizeBatch((const SBI_Vec3*)data->x, (SBI_Vec3*)data->dest,
+                         data->count / 3, tier);
+}
+
+// Nanoseconds per value of the best of a few rounds
+static double bench_math_time(const BenchMathKernel* kernel,
+                              const BenchMathData* data,
+                              int tier) {
+  double best = 0.0;
+  for (Uint32 round = 0; round < BENCH_MATH_ROUNDS; round++) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (tier < 0) {
+      kernel->reference(data);
+    } else {
+      kernel->batch(data, (SBI_MathTier)tier);
+    }
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    double ns = (double)elapsed * 1e9 /
+                (double)SDL_GetPerformanceFrequency() / (double)data->count;
+    if (round == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+// Largest error relative to max(1, |reference|), covers both the absolute
+// error of sin/log and the relative error of exp/pow
+static float bench_math_error(const float* expected,
+                              const float* actual,
+                              Uint64 count) {
+  float error = 0.0f;
+  for (Uint64 i = 0; i < count; i++) {
+    float scale = SDL_max(1.0f, SDL_fabsf(expected[i]));
+    error = SDL_max(error, SDL_fabsf(actual[i] - expected[i]) / scale);
+  }
+  return error;
+}
+
+// Throughput and max error of both tiers of each batched kernel against
+// the scalar libm path over the same inputs
+static bool bench_xmath(SBI_Simulation* state) {
+  static const BenchMathKernel kernels[] = {
+      {"sincos", -1000.0f, 1000.0f, 0.0f, 0.0f, false, bench_libm_sin,
+       bench_batch_sin},
+      {"exp", -87.0f, 88.0f, 0.0f, 0.0f, false, bench_libm_exp,
+       bench_batch_exp},
+      {"log", -30.0f, 30.0f, 0.0f, 0.0f, true, bench_libm_log,
+       bench_batch_log},
+      {"pow", -2.0f, 2.0f, -4.0f, 4.0f, true, bench_libm_pow,
+       bench_batch_pow},
+      {"normalize", -100.0f, 100.0f, 0.0f, 0.0f, false,
+       bench_libm_normalize, bench_batch_normalize},
+  };
+  (void)state;
+
+  float* x = SDL_aligned_alloc(16, sizeof(float) * BENCH_MATH_VALUES);
+  float* y = SDL_aligned_alloc(16, sizeof(float) * BENCH_MATH_VALUES);
+  float* expected = SDL_aligned_alloc(16, sizeof(float) * BENCH_MATH_VALUES);
+  float* actual = SDL_aligned_alloc(16, sizeof(float) * BENCH_MATH_VALUES);
+  float* scratch = SDL_aligned_alloc(16, sizeof(float) * BENCH_MATH_VALUES);
+  bool ok = x != NULL && y != NULL && expected != NULL && actual != NULL &&
+            scratch != NULL;
+
+  for (Uint32 k = 0; ok && k < SDL_arraysize(kernels); k++) {
+    const BenchMathKernel* kernel = &kernels[k];
+    for (Uint64 i = 0; i < BENCH_MATH_VALUES; i++) {
+      float u = SDL_randf();
+      x[i] = kernel->x_min + (kernel->x_max - kernel->x_min) * u;
+      if (kernel->log_scale) {
+        x[i] = SDL_expf(x[i]);
+      }
+      y[i] = kernel->y_min + (kernel->y_max - kernel->y_min) * SDL_randf();
+    }
+
+    BenchMathData reference = {x, y, expected, scratch, BENCH_MATH_VALUES};
+    BenchMathData batch = {x, y, actual, scratch, BENCH_MATH_VALUES};
+    double libm_ns = bench_math_time(kernel, &reference, -1);
+    double accurate_ns = bench_math_time(kernel, &batch, SBI_MATH_ACCURATE);
+    float accurate_error =
+        bench_math_error(expected, actual, BENCH_MATH_VALUES);
+    double fast_ns = bench_math_time(kernel, &batch, SBI_MATH_FAST);
+    float fast_error = bench_math_error(expected, actual, BENCH_MATH_VALUES);
+
+    SDL_Log("%-9s libm %.2f ns | accurate %.2f ns (%.2fx) err %.2g | "
+            "fast %.2f ns (%.2fx) err %.2g",
+            kernel->name, libm_ns, accurate_ns, libm_ns / accurate_ns,
+            accurate_error, fast_ns, libm_ns / fast_ns, fast_error);
+  }
+
+  SDL_aligned_free(scratch);
+  SDL_aligned_free(actual);
+  SDL_aligned_free(expected);
+  SDL_aligned_free(y);
+  SDL_aligned_free(x);
+  return ok;
+}
@@ -0,0 +1,10 @@
+#ifndef SBI_BENCH_H
+#define SBI_BENCH_H
+
+#include "simulation.h"
+
+// Run an in-app benchmark against the real device and log its report.
+// Selected with --bench <name>, the app exits once it finishes.
+bool SBI_BenchRun(SBI_Simulation* state, const char* name);
+
+#endif /* SBI_BENCH_H */
@@ -1,4 +1,7 @@
 #include "billboard.h"
+#include "hiz.h"
+#include "memtrack.h"
+#include "oit.h"
 #include "shader.h"
 #include "xmath.h"
 
@@ -6,48 +9,345 @@
 #include <SDL3/SDL_log.h>
 #include <SDL3/SDL_stdinc.h>
 
+typedef struct {
+  Uint32 counts[4];
+} BillboardScatterUniforms;
+
 typedef struct {
   SBI_ALIGN_MAT4 SBI_Mat4 pv;
-  SBI_ALIGN_VEC3 SBI_Vec3 view_pos;
+  SBI_ALIGN_VEC4 SBI_Vec4 view_pos;
+  SBI_ALIGN_VEC4 SBI_Vec4 view_right;
+  SBI_ALIGN_VEC4 SBI_Vec4 view_up;
+  SBI_ALIGN_VEC4 SBI_Vec4 animation;
+  SBI_ALIGN_VEC4 Uint32 visibility[4];
 } BillboardUniforms;
 
+// Pixels of a side of each generated sprite sheet frame
+#define BILLBOARD_ATLAS_FRAME_SIZE (32)
+
+// Vertex shader specialized for each SBI_BillboardMode
+static const char* billboard_vert_shaders[SBI_BILLBOARD_MODE_COUNT] = {
+    "billboard.vert",
+    "billboard_cylindrical.vert",
+    "billboard_screen.vert",
+    "billboard_fixed.vert",
+};
+
+// Bytes of an instance in each SBI_BillboardStream
+static const Uint32 billboard_stream_strides[SBI_BILLBOARD_STREAM_COUNT] = {
+    sizeof(SBI_Vec4),
+    sizeof(Uint32),
+    sizeof(SBI_BillboardAnimation),
+};
+
+// Two triangles over the 4 quad corners of the vertex shader
+static const Uint16 billboard_quad_indices[6] = {0, 1, 2, 2, 3, 0};
+
 float remap_value(float value,
                   float start1,
                   float stop1,
                   float start2,
                   float stop2);
 
-bool SBI_BillboardLoad(SBI_Billboard* billboard,
-                       SDL_GPUDevice* device,
-                       SDL_Window* window,
-                       Uint64 instances_count) {
+static int compare_sort_keys(const void* a, const void* b) {
+  const SBI_BillboardSortKey* ka = a;
+  const SBI_BillboardSortKey* kb = b;
+  if (ka->distance == kb->distance) {
+    return 0;
+  }
+
+  // Farthest first
+  return ka->distance > kb->distance ? -1 : 1;
+}
+
+SBI_BillboardOptions SBI_BillboardDefaultOptions(Uint64 instances_count) {
+  return (SBI_BillboardOptions){
+      .instances_count = instances_count,
+      .mode = SBI_BILLBOARD_SPHERICAL,
+      .blend = SBI_BILLBOARD_BLEND_UNSORTED,
+      .opacity = 1.0f,
+      .animated = false,
+      .atlas_columns = 1,
+      .atlas_rows = 1,
+      .depth_test = false,
+      .lights = NULL,
+      .sparse_capacity = SBI_BILLBOARD_SPARSE_CAPACITY,
+      .sparse_ratio = SBI_BILLBOARD_SPARSE_RATIO,
+      .generator = SBI_GeneratorDefaultOptions(SBI_GENERATOR_UNIFORM),
+  };
+}
+
+// Only animated sets pay for the animation stream
+static bool billboard_has_stream(const SBI_BillboardOptions* options,
+                                 SBI_BillboardStream stream) {
+  return stream != SBI_BILLBOARD_STREAM_ANIMATION || options->animated;
+}
+
+// Alpha of a ring growing across the frames of the sheet, white otherwise
+static Uint32 billboard_atlas_texel(Uint32 frame,
+                                    Uint32 frames_count,
+                                    Uint32 x,
+                                    Uint32 y) {
+  if (frames_count == 1) {
+    return 0xFFFFFFFFu;
+  }
+
+  float half = BILLBOARD_ATLAS_FRAME_SIZE * 0.5f;
+  float dx = ((float)x + 0.5f - half) / half;
+  float dy = ((float)y + 0.5f - half) / half;
+  float radius = 0.15f + 0.8f * (float)frame / (float)(frames_count - 1);
+  float ring = 1.0f - SDL_fabsf(SDL_sqrtf(dx * dx + dy * dy) - radius) * 6.0f;
+  Uint32 alpha = (Uint32)(SDL_clamp(ring, 0.0f, 1.0f) * 255.0f);
+  return 0x00FFFFFFu | (alpha << 24);
+}
+
+// Generate the sprite sheet, frames are stored left to right, top to bottom
+static bool billboard_load_atlas(SBI_Billboard* billboard,
+                                 Uint32 columns,
+                                 Uint32 rows) {
+  SDL_GPUDevice* device = billboard->device;
+  Uint32 frames_count = columns * rows;
+  Uint32 frame_size = frames_count > 1 ? BILLBOARD_ATLAS_FRAME_SIZE : 1;
+  Uint32 width = columns * frame_size;
+  Uint32 height = rows * frame_size;
+  billboard->atlas_columns = columns;
+  billboard->atlas_rows = rows;
+
+  SDL_GPUTextureCreateInfo texture_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+      .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  billboard->atlas = SDL_CreateGPUTexture(device, &texture_create_info);
+  if (billboard->atlas == NULL) {
+    SDL_Log("Couldn't create billboard atlas: %s", SDL_GetError());
+    return false;
+  }
+
+  // Nearest filtering so neighbouring frames never bleed into each other
+  SDL_GPUSamplerCreateInfo sampler_create_info = {
+      .min_filter = SDL_GPU_FILTER_NEAREST,
+      .mag_filter = SDL_GPU_FILTER_NEAREST,
+      .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST,
+      .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+  };
+  billboard->atlas_sampler = SDL_CreateGPUSampler(device, &sampler_create_info);
+  if (billboard->atlas_sampler == NULL) {
+    SDL_Log("Couldn't create sampler for billboard atlas");
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = width * height * sizeof(Uint32),
+  };
+  SDL_GPUTransferBuffer* transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &transfer_create_info);
+  if (transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of billboard atlas");
+    return false;
+  }
+
+  Uint32* texels = SDL_MapGPUTransferBuffer(device, transfer_buffer, false);
+  for (Uint32 y = 0; y < height; y++) {
+    for (Uint32 x = 0; x < width; x++) {
+      Uint32 frame = (y / frame_size) * columns + x / frame_size;
+      texels[y * width + x] = billboard_atlas_texel(
+          frame, frames_count, x % frame_size, y % frame_size);
+    }
+  }
+  SDL_UnmapGPUTransferBuffer(device, transfer_buffer);
+
+  SDL_GPUCommandBuffer* upload_cmd_buf = SDL_AcquireGPUCommandBuffer(device);
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buf);
+  {
+    SDL_GPUTextureTransferInfo source = {
+        .transfer_buffer = transfer_buffer,
+        .offset = 0,
+    };
+    SDL_GPUTextureRegion destination = {
+        .texture = billboard->atlas,
+        .w = width,
+        .h = height,
+        .d = 1,
+    };
+    SDL_UploadToGPUTexture(copy_pass, &source, &destination, false);
+  }
+  SDL_EndGPUCopyPass(copy_pass);
+  SDL_SubmitGPUCommandBuffer(upload_cmd_buf);
+
+  // Released once the upload completes
+  SDL_ReleaseGPUTransferBuffer(device, transfer_buffer);
+  return true;
+}
+
+// Lists of changed instances and the buffers they are scattered from, each
+// stream has a region of indices followed by their values
+static bool billboard_load_scatter(SBI_Billboard* billboard) {
+  SDL_GPUDevice* device = billboard->device;
+  Uint32 capacity = billboard->sparse_capacity;
+  Uint64 scatter_size = 0;
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (stream->data == NULL) {
+      continue;
+    }
+
+    stream->sparse = SDL_malloc(sizeof(Uint32) * capacity);
+    if (stream->sparse == NULL) {
+      SDL_Log("Could not allocate memory for %d sparse changes", capacity);
+      return false;
+    }
+    stream->scatter_offset = scatter_size;
+    scatter_size += (Uint64)(sizeof(Uint32) + stream->stride) * capacity;
+  }
+
+  SBI_ComputeOptions scatter_options = (SBI_ComputeOptions){
+      .filename = "billboard_scatter.comp",
+      .readonly_storage_buffer_count = 1,
+      .readwrite_storage_buffer_count = 1,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_BILLBOARD_SCATTER_GROUP_SIZE,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  billboard->scatter_pipeline =
+      SBI_ComputePipelineLoad(device, scatter_options);
+  if (billboard->scatter_pipeline == NULL) {
+    SDL_Log("Couldn't create compute pipeline for billboard scatter");
+    return false;
+  }
+
+  SDL_GPUBufferCreateInfo buffer_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+      .size = (Uint32)scatter_size,
+  };
+  billboard->scatter_buffer = SDL_CreateGPUBuffer(device, &buffer_create_info);
+  if (billboard->scatter_buffer == NULL) {
+    SDL_Log("Couldn't create scatter buffer of billboards");
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = (Uint32)scatter_size,
+  };
+  billboard->scatter_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &transfer_create_info);
+  if (billboard->scatter_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create scatter transfer buffer of billboards");
+    return false;
+  }
+  return true;
+}
+
+static bool billboard_load(SBI_Billboard* billboard,
+                           SDL_GPUDevice* device,
+                           SDL_Window* window,
+                           SBI_BillboardOptions options) {
+  Uint64 instances_count = options.instances_count;
+  SBI_BillboardMode mode = options.mode;
+  Uint32 atlas_columns =
+      options.animated ? SDL_max(options.atlas_columns, 1) : 1;
+  Uint32 atlas_rows = options.animated ? SDL_max(options.atlas_rows, 1) : 1;
   billboard->instances_count = instances_count;
+  billboard->mode = mode;
+  billboard->blend = options.blend;
+  billboard->opacity = options.opacity;
+  billboard->depth_test = options.depth_test;
+  billboard->sorted = false;
+
+  // Sorted sets upload every stream each frame, nothing to scatter
+  bool sorted = options.blend == SBI_BILLBOARD_BLEND_SORTED;
+  billboard->sparse_capacity = sorted ? 0 : options.sparse_capacity;
+  billboard->sparse_ratio = options.sparse_ratio;
 
-  size_t instances_buffer_size = sizeof(SBI_Vec4) * instances_count;
-  billboard->instances = SDL_aligned_alloc(16, instances_buffer_size);
-  if (billboard->instances == NULL) {
-    SDL_Log("Could not allocate memory for %ld billboards", instances_count);
+  // Transparent instances are never lit, one less shader variant
+  bool oit = options.blend == SBI_BILLBOARD_BLEND_OIT;
+  billboard->lights = oit ? NULL : options.lights;
+  if (oit && options.lights != NULL) {
+    SDL_Log("Billboards blended with OIT are not lit");
+  }
+
+  // Every stream shares one transfer buffer, one region per stream
+  Uint64 transfer_size = 0;
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (!billboard_has_stream(&options, s)) {
+      continue;
+    }
+
+    size_t stream_size = billboard_stream_strides[s] * instances_count;
+    stream->stride = billboard_stream_strides[s];
+    stream->transfer_offset = transfer_size;
+    stream->data = SDL_aligned_alloc(16, stream_size);
+    if (stream->data == NULL) {
+      SDL_Log("Could not allocate memory for %ld billboards", instances_count);
+      return false;
+    }
+    SDL_memset(stream->data, 0, stream_size);
+    SBI_BillboardMarkDirty(billboard, s, 0, instances_count);
+    transfer_size += stream_size;
+  }
+  billboard->instances = billboard->streams[SBI_BILLBOARD_STREAM_POSITION].data;
+  billboard->colors = billboard->streams[SBI_BILLBOARD_STREAM_COLOR].data;
+  billboard->animations =
+      billboard->streams[SBI_BILLBOARD_STREAM_ANIMATION].data;
+  billboard->time = 0.0f;
+
+  if (!SBI_GeneratorRun(&options.generator, NULL, billboard->instances,
+                        billboard->colors, instances_count)) {
     return false;
   }
-  SDL_memset(billboard->instances, 0, instances_buffer_size);
 
-  for (Uint64 i = 0; i < instances_count; i++) {
-    float rx = remap_value(SDL_randf(), 0.0f, 1.0f, -10.0f, 10.0f);
-    float ry = remap_value(SDL_randf(), 0.0f, 1.0f, -10.0f, 10.0f);
-    float rz = remap_value(SDL_randf(), 0.0f, 1.0f, -10.0f, 10.0f);
-    billboard->instances[i][0] = rx;
-    billboard->instances[i][1] = ry;
-    billboard->instances[i][2] = rz;
-    billboard->instances[i][3] = 0.5f;
+  // Every instance plays the whole sheet at its own rate and phase, drawn
+  // from the scene seed so the same seed animates the same way
+  Uint32 frames_count = atlas_columns * atlas_rows;
+  for (Uint64 i = 0; options.animated && i < instances_count; i++) {
+    Uint32 words[4];
+    SBI_GeneratorBlock(&options.generator, i, 0,
+                       SBI_GENERATOR_DOMAIN_ANIMATION, words);
+    float fps = (float)(words[0] >> 8) / 16777216.0f;
+    float phase = (float)(words[1] >> 8) / 16777216.0f;
+    billboard->animations[i] = (SBI_BillboardAnimation){
+        .first_frame = 0,
+        .frames_count = (Uint16)frames_count,
+        .loop = SBI_BILLBOARD_LOOP_REPEAT,
+        .fps = remap_value(fps, 0.0f, 1.0f, 8.0f, 16.0f),
+        .phase = phase * (float)frames_count,
+    };
   }
 
+  // Scratch space to order the upload back to front
+  if (options.blend == SBI_BILLBOARD_BLEND_SORTED) {
+    billboard->sort_keys =
+        SDL_malloc(sizeof(SBI_BillboardSortKey) * instances_count);
+    if (billboard->sort_keys == NULL) {
+      SDL_Log("Could not allocate memory to sort %ld billboards",
+              instances_count);
+      return false;
+    }
+  }
+
+  // Sets of the software rasterizer only need the CPU streams
   billboard->device = device;
+  if (device == NULL) {
+    return true;
+  }
+
   SBI_ShaderOptions vert_options = (SBI_ShaderOptions){
-      .filename = "billboard.vert",
+      .filename = billboard_vert_shaders[mode],
       .stage = SDL_GPU_SHADERSTAGE_VERTEX,
       .sampler_count = 0,
       .uniform_buffer_count = 1,
-      .storage_buffer_count = 1,
+      .storage_buffer_count = SBI_BILLBOARD_STREAM_COUNT + 1,
       .storage_texture_count = 0,
   };
   SDL_GPUShader* vert_shader = SBI_ShaderLoad(device, vert_options);
@@ -55,12 +355,21 @@ bool SBI_BillboardLoad(SBI_Billboard* billboard,
     return false;
   }
 
+  // Sorted and unsorted sets share the premultiplied alpha shader, lit sets
+  // also read the light clusters
+  bool lit = billboard->lights != NULL;
+  const char* frag_filename = "billboard.frag";
+  if (oit) {
+    frag_filename = "billboard_oit.frag";
+  } else if (lit) {
+    frag_filename = "billboard_lit.frag";
+  }
   SBI_ShaderOptions frag_options = (SBI_ShaderOptions){
-      .filename = "billboard.frag",
+      .filename = frag_filename,
       .stage = SDL_GPU_SHADERSTAGE_FRAGMENT,
-      .sampler_count = 0,
-      .uniform_buffer_count = 0,
-      .storage_buffer_count = 0,
+      .sampler_count = 1,
+      .uniform_buffer_count = lit ? 1 : 0,
+      .storage_buffer_count = lit ? 3 : 0,
       .storage_texture_count = 0,
   };
   SDL_GPUShader* frag_shader = SBI_ShaderLoad(device, frag_options);
@@ -87,11 +396,58 @@ bool SBI_BillboardLoad(SBI_Billboard* billboard,
       }},
   };
 
+  // Weighted blended OIT: additive accumulation and multiplicative revealage
+  SDL_GPUGraphicsPipelineTargetInfo oit_target_info = {
+      .num_color_targets = 2,
+      .color_target_descriptions = (SDL_GPUColorTargetDescription[]){
+          {
+              .format = SBI_OIT_ACCUM_FORMAT,
+              .blend_state =
+                  (SDL_GPUColorTargetBlendState){
+                      .enable_blend = true,
+                      .src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                      .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                      .color_blend_op = SDL_GPU_BLENDOP_ADD,
+                      .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                      .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                      .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+                  },
+          },
+          {
+              .format = SBI_OIT_REVEAL_FORMAT,
+              .blend_state =
+                  (SDL_GPUColorTargetBlendState){
+                      .enable_blend = true,
+                      .src_color_blendfactor = SDL_GPU_BLENDFACTOR_ZERO,
+                      .dst_color_blendfactor =
+                          SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_COLOR,
+                      .color_blend_op = SDL_GPU_BLENDOP_ADD,
+                      .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ZERO,
+                      .dst_alpha_blendfactor =
+                          SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                      .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+                  },
+          },
+      },
+  };
+
+  // Occluded instances are rejected by the depth test of nearer ones
+  if (options.depth_test) {
+    color_target_info.has_depth_stencil_target = true;
+    color_target_info.depth_stencil_format = SBI_HIZ_DEPTH_FORMAT;
+  }
+
   SDL_GPUGraphicsPipelineCreateInfo pipeline_create_info = {
-      .target_info = color_target_info,
+      .target_info = oit ? oit_target_info : color_target_info,
       .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
       .vertex_shader = vert_shader,
       .fragment_shader = frag_shader,
+      .depth_stencil_state =
+          (SDL_GPUDepthStencilState){
+              .compare_op = SDL_GPU_COMPAREOP_LESS,
+              .enable_depth_test = options.depth_test,
+              .enable_depth_write = options.depth_test,
+          },
   };
   billboard->pipeline =
       SDL_CreateGPUGraphicsPipeline(device, &pipeline_create_info);
@@ -104,21 +460,50 @@ bool SBI_BillboardLoad(SBI_Billboard* billboard,
     return false;
   }
 
-  // Create buffer location for transform
-  SDL_GPUBufferCreateInfo buffer_create_info = {
-      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
-      .size = instances_buffer_size,
+  // Create a storage buffer per attribute stream
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (stream->data == NULL) {
+      continue;
+    }
+
+    // Positions are also read by the occlusion culling pass, and sparse
+    // changes are written by the scatter pass
+    SDL_GPUBufferCreateInfo buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+                 SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+        .size = stream->stride * instances_count,
+    };
+    if (billboard->sparse_capacity > 0) {
+      buffer_create_info.usage |= SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    }
+    stream->buffer = SDL_CreateGPUBuffer(device, &buffer_create_info);
+    if (stream->buffer == NULL) {
+      SDL_Log("Couldn't create buffer for billboard stream %d", s);
+      return false;
+    }
+  }
+
+  if (billboard->sparse_capacity > 0 && !billboard_load_scatter(billboard)) {
+    return false;
+  }
+
+  // Create the quad index buffer, shared by every instance
+  SDL_GPUBufferCreateInfo index_buffer_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+      .size = sizeof(billboard_quad_indices),
   };
-  billboard->buffer = SDL_CreateGPUBuffer(device, &buffer_create_info);
-  if (billboard->buffer == NULL) {
-    SDL_Log("Couldn't create buffer to store the params of debug grid");
+  billboard->index_buffer =
+      SDL_CreateGPUBuffer(device, &index_buffer_create_info);
+  if (billboard->index_buffer == NULL) {
+    SDL_Log("Couldn't create index buffer of billboard");
     return false;
   }
 
   // Create transfer buffer handle
   SDL_GPUTransferBufferCreateInfo upload_transfer_buffer_create_info = {
       .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-      .size = instances_buffer_size,
+      .size = SDL_max(transfer_size, sizeof(billboard_quad_indices)),
   };
   billboard->upload_transfer_buffer =
       SDL_CreateGPUTransferBuffer(device, &upload_transfer_buffer_create_info);
@@ -127,67 +512,491 @@ bool SBI_BillboardLoad(SBI_Billboard* billboard,
     return false;
   }
 
-  return true;
+  // Upload the quad indices once, they never change
+  void* transfer_point = SDL_MapGPUTransferBuffer(
+      device, billboard->upload_transfer_buffer, false);
+  SDL_memcpy(transfer_point, billboard_quad_indices,
+             sizeof(billboard_quad_indices));
+  SDL_UnmapGPUTransferBuffer(device, billboard->upload_transfer_buffer);
+
+  SDL_GPUCommandBuffer* upload_cmd_buf = SDL_AcquireGPUCommandBuffer(device);
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buf);
+  {
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = billboard->upload_transfer_buffer,
+        .offset = 0,
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = billboard->index_buffer,
+        .offset = 0,
+        .size = sizeof(billboard_quad_indices),
+    };
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+  }
+  SDL_EndGPUCopyPass(copy_pass);
+  SDL_SubmitGPUCommandBuffer(upload_cmd_buf);
+
+  return billboard_load_atlas(billboard, atlas_columns, atlas_rows);
 }
 
-void SBI_BillboardDraw(SBI_Billboard* billboard,
-                       const SBI_Mat4 proj,
-                       const SBI_Mat4 view,
-                       const SBI_Vec3 view_pos,
-                       SDL_GPUCommandBuffer* cmd_buf,
-                       SDL_GPURenderPass* render_pass) {
-  BillboardUniforms uniforms = {0};
-  SBI_Mat4Mul(proj, view, uniforms.pv);
-  SBI_Vec3Copy(view_pos, uniforms.view_pos);
+bool SBI_BillboardLoad(SBI_Billboard* billboard,
+                       SDL_GPUDevice* device,
+                       SDL_Window* window,
+                       SBI_BillboardOptions options) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_BILLBOARD);
+  bool result = billboard_load(billboard, device, window, options);
+  SBI_MemTrackPop(tag);
+  return result;
+}
 
-  SDL_BindGPUGraphicsPipeline(render_pass, billboard->pipeline);
-  {
-    // Copy data to the staging of the GPU
-    void* transfer_point = SDL_MapGPUTransferBuffer(
-        billboard->device, billboard->upload_transfer_buffer, 0);
-    SDL_memcpy(transfer_point, billboard->instances,
-               sizeof(SBI_Vec4) * billboard->instances_count);
+void SBI_BillboardMarkDirty(SBI_Billboard* billboard,
+                            SBI_BillboardStream stream,
+                            Uint64 first,
+                            Uint64 count) {
+  SBI_BillboardStreamBuffer* buffer = &billboard->streams[stream];
+  Uint64 last = SDL_min(first + count, billboard->instances_count);
+  if (first >= last || buffer->data == NULL) {
+    return;
+  }
+
+  billboard->version++;
+  if (buffer->dirty_begin >= buffer->dirty_end) {
+    buffer->dirty_begin = first;
+    buffer->dirty_end = last;
+  } else {
+    buffer->dirty_begin = SDL_min(buffer->dirty_begin, first);
+    buffer->dirty_end = SDL_max(buffer->dirty_end, last);
+  }
+
+  // Once the list is full only the range is uploaded this frame
+  if (buffer->sparse == NULL || buffer->sparse_full) {
+    return;
+  }
+  if (last - first > billboard->sparse_capacity - buffer->sparse_count) {
+    buffer->sparse_full = true;
+    return;
+  }
+  for (Uint64 i = first; i < last; i++) {
+    buffer->sparse[buffer->sparse_count++] = (Uint32)i;
+  }
+}
+
+// Scatter a stream when its (index, value) pairs are smaller than the
+// given fraction of its dirty range
+static bool billboard_stream_scatters(const SBI_Billboard* billboard,
+                                      const SBI_BillboardStreamBuffer* stream) {
+  if (stream->sparse == NULL || stream->sparse_full ||
+      stream->sparse_count == 0) {
+    return false;
+  }
+
+  Uint64 range_bytes = (stream->dirty_end - stream->dirty_begin) *
+                       stream->stride;
+  Uint64 pairs_bytes =
+      (Uint64)stream->sparse_count * (sizeof(Uint32) + stream->stride);
+  return (double)pairs_bytes <=
+         (double)range_bytes * (double)billboard->sparse_ratio;
+}
+
+static void billboard_upload(SBI_Billboard* billboard,
+                             SDL_GPUCommandBuffer* cmd_buf) {
+  billboard->uploaded_bytes = 0;
+  billboard->scattered_count = 0;
+  billboard->draws_count = 0;
+  if (billboard->instances_count == 0 || billboard->device == NULL) {
+    return;
+  }
+
+  // A sorted upload rewrites every stream in the new order, and the first
+  // upload after it has to restore the array order
+  bool full = billboard->sorted || billboard->gpu_sorted;
+  bool scatters[SBI_BILLBOARD_STREAM_COUNT] = {0};
+  bool any_ranged = false;
+  bool any_scattered = false;
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (full && stream->data != NULL) {
+      stream->dirty_begin = 0;
+      stream->dirty_end = billboard->instances_count;
+      stream->sparse_full = true;
+    }
+    if (stream->dirty_begin >= stream->dirty_end) {
+      continue;
+    }
+
+    scatters[s] = billboard_stream_scatters(billboard, stream);
+    any_scattered = any_scattered || scatters[s];
+    any_ranged = any_ranged || !scatters[s];
+  }
+
+  if (!any_ranged && !any_scattered) {
+    return;
+  }
+
+  // Copy the dirty ranges to the staging of the GPU
+  if (any_ranged) {
+    Uint8* transfer_point = SDL_MapGPUTransferBuffer(
+        billboard->device, billboard->upload_transfer_buffer, true);
+    for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+      SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+      if (stream->dirty_begin >= stream->dirty_end || scatters[s]) {
+        continue;
+      }
+
+      Uint8* dst = transfer_point + stream->transfer_offset +
+                   stream->dirty_begin * stream->stride;
+      const Uint8* src = stream->data;
+      if (billboard->sorted) {
+        for (Uint64 i = 0; i < billboard->instances_count; i++) {
+          Uint64 index = billboard->sort_keys[i].index;
+          SDL_memcpy(dst + i * stream->stride, src + index * stream->stride,
+                     stream->stride);
+        }
+      } else {
+        SDL_memcpy(dst, src + stream->dirty_begin * stream->stride,
+                   (stream->dirty_end - stream->dirty_begin) * stream->stride);
+      }
+    }
     SDL_UnmapGPUTransferBuffer(billboard->device,
                                billboard->upload_transfer_buffer);
+  }
+
+  // Pack the changed instances as their indices followed by their values
+  if (any_scattered) {
+    Uint8* transfer_point = SDL_MapGPUTransferBuffer(
+        billboard->device, billboard->scatter_transfer_buffer, true);
+    for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+      SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+      if (!scatters[s]) {
+        continue;
+      }
+
+      Uint32* indices = (Uint32*)(transfer_point + stream->scatter_offset);
+      Uint8* values = (Uint8*)(indices + stream->sparse_count);
+      const Uint8* src = stream->data;
+      SDL_memcpy(indices, stream->sparse,
+                 sizeof(Uint32) * stream->sparse_count);
+      for (Uint32 i = 0; i < stream->sparse_count; i++) {
+        SDL_memcpy(values + (Uint64)i * stream->stride,
+                   src + (Uint64)stream->sparse[i] * stream->stride,
+                   stream->stride);
+      }
+    }
+    SDL_UnmapGPUTransferBuffer(billboard->device,
+                               billboard->scatter_transfer_buffer);
+  }
+
+  // Bounds only change with the positions, scattered ones can only grow
+  // them so the scan stays proportional to the changes
+  SBI_BillboardStreamBuffer* positions =
+      &billboard->streams[SBI_BILLBOARD_STREAM_POSITION];
+  if (positions->dirty_begin < positions->dirty_end) {
+    Uint64 count = billboard->instances_count;
+    if (scatters[SBI_BILLBOARD_STREAM_POSITION]) {
+      count = positions->sparse_count;
+    } else {
+      SBI_Vec3Copy(billboard->instances[0], billboard->bounds_min);
+      SBI_Vec3Copy(billboard->instances[0], billboard->bounds_max);
+    }
+    for (Uint64 i = 0; i < count; i++) {
+      Uint64 index = scatters[SBI_BILLBOARD_STREAM_POSITION]
+                         ? positions->sparse[i]
+                         : i;
+      const float* instance = billboard->instances[index];
+      for (Uint32 c = 0; c < 3; c++) {
+        billboard->bounds_min[c] =
+            SDL_min(billboard->bounds_min[c], instance[c] - instance[3]);
+        billboard->bounds_max[c] =
+            SDL_max(billboard->bounds_max[c], instance[c] + instance[3]);
+      }
+    }
+  }
+
+  // Record the copies in the frame command buffer, shared by every view
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (stream->dirty_begin >= stream->dirty_end) {
+      continue;
+    }
 
-    // Create a copy pass
-    SDL_GPUCommandBuffer* upload_cmd_buf =
-        SDL_AcquireGPUCommandBuffer(billboard->device);
-    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buf);
-    {
+    if (scatters[s]) {
       SDL_GPUTransferBufferLocation source = {
-          .transfer_buffer = billboard->upload_transfer_buffer,
-          .offset = 0,
+          .transfer_buffer = billboard->scatter_transfer_buffer,
+          .offset = (Uint32)stream->scatter_offset,
       };
       SDL_GPUBufferRegion destination = {
-          .buffer = billboard->buffer,
-          .offset = 0,
-          .size = sizeof(SBI_Vec4) * billboard->instances_count,
+          .buffer = billboard->scatter_buffer,
+          .offset = (Uint32)stream->scatter_offset,
+          .size = stream->sparse_count * (sizeof(Uint32) + stream->stride),
       };
 
       SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
-      SDL_EndGPUCopyPass(copy_pass);
-      SDL_SubmitGPUCommandBuffer(upload_cmd_buf);
+      billboard->uploaded_bytes += destination.size;
+      continue;
     }
+
+    Uint64 offset = stream->dirty_begin * stream->stride;
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = billboard->upload_transfer_buffer,
+        .offset = (Uint32)(stream->transfer_offset + offset),
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = stream->buffer,
+        .offset = (Uint32)offset,
+        .size = (Uint32)((stream->dirty_end - stream->dirty_begin) *
+                         stream->stride),
+    };
+
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+    billboard->uploaded_bytes += destination.size;
+  }
+  SDL_EndGPUCopyPass(copy_pass);
+
+  // One thread per word of a changed instance, repeated indices write the
+  // same value so their order doesn't matter
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (!scatters[s]) {
+      continue;
+    }
+
+    Uint32 words = stream->stride / sizeof(Uint32);
+    Uint32 indices_offset = (Uint32)(stream->scatter_offset / sizeof(Uint32));
+    BillboardScatterUniforms uniforms = {
+        .counts = {stream->sparse_count, words, indices_offset,
+                   indices_offset + stream->sparse_count},
+    };
+    SDL_GPUStorageBufferReadWriteBinding binding = {
+        .buffer = stream->buffer,
+        .cycle = false,
+    };
+
+    Uint32 groups = (stream->sparse_count * words +
+                     SBI_BILLBOARD_SCATTER_GROUP_SIZE - 1) /
+                    SBI_BILLBOARD_SCATTER_GROUP_SIZE;
+    SDL_GPUComputePass* compute_pass =
+        SDL_BeginGPUComputePass(cmd_buf, NULL, 0, &binding, 1);
+    SDL_BindGPUComputePipeline(compute_pass, billboard->scatter_pipeline);
+    SDL_BindGPUComputeStorageBuffers(compute_pass, 0,
+                                     &billboard->scatter_buffer, 1);
+    SDL_PushGPUComputeUniformData(cmd_buf, 0, &uniforms,
+                                  sizeof(BillboardScatterUniforms));
+    SDL_DispatchGPUCompute(compute_pass, groups, 1, 1);
+    SDL_EndGPUComputePass(compute_pass);
+    billboard->scattered_count += stream->sparse_count;
+  }
+
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    stream->dirty_begin = 0;
+    stream->dirty_end = 0;
+    stream->sparse_count = 0;
+    stream->sparse_full = false;
+  }
+
+  billboard->gpu_sorted = billboard->sorted;
+  billboard->sorted = false;
+}
+
+void SBI_BillboardUpload(SBI_Billboard* billboard,
+                         SDL_GPUCommandBuffer* cmd_buf) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_BILLBOARD);
+  billboard_upload(billboard, cmd_buf);
+  SBI_MemTrackPop(tag);
+}
+
+void SBI_BillboardSort(SBI_Billboard* billboard, const SBI_Vec3 view_pos) {
+  if (billboard->blend != SBI_BILLBOARD_BLEND_SORTED) {
+    return;
+  }
+
+  SBI_ALIGN_VEC3 SBI_Vec3 delta = {0};
+  for (Uint64 i = 0; i < billboard->instances_count; i++) {
+    SBI_Vec3Sub(billboard->instances[i], view_pos, delta);
+    billboard->sort_keys[i] = (SBI_BillboardSortKey){
+        .distance = SBI_Vec3Dot(delta, delta),
+        .index = (Uint32)i,
+    };
   }
 
+  SDL_qsort(billboard->sort_keys, billboard->instances_count,
+            sizeof(SBI_BillboardSortKey), compare_sort_keys);
+  billboard->sorted = true;
+}
+
+// Bind the pipeline and resources of a draw, streams missing from it are
+// bound to the instances but never read. With a visible list the instance
+// index of the draw is a position in that list. Instances start at
+// first_instance of the buffers, for sets suballocated in a shared buffer.
+static void billboard_bind(SBI_Billboard* billboard,
+                           SDL_GPUBuffer* buffer,
+                           Uint32 first_instance,
+                           SDL_GPUBuffer* colors,
+                           SDL_GPUBuffer* animations,
+                           SDL_GPUBuffer* visible,
+                           const SBI_Mat4 proj,
+                           const SBI_Mat4 view,
+                           const SBI_Vec3 view_pos,
+                           SDL_GPUCommandBuffer* cmd_buf,
+                           SDL_GPURenderPass* render_pass) {
+  BillboardUniforms uniforms = {0};
+  SBI_Mat4Mul(proj, view, uniforms.pv);
+  SBI_Vec3Copy(view_pos, uniforms.view_pos);
+  uniforms.view_pos[3] = colors != NULL ? 1.0f : 0.0f;
+
+  // Camera axes are the rows of the view rotation, used by the screen mode
+  SBI_Vec3Make(view[0], view[4], view[8], uniforms.view_right);
+  SBI_Vec3Make(view[1], view[5], view[9], uniforms.view_up);
+  uniforms.view_right[3] = proj[5] != 0.0f ? proj[0] / proj[5] : 1.0f;
+  uniforms.view_up[3] = billboard->opacity;
+
+  // The frame of each instance is computed from the time on the GPU
+  uniforms.animation[0] = billboard->time;
+  uniforms.animation[1] = (float)billboard->atlas_columns;
+  uniforms.animation[2] = (float)billboard->atlas_rows;
+  uniforms.animation[3] = animations != NULL ? 1.0f : 0.0f;
+  uniforms.visibility[0] = visible != NULL ? 1 : 0;
+  uniforms.visibility[1] = first_instance;
+
+  SDL_GPUBufferBinding index_binding = {
+      .buffer = billboard->index_buffer,
+      .offset = 0,
+  };
+
+  SDL_BindGPUGraphicsPipeline(render_pass, billboard->pipeline);
   SDL_PushGPUVertexUniformData(cmd_buf, 0, &uniforms,
                                sizeof(BillboardUniforms));
-  SDL_BindGPUVertexStorageBuffers(render_pass, 0, &billboard->buffer, 1);
-  SDL_DrawGPUPrimitives(render_pass, 6, billboard->instances_count, 0, 0);
+  SDL_GPUBuffer* streams[SBI_BILLBOARD_STREAM_COUNT + 1] = {
+      buffer,
+      colors != NULL ? colors
+                     : billboard->streams[SBI_BILLBOARD_STREAM_COLOR].buffer,
+      animations != NULL ? animations : buffer,
+      visible != NULL ? visible : buffer,
+  };
+  SDL_BindGPUVertexStorageBuffers(render_pass, 0, streams,
+                                  SDL_arraysize(streams));
+  SDL_GPUTextureSamplerBinding atlas_binding = {
+      .texture = billboard->atlas,
+      .sampler = billboard->atlas_sampler,
+  };
+  SDL_BindGPUFragmentSamplers(render_pass, 0, &atlas_binding, 1);
+  if (billboard->lights != NULL) {
+    SBI_LightsBind(billboard->lights, 0, cmd_buf, render_pass);
+  }
+  SDL_BindGPUIndexBuffer(render_pass, &index_binding,
+                         SDL_GPU_INDEXELEMENTSIZE_16BIT);
+  billboard->draws_count++;
+}
+
+void SBI_BillboardDraw(SBI_Billboard* billboard,
+                       const SBI_Mat4 proj,
+                       const SBI_Mat4 view,
+                       const SBI_Vec3 view_pos,
+                       SDL_GPUCommandBuffer* cmd_buf,
+                       SDL_GPURenderPass* render_pass) {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+  SBI_Frustum frustum = {0};
+  SBI_Mat4Mul(proj, view, pv);
+  SBI_FrustumFromMat4(pv, frustum);
+  if (!SBI_FrustumTestAABB(frustum, billboard->bounds_min,
+                           billboard->bounds_max)) {
+    return;
+  }
+
+  SBI_BillboardStreamBuffer* streams = billboard->streams;
+  billboard_bind(billboard, streams[SBI_BILLBOARD_STREAM_POSITION].buffer, 0,
+                 streams[SBI_BILLBOARD_STREAM_COLOR].buffer,
+                 streams[SBI_BILLBOARD_STREAM_ANIMATION].buffer, NULL, proj,
+                 view, view_pos, cmd_buf, render_pass);
+  SDL_DrawGPUIndexedPrimitives(render_pass, 6, billboard->instances_count, 0,
+                               0, 0);
+}
+
+void SBI_BillboardDrawBuffer(SBI_Billboard* billboard,
+                             SDL_GPUBuffer* buffer,
+                             SDL_GPUBuffer* colors,
+                             Uint32 first_instance,
+                             Uint32 instances_count,
+                             const SBI_Mat4 proj,
+                             const SBI_Mat4 view,
+                             const SBI_Vec3 view_pos,
+                             SDL_GPUCommandBuffer* cmd_buf,
+                             SDL_GPURenderPass* render_pass) {
+  billboard_bind(billboard, buffer, first_instance, colors, NULL, NULL, proj,
+                 view, view_pos, cmd_buf, render_pass);
+  SDL_DrawGPUIndexedPrimitives(render_pass, 6, instances_count, 0, 0, 0);
+}
+
+void SBI_BillboardDrawIndirect(SBI_Billboard* billboard,
+                               SDL_GPUBuffer* visible,
+                               SDL_GPUBuffer* args,
+                               Uint32 args_offset,
+                               const SBI_Mat4 proj,
+                               const SBI_Mat4 view,
+                               const SBI_Vec3 view_pos,
+                               SDL_GPUCommandBuffer* cmd_buf,
+                               SDL_GPURenderPass* render_pass) {
+  SBI_BillboardStreamBuffer* streams = billboard->streams;
+  billboard_bind(billboard, streams[SBI_BILLBOARD_STREAM_POSITION].buffer, 0,
+                 streams[SBI_BILLBOARD_STREAM_COLOR].buffer,
+                 streams[SBI_BILLBOARD_STREAM_ANIMATION].buffer, visible, proj,
+                 view, view_pos, cmd_buf, render_pass);
+  SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, args, args_offset, 1);
+}
+
+void SBI_BillboardDrawBufferIndirect(SBI_Billboard* billboard,
+                                     SDL_GPUBuffer* buffer,
+                                     SDL_GPUBuffer* colors,
+                                     SDL_GPUBuffer* visible,
+                                     SDL_GPUBuffer* args,
+                                     Uint32 args_offset,
+                                     const SBI_Mat4 proj,
+                                     const SBI_Mat4 view,
+                                     const SBI_Vec3 view_pos,
+                                     SDL_GPUCommandBuffer* cmd_buf,
+                                     SDL_GPURenderPass* render_pass) {
+  billboard_bind(billboard, buffer, 0, colors, NULL, visible, proj, view,
+                 view_pos, cmd_buf, render_pass);
+  SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, args, args_offset, 1);
 }
 
 void SBI_BillboardDestroy(SBI_Billboard* billboard) {
-  SDL_ReleaseGPUGraphicsPipeline(billboard->device, billboard->pipeline);
-  SDL_ReleaseGPUBuffer(billboard->device, billboard->buffer);
-  SDL_ReleaseGPUTransferBuffer(billboard->device,
-                               billboard->upload_transfer_buffer);
+  if (billboard->device != NULL) {
+    SDL_ReleaseGPUGraphicsPipeline(billboard->device, billboard->pipeline);
+    SDL_ReleaseGPUBuffer(billboard->device, billboard->index_buffer);
+    SDL_ReleaseGPUTransferBuffer(billboard->device,
+                                 billboard->upload_transfer_buffer);
+    SDL_ReleaseGPUTexture(billboard->device, billboard->atlas);
+    SDL_ReleaseGPUSampler(billboard->device, billboard->atlas_sampler);
+    SDL_ReleaseGPUComputePipeline(billboard->device,
+                                  billboard->scatter_pipeline);
+    SDL_ReleaseGPUBuffer(billboard->device, billboard->scatter_buffer);
+    SDL_ReleaseGPUTransferBuffer(billboard->device,
+                                 billboard->scatter_transfer_buffer);
+  }
+  billboard->atlas = NULL;
+  billboard->atlas_sampler = NULL;
+  billboard->scatter_pipeline = NULL;
+  billboard->scatter_buffer = NULL;
+  billboard->scatter_transfer_buffer = NULL;
+
+  SDL_free(billboard->sort_keys);
+  billboard->sort_keys = NULL;
 
-  if (billboard->instances != NULL) {
-    SDL_aligned_free(billboard->instances);
-    billboard->instances = NULL;
-    billboard->instances_count = 0;
+  for (Uint32 s = 0; s < SBI_BILLBOARD_STREAM_COUNT; s++) {
+    SBI_BillboardStreamBuffer* stream = &billboard->streams[s];
+    if (stream->buffer != NULL) {
+      SDL_ReleaseGPUBuffer(billboard->device, stream->buffer);
+    }
+    SDL_aligned_free(stream->data);
+    SDL_free(stream->sparse);
+    SDL_memset(stream, 0, sizeof(SBI_BillboardStreamBuffer));
   }
+  billboard->instances = NULL;
+  billboard->colors = NULL;
+  billboard->animations = NULL;
+  billboard->instances_count = 0;
 }
 
 float remap_value(float value,
@@ -2,29 +2,220 @@
 #define SBI_BILLBOARD_H
 
 #include <SDL3/SDL_gpu.h>
+#include "generator.h"
+#include "lights.h"
 #include "xmath.h"
 
+#define SBI_BILLBOARD_SCATTER_GROUP_SIZE (64)
+#define SBI_BILLBOARD_SPARSE_CAPACITY (65536)
+#define SBI_BILLBOARD_SPARSE_RATIO (0.5f)
+
+// Billboard orientation, each mode is a specialized vertex shader
+typedef enum {
+  SBI_BILLBOARD_SPHERICAL,
+  SBI_BILLBOARD_CYLINDRICAL,
+  SBI_BILLBOARD_SCREEN,
+  SBI_BILLBOARD_FIXED_SCALE,
+  SBI_BILLBOARD_MODE_COUNT,
+} SBI_BillboardMode;
+
+// How the billboards of a set are blended together
+typedef enum {
+  SBI_BILLBOARD_BLEND_UNSORTED,
+  SBI_BILLBOARD_BLEND_SORTED,
+  SBI_BILLBOARD_BLEND_OIT,
+} SBI_BillboardBlend;
+
+// Attribute streams of the instances, each one in its own storage buffer
+typedef enum {
+  SBI_BILLBOARD_STREAM_POSITION,
+  SBI_BILLBOARD_STREAM_COLOR,
+  SBI_BILLBOARD_STREAM_ANIMATION,
+  SBI_BILLBOARD_STREAM_COUNT,
+} SBI_BillboardStream;
+
+// What an animation does after its last frame
+typedef enum {
+  SBI_BILLBOARD_LOOP_REPEAT,
+  SBI_BILLBOARD_LOOP_ONCE,
+  SBI_BILLBOARD_LOOP_PING_PONG,
+} SBI_BillboardLoop;
+
+// Sprite sheet animation of an instance, evaluated by the vertex shader
+// from the time of the set: frame = first_frame + step(time * fps + phase)
+typedef struct {
+  Uint32 first_frame;
+  Uint16 frames_count;
+  Uint16 loop;
+  float fps;
+  float phase;
+} SBI_BillboardAnimation;
+
+// CPU copy and GPU buffer of a stream, only [dirty_begin, dirty_end) is
+// uploaded on the next frame. Optional streams have no data nor buffer.
+// The changed instances are also listed in sparse until it fills up, few
+// changes far apart are scattered by a compute pass instead.
+typedef struct {
+  void* data;
+  SDL_GPUBuffer* buffer;
+  Uint32 stride;
+  Uint64 transfer_offset;
+  Uint64 dirty_begin;
+  Uint64 dirty_end;
+  Uint32* sparse;
+  Uint32 sparse_count;
+  bool sparse_full;
+  Uint64 scatter_offset;
+} SBI_BillboardStreamBuffer;
+
+// Squared distance of an instance to the camera, to sort transparent sets
+typedef struct {
+  float distance;
+  Uint32 index;
+} SBI_BillboardSortKey;
+
+// Creation options of a billboard set
+typedef struct {
+  Uint64 instances_count;
+  SBI_BillboardMode mode;
+  SBI_BillboardBlend blend;
+  float opacity;
+  bool animated;
+  Uint32 atlas_columns;
+  Uint32 atlas_rows;
+  bool depth_test;
+  const SBI_Lights* lights;
+  Uint32 sparse_capacity;
+  float sparse_ratio;
+  SBI_GeneratorOptions generator;
+} SBI_BillboardOptions;
+
 typedef struct {
   SDL_GPUDevice* device;
   SDL_GPUGraphicsPipeline* pipeline;
-  SDL_GPUBuffer* buffer;
+  SDL_GPUBuffer* index_buffer;
   SDL_GPUTransferBuffer* upload_transfer_buffer;
+  SDL_GPUComputePipeline* scatter_pipeline;
+  SDL_GPUBuffer* scatter_buffer;
+  SDL_GPUTransferBuffer* scatter_transfer_buffer;
+  Uint32 sparse_capacity;
+  float sparse_ratio;
+  SDL_GPUTexture* atlas;
+  SDL_GPUSampler* atlas_sampler;
+  Uint32 atlas_columns;
+  Uint32 atlas_rows;
+  SBI_BillboardStreamBuffer streams[SBI_BILLBOARD_STREAM_COUNT];
   SBI_Vec4* instances;
+  Uint32* colors;
+  SBI_BillboardAnimation* animations;
   Uint64 instances_count;
+  float time;
+  SBI_ALIGN_VEC3 SBI_Vec3 bounds_min;
+  SBI_ALIGN_VEC3 SBI_Vec3 bounds_max;
+  SBI_BillboardMode mode;
+  SBI_BillboardBlend blend;
+  float opacity;
+  bool depth_test;
+  const SBI_Lights* lights;
+  Uint64 version;
+  Uint64 uploaded_bytes;
+  Uint64 scattered_count;
+  Uint32 draws_count;
+  SBI_BillboardSortKey* sort_keys;
+  bool sorted;
+  bool gpu_sorted;
 } SBI_Billboard;
 
+// Default options: opaque spherical billboards blended in array order,
+// without animations and with a single white frame as the atlas. Up to
+// SBI_BILLBOARD_SPARSE_CAPACITY changes per stream are scattered. The
+// instances are scattered uniformly in a box of 10 around the origin.
+SBI_BillboardOptions SBI_BillboardDefaultOptions(Uint64 instances_count);
+
+// Load a billboard set, in fixed scale mode the instance scale is a fraction
+// of the viewport height instead of world units. Sets using the OIT blend
+// must be drawn into the SBI_OIT accumulation targets. Animated sets get
+// the animation stream and a generated sprite sheet of columns x rows
+// frames, the frame of each instance follows billboard->time on the GPU.
+// Depth tested sets write SBI_HIZ_DEPTH_FORMAT and need a depth target.
+// Sets given lights are shaded by the clusters of the last SBI_LightsCull,
+// the OIT blend ignores them. A NULL device only loads the CPU streams,
+// for the software rasterizer. Zero sparse_capacity always uploads ranges.
 bool SBI_BillboardLoad(SBI_Billboard* billboard,
                        SDL_GPUDevice* device,
                        SDL_Window* window,
-                       Uint64 instances_count);
+                       SBI_BillboardOptions options);
+
+// Flag instances [first, first + count) of a stream as changed. Writers of
+// instances (position and scale), colors (RGBA8) or animations must call
+// it, advancing the time of an animated set uploads nothing. Flagging the
+// same instance twice in a frame is allowed. Bumps the version of the set.
+void SBI_BillboardMarkDirty(SBI_Billboard* billboard,
+                            SBI_BillboardStream stream,
+                            Uint64 first,
+                            Uint64 count);
 
-void SBI_BillboardDraw(SBI_Billboard* grid,
+// Order the next upload back to front from view_pos (sorted blend only)
+void SBI_BillboardSort(SBI_Billboard* billboard, const SBI_Vec3 view_pos);
+
+// Upload the changes of each stream once per frame, before any render
+// pass. Streams whose (index, value) pairs take at most sparse_ratio of
+// their dirty range are scattered, the others upload the range. Also
+// refreshes the bounds used to cull the draw of each view and restarts
+// the uploaded bytes, scattered and draws counters of the frame.
+void SBI_BillboardUpload(SBI_Billboard* billboard,
+                         SDL_GPUCommandBuffer* cmd_buf);
+
+// Draw the uploaded instances, skipped when the bounds are out of view
+void SBI_BillboardDraw(SBI_Billboard* billboard,
                        const SBI_Mat4 proj,
                        const SBI_Mat4 view,
                        const SBI_Vec3 view_pos,
                        SDL_GPUCommandBuffer* cmd_buf,
                        SDL_GPURenderPass* render_pass);
 
+// Draw instances stored in external storage buffers using the billboard
+// pipeline, used by systems that own their instance data (e.g. chunks).
+// Without a color buffer each instance gets a tint from its index. The
+// instances start at first_instance of the buffers.
+void SBI_BillboardDrawBuffer(SBI_Billboard* billboard,
+                             SDL_GPUBuffer* buffer,
+                             SDL_GPUBuffer* colors,
+                             Uint32 first_instance,
+                             Uint32 instances_count,
+                             const SBI_Mat4 proj,
+                             const SBI_Mat4 view,
+                             const SBI_Vec3 view_pos,
+                             SDL_GPUCommandBuffer* cmd_buf,
+                             SDL_GPURenderPass* render_pass);
+
+// Draw the instances listed in visible, the instance count comes from the
+// indexed indirect draw command at args_offset of args (GPU culling)
+void SBI_BillboardDrawIndirect(SBI_Billboard* billboard,
+                               SDL_GPUBuffer* visible,
+                               SDL_GPUBuffer* args,
+                               Uint32 args_offset,
+                               const SBI_Mat4 proj,
+                               const SBI_Mat4 view,
+                               const SBI_Vec3 view_pos,
+                               SDL_GPUCommandBuffer* cmd_buf,
+                               SDL_GPURenderPass* render_pass);
+
+// Draw the instances of external buffers listed in visible, the instance
+// count comes from the indexed indirect draw command at args_offset of
+// args (GPU particles)
+void SBI_BillboardDrawBufferIndirect(SBI_Billboard* billboard,
+                                     SDL_GPUBuffer* buffer,
+                                     SDL_GPUBuffer* colors,
+                                     SDL_GPUBuffer* visible,
+                                     SDL_GPUBuffer* args,
+                                     Uint32 args_offset,
+                                     const SBI_Mat4 proj,
+                                     const SBI_Mat4 view,
+                                     const SBI_Vec3 view_pos,
+                                     SDL_GPUCommandBuffer* cmd_buf,
+                                     SDL_GPURenderPass* render_pass);
+
 void SBI_BillboardDestroy(SBI_Billboard* billboard);
 
 #endif /* SBI_BILLBOARD_H */
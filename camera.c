@@ -27,6 +27,7 @@ void SBI_CameraLoad(SBI_Camera* camera, float aspect) {
 
 void SBI_CameraViewportResize(SBI_Camera* camera, float aspect) {
   SBI_Mat4PerspectiveResize(camera->proj, aspect, camera->proj);
+  camera->version++;
 }
 
 void SBI_CameraUpdate(SBI_Camera* camera,
@@ -35,27 +36,76 @@ void SBI_CameraUpdate(SBI_Camera* camera,
                       float dt) {
   // Update camera orbiting position using keyboard
   const bool* keyboard_state = SDL_GetKeyboardState(NULL);
+  SBI_CameraInput input = {
+      .forward = keyboard_state[SDL_SCANCODE_W],
+      .back = keyboard_state[SDL_SCANCODE_S],
+      .left = keyboard_state[SDL_SCANCODE_A],
+      .right = keyboard_state[SDL_SCANCODE_D],
+      .wheel = relative_mouse_wheel,
+  };
+
+  // Orbit the camera around the orbit point
+  const SDL_MouseButtonFlags mouse_state =
+      SDL_GetRelativeMouseState(&input.orbit_x, &input.orbit_y);
+  input.orbiting = SDL_BUTTON_MMASK & mouse_state;
+  SDL_CaptureMouse(input.orbiting);
+  SDL_SetWindowRelativeMouseMode(window, input.orbiting);
+
+  SBI_CameraStep(camera, &input, dt);
+}
+
+void SBI_CameraInputEvent(SBI_CameraInput* input, const SDL_Event* event) {
+  switch (event->type) {
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+      if (event->key.scancode == SDL_SCANCODE_W) {
+        input->forward = event->key.down;
+      } else if (event->key.scancode == SDL_SCANCODE_S) {
+        input->back = event->key.down;
+      } else if (event->key.scancode == SDL_SCANCODE_A) {
+        input->left = event->key.down;
+      } else if (event->key.scancode == SDL_SCANCODE_D) {
+        input->right = event->key.down;
+      }
+      break;
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+      if (event->button.button == SDL_BUTTON_MIDDLE) {
+        input->orbiting = event->button.down;
+      }
+      break;
+    case SDL_EVENT_MOUSE_MOTION:
+      input->orbit_x += event->motion.xrel;
+      input->orbit_y += event->motion.yrel;
+      break;
+    case SDL_EVENT_MOUSE_WHEEL:
+      input->wheel += -event->wheel.y;
+      break;
+    default:
+      break;
+  }
+}
+
+void SBI_CameraStep(SBI_Camera* camera, const SBI_CameraInput* input, float dt) {
   SBI_ALIGN_VEC3 SBI_Vec3 world_up = {0.0, 1.0f, 0.0f};
   SBI_ALIGN_VEC3 SBI_Vec3 input_forward = {0.0f, 0.0f, 0.0f};
   SBI_ALIGN_VEC3 SBI_Vec3 input_left = {0.0f, 0.0f, 0.0f};
   SBI_ALIGN_VEC3 SBI_Vec3 cam_forward = {0};
   SBI_ALIGN_VEC3 SBI_Vec3 cam_left = {0};
   SBI_ALIGN_VEC3 SBI_Vec3 move_dir = {0};
-  SBI_ALIGN_VEC3 SBI_Vec3 orbit_vec = {0};
   SBI_ALIGN_QUAT SBI_Quat yaw_rot = {0};
-  SBI_Vec2 mouse_coords = {0};
   float a = SBI_Rads(camera->azimuth);
-  float p = SBI_Rads(camera->polar);
+  float relative_mouse_wheel = input->wheel;
 
-  if (keyboard_state[SDL_SCANCODE_W]) {
+  if (input->forward) {
     input_forward[2] = -1.0f;
-  } else if (keyboard_state[SDL_SCANCODE_S]) {
+  } else if (input->back) {
     input_forward[2] = 1.0f;
   }
 
-  if (keyboard_state[SDL_SCANCODE_A]) {
+  if (input->left) {
     input_left[0] = -1.0f;
-  } else if (keyboard_state[SDL_SCANCODE_D]) {
+  } else if (input->right) {
     input_left[0] = 1.0f;
   }
 
@@ -69,26 +119,12 @@ void SBI_CameraUpdate(SBI_Camera* camera,
   SBI_Vec3Add(move_dir, camera->orbit_point, camera->orbit_point);
 
   // Orbit the camera around the orbit point
-  const SDL_MouseButtonFlags mouse_state =
-      SDL_GetRelativeMouseState(&mouse_coords[0], &mouse_coords[1]);
-  if (SDL_BUTTON_MMASK & mouse_state) {
-    SDL_CaptureMouse(true);
-    SDL_SetWindowRelativeMouseMode(window, true);
-    camera->azimuth += SBI_Rads(mouse_coords[0] * camera->orbit_speed) * dt;
-    camera->polar = SDL_clamp(camera->polar + SBI_Rads(mouse_coords[1] * camera->orbit_speed) * dt,
+  if (input->orbiting) {
+    camera->azimuth += SBI_Rads(input->orbit_x * camera->orbit_speed) * dt;
+    camera->polar = SDL_clamp(camera->polar + SBI_Rads(input->orbit_y * camera->orbit_speed) * dt,
                               -90.0f, 90.0f);
-  } else {
-    SDL_CaptureMouse(false);
-    SDL_SetWindowRelativeMouseMode(window, false);
   }
 
-  orbit_vec[0] = camera->orbit_point[0] + camera->radius * SDL_cos(p) * SDL_cos(a);
-  orbit_vec[1] = camera->orbit_point[1] + camera->radius * SDL_sin(p);
-  orbit_vec[2] = camera->orbit_point[2] + camera->radius * SDL_cos(p) * SDL_sin(a);
-
-  SBI_XFormTranslate(camera->xform, orbit_vec, camera->xform);
-  SBI_XFormLookAtPoint(camera->xform, camera->orbit_point, world_up, camera->xform);
-
   // Interpolate the zoom to smooth transition
   if ((camera->radius > camera->zoom_in_limit && relative_mouse_wheel < 0.0f) ||
       (camera->radius < camera->zoom_out_limit && relative_mouse_wheel > 0.0f)) {
@@ -101,6 +137,27 @@ void SBI_CameraUpdate(SBI_Camera* camera,
     camera->radius *= SDL_powf(camera->target_radius / camera->radius, dt * camera->zoom_speed);
   }
 
-  // Apply transform and get view matrix
-  SBI_XFormToView(camera->xform, camera->view);
+  SBI_CameraApplyOrbit(camera);
+}
+
+void SBI_CameraApplyOrbit(SBI_Camera* camera) {
+  SBI_ALIGN_VEC3 SBI_Vec3 world_up = {0.0, 1.0f, 0.0f};
+  SBI_ALIGN_VEC3 SBI_Vec3 orbit_vec = {0};
+  float a = SBI_Rads(camera->azimuth);
+  float p = SBI_Rads(camera->polar);
+
+  orbit_vec[0] = camera->orbit_point[0] + camera->radius * SDL_cos(p) * SDL_cos(a);
+  orbit_vec[1] = camera->orbit_point[1] + camera->radius * SDL_sin(p);
+  orbit_vec[2] = camera->orbit_point[2] + camera->radius * SDL_cos(p) * SDL_sin(a);
+
+  SBI_XFormTranslate(camera->xform, orbit_vec, camera->xform);
+  SBI_XFormLookAtPoint(camera->xform, camera->orbit_point, world_up, camera->xform);
+
+  // Apply transform and get view matrix, a camera at rest keeps its version
+  SBI_ALIGN_MAT4 SBI_Mat4 view = {0};
+  SBI_XFormToView(camera->xform, view);
+  if (SDL_memcmp(view, camera->view, sizeof(SBI_Mat4)) != 0) {
+    SDL_memcpy(camera->view, view, sizeof(SBI_Mat4));
+    camera->version++;
+  }
 }
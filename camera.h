@@ -1,6 +1,7 @@
 #ifndef SBI_CAMERA_H
 #define SBI_CAMERA_H
 
+#include <SDL3/SDL_events.h>
 #include <SDL3/SDL_video.h>
 #include "xmath.h"
 
@@ -22,8 +23,23 @@ typedef struct {
   float zoom_step;
   float zoom_in_limit;
   float zoom_out_limit;
+
+  // Bumped whenever proj or view change
+  Uint64 version;
 } SBI_Camera;
 
+// Controls of the camera for one step, from the device state or events
+typedef struct {
+  bool forward;
+  bool back;
+  bool left;
+  bool right;
+  bool orbiting;
+  float orbit_x;
+  float orbit_y;
+  float wheel;
+} SBI_CameraInput;
+
 // Load camera using perspective projection and default parameters
 void SBI_CameraLoad(SBI_Camera* camera, float aspect);
 
@@ -36,4 +52,13 @@ void SBI_CameraUpdate(SBI_Camera* camera,
                       float relative_mouse_wheel,
                       float dt);
 
+// Accumulate an input event, orbit and wheel deltas add up until cleared
+void SBI_CameraInputEvent(SBI_CameraInput* input, const SDL_Event* event);
+
+// Move the camera with the given controls, no window or device access
+void SBI_CameraStep(SBI_Camera* camera, const SBI_CameraInput* input, float dt);
+
+// Place the camera from its orbit parameters and refresh the view matrix
+void SBI_CameraApplyOrbit(SBI_Camera* camera);
+
 #endif /* SBI_CAMERA_H */
@@ -0,0 +1,563 @@
+#include "capture.h"
+#include "simulation.h"
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#define CAPTURE_DEFAULT_DT (0.0166666666667f)
+#define CAPTURE_DEFAULT_ENCODERS (2)
+#define CAPTURE_PPM_HEADER_SIZE (32)
+#define CAPTURE_PNG_BLOCK_SIZE (65535)
+#define CAPTURE_ADLER_MOD (65521)
+#define CAPTURE_ADLER_RUN (5552)
+
+static const char* capture_extensions[] = {"rgba", "ppm", "png"};
+static const Uint8 capture_png_signature[] = {0x89, 'P',  'N',  'G',
+                                              '\r', '\n', 0x1a, '\n'};
+
+// Deflate stream of stored blocks being written, with its Adler-32
+typedef struct {
+  Uint8* out;
+  Uint32 block_left;
+  Uint64 raw_left;
+  Uint32 s1;
+  Uint32 s2;
+} CapturePNGWriter;
+
+static int capture_encoder_thread(void* data);
+static bool capture_read_back(SBI_Capture* capture, SBI_CaptureSlot* slot);
+static size_t capture_scratch_size(const SBI_Capture* capture);
+
+SBI_CaptureOptions SBI_CaptureDefaultOptions(const char* path,
+                                             Uint32 frames_count) {
+  return (SBI_CaptureOptions){
+      .path = path,
+      .frames_count = frames_count,
+      .dt = CAPTURE_DEFAULT_DT,
+      .format = SBI_CAPTURE_PPM,
+      .encoders_count = CAPTURE_DEFAULT_ENCODERS,
+  };
+}
+
+bool SBI_CaptureLoad(SBI_Capture* capture,
+                     SBI_Simulation* state,
+                     SBI_CaptureOptions options) {
+  SDL_GPUDevice* device = state->device;
+  capture->device = device;
+  capture->options = options;
+  capture->options.encoders_count =
+      SDL_clamp(options.encoders_count, 1, SBI_CAPTURE_MAX_ENCODERS);
+
+  int width = 0;
+  int height = 0;
+  if (!SDL_GetWindowSizeInPixels(state->window, &width, &height) ||
+      width <= 0 || height <= 0) {
+    SDL_Log("Could not get window size to capture: %s", SDL_GetError());
+    return false;
+  }
+  capture->width = (Uint32)width;
+  capture->height = (Uint32)height;
+
+  // The pipelines target the swapchain format, only 8 bit RGBA orders can
+  // be written as they are read back
+  SDL_GPUTextureFormat format =
+      SDL_GetGPUSwapchainTextureFormat(device, state->window);
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM_SRGB:
+      capture->bgra = true;
+      break;
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB:
+      capture->bgra = false;
+      break;
+    default:
+      SDL_Log("Capture does not support swapchain format %d", format);
+      return false;
+  }
+
+  if (!SDL_CreateDirectory(options.path)) {
+    SDL_Log("Could not create capture directory: %s", SDL_GetError());
+    return false;
+  }
+
+  Uint32 frame_size = capture->width * capture->height * 4;
+  for (Uint32 i = 0; i < SBI_CAPTURE_FRAMES_IN_FLIGHT; i++) {
+    SBI_CaptureSlot* slot = &capture->slots[i];
+    slot->texture = SDL_CreateGPUTexture(
+        device, &(SDL_GPUTextureCreateInfo){
+                    .type = SDL_GPU_TEXTURETYPE_2D,
+                    .format = format,
+                    .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
+                    .width = capture->width,
+                    .height = capture->height,
+                    .layer_count_or_depth = 1,
+                    .num_levels = 1,
+                });
+    slot->transfer_buffer = SDL_CreateGPUTransferBuffer(
+        device, &(SDL_GPUTransferBufferCreateInfo){
+                    .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+                    .size = frame_size,
+                });
+    if (slot->texture == NULL || slot->transfer_buffer == NULL) {
+      SDL_Log("Could not create capture slot: %s", SDL_GetError());
+      return false;
+    }
+  }
+
+  // One image per frame in flight and per encoder, so a read back never
+  // waits unless the encoders fall behind
+  capture->images_count =
+      SBI_CAPTURE_FRAMES_IN_FLIGHT + capture->options.encoders_count;
+  for (Uint32 i = 0; i < capture->images_count; i++) {
+    capture->images[i].pixels = SDL_malloc(frame_size);
+    if (capture->images[i].pixels == NULL) {
+      SDL_Log("Could not allocate memory for capture images");
+      return false;
+    }
+    capture->free[capture->free_count++] = i;
+  }
+
+  capture->lock = SDL_CreateMutex();
+  capture->wake = SDL_CreateCondition();
+  capture->done = SDL_CreateCondition();
+  if (capture->lock == NULL || capture->wake == NULL ||
+      capture->done == NULL) {
+    SDL_Log("Could not create capture sync objects: %s", SDL_GetError());
+    return false;
+  }
+
+  size_t scratch_size = capture_scratch_size(capture);
+  for (Uint32 i = 0; i < capture->options.encoders_count; i++) {
+    SBI_CaptureEncoder* encoder = &capture->encoders[i];
+    encoder->capture = capture;
+    encoder->scratch_size = scratch_size;
+    if (scratch_size > 0) {
+      encoder->scratch = SDL_malloc(scratch_size);
+      if (encoder->scratch == NULL) {
+        SDL_Log("Could not allocate memory for capture encoder");
+        return false;
+      }
+    }
+
+    encoder->thread = SDL_CreateThread(capture_encoder_thread,
+                                       "SBI_CaptureEncoder", encoder);
+    if (encoder->thread == NULL) {
+      SDL_Log("Could not create capture encoder: %s", SDL_GetError());
+      return false;
+    }
+    capture->encoders_count++;
+  }
+
+  SDL_Log("Capturing %d frames of %dx%d as %s to %s with %d encoders",
+          options.frames_count, capture->width, capture->height,
+          capture_extensions[options.format], options.path,
+          capture->encoders_count);
+  return true;
+}
+
+bool SBI_CaptureFrame(SBI_Capture* capture, SBI_Simulation* state) {
+  SBI_CaptureSlot* slot =
+      &capture->slots[capture->frame % SBI_CAPTURE_FRAMES_IN_FLIGHT];
+  if (slot->fence != NULL && !capture_read_back(capture, slot)) {
+    return false;
+  }
+
+  // Fixed steps, the captured sequence doesn't depend on the host speed
+  float dt = capture->options.dt;
+  capture->update_time += dt;
+  if (capture->update_time >= state->tick_time) {
+    SBI_SimulationUpdate(state, state->tick_time);
+    capture->update_time -= state->tick_time;
+  }
+
+  SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(capture->device);
+  if (cmd_buf == NULL) {
+    SDL_Log("Could not acquire GPU command buffer: %s", SDL_GetError());
+    return false;
+  }
+
+  if (!SBI_SimulationRenderTarget(state, dt, cmd_buf, slot->texture,
+                                  capture->width, capture->height)) {
+    SDL_SubmitGPUCommandBuffer(cmd_buf);
+    return false;
+  }
+
+  // The download runs after the frame on the GPU, nothing waits for it
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+  SDL_DownloadFromGPUTexture(copy_pass,
+                             &(SDL_GPUTextureRegion){
+                                 .texture = slot->texture,
+                                 .w = capture->width,
+                                 .h = capture->height,
+                                 .d = 1,
+                             },
+                             &(SDL_GPUTextureTransferInfo){
+                                 .transfer_buffer = slot->transfer_buffer,
+                             });
+  SDL_EndGPUCopyPass(copy_pass);
+
+  slot->fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+  if (slot->fence == NULL) {
+    SDL_Log("Could not submit capture frame: %s", SDL_GetError());
+    return false;
+  }
+  slot->frame = capture->frame++;
+
+  // Fewer frames are in flight than the lag of frames without fences
+  SBI_GPUMemoryEndFrame(&state->gpu_memory, NULL);
+  return true;
+}
+
+bool SBI_CaptureFlush(SBI_Capture* capture) {
+  // Oldest frame first, the next slot to be reused
+  bool result = true;
+  for (Uint32 i = 0; i < SBI_CAPTURE_FRAMES_IN_FLIGHT; i++) {
+    Uint32 index = (capture->frame + i) % SBI_CAPTURE_FRAMES_IN_FLIGHT;
+    SBI_CaptureSlot* slot = &capture->slots[index];
+    if (slot->fence != NULL && !capture_read_back(capture, slot)) {
+      result = false;
+    }
+  }
+
+  SDL_LockMutex(capture->lock);
+  while (capture->queue_count > 0 || capture->encoding > 0) {
+    SDL_WaitCondition(capture->done, capture->lock);
+  }
+  if (capture->failed_count > 0) {
+    SDL_Log("Could not write %d captured frames", capture->failed_count);
+    result = false;
+  }
+  SDL_UnlockMutex(capture->lock);
+  return result;
+}
+
+void SBI_CaptureDestroy(SBI_Capture* capture) {
+  if (capture->lock != NULL) {
+    SDL_LockMutex(capture->lock);
+    capture->quit = true;
+    SDL_BroadcastCondition(capture->wake);
+    SDL_UnlockMutex(capture->lock);
+  }
+
+  for (Uint32 i = 0; i < capture->encoders_count; i++) {
+    SDL_WaitThread(capture->encoders[i].thread, NULL);
+  }
+  for (Uint32 i = 0; i < SBI_CAPTURE_MAX_ENCODERS; i++) {
+    SDL_free(capture->encoders[i].scratch);
+  }
+
+  for (Uint32 i = 0; i < SBI_CAPTURE_FRAMES_IN_FLIGHT; i++) {
+    SBI_CaptureSlot* slot = &capture->slots[i];
+    if (slot->fence != NULL) {
+      SDL_WaitForGPUFences(capture->device, true, &slot->fence, 1);
+      SDL_ReleaseGPUFence(capture->device, slot->fence);
+    }
+    if (slot->transfer_buffer != NULL) {
+      SDL_ReleaseGPUTransferBuffer(capture->device, slot->transfer_buffer);
+    }
+    if (slot->texture != NULL) {
+      SDL_ReleaseGPUTexture(capture->device, slot->texture);
+    }
+  }
+
+  for (Uint32 i = 0; i < capture->images_count; i++) {
+    SDL_free(capture->images[i].pixels);
+  }
+
+  SDL_DestroyCondition(capture->done);
+  SDL_DestroyCondition(capture->wake);
+  SDL_DestroyMutex(capture->lock);
+  SDL_memset(capture, 0, sizeof(SBI_Capture));
+}
+
+bool SBI_CaptureRun(SBI_Simulation* state, SBI_CaptureOptions options) {
+  if (state->device == NULL) {
+    SDL_Log("Capture needs a GPU device, it can't run with --software");
+    return false;
+  }
+
+  SBI_Capture* capture = SDL_malloc(sizeof(SBI_Capture));
+  if (capture == NULL) {
+    SDL_Log("Could not allocate memory for capture");
+    return false;
+  }
+  SDL_memset(capture, 0, sizeof(SBI_Capture));
+
+  bool result = SBI_CaptureLoad(capture, state, options);
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (Uint32 i = 0; result && i < options.frames_count; i++) {
+    result = SBI_CaptureFrame(capture, state);
+  }
+  if (capture->lock != NULL) {
+    result = SBI_CaptureFlush(capture) && result;
+  }
+  double seconds = (double)(SDL_GetPerformanceCounter() - start) /
+                   (double)SDL_GetPerformanceFrequency();
+
+  if (result) {
+    SDL_Log("Captured %d frames in %.2f s: %.1f frames/s, %.1f MB written",
+            capture->frame, seconds,
+            seconds > 0.0 ? (double)capture->frame / seconds : 0.0,
+            (double)capture->written_bytes / (1024.0 * 1024.0));
+  }
+
+  SBI_CaptureDestroy(capture);
+  SDL_free(capture);
+  return result;
+}
+
+// Wait for the frame of a slot, copy its pixels to a free image and queue
+// it for the encoders
+static bool capture_read_back(SBI_Capture* capture, SBI_CaptureSlot* slot) {
+  SDL_GPUDevice* device = capture->device;
+  SDL_WaitForGPUFences(device, true, &slot->fence, 1);
+  SDL_ReleaseGPUFence(device, slot->fence);
+  slot->fence = NULL;
+
+  SDL_LockMutex(capture->lock);
+  while (capture->free_count == 0) {
+    SDL_WaitCondition(capture->done, capture->lock);
+  }
+  Uint32 index = capture->free[--capture->free_count];
+  SDL_UnlockMutex(capture->lock);
+
+  SBI_CaptureImage* image = &capture->images[index];
+  void* transfer_point =
+      SDL_MapGPUTransferBuffer(device, slot->transfer_buffer, false);
+  if (transfer_point == NULL) {
+    SDL_Log("Could not map captured frame %d: %s", slot->frame,
+            SDL_GetError());
+    SDL_LockMutex(capture->lock);
+    capture->free[capture->free_count++] = index;
+    SDL_UnlockMutex(capture->lock);
+    return false;
+  }
+  SDL_memcpy(image->pixels, transfer_point,
+             (size_t)capture->width * capture->height * 4);
+  SDL_UnmapGPUTransferBuffer(device, slot->transfer_buffer);
+  image->frame = slot->frame;
+
+  SDL_LockMutex(capture->lock);
+  Uint32 tail =
+      (capture->queue_head + capture->queue_count) % SBI_CAPTURE_MAX_IMAGES;
+  capture->queue[tail] = index;
+  capture->queue_count++;
+  SDL_SignalCondition(capture->wake);
+  SDL_UnlockMutex(capture->lock);
+  return true;
+}
+
+// Bytes an encoder builds before writing a frame, raw frames are written
+// straight from their image
+static size_t capture_scratch_size(const SBI_Capture* capture) {
+  size_t pixels = (size_t)capture->width * capture->height;
+  size_t raw = capture->height * ((size_t)capture->width * 4 + 1);
+  size_t blocks =
+      (raw + CAPTURE_PNG_BLOCK_SIZE - 1) / CAPTURE_PNG_BLOCK_SIZE;
+  switch (capture->options.format) {
+    case SBI_CAPTURE_PPM:
+      return CAPTURE_PPM_HEADER_SIZE + pixels * 3;
+    case SBI_CAPTURE_PNG:
+      // Signature, IHDR, IDAT with a zlib stream of stored blocks, IEND
+      return sizeof(capture_png_signature) + 25 + 12 + 2 + blocks * 5 +
+             raw + 4 + 12;
+    default:
+      return 0;
+  }
+}
+
+static Uint8* capture_put_u32(Uint8* out, Uint32 value) {
+  out[0] = (Uint8)(value >> 24);
+  out[1] = (Uint8)(value >> 16);
+  out[2] = (Uint8)(value >> 8);
+  out[3] = (Uint8)value;
+  return out + 4;
+}
+
+// Append a chunk whose data is already at start + 8, returns its end
+static Uint8* capture_png_chunk(Uint8* start,
+                                const char* type,
+                                Uint32 size) {
+  capture_put_u32(start, size);
+  SDL_memcpy(start + 4, type, 4);
+  Uint32 crc = SDL_crc32(0, start + 4, size + 4);
+  return capture_put_u32(start + 8 + size, crc);
+}
+
+static void capture_png_put(CapturePNGWriter* writer,
+                            const Uint8* data,
+                            Uint64 size) {
+  while (size > 0) {
+    if (writer->block_left == 0) {
+      Uint32 block = (Uint32)SDL_min(writer->raw_left, CAPTURE_PNG_BLOCK_SIZE);
+      writer->raw_left -= block;
+      *writer->out++ = writer->raw_left == 0 ? 1 : 0;
+      *writer->out++ = (Uint8)block;
+      *writer->out++ = (Uint8)(block >> 8);
+      *writer->out++ = (Uint8)~block;
+      *writer->out++ = (Uint8)(~block >> 8);
+      writer->block_left = block;
+    }
+
+    Uint32 count = (Uint32)SDL_min(size, writer->block_left);
+    SDL_memcpy(writer->out, data, count);
+    for (Uint32 begin = 0; begin < count; begin += CAPTURE_ADLER_RUN) {
+      Uint32 end = SDL_min(begin + CAPTURE_ADLER_RUN, count);
+      for (Uint32 i = begin; i < end; i++) {
+        writer->s1 += data[i];
+        writer->s2 += writer->s1;
+      }
+      writer->s1 %= CAPTURE_ADLER_MOD;
+      writer->s2 %= CAPTURE_ADLER_MOD;
+    }
+    writer->out += count;
+    writer->block_left -= count;
+    data += count;
+    size -= count;
+  }
+}
+
+// Build a PNG of RGBA8 rows without filters, the zlib stream only has
+// stored blocks since no deflate encoder is available
+static size_t capture_encode_png(SBI_CaptureEncoder* encoder,
+                                 const Uint8* pixels) {
+  SBI_Capture* capture = encoder->capture;
+  Uint32 row_size = capture->width * 4;
+  Uint8* out = encoder->scratch;
+  SDL_memcpy(out, capture_png_signature, sizeof(capture_png_signature));
+  out += sizeof(capture_png_signature);
+
+  Uint8* ihdr = out;
+  Uint8* data = capture_put_u32(ihdr + 8, capture->width);
+  data = capture_put_u32(data, capture->height);
+  data[0] = 8;  // Bit depth
+  data[1] = 6;  // RGBA
+  data[2] = 0;  // Deflate
+  data[3] = 0;  // Adaptive filters
+  data[4] = 0;  // Not interlaced
+  out = capture_png_chunk(ihdr, "IHDR", 13);
+
+  Uint8* idat = out;
+  CapturePNGWriter writer = {
+      .out = idat + 8,
+      .raw_left = (Uint64)capture->height * (row_size + 1),
+      .s1 = 1,
+  };
+  *writer.out++ = 0x78;
+  *writer.out++ = 0x01;
+  const Uint8 filter = 0;
+  for (Uint32 y = 0; y < capture->height; y++) {
+    capture_png_put(&writer, &filter, 1);
+    capture_png_put(&writer, pixels + (size_t)y * row_size, row_size);
+  }
+  writer.out = capture_put_u32(writer.out, (writer.s2 << 16) | writer.s1);
+  out = capture_png_chunk(idat, "IDAT", (Uint32)(writer.out - idat - 8));
+
+  return (size_t)(capture_png_chunk(out, "IEND", 0) - encoder->scratch);
+}
+
+static size_t capture_encode_ppm(SBI_CaptureEncoder* encoder,
+                                 const Uint8* pixels) {
+  SBI_Capture* capture = encoder->capture;
+  Uint8* out = encoder->scratch;
+  out += SDL_snprintf((char*)out, CAPTURE_PPM_HEADER_SIZE, "P6\n%d %d\n255\n",
+                      capture->width, capture->height);
+
+  size_t pixels_count = (size_t)capture->width * capture->height;
+  for (size_t i = 0; i < pixels_count; i++) {
+    out[0] = pixels[i * 4 + 0];
+    out[1] = pixels[i * 4 + 1];
+    out[2] = pixels[i * 4 + 2];
+    out += 3;
+  }
+  return (size_t)(out - encoder->scratch);
+}
+
+// Encode an image to its file, returns the bytes written or zero
+static size_t capture_encode(SBI_CaptureEncoder* encoder,
+                             SBI_CaptureImage* image) {
+  SBI_Capture* capture = encoder->capture;
+  size_t pixels_count = (size_t)capture->width * capture->height;
+  Uint8* pixels = image->pixels;
+
+  // Every format stores RGBA, the encoder owns the image so swap in place
+  if (capture->bgra) {
+    for (size_t i = 0; i < pixels_count; i++) {
+      Uint8 blue = pixels[i * 4 + 0];
+      pixels[i * 4 + 0] = pixels[i * 4 + 2];
+      pixels[i * 4 + 2] = blue;
+    }
+  }
+
+  const Uint8* bytes = pixels;
+  size_t size = pixels_count * 4;
+  switch (capture->options.format) {
+    case SBI_CAPTURE_PPM:
+      bytes = encoder->scratch;
+      size = capture_encode_ppm(encoder, pixels);
+      break;
+    case SBI_CAPTURE_PNG:
+      bytes = encoder->scratch;
+      size = capture_encode_png(encoder, pixels);
+      break;
+    default:
+      break;
+  }
+
+  char path[512] = {0};
+  SDL_snprintf(path, sizeof(path), "%s/frame_%05d.%s", capture->options.path,
+               image->frame, capture_extensions[capture->options.format]);
+  SDL_IOStream* file = SDL_IOFromFile(path, "wb");
+  if (file == NULL) {
+    SDL_Log("Could not open %s: %s", path, SDL_GetError());
+    return 0;
+  }
+
+  bool written = SDL_WriteIO(file, bytes, size) == size;
+  if (!SDL_CloseIO(file) || !written) {
+    SDL_Log("Could not write %s: %s", path, SDL_GetError());
+    return 0;
+  }
+  return size;
+}
+
+static int capture_encoder_thread(void* data) {
+  SBI_CaptureEncoder* encoder = data;
+  SBI_Capture* capture = encoder->capture;
+
+  // Queued images are drained before quitting
+  SDL_LockMutex(capture->lock);
+  while (true) {
+    if (capture->queue_count == 0) {
+      if (capture->quit) {
+        break;
+      }
+      SDL_WaitCondition(capture->wake, capture->lock);
+      continue;
+    }
+
+    Uint32 index = capture->queue[capture->queue_head];
+    capture->queue_head = (capture->queue_head + 1) % SBI_CAPTURE_MAX_IMAGES;
+    capture->queue_count--;
+    capture->encoding++;
+    SDL_UnlockMutex(capture->lock);
+
+    // Encode outside of the lock so the main thread keeps rendering
+    size_t written = capture_encode(encoder, &capture->images[index]);
+
+    SDL_LockMutex(capture->lock);
+    capture->encoding--;
+    capture->written_bytes += written;
+    if (written == 0) {
+      capture->failed_count++;
+    }
+    capture->free[capture->free_count++] = index;
+    SDL_SignalCondition(capture->done);
+  }
+  SDL_UnlockMutex(capture->lock);
+  return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef SBI_CAPTURE_H
+#define SBI_CAPTURE_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#include "simulation.h"
+
+#define SBI_CAPTURE_FRAMES_IN_FLIGHT (3)
+#define SBI_CAPTURE_MAX_ENCODERS (8)
+#define SBI_CAPTURE_MAX_IMAGES \
+  (SBI_CAPTURE_FRAMES_IN_FLIGHT + SBI_CAPTURE_MAX_ENCODERS)
+
+// File format of the captured frames. Raw frames are tightly packed RGBA8
+// rows without a header, PNG frames are not compressed.
+typedef enum {
+  SBI_CAPTURE_RAW,
+  SBI_CAPTURE_PPM,
+  SBI_CAPTURE_PNG,
+} SBI_CaptureFormat;
+
+// Options of an offline capture
+typedef struct {
+  const char* path;
+  Uint32 frames_count;
+  float dt;
+  SBI_CaptureFormat format;
+  Uint32 encoders_count;
+} SBI_CaptureOptions;
+
+// A frame in flight: its target, the buffer it is read back to and the
+// fence of its command buffer, NULL when the slot is free
+typedef struct {
+  SDL_GPUTexture* texture;
+  SDL_GPUTransferBuffer* transfer_buffer;
+  SDL_GPUFence* fence;
+  Uint32 frame;
+} SBI_CaptureSlot;
+
+// Pixels of a read back frame, owned by the queue or by one encoder
+typedef struct {
+  Uint8* pixels;
+  Uint32 frame;
+} SBI_CaptureImage;
+
+typedef struct SBI_Capture SBI_Capture;
+
+typedef struct {
+  SBI_Capture* capture;
+  SDL_Thread* thread;
+  Uint8* scratch;
+  size_t scratch_size;
+} SBI_CaptureEncoder;
+
+// Renders frames into offscreen targets and reads them back without
+// stalling: each frame is downloaded in the command buffer that draws it
+// and only mapped when its slot comes around again, frames in flight
+// later. Mapped pixels are copied to an image and encoded to files by the
+// encoder threads while the next frames render.
+struct SBI_Capture {
+  SDL_GPUDevice* device;
+  SBI_CaptureOptions options;
+  SBI_CaptureSlot slots[SBI_CAPTURE_FRAMES_IN_FLIGHT];
+  Uint32 width;
+  Uint32 height;
+  bool bgra;
+  Uint32 frame;
+  float update_time;
+  SBI_CaptureEncoder encoders[SBI_CAPTURE_MAX_ENCODERS];
+  Uint32 encoders_count;
+
+  // Image queue, guarded by lock
+  SDL_Mutex* lock;
+  SDL_Condition* wake;
+  SDL_Condition* done;
+  SBI_CaptureImage images[SBI_CAPTURE_MAX_IMAGES];
+  Uint32 images_count;
+  Uint32 free[SBI_CAPTURE_MAX_IMAGES];
+  Uint32 free_count;
+  Uint32 queue[SBI_CAPTURE_MAX_IMAGES];
+  Uint32 queue_head;
+  Uint32 queue_count;
+  Uint32 encoding;
+  Uint32 failed_count;
+  Uint64 written_bytes;
+  bool quit;
+};
+
+// Default options: frames at 60 per second written as PPM by two encoders
+SBI_CaptureOptions SBI_CaptureDefaultOptions(const char* path,
+                                             Uint32 frames_count);
+
+// Create the targets at the window size in pixels with the swapchain
+// format, the readback buffers and the encoders. The directory at
+// options.path is created when missing.
+bool SBI_CaptureLoad(SBI_Capture* capture,
+                     SBI_Simulation* state,
+                     SBI_CaptureOptions options);
+
+// Step the simulation by the fixed dt and render the next frame, reading
+// back the oldest frame in flight when its slot is needed
+bool SBI_CaptureFrame(SBI_Capture* capture, SBI_Simulation* state);
+
+// Read back every frame in flight and wait for the encoders to write them
+bool SBI_CaptureFlush(SBI_Capture* capture);
+
+void SBI_CaptureDestroy(SBI_Capture* capture);
+
+// Capture options.frames_count frames and log the throughput. Selected
+// with --capture <dir> <frames> [raw|ppm|png], the app exits once done.
+bool SBI_CaptureRun(SBI_Simulation* state, SBI_CaptureOptions options);
+
+#endif /* SBI_CAPTURE_H */
@@ -0,0 +1,678 @@
+#include "chunks.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define CHUNK_VELOCITY_SMOOTHING (0.25f)
+
+typedef struct {
+  Sint32 coord[3];
+  Uint64 index;
+} ChunkBakeKey;
+
+static int compare_bake_keys(const void* a, const void* b) {
+  const ChunkBakeKey* ka = a;
+  const ChunkBakeKey* kb = b;
+  for (Uint32 i = 0; i < 3; i++) {
+    if (ka->coord[i] != kb->coord[i]) {
+      return ka->coord[i] < kb->coord[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+static int compare_ranks(const void* a, const void* b) {
+  const SBI_ChunkRank* ra = a;
+  const SBI_ChunkRank* rb = b;
+  if (ra->score == rb->score) {
+    return 0;
+  }
+
+  return ra->score < rb->score ? -1 : 1;
+}
+
+static int chunk_io_thread(void* data);
+static void chunks_drain_completed(SBI_ChunkStreamer* streamer);
+static Sint32 chunks_acquire_slot(SBI_ChunkStreamer* streamer, Uint32 bytes);
+
+SBI_ChunkStreamerOptions SBI_ChunkStreamerDefaultOptions(const char* path) {
+  return (SBI_ChunkStreamerOptions){
+      .path = path,
+      .host_budget = 256ull * 1024ull * 1024ull,
+      .vram_budget = 512ull * 1024ull * 1024ull,
+      .upload_budget = 16u * 1024u * 1024u,
+      .load_radius = 60.0f,
+      .prefetch_time = 1.0f,
+  };
+}
+
+bool SBI_ChunkWorldBake(const char* path,
+                        const SBI_Vec4* instances,
+                        Uint64 instances_count,
+                        float chunk_size) {
+  char index_path[512] = {0};
+  char data_path[512] = {0};
+  SDL_snprintf(index_path, sizeof(index_path), "%s/%s", path,
+               SBI_CHUNK_INDEX_FILE);
+  SDL_snprintf(data_path, sizeof(data_path), "%s/%s", path,
+               SBI_CHUNK_DATA_FILE);
+
+  if (!SDL_CreateDirectory(path)) {
+    SDL_Log("Could not create world directory: %s", SDL_GetError());
+    return false;
+  }
+
+  ChunkBakeKey* keys = SDL_malloc(sizeof(ChunkBakeKey) * instances_count);
+  SBI_Vec4* chunk_data =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * instances_count);
+  SBI_ChunkInfo* infos = NULL;
+  Uint32 infos_count = 0;
+  Uint32 infos_capacity = 0;
+  bool result = false;
+  SDL_IOStream* data_file = NULL;
+  SDL_IOStream* index_file = NULL;
+  if (keys == NULL || chunk_data == NULL) {
+    SDL_Log("Could not allocate memory to bake %ld instances",
+            instances_count);
+    goto cleanup;
+  }
+
+  // Bin each instance by its chunk coordinate
+  for (Uint64 i = 0; i < instances_count; i++) {
+    keys[i].index = i;
+    for (Uint32 c = 0; c < 3; c++) {
+      keys[i].coord[c] = (Sint32)SDL_floorf(instances[i][c] / chunk_size);
+    }
+  }
+  SDL_qsort(keys, instances_count, sizeof(ChunkBakeKey), compare_bake_keys);
+
+  data_file = SDL_IOFromFile(data_path, "wb");
+  if (data_file == NULL) {
+    SDL_Log("Could not open world data file: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  Uint64 offset = 0;
+  for (Uint64 begin = 0; begin < instances_count;) {
+    Uint64 end = begin + 1;
+    while (end < instances_count &&
+           compare_bake_keys(&keys[begin], &keys[end]) == 0) {
+      end++;
+    }
+
+    if (infos_count == infos_capacity) {
+      infos_capacity = infos_capacity == 0 ? 64 : infos_capacity * 2;
+      SBI_ChunkInfo* grown =
+          SDL_realloc(infos, sizeof(SBI_ChunkInfo) * infos_capacity);
+      if (grown == NULL) {
+        SDL_Log("Could not allocate memory for chunk index");
+        goto cleanup;
+      }
+      infos = grown;
+    }
+
+    SBI_ChunkInfo* info = &infos[infos_count++];
+    SDL_memset(info, 0, sizeof(SBI_ChunkInfo));
+    SDL_memcpy(info->coord, keys[begin].coord, sizeof(info->coord));
+    info->count = (Uint32)(end - begin);
+    info->offset = offset;
+    SBI_Vec3Copy(instances[keys[begin].index], info->min);
+    SBI_Vec3Copy(instances[keys[begin].index], info->max);
+    for (Uint64 i = begin; i < end; i++) {
+      const float* instance = instances[keys[i].index];
+      SDL_memcpy(chunk_data[i - begin], instance, sizeof(SBI_Vec4));
+      for (Uint32 c = 0; c < 3; c++) {
+        info->min[c] = SDL_min(info->min[c], instance[c] - instance[3]);
+        info->max[c] = SDL_max(info->max[c], instance[c] + instance[3]);
+      }
+    }
+
+    size_t bytes = sizeof(SBI_Vec4) * info->count;
+    if (SDL_WriteIO(data_file, chunk_data, bytes) != bytes) {
+      SDL_Log("Could not write world data: %s", SDL_GetError());
+      goto cleanup;
+    }
+    offset += bytes;
+    begin = end;
+  }
+
+  index_file = SDL_IOFromFile(index_path, "wb");
+  if (index_file == NULL) {
+    SDL_Log("Could not open world index file: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  SBI_ChunkIndexHeader header = {
+      .magic = SBI_CHUNK_MAGIC,
+      .version = SBI_CHUNK_VERSION,
+      .chunk_size = chunk_size,
+      .chunk_count = infos_count,
+  };
+  size_t infos_bytes = sizeof(SBI_ChunkInfo) * infos_count;
+  if (SDL_WriteIO(index_file, &header, sizeof(header)) != sizeof(header) ||
+      SDL_WriteIO(index_file, infos, infos_bytes) != infos_bytes) {
+    SDL_Log("Could not write world index: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  SDL_Log("Baked %ld instances into %d chunks at %s", instances_count,
+          infos_count, path);
+  result = true;
+
+cleanup:
+  if (index_file != NULL) {
+    SDL_CloseIO(index_file);
+  }
+  if (data_file != NULL) {
+    SDL_CloseIO(data_file);
+  }
+  SDL_free(infos);
+  SDL_free(keys);
+  SDL_aligned_free(chunk_data);
+  return result;
+}
+
+bool SBI_ChunkStreamerLoad(SBI_ChunkStreamer* streamer,
+                           SDL_GPUDevice* device,
+                           SBI_GPUMemory* memory,
+                           SBI_ChunkStreamerOptions options) {
+  char index_path[512] = {0};
+  char data_path[512] = {0};
+  SDL_snprintf(index_path, sizeof(index_path), "%s/%s", options.path,
+               SBI_CHUNK_INDEX_FILE);
+  SDL_snprintf(data_path, sizeof(data_path), "%s/%s", options.path,
+               SBI_CHUNK_DATA_FILE);
+
+  SDL_memset(streamer, 0, sizeof(SBI_ChunkStreamer));
+  streamer->device = device;
+  streamer->memory = memory;
+  streamer->options = options;
+  streamer->loading = -1;
+
+  size_t index_size = 0;
+  Uint8* index_data = SDL_LoadFile(index_path, &index_size);
+  if (index_data == NULL) {
+    SDL_Log("Couldn't load world index: %s", SDL_GetError());
+    return false;
+  }
+
+  SBI_ChunkIndexHeader header = {0};
+  if (index_size >= sizeof(header)) {
+    SDL_memcpy(&header, index_data, sizeof(header));
+  }
+  if (header.magic != SBI_CHUNK_MAGIC || header.version != SBI_CHUNK_VERSION ||
+      index_size <
+          sizeof(header) + sizeof(SBI_ChunkInfo) * header.chunk_count) {
+    SDL_Log("Invalid world index: %s", index_path);
+    SDL_free(index_data);
+    return false;
+  }
+
+  Uint32 count = header.chunk_count;
+  streamer->chunk_size = header.chunk_size;
+  streamer->chunks_count = count;
+  streamer->infos = SDL_malloc(sizeof(SBI_ChunkInfo) * count);
+  streamer->entries = SDL_malloc(sizeof(SBI_ChunkEntry) * count);
+  streamer->ranks = SDL_malloc(sizeof(SBI_ChunkRank) * count);
+  streamer->pending = SDL_malloc(sizeof(Uint32) * count);
+  streamer->completed = SDL_malloc(sizeof(SBI_ChunkLoad) * count);
+  if (streamer->infos == NULL || streamer->entries == NULL ||
+      streamer->ranks == NULL || streamer->pending == NULL ||
+      streamer->completed == NULL) {
+    SDL_Log("Could not allocate memory for %d chunks", count);
+    SDL_free(index_data);
+    return false;
+  }
+
+  SDL_memcpy(streamer->infos, index_data + sizeof(header),
+             sizeof(SBI_ChunkInfo) * count);
+  SDL_free(index_data);
+
+  for (Uint32 i = 0; i < count; i++) {
+    streamer->entries[i] = (SBI_ChunkEntry){
+        .state = SBI_CHUNK_UNLOADED,
+        .data = NULL,
+        .slot = -1,
+        .desired = false,
+    };
+    streamer->chunk_capacity =
+        SDL_max(streamer->chunk_capacity, streamer->infos[i].count);
+  }
+
+  // A slot per chunk, the VRAM budget bounds the bytes of the resident ones
+  Uint32 slot_size = sizeof(SBI_Vec4) * SDL_max(streamer->chunk_capacity, 1);
+  streamer->slots_count = SDL_max(count, 1);
+  streamer->slots = SDL_calloc(streamer->slots_count, sizeof(SBI_ChunkSlot));
+  if (streamer->slots == NULL) {
+    SDL_Log("Could not allocate memory for chunk slots");
+    return false;
+  }
+
+  for (Uint32 i = 0; i < streamer->slots_count; i++) {
+    streamer->slots[i].chunk = -1;
+  }
+
+  streamer->options.upload_budget = SDL_max(options.upload_budget, slot_size);
+  SDL_GPUTransferBufferCreateInfo upload_transfer_buffer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = streamer->options.upload_budget,
+  };
+  streamer->upload_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &upload_transfer_buffer_create_info);
+  if (streamer->upload_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of chunks");
+    return false;
+  }
+
+  streamer->data_file = SDL_IOFromFile(data_path, "rb");
+  if (streamer->data_file == NULL) {
+    SDL_Log("Couldn't open world data: %s", SDL_GetError());
+    return false;
+  }
+
+  streamer->lock = SDL_CreateMutex();
+  streamer->wake = SDL_CreateCondition();
+  if (streamer->lock == NULL || streamer->wake == NULL) {
+    SDL_Log("Couldn't create chunk streamer sync objects: %s", SDL_GetError());
+    return false;
+  }
+
+  streamer->io_thread =
+      SDL_CreateThread(chunk_io_thread, "SBI_ChunkIO", streamer);
+  if (streamer->io_thread == NULL) {
+    SDL_Log("Couldn't create chunk I/O thread: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_Log("Streaming %d chunks of up to %d instances in %" SDL_PRIu64
+          " bytes of VRAM",
+          count, streamer->chunk_capacity, options.vram_budget);
+  return true;
+}
+
+void SBI_ChunkStreamerUpdate(SBI_ChunkStreamer* streamer,
+                             const SBI_Camera* camera,
+                             float dt) {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+  SBI_Frustum frustum = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 velocity = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 predicted = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 center = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 extent = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 delta = {0};
+  SBI_ChunkStreamerOptions* options = &streamer->options;
+
+  chunks_drain_completed(streamer);
+
+  // Estimate the camera velocity to prefetch chunks ahead of it
+  if (streamer->frame > 0 && dt > 0.0f) {
+    SBI_Vec3Sub(camera->orbit_point, streamer->last_focus, velocity);
+    SBI_Vec3Scale(velocity, 1.0f / dt, velocity);
+    SBI_Vec3Sub(velocity, streamer->velocity, delta);
+    SBI_Vec3Scale(delta, CHUNK_VELOCITY_SMOOTHING, delta);
+    SBI_Vec3Add(streamer->velocity, delta, streamer->velocity);
+  }
+  SBI_Vec3Copy(camera->orbit_point, streamer->last_focus);
+  SBI_Vec3Scale(streamer->velocity, options->prefetch_time, predicted);
+  SBI_Vec3Add(camera->orbit_point, predicted, predicted);
+
+  SBI_Mat4Mul(camera->proj, camera->view, pv);
+  SBI_FrustumFromMat4(pv, frustum);
+
+  // Rank the chunks close to the focus or to where it is heading
+  Uint32 candidates = 0;
+  for (Uint32 i = 0; i < streamer->chunks_count; i++) {
+    const SBI_ChunkInfo* info = &streamer->infos[i];
+    streamer->entries[i].desired = false;
+
+    SBI_Vec3Add(info->min, info->max, center);
+    SBI_Vec3Scale(center, 0.5f, center);
+    SBI_Vec3Sub(info->max, center, extent);
+    float radius = SBI_Vec3Len(extent);
+
+    SBI_Vec3Sub(center, camera->orbit_point, delta);
+    float distance = SBI_Vec3Len(delta);
+    SBI_Vec3Sub(center, predicted, delta);
+    distance = SDL_max(SDL_min(distance, SBI_Vec3Len(delta)) - radius, 0.0f);
+    if (distance > options->load_radius) {
+      continue;
+    }
+
+    bool visible = SBI_FrustumTestAABB(frustum, info->min, info->max);
+    streamer->ranks[candidates++] = (SBI_ChunkRank){
+        .score = visible ? distance : distance * 2.0f + options->load_radius,
+        .chunk = i,
+    };
+  }
+  SDL_qsort(streamer->ranks, candidates, sizeof(SBI_ChunkRank), compare_ranks);
+
+  // Keep the best ranked chunks that fit in the GPU slots
+  streamer->desired_count = SDL_min(candidates, streamer->slots_count);
+  for (Uint32 r = 0; r < streamer->desired_count; r++) {
+    SBI_ChunkEntry* entry = &streamer->entries[streamer->ranks[r].chunk];
+    entry->desired = true;
+    if (entry->state == SBI_CHUNK_RESIDENT) {
+      streamer->slots[entry->slot].last_used = streamer->frame;
+    }
+  }
+
+  // Drop host copies that are no longer wanted, GPU copies stay for the LRU
+  Uint64 host_bytes = 0;
+  for (Uint32 i = 0; i < streamer->chunks_count; i++) {
+    SBI_ChunkEntry* entry = &streamer->entries[i];
+    if (entry->state != SBI_CHUNK_LOADED) {
+      continue;
+    }
+
+    if (!entry->desired) {
+      SDL_aligned_free(entry->data);
+      entry->data = NULL;
+      entry->state = SBI_CHUNK_UNLOADED;
+      continue;
+    }
+    host_bytes += sizeof(SBI_Vec4) * streamer->infos[i].count;
+  }
+
+  // Replace the I/O queue with the missing chunks in rank order
+  SDL_LockMutex(streamer->lock);
+  {
+    for (Uint32 i = streamer->pending_head; i < streamer->pending_count; i++) {
+      SBI_ChunkEntry* entry = &streamer->entries[streamer->pending[i]];
+      if (entry->state == SBI_CHUNK_QUEUED) {
+        entry->state = SBI_CHUNK_UNLOADED;
+      }
+    }
+
+    if (streamer->loading >= 0) {
+      host_bytes += sizeof(SBI_Vec4) * streamer->infos[streamer->loading].count;
+    }
+
+    streamer->pending_head = 0;
+    streamer->pending_count = 0;
+    for (Uint32 r = 0; r < streamer->desired_count; r++) {
+      Uint32 chunk = streamer->ranks[r].chunk;
+      SBI_ChunkEntry* entry = &streamer->entries[chunk];
+      Uint64 bytes = sizeof(SBI_Vec4) * streamer->infos[chunk].count;
+      if (entry->state != SBI_CHUNK_UNLOADED || chunk == streamer->loading) {
+        continue;
+      }
+
+      if (host_bytes + bytes > options->host_budget) {
+        break;
+      }
+
+      entry->state = SBI_CHUNK_QUEUED;
+      streamer->pending[streamer->pending_count++] = chunk;
+      host_bytes += bytes;
+    }
+
+    if (streamer->pending_count > 0) {
+      SDL_SignalCondition(streamer->wake);
+    }
+  }
+  SDL_UnlockMutex(streamer->lock);
+
+  streamer->frame++;
+}
+
+void SBI_ChunkStreamerUpload(SBI_ChunkStreamer* streamer,
+                             SDL_GPUCommandBuffer* cmd_buf) {
+  chunks_drain_completed(streamer);
+
+  Uint8* transfer_point = NULL;
+  SDL_GPUCopyPass* copy_pass = NULL;
+  Uint32 transfer_offset = 0;
+  for (Uint32 r = 0; r < streamer->desired_count; r++) {
+    Uint32 chunk = streamer->ranks[r].chunk;
+    SBI_ChunkEntry* entry = &streamer->entries[chunk];
+    Uint32 bytes = sizeof(SBI_Vec4) * streamer->infos[chunk].count;
+    if (entry->state != SBI_CHUNK_LOADED) {
+      continue;
+    }
+
+    if (transfer_offset + bytes > streamer->options.upload_budget) {
+      break;
+    }
+
+    Sint32 slot = chunks_acquire_slot(streamer, bytes);
+    if (slot < 0) {
+      break;
+    }
+
+    if (transfer_point == NULL) {
+      transfer_point = SDL_MapGPUTransferBuffer(
+          streamer->device, streamer->upload_transfer_buffer, true);
+      copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    }
+    SDL_memcpy(transfer_point + transfer_offset, entry->data, bytes);
+
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = streamer->upload_transfer_buffer,
+        .offset = transfer_offset,
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = streamer->slots[slot].allocation.buffer,
+        .offset = streamer->slots[slot].allocation.offset,
+        .size = bytes,
+    };
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+    transfer_offset += bytes;
+
+    SDL_aligned_free(entry->data);
+    entry->data = NULL;
+    entry->state = SBI_CHUNK_RESIDENT;
+    entry->slot = slot;
+    streamer->slots[slot].chunk = (Sint32)chunk;
+    streamer->slots[slot].last_used = streamer->frame;
+  }
+
+  if (transfer_point != NULL) {
+    SDL_UnmapGPUTransferBuffer(streamer->device,
+                               streamer->upload_transfer_buffer);
+    SDL_EndGPUCopyPass(copy_pass);
+  }
+}
+
+bool SBI_ChunkStreamerSettled(SBI_ChunkStreamer* streamer) {
+  SDL_LockMutex(streamer->lock);
+  bool settled = streamer->pending_head >= streamer->pending_count &&
+                 streamer->loading < 0 && streamer->completed_count == 0;
+  SDL_UnlockMutex(streamer->lock);
+
+  for (Uint32 r = 0; settled && r < streamer->desired_count; r++) {
+    settled = streamer->entries[streamer->ranks[r].chunk].state !=
+              SBI_CHUNK_LOADED;
+  }
+  return settled;
+}
+
+void SBI_ChunkStreamerDraw(SBI_ChunkStreamer* streamer,
+                           SBI_Billboard* billboard,
+                           const SBI_Mat4 proj,
+                           const SBI_Mat4 view,
+                           const SBI_Vec3 view_pos,
+                           SDL_GPUCommandBuffer* cmd_buf,
+                           SDL_GPURenderPass* render_pass) {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+  SBI_Frustum frustum = {0};
+  SBI_Mat4Mul(proj, view, pv);
+  SBI_FrustumFromMat4(pv, frustum);
+
+  for (Uint32 i = 0; i < streamer->slots_count; i++) {
+    SBI_ChunkSlot* slot = &streamer->slots[i];
+    if (slot->chunk < 0) {
+      continue;
+    }
+
+    const SBI_ChunkInfo* info = &streamer->infos[slot->chunk];
+    if (!SBI_FrustumTestAABB(frustum, info->min, info->max)) {
+      continue;
+    }
+
+    SBI_BillboardDrawBuffer(billboard, slot->allocation.buffer, NULL,
+                            slot->allocation.offset / sizeof(SBI_Vec4),
+                            info->count, proj, view, view_pos, cmd_buf,
+                            render_pass);
+  }
+}
+
+void SBI_ChunkStreamerDestroy(SBI_ChunkStreamer* streamer) {
+  if (streamer->io_thread != NULL) {
+    SDL_LockMutex(streamer->lock);
+    streamer->quit = true;
+    SDL_SignalCondition(streamer->wake);
+    SDL_UnlockMutex(streamer->lock);
+    SDL_WaitThread(streamer->io_thread, NULL);
+    streamer->io_thread = NULL;
+  }
+
+  if (streamer->completed != NULL) {
+    chunks_drain_completed(streamer);
+  }
+
+  if (streamer->entries != NULL) {
+    for (Uint32 i = 0; i < streamer->chunks_count; i++) {
+      SDL_aligned_free(streamer->entries[i].data);
+    }
+  }
+
+  if (streamer->slots != NULL) {
+    for (Uint32 i = 0; i < streamer->slots_count; i++) {
+      SBI_GPUMemoryFree(streamer->memory, &streamer->slots[i].allocation);
+    }
+  }
+
+  if (streamer->upload_transfer_buffer != NULL) {
+    SDL_ReleaseGPUTransferBuffer(streamer->device,
+                                 streamer->upload_transfer_buffer);
+  }
+
+  if (streamer->data_file != NULL) {
+    SDL_CloseIO(streamer->data_file);
+  }
+
+  SDL_DestroyCondition(streamer->wake);
+  SDL_DestroyMutex(streamer->lock);
+  SDL_free(streamer->slots);
+  SDL_free(streamer->completed);
+  SDL_free(streamer->pending);
+  SDL_free(streamer->ranks);
+  SDL_free(streamer->entries);
+  SDL_free(streamer->infos);
+  SDL_memset(streamer, 0, sizeof(SBI_ChunkStreamer));
+}
+
+static int chunk_io_thread(void* data) {
+  SBI_ChunkStreamer* streamer = data;
+
+  SDL_LockMutex(streamer->lock);
+  while (!streamer->quit) {
+    if (streamer->pending_head >= streamer->pending_count) {
+      SDL_WaitCondition(streamer->wake, streamer->lock);
+      continue;
+    }
+
+    Uint32 chunk = streamer->pending[streamer->pending_head++];
+    const SBI_ChunkInfo* info = &streamer->infos[chunk];
+    streamer->loading = chunk;
+    SDL_UnlockMutex(streamer->lock);
+
+    // Read outside of the lock so the main thread never waits on I/O
+    size_t bytes = sizeof(SBI_Vec4) * info->count;
+    SBI_Vec4* chunk_data = SDL_aligned_alloc(16, bytes);
+    if (chunk_data != NULL &&
+        (SDL_SeekIO(streamer->data_file, (Sint64)info->offset,
+                    SDL_IO_SEEK_SET) < 0 ||
+         SDL_ReadIO(streamer->data_file, chunk_data, bytes) != bytes)) {
+      SDL_Log("Couldn't read chunk %d: %s", chunk, SDL_GetError());
+      SDL_aligned_free(chunk_data);
+      chunk_data = NULL;
+    }
+
+    SDL_LockMutex(streamer->lock);
+    streamer->loading = -1;
+    if (chunk_data != NULL) {
+      streamer->completed[streamer->completed_count++] = (SBI_ChunkLoad){
+          .chunk = chunk,
+          .data = chunk_data,
+      };
+    }
+  }
+  SDL_UnlockMutex(streamer->lock);
+  return 0;
+}
+
+static void chunks_drain_completed(SBI_ChunkStreamer* streamer) {
+  SDL_LockMutex(streamer->lock);
+  for (Uint32 i = 0; i < streamer->completed_count; i++) {
+    SBI_ChunkLoad* load = &streamer->completed[i];
+    SBI_ChunkEntry* entry = &streamer->entries[load->chunk];
+    if (entry->state == SBI_CHUNK_LOADED ||
+        entry->state == SBI_CHUNK_RESIDENT) {
+      SDL_aligned_free(load->data);
+      continue;
+    }
+
+    entry->state = SBI_CHUNK_LOADED;
+    entry->data = load->data;
+  }
+  streamer->completed_count = 0;
+  SDL_UnlockMutex(streamer->lock);
+}
+
+// Evict the least recently used chunk that is no longer wanted, its range
+// is recycled once the frames drawing it are done
+static bool chunks_evict(SBI_ChunkStreamer* streamer) {
+  Sint32 best = -1;
+  for (Uint32 i = 0; i < streamer->slots_count; i++) {
+    SBI_ChunkSlot* slot = &streamer->slots[i];
+    if (slot->chunk < 0 || streamer->entries[slot->chunk].desired) {
+      continue;
+    }
+
+    if (best < 0 || slot->last_used < streamer->slots[best].last_used) {
+      best = (Sint32)i;
+    }
+  }
+
+  if (best < 0) {
+    return false;
+  }
+
+  SBI_ChunkSlot* slot = &streamer->slots[best];
+  SBI_ChunkEntry* evicted = &streamer->entries[slot->chunk];
+  evicted->state = SBI_CHUNK_UNLOADED;
+  evicted->slot = -1;
+  streamer->resident_bytes -= slot->allocation.size;
+  SBI_GPUMemoryFree(streamer->memory, &slot->allocation);
+  slot->chunk = -1;
+  return true;
+}
+
+static Sint32 chunks_acquire_slot(SBI_ChunkStreamer* streamer, Uint32 bytes) {
+  Sint32 free_slot = -1;
+  for (Uint32 i = 0; i < streamer->slots_count && free_slot < 0; i++) {
+    if (streamer->slots[i].chunk < 0) {
+      free_slot = (Sint32)i;
+    }
+  }
+  if (free_slot < 0) {
+    return -1;
+  }
+
+  SBI_GPUAllocation* allocation = &streamer->slots[free_slot].allocation;
+  while (streamer->resident_bytes + bytes > streamer->options.vram_budget ||
+         !SBI_GPUMemoryAlloc(streamer->memory, SBI_GPU_POOL_STORAGE, bytes,
+                             allocation)) {
+    if (!chunks_evict(streamer)) {
+      return -1;
+    }
+  }
+
+  streamer->resident_bytes += allocation->size;
+  return free_slot;
+}
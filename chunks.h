@@ -0,0 +1,156 @@
+#ifndef SBI_CHUNKS_H
+#define SBI_CHUNKS_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#include "billboard.h"
+#include "camera.h"
+#include "gpumemory.h"
+#include "xmath.h"
+
+#define SBI_CHUNK_MAGIC SDL_FOURCC('S', 'B', 'C', 'K')
+#define SBI_CHUNK_VERSION (1)
+#define SBI_CHUNK_INDEX_FILE "index.bin"
+#define SBI_CHUNK_DATA_FILE "chunks.bin"
+
+// Header of the world index file, followed by chunk_count SBI_ChunkInfo
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  float chunk_size;
+  Uint32 chunk_count;
+} SBI_ChunkIndexHeader;
+
+// On-disk description of a chunk of instances
+typedef struct {
+  Sint32 coord[3];
+  Uint32 count;
+  Uint64 offset;
+  SBI_Vec3 min;
+  SBI_Vec3 max;
+} SBI_ChunkInfo;
+
+typedef enum {
+  SBI_CHUNK_UNLOADED,
+  SBI_CHUNK_QUEUED,
+  SBI_CHUNK_LOADED,
+  SBI_CHUNK_RESIDENT,
+} SBI_ChunkState;
+
+// Runtime state of a chunk, only touched by the main thread
+typedef struct {
+  SBI_ChunkState state;
+  SBI_Vec4* data;
+  Sint32 slot;
+  bool desired;
+} SBI_ChunkEntry;
+
+// Chunk candidate ordered by its distance score (lower is more important)
+typedef struct {
+  float score;
+  Uint32 chunk;
+} SBI_ChunkRank;
+
+// Storage suballocated for a resident chunk, recycled in LRU order
+typedef struct {
+  SBI_GPUAllocation allocation;
+  Sint32 chunk;
+  Uint64 last_used;
+} SBI_ChunkSlot;
+
+// A chunk read by the I/O thread
+typedef struct {
+  Uint32 chunk;
+  SBI_Vec4* data;
+} SBI_ChunkLoad;
+
+// Budgets and tuning of the chunk streamer
+typedef struct {
+  const char* path;
+  Uint64 host_budget;
+  Uint64 vram_budget;
+  Uint32 upload_budget;
+  float load_radius;
+  float prefetch_time;
+} SBI_ChunkStreamerOptions;
+
+// Pages spatial chunks of billboard instances from disk around the camera.
+typedef struct {
+  SDL_GPUDevice* device;
+  SBI_GPUMemory* memory;
+  SDL_GPUTransferBuffer* upload_transfer_buffer;
+  SBI_ChunkStreamerOptions options;
+  float chunk_size;
+  Uint32 chunk_capacity;
+
+  SBI_ChunkInfo* infos;
+  SBI_ChunkEntry* entries;
+  SBI_ChunkRank* ranks;
+  Uint32 chunks_count;
+  Uint32 desired_count;
+
+  SBI_ChunkSlot* slots;
+  Uint32 slots_count;
+  Uint64 resident_bytes;
+  Uint64 frame;
+
+  SBI_ALIGN_VEC3 SBI_Vec3 last_focus;
+  SBI_ALIGN_VEC3 SBI_Vec3 velocity;
+
+  // Shared with the I/O thread, guarded by lock
+  SDL_Thread* io_thread;
+  SDL_Mutex* lock;
+  SDL_Condition* wake;
+  SDL_IOStream* data_file;
+  Uint32* pending;
+  Uint32 pending_head;
+  Uint32 pending_count;
+  SBI_ChunkLoad* completed;
+  Uint32 completed_count;
+  Sint64 loading;
+  bool quit;
+} SBI_ChunkStreamer;
+
+// Default options for a streamed world stored at path
+SBI_ChunkStreamerOptions SBI_ChunkStreamerDefaultOptions(const char* path);
+
+// Split instances into chunks of chunk_size and write them to a world dir
+bool SBI_ChunkWorldBake(const char* path,
+                        const SBI_Vec4* instances,
+                        Uint64 instances_count,
+                        float chunk_size);
+
+// Open a world and start the background I/O thread, resident chunks are
+// suballocated from the storage pool of memory
+bool SBI_ChunkStreamerLoad(SBI_ChunkStreamer* streamer,
+                           SDL_GPUDevice* device,
+                           SBI_GPUMemory* memory,
+                           SBI_ChunkStreamerOptions options);
+
+// Pick the chunks to keep resident and queue the missing ones (fixed rate)
+void SBI_ChunkStreamerUpdate(SBI_ChunkStreamer* streamer,
+                             const SBI_Camera* camera,
+                             float dt);
+
+// Upload loaded chunks within the upload budget, before the render pass
+void SBI_ChunkStreamerUpload(SBI_ChunkStreamer* streamer,
+                             SDL_GPUCommandBuffer* cmd_buf);
+
+// Whether every wanted chunk is resident and the I/O thread has no work
+bool SBI_ChunkStreamerSettled(SBI_ChunkStreamer* streamer);
+
+// Draw the resident chunks that are inside the view
+void SBI_ChunkStreamerDraw(SBI_ChunkStreamer* streamer,
+                           SBI_Billboard* billboard,
+                           const SBI_Mat4 proj,
+                           const SBI_Mat4 view,
+                           const SBI_Vec3 view_pos,
+                           SDL_GPUCommandBuffer* cmd_buf,
+                           SDL_GPURenderPass* render_pass);
+
+// Stop the I/O thread and release every chunk
+void SBI_ChunkStreamerDestroy(SBI_ChunkStreamer* streamer);
+
+#endif /* SBI_CHUNKS_H */
@@ -0,0 +1,455 @@
+#include "debugdraw.h"
+#include "hiz.h"
+#include "shader.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv;
+  Uint32 first[4];  // x: first vertex of the mode in the buffer
+} DebugDrawUniforms;
+
+static const SBI_Vec3 debug_draw_axes[3] = {
+    {1.0f, 0.0f, 0.0f},
+    {0.0f, 1.0f, 0.0f},
+    {0.0f, 0.0f, 1.0f},
+};
+
+static const Uint32 debug_draw_axis_colors[3] = {
+    SBI_DEBUG_COLOR(255, 0, 0, 255),
+    SBI_DEBUG_COLOR(0, 255, 0, 255),
+    SBI_DEBUG_COLOR(0, 0, 255, 255),
+};
+
+static bool debug_draw_load_pipelines(SBI_DebugDraw* debug,
+                                      SDL_Window* window) {
+  SDL_GPUDevice* device = debug->device;
+  SBI_ShaderOptions vert_options = (SBI_ShaderOptions){
+      .filename = "debug_draw.vert",
+      .stage = SDL_GPU_SHADERSTAGE_VERTEX,
+      .sampler_count = 0,
+      .uniform_buffer_count = 1,
+      .storage_buffer_count = 1,
+      .storage_texture_count = 0,
+  };
+  SDL_GPUShader* vert_shader = SBI_ShaderLoad(device, vert_options);
+  if (vert_shader == NULL) {
+    return false;
+  }
+
+  SBI_ShaderOptions frag_options = (SBI_ShaderOptions){
+      .filename = "debug_draw.frag",
+      .stage = SDL_GPU_SHADERSTAGE_FRAGMENT,
+      .sampler_count = 0,
+      .uniform_buffer_count = 0,
+      .storage_buffer_count = 0,
+      .storage_texture_count = 0,
+  };
+  SDL_GPUShader* frag_shader = SBI_ShaderLoad(device, frag_options);
+  if (frag_shader == NULL) {
+    SDL_ReleaseGPUShader(device, vert_shader);
+    return false;
+  }
+
+  // Both modes draw in the same pass, the overlay ignores its depth
+  SDL_GPUGraphicsPipelineTargetInfo target_info = {
+      .num_color_targets = 1,
+      .color_target_descriptions = (SDL_GPUColorTargetDescription[]){{
+          .format = SDL_GetGPUSwapchainTextureFormat(device, window),
+          .blend_state =
+              (SDL_GPUColorTargetBlendState){
+                  .enable_blend = true,
+                  .src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                  .dst_color_blendfactor =
+                      SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                  .color_blend_op = SDL_GPU_BLENDOP_ADD,
+                  .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                  .dst_alpha_blendfactor =
+                      SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                  .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+              },
+      }},
+      .has_depth_stencil_target = true,
+      .depth_stencil_format = SBI_HIZ_DEPTH_FORMAT,
+  };
+
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    bool depth = m == SBI_DEBUG_DRAW_DEPTH;
+    SDL_GPUGraphicsPipelineCreateInfo pipeline_create_info = {
+        .target_info = target_info,
+        .primitive_type = SDL_GPU_PRIMITIVETYPE_LINELIST,
+        .vertex_shader = vert_shader,
+        .fragment_shader = frag_shader,
+        .depth_stencil_state =
+            (SDL_GPUDepthStencilState){
+                .compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL,
+                .enable_depth_test = depth,
+                .enable_depth_write = depth,
+            },
+    };
+    debug->pipelines[m] =
+        SDL_CreateGPUGraphicsPipeline(device, &pipeline_create_info);
+  }
+
+  SDL_ReleaseGPUShader(device, vert_shader);
+  SDL_ReleaseGPUShader(device, frag_shader);
+
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    if (debug->pipelines[m] == NULL) {
+      SDL_Log("Couldn't create graphics pipeline for debug draw");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SBI_DebugDrawLoad(SBI_DebugDraw* debug,
+                       SDL_GPUDevice* device,
+                       SBI_GPUMemory* memory,
+                       SDL_Window* window,
+                       Uint32 capacity) {
+  debug->device = device;
+  debug->memory = memory;
+  if (!debug_draw_load_pipelines(debug, window)) {
+    return false;
+  }
+
+  capacity = SDL_clamp(capacity, 2, SBI_DEBUG_DRAW_MAX_VERTICES);
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    SBI_DebugDrawList* list = &debug->lists[m];
+    list->vertices = SDL_malloc(sizeof(SBI_DebugVertex) * capacity);
+    if (list->vertices == NULL) {
+      SDL_Log("Could not allocate memory for %d debug vertices", capacity);
+      return false;
+    }
+    list->capacity = capacity;
+  }
+
+  for (Uint32 i = 0; i <= SBI_DEBUG_DRAW_CIRCLE_SEGMENTS; i++) {
+    float angle = 2.0f * SDL_PI_F * (float)i /
+                  (float)SBI_DEBUG_DRAW_CIRCLE_SEGMENTS;
+    debug->circle[i][0] = SDL_cosf(angle);
+    debug->circle[i][1] = SDL_sinf(angle);
+  }
+  return true;
+}
+
+// Room for count more vertices in the list of mode, NULL when the
+// primitive is dropped
+static SBI_DebugVertex* debug_draw_reserve(SBI_DebugDraw* debug,
+                                           SBI_DebugDrawMode mode,
+                                           Uint32 count) {
+  SBI_DebugDrawList* list = &debug->lists[mode];
+  if (list->count + count > list->capacity) {
+    Uint32 needed = list->count + count;
+    if (needed > SBI_DEBUG_DRAW_MAX_VERTICES || list->vertices == NULL) {
+      debug->dropped_count++;
+      return NULL;
+    }
+
+    Uint32 capacity = SDL_min(SDL_max(list->capacity * 2, needed),
+                              SBI_DEBUG_DRAW_MAX_VERTICES);
+    SBI_DebugVertex* vertices =
+        SDL_realloc(list->vertices, sizeof(SBI_DebugVertex) * capacity);
+    if (vertices == NULL) {
+      debug->dropped_count++;
+      return NULL;
+    }
+    list->vertices = vertices;
+    list->capacity = capacity;
+  }
+
+  SBI_DebugVertex* vertices = list->vertices + list->count;
+  list->count += count;
+  return vertices;
+}
+
+static inline void debug_draw_vertex(SBI_DebugVertex* vertex,
+                                     const float* position,
+                                     Uint32 color) {
+  vertex->position[0] = position[0];
+  vertex->position[1] = position[1];
+  vertex->position[2] = position[2];
+  vertex->color = color;
+}
+
+void SBI_DebugDrawLine(SBI_DebugDraw* debug,
+                       const SBI_Vec3 a,
+                       const SBI_Vec3 b,
+                       Uint32 color,
+                       SBI_DebugDrawMode mode) {
+  SBI_DebugVertex* vertices = debug_draw_reserve(debug, mode, 2);
+  if (vertices == NULL) {
+    return;
+  }
+  debug_draw_vertex(&vertices[0], a, color);
+  debug_draw_vertex(&vertices[1], b, color);
+}
+
+// The 12 edges of a box join the corners that differ in one bit, bit 0
+// selects x, bit 1 y and bit 2 z
+static void debug_draw_box(SBI_DebugDraw* debug,
+                           SBI_Vec3 corners[8],
+                           Uint32 color,
+                           SBI_DebugDrawMode mode) {
+  SBI_DebugVertex* vertices = debug_draw_reserve(debug, mode, 24);
+  if (vertices == NULL) {
+    return;
+  }
+  for (Uint32 c = 0; c < 8; c++) {
+    for (Uint32 bit = 1; bit < 8; bit <<= 1) {
+      if ((c & bit) == 0) {
+        debug_draw_vertex(vertices++, corners[c], color);
+        debug_draw_vertex(vertices++, corners[c | bit], color);
+      }
+    }
+  }
+}
+
+void SBI_DebugDrawAABB(SBI_DebugDraw* debug,
+                       const SBI_Vec3 min,
+                       const SBI_Vec3 max,
+                       Uint32 color,
+                       SBI_DebugDrawMode mode) {
+  SBI_Vec3 corners[8];
+  for (Uint32 c = 0; c < 8; c++) {
+    corners[c][0] = (c & 1) ? max[0] : min[0];
+    corners[c][1] = (c & 2) ? max[1] : min[1];
+    corners[c][2] = (c & 4) ? max[2] : min[2];
+  }
+  debug_draw_box(debug, corners, color, mode);
+}
+
+void SBI_DebugDrawSphere(SBI_DebugDraw* debug,
+                         const SBI_Vec3 center,
+                         float radius,
+                         Uint32 color,
+                         SBI_DebugDrawMode mode) {
+  SBI_DebugVertex* vertices =
+      debug_draw_reserve(debug, mode, 6 * SBI_DEBUG_DRAW_CIRCLE_SEGMENTS);
+  if (vertices == NULL) {
+    return;
+  }
+
+  // A circle per plane, the two unit table values go to axes u and v
+  for (Uint32 axis = 0; axis < 3; axis++) {
+    Uint32 u = (axis + 1) % 3;
+    Uint32 v = (axis + 2) % 3;
+    for (Uint32 i = 0; i < 2 * SBI_DEBUG_DRAW_CIRCLE_SEGMENTS; i++) {
+      const float* unit = debug->circle[(i + 1) / 2];
+      float point[3] = {center[0], center[1], center[2]};
+      point[u] += unit[0] * radius;
+      point[v] += unit[1] * radius;
+      debug_draw_vertex(vertices++, point, color);
+    }
+  }
+}
+
+void SBI_DebugDrawFrustum(SBI_DebugDraw* debug,
+                          const SBI_Mat4 pv,
+                          Uint32 color,
+                          SBI_DebugDrawMode mode) {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv_inv = {0};
+  if (!SBI_Mat4Invert(pv, pv_inv)) {
+    return;
+  }
+
+  // Unproject the corners of the clip volume, depth goes from 0 to 1
+  SBI_Vec3 corners[8];
+  for (Uint32 c = 0; c < 8; c++) {
+    SBI_ALIGN_VEC4 SBI_Vec4 clip = {
+        (c & 1) ? 1.0f : -1.0f,
+        (c & 2) ? 1.0f : -1.0f,
+        (c & 4) ? 1.0f : 0.0f,
+        1.0f,
+    };
+    SBI_ALIGN_VEC4 SBI_Vec4 world = {0};
+    SBI_Mat4TransformVec4(pv_inv, clip, world);
+    corners[c][0] = world[0] / world[3];
+    corners[c][1] = world[1] / world[3];
+    corners[c][2] = world[2] / world[3];
+  }
+  debug_draw_box(debug, corners, color, mode);
+}
+
+void SBI_DebugDrawAxis(SBI_DebugDraw* debug,
+                       const SBI_XForm xform,
+                       float length,
+                       SBI_DebugDrawMode mode) {
+  SBI_DebugVertex* vertices = debug_draw_reserve(debug, mode, 6);
+  if (vertices == NULL) {
+    return;
+  }
+
+  const float* origin = &xform[4];
+  for (Uint32 a = 0; a < 3; a++) {
+    SBI_ALIGN_VEC3 SBI_Vec3 end = {0};
+    SBI_ALIGN_VEC3 SBI_Vec3 axis = {
+        debug_draw_axes[a][0] * length,
+        debug_draw_axes[a][1] * length,
+        debug_draw_axes[a][2] * length,
+    };
+    SBI_QuatTransformVec3(xform, axis, end);
+    SBI_Vec3Add(end, origin, end);
+    debug_draw_vertex(vertices++, origin, debug_draw_axis_colors[a]);
+    debug_draw_vertex(vertices++, end, debug_draw_axis_colors[a]);
+  }
+}
+
+bool SBI_DebugDrawUpload(SBI_DebugDraw* debug, SDL_GPUCommandBuffer* cmd_buf) {
+  Uint32 total = 0;
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    SBI_DebugDrawList* list = &debug->lists[m];
+    list->first = total;
+    list->drawn_count = 0;
+    total += list->count;
+  }
+  if (total == 0) {
+    return true;
+  }
+
+  // Staging and vertices are only used by this frame, both are recycled
+  // once it is done on the GPU
+  Uint32 size = (Uint32)sizeof(SBI_DebugVertex) * total;
+  SBI_GPUAllocation staging = {0};
+  bool reserved =
+      SBI_GPUMemoryAllocFrame(debug->memory, SBI_GPU_POOL_UPLOAD, size,
+                              &staging) &&
+      SBI_GPUMemoryAllocFrame(debug->memory, SBI_GPU_POOL_STORAGE, size,
+                              &debug->vertices);
+  Uint8* transfer_point =
+      reserved ? SBI_GPUMemoryMap(debug->memory, &staging) : NULL;
+  if (transfer_point != NULL) {
+    // The lists are packed one after the other, each drawn from its first
+    for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+      SBI_DebugDrawList* list = &debug->lists[m];
+      SDL_memcpy(transfer_point + sizeof(SBI_DebugVertex) * list->first,
+                 list->vertices, sizeof(SBI_DebugVertex) * list->count);
+      list->first += debug->vertices.offset / sizeof(SBI_DebugVertex);
+      list->drawn_count = list->count;
+    }
+    SBI_GPUMemoryUnmap(debug->memory, &staging);
+
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = staging.transfer_buffer,
+        .offset = staging.offset,
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = debug->vertices.buffer,
+        .offset = debug->vertices.offset,
+        .size = size,
+    };
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+    SDL_EndGPUCopyPass(copy_pass);
+  } else {
+    SDL_Log("Couldn't allocate %d debug vertices", total);
+    reserved = false;
+  }
+
+  // Immediate mode: the next frame appends its primitives from scratch
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    debug->lists[m].count = 0;
+  }
+  return reserved;
+}
+
+bool SBI_DebugDrawPrepare(SBI_DebugDraw* debug, Uint32 width, Uint32 height) {
+  if (debug->depth != NULL && debug->width == width &&
+      debug->height == height) {
+    return true;
+  }
+
+  SDL_ReleaseGPUTexture(debug->device, debug->depth);
+  debug->width = 0;
+  debug->height = 0;
+
+  SDL_GPUTextureCreateInfo depth_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SBI_HIZ_DEPTH_FORMAT,
+      .usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  debug->depth = SDL_CreateGPUTexture(debug->device, &depth_create_info);
+  if (debug->depth == NULL) {
+    SDL_Log("Couldn't create debug draw depth: %s", SDL_GetError());
+    return false;
+  }
+
+  debug->width = width;
+  debug->height = height;
+  return true;
+}
+
+void SBI_DebugDrawRender(SBI_DebugDraw* debug,
+                         SBI_View* views,
+                         Uint32 views_count,
+                         float scale,
+                         SDL_GPUTexture* target,
+                         SDL_GPUTexture* scene_depth,
+                         SDL_GPUCommandBuffer* cmd_buf) {
+  SDL_GPUTexture* depth = scene_depth != NULL ? scene_depth : debug->depth;
+  Uint32 drawn_count = 0;
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    drawn_count += debug->lists[m].drawn_count;
+  }
+  if (drawn_count == 0 || depth == NULL) {
+    return;
+  }
+
+  SDL_GPUColorTargetInfo color_target_info = {
+      .texture = target,
+      .load_op = SDL_GPU_LOADOP_LOAD,
+      .store_op = SDL_GPU_STOREOP_STORE,
+  };
+  SDL_GPUDepthStencilTargetInfo depth_target_info = {
+      .texture = depth,
+      .clear_depth = 1.0f,
+      .load_op =
+          scene_depth != NULL ? SDL_GPU_LOADOP_LOAD : SDL_GPU_LOADOP_CLEAR,
+      .store_op = scene_depth != NULL ? SDL_GPU_STOREOP_STORE
+                                      : SDL_GPU_STOREOP_DONT_CARE,
+      .stencil_load_op = SDL_GPU_LOADOP_DONT_CARE,
+      .stencil_store_op = SDL_GPU_STOREOP_DONT_CARE,
+  };
+  SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(
+      cmd_buf, &color_target_info, 1, &depth_target_info);
+  SDL_BindGPUVertexStorageBuffers(render_pass, 0, &debug->vertices.buffer, 1);
+
+  // One draw per mode and view
+  for (Uint32 i = 0; i < views_count; i++) {
+    SBI_View* view = &views[i];
+    SBI_ViewBegin(view, render_pass, scale);
+
+    DebugDrawUniforms uniforms = {0};
+    SBI_Mat4Mul(view->camera.proj, view->camera.view, uniforms.pv);
+    for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+      SBI_DebugDrawList* list = &debug->lists[m];
+      if (list->drawn_count == 0) {
+        continue;
+      }
+
+      uniforms.first[0] = list->first;
+      SDL_BindGPUGraphicsPipeline(render_pass, debug->pipelines[m]);
+      SDL_PushGPUVertexUniformData(cmd_buf, 0, &uniforms,
+                                   sizeof(DebugDrawUniforms));
+      SDL_DrawGPUPrimitives(render_pass, list->drawn_count, 1, 0, 0);
+    }
+  }
+  SDL_EndGPURenderPass(render_pass);
+}
+
+void SBI_DebugDrawDestroy(SBI_DebugDraw* debug) {
+  for (Uint32 m = 0; m < SBI_DEBUG_DRAW_MODE_COUNT; m++) {
+    SDL_ReleaseGPUGraphicsPipeline(debug->device, debug->pipelines[m]);
+    SDL_free(debug->lists[m].vertices);
+  }
+  SDL_ReleaseGPUTexture(debug->device, debug->depth);
+  SDL_memset(debug, 0, sizeof(SBI_DebugDraw));
+}
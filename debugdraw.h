@@ -0,0 +1,116 @@
+#ifndef SBI_DEBUGDRAW_H
+#define SBI_DEBUGDRAW_H
+
+#include <SDL3/SDL_gpu.h>
+
+#include "gpumemory.h"
+#include "view.h"
+#include "xmath.h"
+
+#define SBI_DEBUG_DRAW_CAPACITY (65536)
+#define SBI_DEBUG_DRAW_MAX_VERTICES (1 << 22)
+#define SBI_DEBUG_DRAW_CIRCLE_SEGMENTS (32)
+
+// Color packed as RGBA8, red in the low byte
+#define SBI_DEBUG_COLOR(r, g, b, a) \
+  ((Uint32)(r) | (Uint32)(g) << 8 | (Uint32)(b) << 16 | (Uint32)(a) << 24)
+
+// Depth tested primitives are hidden by nearer geometry, overlay ones are
+// drawn over everything
+typedef enum {
+  SBI_DEBUG_DRAW_DEPTH,
+  SBI_DEBUG_DRAW_OVERLAY,
+  SBI_DEBUG_DRAW_MODE_COUNT,
+} SBI_DebugDrawMode;
+
+typedef struct {
+  float position[3];
+  Uint32 color;
+} SBI_DebugVertex;
+
+// Vertices of a mode appended since the last upload
+typedef struct {
+  SBI_DebugVertex* vertices;
+  Uint32 count;
+  Uint32 capacity;
+  Uint32 first;
+  Uint32 drawn_count;
+} SBI_DebugDrawList;
+
+// Immediate mode lines: every primitive is appended as line list vertices
+// to the list of its mode on the CPU. Upload sends the lists of the frame
+// in one copy and empties them, render draws each mode once per view.
+// The vertices of a frame live in a frame allocation of memory.
+typedef struct {
+  SDL_GPUDevice* device;
+  SBI_GPUMemory* memory;
+  SDL_GPUGraphicsPipeline* pipelines[SBI_DEBUG_DRAW_MODE_COUNT];
+  SBI_GPUAllocation vertices;
+  SDL_GPUTexture* depth;
+  Uint32 width;
+  Uint32 height;
+  SBI_DebugDrawList lists[SBI_DEBUG_DRAW_MODE_COUNT];
+  float circle[SBI_DEBUG_DRAW_CIRCLE_SEGMENTS + 1][2];
+  Uint64 dropped_count;
+} SBI_DebugDraw;
+
+// Load the pipelines and room for capacity vertices per mode, the lists
+// grow up to SBI_DEBUG_DRAW_MAX_VERTICES and drop primitives past it
+bool SBI_DebugDrawLoad(SBI_DebugDraw* debug,
+                       SDL_GPUDevice* device,
+                       SBI_GPUMemory* memory,
+                       SDL_Window* window,
+                       Uint32 capacity);
+
+void SBI_DebugDrawLine(SBI_DebugDraw* debug,
+                       const SBI_Vec3 a,
+                       const SBI_Vec3 b,
+                       Uint32 color,
+                       SBI_DebugDrawMode mode);
+
+// Axis aligned box between two corners
+void SBI_DebugDrawAABB(SBI_DebugDraw* debug,
+                       const SBI_Vec3 min,
+                       const SBI_Vec3 max,
+                       Uint32 color,
+                       SBI_DebugDrawMode mode);
+
+// Three circles around the center in the axis planes
+void SBI_DebugDrawSphere(SBI_DebugDraw* debug,
+                         const SBI_Vec3 center,
+                         float radius,
+                         Uint32 color,
+                         SBI_DebugDrawMode mode);
+
+// Edges of the volume seen through a camera, pv is its projection view
+void SBI_DebugDrawFrustum(SBI_DebugDraw* debug,
+                          const SBI_Mat4 pv,
+                          Uint32 color,
+                          SBI_DebugDrawMode mode);
+
+// Local axes of a transform as red, green and blue lines of length
+void SBI_DebugDrawAxis(SBI_DebugDraw* debug,
+                       const SBI_XForm xform,
+                       float length,
+                       SBI_DebugDrawMode mode);
+
+// Copy the appended primitives to the GPU and start the next frame
+bool SBI_DebugDrawUpload(SBI_DebugDraw* debug, SDL_GPUCommandBuffer* cmd_buf);
+
+// Create the depth target used when the scene has none
+bool SBI_DebugDrawPrepare(SBI_DebugDraw* debug, Uint32 width, Uint32 height);
+
+// Draw the uploaded primitives of every view over target in their own
+// pass. Depth tested ones are tested against scene_depth when the scene
+// has one, in SBI_HIZ_DEPTH_FORMAT, only against each other otherwise.
+void SBI_DebugDrawRender(SBI_DebugDraw* debug,
+                         SBI_View* views,
+                         Uint32 views_count,
+                         float scale,
+                         SDL_GPUTexture* target,
+                         SDL_GPUTexture* scene_depth,
+                         SDL_GPUCommandBuffer* cmd_buf);
+
+void SBI_DebugDrawDestroy(SBI_DebugDraw* debug);
+
+#endif /* SBI_DEBUGDRAW_H */
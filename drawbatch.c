@@ -0,0 +1,319 @@
+#include "drawbatch.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+static int compare_entries(const void* a, const void* b) {
+  const SBI_DrawBatchEntry* ea = a;
+  const SBI_DrawBatchEntry* eb = b;
+  if (ea->key != eb->key) {
+    return ea->key < eb->key ? -1 : 1;
+  }
+  if (ea->order != eb->order) {
+    return ea->order < eb->order ? -1 : 1;
+  }
+  return 0;
+}
+
+// Animated sets push their own time and sorted sets reorder their streams
+// every frame, both keep their own draw
+static bool drawbatch_mergeable(const SBI_Billboard* billboard) {
+  return billboard->animations == NULL &&
+         billboard->blend != SBI_BILLBOARD_BLEND_SORTED;
+}
+
+static bool drawbatch_create_buffers(SBI_DrawBatch* batch, Uint32 capacity) {
+  SDL_GPUBufferCreateInfo positions_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+      .size = sizeof(SBI_Vec4) * capacity,
+  };
+  SDL_GPUBufferCreateInfo colors_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+      .size = sizeof(Uint32) * capacity,
+  };
+  SDL_GPUBuffer* positions =
+      SDL_CreateGPUBuffer(batch->device, &positions_create_info);
+  SDL_GPUBuffer* colors =
+      SDL_CreateGPUBuffer(batch->device, &colors_create_info);
+  if (positions == NULL || colors == NULL) {
+    SDL_Log("Failed to create batch buffers for %d instances: %s", capacity,
+            SDL_GetError());
+    SDL_ReleaseGPUBuffer(batch->device, positions);
+    SDL_ReleaseGPUBuffer(batch->device, colors);
+    return false;
+  }
+
+  // Released once the frames drawing from the old buffers are done
+  SDL_ReleaseGPUBuffer(batch->device, batch->positions);
+  SDL_ReleaseGPUBuffer(batch->device, batch->colors);
+  batch->positions = positions;
+  batch->colors = colors;
+  batch->capacity = capacity;
+  return true;
+}
+
+bool SBI_DrawBatchLoad(SBI_DrawBatch* batch,
+                       SDL_GPUDevice* device,
+                       Uint32 capacity) {
+  SDL_memset(batch, 0, sizeof(SBI_DrawBatch));
+  batch->device = device;
+  return drawbatch_create_buffers(batch, SDL_max(capacity, 1));
+}
+
+Uint64 SBI_DrawBatchKey(const SBI_Billboard* billboard) {
+  Uint64 frames_count = billboard->atlas_columns * billboard->atlas_rows;
+  Uint64 opacity =
+      (Uint64)(SDL_clamp(billboard->opacity, 0.0f, 1.0f) * 65535.0f);
+  return (Uint64)billboard->blend << SBI_DRAW_BATCH_BLEND_SHIFT |
+         (Uint64)billboard->mode << SBI_DRAW_BATCH_MODE_SHIFT |
+         (Uint64)billboard->depth_test << SBI_DRAW_BATCH_DEPTH_SHIFT |
+         (Uint64)(billboard->lights != NULL) << SBI_DRAW_BATCH_LIT_SHIFT |
+         (frames_count & 0xFFFF) << SBI_DRAW_BATCH_ATLAS_SHIFT |
+         opacity << SBI_DRAW_BATCH_OPACITY_SHIFT;
+}
+
+void SBI_DrawBatchBegin(SBI_DrawBatch* batch) {
+  batch->entries_count = 0;
+  batch->atlases_count = 0;
+}
+
+// Index of the atlas of a set among the atlases of the frame, past the
+// bits of the key the set keeps its own draw
+static bool drawbatch_texture(SBI_DrawBatch* batch,
+                              SDL_GPUTexture* atlas,
+                              Uint64* texture) {
+  Uint32 index = 0;
+  while (index < batch->atlases_count && batch->atlases[index] != atlas) {
+    index++;
+  }
+  if (index == batch->atlases_count) {
+    if (batch->atlases_count == batch->atlases_capacity) {
+      Uint32 capacity = SDL_max(batch->atlases_capacity * 2, 16);
+      SDL_GPUTexture** atlases =
+          SDL_realloc(batch->atlases, sizeof(SDL_GPUTexture*) * capacity);
+      if (atlases == NULL) {
+        SDL_Log("Could not allocate memory for %d batched atlases", capacity);
+        return false;
+      }
+      batch->atlases = atlases;
+      batch->atlases_capacity = capacity;
+    }
+    batch->atlases[batch->atlases_count++] = atlas;
+  }
+  *texture = index;
+  return true;
+}
+
+bool SBI_DrawBatchAdd(SBI_DrawBatch* batch, SBI_Billboard* billboard) {
+  if (batch->entries_count == batch->entries_capacity) {
+    Uint32 capacity = SDL_max(batch->entries_capacity * 2, 64);
+    SBI_DrawBatchEntry* entries =
+        SDL_realloc(batch->entries, sizeof(SBI_DrawBatchEntry) * capacity);
+    SBI_DrawBatchEntry* previous =
+        SDL_realloc(batch->previous, sizeof(SBI_DrawBatchEntry) * capacity);
+    if (entries != NULL) {
+      batch->entries = entries;
+    }
+    if (previous != NULL) {
+      batch->previous = previous;
+    }
+    if (entries == NULL || previous == NULL) {
+      SDL_Log("Could not allocate memory for %d batched sets", capacity);
+      return false;
+    }
+    batch->entries_capacity = capacity;
+  }
+
+  Uint64 texture = 0;
+  if (!drawbatch_texture(batch, billboard->atlas, &texture)) {
+    return false;
+  }
+
+  Uint32 order = batch->entries_count++;
+  Uint64 key = SBI_DrawBatchKey(billboard) |
+               (texture & SBI_DRAW_BATCH_TEXTURE_MASK)
+                   << SBI_DRAW_BATCH_TEXTURE_SHIFT;
+  if (!drawbatch_mergeable(billboard) ||
+      texture > SBI_DRAW_BATCH_TEXTURE_MASK) {
+    key |= (order + 1) & SBI_DRAW_BATCH_SEQUENCE_MASK;
+  }
+  batch->entries[order] = (SBI_DrawBatchEntry){
+      .billboard = billboard,
+      .key = key,
+      .order = order,
+  };
+  return true;
+}
+
+// Entries sharing a key with a neighbour in key order share the buffers,
+// lone ones keep their own draw and skip the copy
+static Uint32 drawbatch_assign(SBI_DrawBatch* batch) {
+  Uint32 first = 0;
+  batch->merged_count = 0;
+  for (Uint32 i = 0; i < batch->entries_count; i++) {
+    SBI_DrawBatchEntry* entry = &batch->entries[i];
+    bool mergeable = drawbatch_mergeable(entry->billboard) &&
+                     entry->billboard->instances_count > 0;
+    bool shared = (i > 0 && batch->entries[i - 1].key == entry->key) ||
+                  (i + 1 < batch->entries_count &&
+                   batch->entries[i + 1].key == entry->key);
+    entry->merged = mergeable && shared;
+    entry->first = first;
+    if (entry->merged) {
+      first += (Uint32)entry->billboard->instances_count;
+      batch->merged_count++;
+    }
+  }
+  return first;
+}
+
+static bool drawbatch_layout_changed(const SBI_DrawBatch* batch) {
+  if (batch->entries_count != batch->previous_count) {
+    return true;
+  }
+  for (Uint32 i = 0; i < batch->entries_count; i++) {
+    const SBI_DrawBatchEntry* entry = &batch->entries[i];
+    const SBI_DrawBatchEntry* previous = &batch->previous[i];
+    if (entry->billboard != previous->billboard ||
+        entry->key != previous->key || entry->first != previous->first ||
+        entry->merged != previous->merged) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SBI_DrawBatchPrepare(SBI_DrawBatch* batch,
+                          SDL_GPUCommandBuffer* cmd_buf) {
+  batch->copied_bytes = 0;
+  SDL_qsort(batch->entries, batch->entries_count, sizeof(SBI_DrawBatchEntry),
+            compare_entries);
+  Uint32 merged_instances = drawbatch_assign(batch);
+
+  batch->layout_changed = drawbatch_layout_changed(batch);
+  if (merged_instances > batch->capacity) {
+    Uint32 capacity = SDL_max(merged_instances, batch->capacity * 2);
+    if (!drawbatch_create_buffers(batch, capacity)) {
+      return false;
+    }
+    batch->layout_changed = true;
+  }
+
+  // Sets are copied from the buffers their upload just wrote
+  SDL_GPUCopyPass* copy_pass = NULL;
+  for (Uint32 i = 0; i < batch->entries_count; i++) {
+    SBI_DrawBatchEntry* entry = &batch->entries[i];
+    SBI_Billboard* billboard = entry->billboard;
+    bool changed = batch->layout_changed ||
+                   batch->previous[i].version != billboard->version;
+    entry->version = billboard->version;
+    if (!entry->merged || !changed) {
+      continue;
+    }
+
+    if (copy_pass == NULL) {
+      copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    }
+    const SBI_BillboardStreamBuffer* streams = billboard->streams;
+    Uint32 count = (Uint32)billboard->instances_count;
+    SDL_GPUBufferLocation positions_source = {
+        .buffer = streams[SBI_BILLBOARD_STREAM_POSITION].buffer,
+        .offset = 0,
+    };
+    SDL_GPUBufferLocation positions_destination = {
+        .buffer = batch->positions,
+        .offset = sizeof(SBI_Vec4) * entry->first,
+    };
+    SDL_CopyGPUBufferToBuffer(copy_pass, &positions_source,
+                              &positions_destination, sizeof(SBI_Vec4) * count,
+                              false);
+    SDL_GPUBufferLocation colors_source = {
+        .buffer = streams[SBI_BILLBOARD_STREAM_COLOR].buffer,
+        .offset = 0,
+    };
+    SDL_GPUBufferLocation colors_destination = {
+        .buffer = batch->colors,
+        .offset = sizeof(Uint32) * entry->first,
+    };
+    SDL_CopyGPUBufferToBuffer(copy_pass, &colors_source, &colors_destination,
+                              sizeof(Uint32) * count, false);
+    batch->copied_bytes += (sizeof(SBI_Vec4) + sizeof(Uint32)) * count;
+  }
+  if (copy_pass != NULL) {
+    SDL_EndGPUCopyPass(copy_pass);
+  }
+
+  SDL_memcpy(batch->previous, batch->entries,
+             sizeof(SBI_DrawBatchEntry) * batch->entries_count);
+  batch->previous_count = batch->entries_count;
+  return true;
+}
+
+void SBI_DrawBatchDraw(SBI_DrawBatch* batch,
+                       const SBI_Mat4 proj,
+                       const SBI_Mat4 view,
+                       const SBI_Vec3 view_pos,
+                       SDL_GPUCommandBuffer* cmd_buf,
+                       SDL_GPURenderPass* render_pass) {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+  SBI_Frustum frustum = {0};
+  SBI_Mat4Mul(proj, view, pv);
+  SBI_FrustumFromMat4(pv, frustum);
+  for (Uint32 i = 0; i < batch->entries_count; i++) {
+    SBI_DrawBatchEntry* entry = &batch->entries[i];
+    const SBI_Billboard* billboard = entry->billboard;
+    entry->visible = billboard->instances_count > 0 &&
+                     SBI_FrustumTestAABB(frustum, billboard->bounds_min,
+                                         billboard->bounds_max);
+  }
+
+  batch->draws_count = 0;
+  Uint32 i = 0;
+  while (i < batch->entries_count) {
+    SBI_DrawBatchEntry* entry = &batch->entries[i];
+    if (!entry->visible) {
+      i++;
+      continue;
+    }
+    if (!entry->merged) {
+      SBI_BillboardDraw(entry->billboard, proj, view, view_pos, cmd_buf,
+                        render_pass);
+      batch->draws_count++;
+      i++;
+      continue;
+    }
+
+    // Extend the run over the next visible sets of the key, they follow
+    // each other in the shared buffers
+    Uint32 count = (Uint32)entry->billboard->instances_count;
+    Uint32 end = i + 1;
+    while (end < batch->entries_count) {
+      const SBI_DrawBatchEntry* next = &batch->entries[end];
+      if (!next->visible || !next->merged || next->key != entry->key ||
+          next->billboard->lights != entry->billboard->lights ||
+          next->billboard->atlas != entry->billboard->atlas) {
+        break;
+      }
+      count += (Uint32)next->billboard->instances_count;
+      end++;
+    }
+
+    SBI_BillboardDrawBuffer(entry->billboard, batch->positions, batch->colors,
+                            entry->first, count, proj, view, view_pos, cmd_buf,
+                            render_pass);
+    batch->draws_count++;
+    i = end;
+  }
+}
+
+void SBI_DrawBatchDestroy(SBI_DrawBatch* batch) {
+  if (batch->device != NULL) {
+    SDL_ReleaseGPUBuffer(batch->device, batch->positions);
+    SDL_ReleaseGPUBuffer(batch->device, batch->colors);
+  }
+  SDL_free(batch->entries);
+  SDL_free(batch->previous);
+  SDL_free(batch->atlases);
+  SDL_memset(batch, 0, sizeof(SBI_DrawBatch));
+}
@@ -0,0 +1,96 @@
+#ifndef SBI_DRAWBATCH_H
+#define SBI_DRAWBATCH_H
+
+#include <SDL3/SDL_gpu.h>
+
+#include "billboard.h"
+#include "xmath.h"
+
+#define SBI_DRAW_BATCH_CAPACITY (65536)
+
+// Sort key of a set, from the most to the least expensive state change:
+// blend, mode, depth test, lights, atlas frames, opacity, atlas texture.
+// Sets that can not share a draw (animated or sorted) also get a unique
+// sequence in the low bits.
+#define SBI_DRAW_BATCH_BLEND_SHIFT (62)
+#define SBI_DRAW_BATCH_MODE_SHIFT (60)
+#define SBI_DRAW_BATCH_DEPTH_SHIFT (59)
+#define SBI_DRAW_BATCH_LIT_SHIFT (58)
+#define SBI_DRAW_BATCH_ATLAS_SHIFT (42)
+#define SBI_DRAW_BATCH_OPACITY_SHIFT (26)
+#define SBI_DRAW_BATCH_TEXTURE_SHIFT (16)
+#define SBI_DRAW_BATCH_TEXTURE_MASK (0x3FFull)
+#define SBI_DRAW_BATCH_SEQUENCE_MASK ((1ull << 16) - 1)
+
+// A set added this frame and where its instances sit in the shared buffers
+typedef struct {
+  SBI_Billboard* billboard;
+  Uint64 key;
+  Uint32 order;
+  Uint32 first;
+  Uint64 version;
+  bool merged;
+  bool visible;
+} SBI_DrawBatchEntry;
+
+// Sets added once per frame are sorted by key, those sharing a key are
+// copied into shared position and color buffers so consecutive visible
+// ones are drawn with the pipeline of the first in one instanced draw. A
+// set is copied again only when its version changes or the list of sets
+// is not the one of the last frame. The others are drawn on their own.
+// The app draws a single set, the chunks and particles through its
+// pipeline, so only the draw-batch bench drives a batch.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUBuffer* positions;
+  SDL_GPUBuffer* colors;
+  Uint32 capacity;
+
+  SBI_DrawBatchEntry* entries;
+  SBI_DrawBatchEntry* previous;
+  Uint32 entries_count;
+  Uint32 previous_count;
+  Uint32 entries_capacity;
+  Uint32 merged_count;
+  bool layout_changed;
+
+  // Atlas textures of the frame, their index is the texture of the key
+  SDL_GPUTexture** atlases;
+  Uint32 atlases_count;
+  Uint32 atlases_capacity;
+
+  // Counters of the last draw
+  Uint32 draws_count;
+  Uint64 copied_bytes;
+} SBI_DrawBatch;
+
+// Shared buffers for capacity instances, they grow on demand
+bool SBI_DrawBatchLoad(SBI_DrawBatch* batch,
+                       SDL_GPUDevice* device,
+                       Uint32 capacity);
+
+// Key of a set without its atlas texture, equal keys share pipeline state
+Uint64 SBI_DrawBatchKey(const SBI_Billboard* billboard);
+
+// Start collecting the sets of a frame
+void SBI_DrawBatchBegin(SBI_DrawBatch* batch);
+
+// Add an uploaded set to the frame
+bool SBI_DrawBatchAdd(SBI_DrawBatch* batch, SBI_Billboard* billboard);
+
+// Sort the sets and copy the changed ones to the shared buffers, after
+// their SBI_BillboardUpload and before any render pass
+bool SBI_DrawBatchPrepare(SBI_DrawBatch* batch, SDL_GPUCommandBuffer* cmd_buf);
+
+// Draw the sets in key order, sets out of view are skipped and split the
+// runs of shared draws
+void SBI_DrawBatchDraw(SBI_DrawBatch* batch,
+                       const SBI_Mat4 proj,
+                       const SBI_Mat4 view,
+                       const SBI_Vec3 view_pos,
+                       SDL_GPUCommandBuffer* cmd_buf,
+                       SDL_GPURenderPass* render_pass);
+
+void SBI_DrawBatchDestroy(SBI_DrawBatch* batch);
+
+#endif /* SBI_DRAWBATCH_H */
@@ -0,0 +1,317 @@
+#include "flock.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define FLOCK_DENSITY (0.1f)
+
+static void flock_hash_job(void* data, Uint32 worker, Uint64 begin,
+                           Uint64 end);
+static void flock_offsets_job(void* data, Uint32 worker, Uint64 begin,
+                              Uint64 end);
+static void flock_scatter_job(void* data, Uint32 worker, Uint64 begin,
+                              Uint64 end);
+static void flock_steer_job(void* data, Uint32 worker, Uint64 begin,
+                            Uint64 end);
+
+// Cells are two radii wide so the neighbours of an agent lie in the 2x2x2
+// cells around the nearest cell corner
+static float flock_cell_size(const SBI_Flock* flock) {
+  return flock->options.radius * 2.0f;
+}
+
+static Sint32 flock_cell(const SBI_Flock* flock, float x) {
+  return (Sint32)SDL_floorf(x / flock_cell_size(flock));
+}
+
+static Uint32 flock_hash(const SBI_Flock* flock, Sint32 x, Sint32 y,
+                         Sint32 z) {
+  Uint32 h = ((Uint32)x * 73856093u) ^ ((Uint32)y * 19349663u) ^
+             ((Uint32)z * 83492791u);
+  return h & (flock->buckets_count - 1);
+}
+
+SBI_FlockOptions SBI_FlockDefaultOptions(Uint64 agents_count) {
+  // Volume of 2e * 2e * 0.2e holding FLOCK_DENSITY agents per unit
+  float extent = SDL_powf((float)agents_count / FLOCK_DENSITY / 0.8f,
+                          1.0f / 3.0f);
+  return (SBI_FlockOptions){
+      .agents_count = agents_count,
+      .workers_count = 0,
+      .extent = SDL_max(extent, 5.0f),
+      .height = SDL_max(extent * 0.2f, 2.0f),
+      .radius = 2.0f,
+      .separation = 4.0f,
+      .alignment = 1.0f,
+      .cohesion = 0.5f,
+      .containment = 2.0f,
+      .min_speed = 2.0f,
+      .max_speed = 6.0f,
+      .scale = 0.25f,
+  };
+}
+
+bool SBI_FlockLoad(SBI_Flock* flock, SBI_FlockOptions options) {
+  SDL_memset(flock, 0, sizeof(SBI_Flock));
+  flock->options = options;
+
+  if (!SBI_JobPoolLoad(&flock->jobs, options.workers_count)) {
+    return false;
+  }
+
+  // Power of two buckets so the hash is a mask
+  Uint64 agents_count = options.agents_count;
+  flock->buckets_count = 1;
+  while (flock->buckets_count * SBI_FLOCK_AGENTS_PER_BUCKET < agents_count) {
+    flock->buckets_count <<= 1;
+  }
+
+  Uint32 buckets_count = flock->buckets_count;
+  Uint32 workers_count = flock->jobs.workers_count;
+  flock->velocities = SDL_aligned_alloc(16, sizeof(SBI_Vec4) * agents_count);
+  flock->sorted_positions =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * agents_count);
+  flock->sorted_velocities =
+      SDL_aligned_alloc(16, sizeof(SBI_Vec4) * agents_count);
+  flock->sorted_agents = SDL_malloc(sizeof(Uint32) * agents_count);
+  flock->keys = SDL_malloc(sizeof(Uint32) * agents_count);
+  flock->bucket_start = SDL_malloc(sizeof(Uint32) * (buckets_count + 1));
+  flock->histograms =
+      SDL_malloc(sizeof(Uint32) * buckets_count * workers_count);
+  if (flock->velocities == NULL || flock->sorted_positions == NULL ||
+      flock->sorted_velocities == NULL || flock->sorted_agents == NULL ||
+      flock->keys == NULL || flock->bucket_start == NULL ||
+      flock->histograms == NULL) {
+    SDL_Log("Could not allocate memory for %ld agents", agents_count);
+    return false;
+  }
+
+  SDL_memset(flock->velocities, 0, sizeof(SBI_Vec4) * agents_count);
+  SDL_Log("Flock of %ld agents, %d buckets, %d workers", agents_count,
+          buckets_count, workers_count);
+  return true;
+}
+
+void SBI_FlockSpawn(SBI_Flock* flock, SBI_Vec4* instances) {
+  const SBI_FlockOptions* options = &flock->options;
+  for (Uint64 i = 0; i < options->agents_count; i++) {
+    instances[i][0] = (SDL_randf() * 2.0f - 1.0f) * options->extent;
+    instances[i][1] = SDL_randf() * options->height;
+    instances[i][2] = (SDL_randf() * 2.0f - 1.0f) * options->extent;
+    instances[i][3] = options->scale;
+
+    float angle = SDL_randf() * SDL_PI_F * 2.0f;
+    float speed = (options->min_speed + options->max_speed) * 0.5f;
+    SBI_Vec3Make(SDL_cosf(angle) * speed, 0.0f, SDL_sinf(angle) * speed,
+                 flock->velocities[i]);
+  }
+}
+
+void SBI_FlockUpdate(SBI_Flock* flock, SBI_Vec4* instances, float dt) {
+  Uint64 agents_count = flock->options.agents_count;
+  if (agents_count == 0) {
+    return;
+  }
+
+  flock->positions = instances;
+  flock->dt = dt;
+
+  // Counting sort by bucket: per worker histograms, per bucket offsets of
+  // each worker, exclusive scan of the bucket sizes, then a stable scatter
+  SBI_JobPoolRun(&flock->jobs, flock_hash_job, flock, agents_count);
+  SBI_JobPoolRun(&flock->jobs, flock_offsets_job, flock,
+                 flock->buckets_count);
+
+  Uint32 start = 0;
+  for (Uint32 b = 0; b < flock->buckets_count; b++) {
+    Uint32 size = flock->bucket_start[b];
+    flock->bucket_start[b] = start;
+    start += size;
+  }
+  flock->bucket_start[flock->buckets_count] = start;
+
+  SBI_JobPoolRun(&flock->jobs, flock_scatter_job, flock, agents_count);
+  SBI_JobPoolRun(&flock->jobs, flock_steer_job, flock, agents_count);
+  flock->positions = NULL;
+}
+
+void SBI_FlockDestroy(SBI_Flock* flock) {
+  SBI_JobPoolDestroy(&flock->jobs);
+  SDL_aligned_free(flock->velocities);
+  SDL_aligned_free(flock->sorted_positions);
+  SDL_aligned_free(flock->sorted_velocities);
+  SDL_free(flock->sorted_agents);
+  SDL_free(flock->keys);
+  SDL_free(flock->bucket_start);
+  SDL_free(flock->histograms);
+  SDL_memset(flock, 0, sizeof(SBI_Flock));
+}
+
+static void flock_hash_job(void* data, Uint32 worker, Uint64 begin,
+                           Uint64 end) {
+  SBI_Flock* flock = data;
+  Uint32* histogram = flock->histograms + worker * flock->buckets_count;
+  SDL_memset(histogram, 0, sizeof(Uint32) * flock->buckets_count);
+
+  for (Uint64 i = begin; i < end; i++) {
+    const float* p = flock->positions[i];
+    Uint32 key = flock_hash(flock, flock_cell(flock, p[0]),
+                            flock_cell(flock, p[1]), flock_cell(flock, p[2]));
+    flock->keys[i] = key;
+    histogram[key]++;
+  }
+}
+
+static void flock_offsets_job(void* data, Uint32 worker, Uint64 begin,
+                              Uint64 end) {
+  SBI_Flock* flock = data;
+  Uint32 workers_count = flock->jobs.workers_count;
+
+  // Turn the counts of each worker into its offset inside the bucket
+  for (Uint64 b = begin; b < end; b++) {
+    Uint32 size = 0;
+    for (Uint32 w = 0; w < workers_count; w++) {
+      Uint32* count = &flock->histograms[w * flock->buckets_count + b];
+      Uint32 c = *count;
+      *count = size;
+      size += c;
+    }
+    flock->bucket_start[b] = size;
+  }
+}
+
+static void flock_scatter_job(void* data, Uint32 worker, Uint64 begin,
+                              Uint64 end) {
+  SBI_Flock* flock = data;
+  Uint32* offsets = flock->histograms + worker * flock->buckets_count;
+
+  // Same range as the hash job, so the offsets of this worker are private
+  for (Uint64 i = begin; i < end; i++) {
+    Uint32 key = flock->keys[i];
+    Uint32 dst = flock->bucket_start[key] + offsets[key]++;
+    SDL_memcpy(flock->sorted_positions[dst], flock->positions[i],
+               sizeof(SBI_Vec4));
+    SDL_memcpy(flock->sorted_velocities[dst], flock->velocities[i],
+               sizeof(SBI_Vec4));
+    flock->sorted_agents[dst] = (Uint32)i;
+  }
+}
+
+static void flock_steer_job(void* data, Uint32 worker, Uint64 begin,
+                            Uint64 end) {
+  SBI_Flock* flock = data;
+  const SBI_FlockOptions* options = &flock->options;
+  float radius_sq = options->radius * options->radius;
+  float dt = flock->dt;
+
+  // Agents are visited in bucket order so neighbour reads stay local
+  for (Uint64 j = begin; j < end; j++) {
+    const float* p = flock->sorted_positions[j];
+    const float* v = flock->sorted_velocities[j];
+
+    // The corner is at most a radius away on each axis, the block spans a
+    // cell (two radii) past it on both sides
+    Sint32 base[3];
+    for (Uint32 c = 0; c < 3; c++) {
+      float cell = p[c] / flock_cell_size(flock);
+      float floor = SDL_floorf(cell);
+      base[c] = (Sint32)floor - (cell - floor < 0.5f ? 1 : 0);
+    }
+
+    SBI_ALIGN_VEC3 SBI_Vec3 separation = {0};
+    SBI_ALIGN_VEC3 SBI_Vec3 heading = {0};
+    SBI_ALIGN_VEC3 SBI_Vec3 center = {0};
+    Uint32 neighbours = 0;
+
+    // Cells colliding in the hash share a bucket, visit each bucket once
+    Uint32 visited[8];
+    Uint32 visited_count = 0;
+    for (Uint32 corner = 0; corner < 8; corner++) {
+      Uint32 key = flock_hash(flock, base[0] + (Sint32)(corner & 1),
+                              base[1] + (Sint32)((corner >> 1) & 1),
+                              base[2] + (Sint32)((corner >> 2) & 1));
+      bool seen = false;
+      for (Uint32 k = 0; k < visited_count && !seen; k++) {
+        seen = visited[k] == key;
+      }
+      if (seen) {
+        continue;
+      }
+      visited[visited_count++] = key;
+
+      Uint32 first = flock->bucket_start[key];
+      Uint32 last = flock->bucket_start[key + 1];
+      for (Uint32 k = first;
+           k < last && neighbours < SBI_FLOCK_MAX_NEIGHBOURS; k++) {
+        // Distance test inlined, this loop dominates the tick
+        const float* q = flock->sorted_positions[k];
+        float dx = q[0] - p[0];
+        float dy = q[1] - p[1];
+        float dz = q[2] - p[2];
+        float dist_sq = dx * dx + dy * dy + dz * dz;
+        if (dist_sq > radius_sq || k == j || dist_sq <= 0.0f) {
+          continue;
+        }
+
+        // Push away harder from the closest neighbours
+        const float* w = flock->sorted_velocities[k];
+        float push = -1.0f / dist_sq;
+        separation[0] += dx * push;
+        separation[1] += dy * push;
+        separation[2] += dz * push;
+        heading[0] += w[0];
+        heading[1] += w[1];
+        heading[2] += w[2];
+        center[0] += q[0];
+        center[1] += q[1];
+        center[2] += q[2];
+        neighbours++;
+      }
+    }
+
+    SBI_ALIGN_VEC3 SBI_Vec3 steer = {0};
+    if (neighbours > 0) {
+      float inv = 1.0f / (float)neighbours;
+      SBI_Vec3Scale(separation, options->separation, steer);
+
+      SBI_Vec3Scale(heading, inv, heading);
+      SBI_Vec3Sub(heading, v, heading);
+      SBI_Vec3Scale(heading, options->alignment, heading);
+      SBI_Vec3Add(steer, heading, steer);
+
+      SBI_Vec3Scale(center, inv, center);
+      SBI_Vec3Sub(center, p, center);
+      SBI_Vec3Scale(center, options->cohesion, center);
+      SBI_Vec3Add(steer, center, steer);
+    }
+
+    // Turn back smoothly when leaving the bounds
+    const float bounds_min[3] = {-options->extent, 0.0f, -options->extent};
+    const float bounds_max[3] = {options->extent, options->height,
+                                 options->extent};
+    for (Uint32 c = 0; c < 3; c++) {
+      if (p[c] < bounds_min[c]) {
+        steer[c] += (bounds_min[c] - p[c]) * options->containment;
+      } else if (p[c] > bounds_max[c]) {
+        steer[c] -= (p[c] - bounds_max[c]) * options->containment;
+      }
+    }
+
+    SBI_ALIGN_VEC3 SBI_Vec3 velocity = {0};
+    SBI_Vec3Scale(steer, dt, steer);
+    SBI_Vec3Add(v, steer, velocity);
+    float speed = SBI_Vec3Len(velocity);
+    if (speed > 0.0f) {
+      float clamped = SDL_clamp(speed, options->min_speed, options->max_speed);
+      SBI_Vec3Scale(velocity, clamped / speed, velocity);
+    }
+
+    // Write back in agent order, the sorted copies are read only here
+    Uint32 agent = flock->sorted_agents[j];
+    float* position = flock->positions[agent];
+    SBI_Vec3Copy(velocity, flock->velocities[agent]);
+    SBI_Vec3Scale(velocity, dt, velocity);
+    SBI_Vec3Add(p, velocity, position);
+  }
+}
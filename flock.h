@@ -0,0 +1,62 @@
+#ifndef SBI_FLOCK_H
+#define SBI_FLOCK_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "jobs.h"
+#include "xmath.h"
+
+#define SBI_FLOCK_AGENTS_PER_BUCKET (4)
+#define SBI_FLOCK_MAX_NEIGHBOURS (32)
+
+// Behaviour and bounds of a flock
+typedef struct {
+  Uint64 agents_count;
+  Uint32 workers_count;
+  float extent;
+  float height;
+  float radius;
+  float separation;
+  float alignment;
+  float cohesion;
+  float containment;
+  float min_speed;
+  float max_speed;
+  float scale;
+} SBI_FlockOptions;
+
+// Boids steered by separation, alignment and cohesion. Neighbours are found
+// through a spatial hash of radius sized cells that is rebuilt every tick
+// with a parallel counting sort.
+typedef struct {
+  SBI_FlockOptions options;
+  SBI_JobPool jobs;
+  SBI_Vec4* positions;
+  SBI_Vec4* velocities;
+  float dt;
+
+  // Spatial hash, agents sorted by bucket
+  Uint32 buckets_count;
+  Uint32* keys;
+  Uint32* histograms;
+  Uint32* bucket_start;
+  Uint32* sorted_agents;
+  SBI_Vec4* sorted_positions;
+  SBI_Vec4* sorted_velocities;
+} SBI_Flock;
+
+// Default options, the bounds grow with agents_count to keep the density
+SBI_FlockOptions SBI_FlockDefaultOptions(Uint64 agents_count);
+
+// Allocate the flock and start its workers
+bool SBI_FlockLoad(SBI_Flock* flock, SBI_FlockOptions options);
+
+// Scatter the agents inside the bounds with random headings
+void SBI_FlockSpawn(SBI_Flock* flock, SBI_Vec4* instances);
+
+// Step the agents and write their positions to the instances (fixed rate)
+void SBI_FlockUpdate(SBI_Flock* flock, SBI_Vec4* instances, float dt);
+
+void SBI_FlockDestroy(SBI_Flock* flock);
+
+#endif /* SBI_FLOCK_H */
@@ -0,0 +1,417 @@
+#include "generator.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define PHILOX_M0 (0xD2511F53u)
+#define PHILOX_M1 (0xCD9E8D57u)
+#define PHILOX_W0 (0x9E3779B9u)
+#define PHILOX_W1 (0xBB67AE85u)
+#define PHILOX_ROUNDS (10)
+#define GENERATOR_MAX_CLUSTERS (256)
+#define GENERATOR_TERRAIN_OCTAVES (3)
+#define GENERATOR_TILE (256)
+#define GENERATOR_TILE_LANES (2 * GENERATOR_TERRAIN_OCTAVES * GENERATOR_TILE)
+#define GENERATOR_PALETTE_SIZE (256)
+
+// Scratch of a worker: random words of up to GENERATOR_TILE instances and
+// the arguments and results of the batched math kernels over them
+typedef struct {
+  Uint32 words[GENERATOR_TILE][8];
+  float args[GENERATOR_TILE_LANES];
+  float angles[GENERATOR_TILE_LANES];
+  float sin[GENERATOR_TILE_LANES];
+  float cos[GENERATOR_TILE_LANES];
+  float gauss[4][GENERATOR_TILE];
+} GeneratorTile;
+
+typedef struct {
+  const SBI_GeneratorOptions* options;
+  SBI_Vec4* instances;
+  Uint32* colors;
+  SBI_Vec4 centers[GENERATOR_MAX_CLUSTERS];
+  Uint32 clusters_count;
+  Uint32 palette[GENERATOR_PALETTE_SIZE];
+  GeneratorTile tiles[SBI_JOB_MAX_WORKERS];
+} GeneratorJob;
+
+static void generator_job(void* data, Uint32 worker, Uint64 begin,
+                          Uint64 end);
+
+static const char* generator_kind_names[SBI_GENERATOR_COUNT] = {
+    "uniform",
+    "clusters",
+    "galaxy",
+    "terrain",
+};
+
+SBI_GeneratorOptions SBI_GeneratorDefaultOptions(SBI_GeneratorKind kind) {
+  return (SBI_GeneratorOptions){
+      .kind = kind,
+      .seed = 0x5EED,
+      .extent = 10.0f,
+      .scale = 0.5f,
+      .clusters_count = 16,
+      .cluster_sigma = 0.8f,
+      .arms_count = 4,
+      .arm_twist = 5.0f,
+      .arm_spread = 0.25f,
+      .thickness = 1.0f,
+      .terrain_height = 3.0f,
+      .terrain_frequency = 0.3f,
+      .hover = 2.0f,
+  };
+}
+
+const char* SBI_GeneratorKindName(SBI_GeneratorKind kind) {
+  return kind < SBI_GENERATOR_COUNT ? generator_kind_names[kind] : "unknown";
+}
+
+bool SBI_GeneratorParseKind(const char* name, SBI_GeneratorKind* kind) {
+  for (Uint32 k = 0; k < SBI_GENERATOR_COUNT; k++) {
+    if (SDL_strcmp(name, generator_kind_names[k]) == 0) {
+      *kind = (SBI_GeneratorKind)k;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SBI_PhiloxBlock(const SBI_Philox* philox, Uint32 out[4]) {
+  Uint32 c0 = philox->counter[0];
+  Uint32 c1 = philox->counter[1];
+  Uint32 c2 = philox->counter[2];
+  Uint32 c3 = philox->counter[3];
+  Uint32 k0 = philox->key[0];
+  Uint32 k1 = philox->key[1];
+
+  for (Uint32 r = 0; r < PHILOX_ROUNDS; r++) {
+    Uint64 p0 = (Uint64)PHILOX_M0 * c0;
+    Uint64 p1 = (Uint64)PHILOX_M1 * c2;
+    Uint32 hi0 = (Uint32)(p0 >> 32);
+    Uint32 hi1 = (Uint32)(p1 >> 32);
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = (Uint32)p1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = (Uint32)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+void SBI_GeneratorBlock(const SBI_GeneratorOptions* options,
+                        Uint64 index,
+                        Uint32 block,
+                        SBI_GeneratorDomain domain,
+                        Uint32 out[4]) {
+  SBI_Philox philox = {
+      .counter = {(Uint32)index, (Uint32)(index >> 32), block, domain},
+      .key = {(Uint32)options->seed, (Uint32)(options->seed >> 32)},
+  };
+  SBI_PhiloxBlock(&philox, out);
+}
+
+// Top 24 bits as a float in [0, 1)
+static float generator_unit(Uint32 word) {
+  return (float)(word >> 8) * (1.0f / 16777216.0f);
+}
+
+// Top 24 bits as a float in (0, 1), safe to take the log of
+static float generator_open_unit(Uint32 word) {
+  return ((float)(word >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+// Standard normal pairs of words a and b of count instances (Box-Muller)
+static void generator_gaussians(GeneratorTile* tile,
+                                Uint32 count,
+                                Uint32 a,
+                                Uint32 b,
+                                float* dest0,
+                                float* dest1) {
+  for (Uint32 i = 0; i < count; i++) {
+    tile->args[i] = generator_open_unit(tile->words[i][a]);
+    tile->angles[i] = 2.0f * SDL_PI_F * generator_unit(tile->words[i][b]);
+  }
+  SBI_LogBatch(tile->args, tile->args, count, SBI_MATH_ACCURATE);
+  SBI_SinCosBatch(tile->angles, tile->sin, tile->cos, count,
+                  SBI_MATH_ACCURATE);
+  for (Uint32 i = 0; i < count; i++) {
+    float radius = SDL_sqrtf(-2.0f * tile->args[i]);
+    dest0[i] = radius * tile->cos[i];
+    dest1[i] = radius * tile->sin[i];
+  }
+}
+
+static Uint32 generator_rgba(float r, float g, float b) {
+  return 0xFF000000u | ((Uint32)(SDL_clamp(b, 0.0f, 1.0f) * 255.0f) << 16) |
+         ((Uint32)(SDL_clamp(g, 0.0f, 1.0f) * 255.0f) << 8) |
+         (Uint32)(SDL_clamp(r, 0.0f, 1.0f) * 255.0f);
+}
+
+// Pastel tint of a hue in [0, 1)
+static Uint32 generator_hue_color(float hue) {
+  static const float offsets[3] = {0.0f, 0.33f, 0.67f};
+  float tints[3];
+  for (Uint32 c = 0; c < 3; c++) {
+    tints[c] = 0.6f + 0.4f * SDL_cosf(6.2831853f * (hue + offsets[c]));
+  }
+  return generator_rgba(tints[0], tints[1], tints[2]);
+}
+
+// Golden ratio steps spread consecutive ids around the hue palette so
+// blending order is visible, the fraction is exact for any id
+static Uint32 generator_id_color(const GeneratorJob* job, Uint64 id) {
+  return job->palette[(Uint32)(id * PHILOX_W0) >> 24];
+}
+
+// Sum of octaves of sin(x) * cos(z), the sines and cosines of the x and z
+// arguments of every octave are taken in one batch
+static void generator_terrain_heights(const SBI_GeneratorOptions* options,
+                                      GeneratorTile* tile,
+                                      const float* x,
+                                      const float* z,
+                                      Uint32 count,
+                                      float* dest) {
+  static const float amplitudes[GENERATOR_TERRAIN_OCTAVES] = {0.6f, 0.3f,
+                                                              0.1f};
+  static const float phases[GENERATOR_TERRAIN_OCTAVES] = {0.0f, 1.3f, 2.9f};
+
+  float frequency = options->terrain_frequency;
+  for (Uint32 o = 0; o < GENERATOR_TERRAIN_OCTAVES; o++) {
+    float* x_args = &tile->angles[2 * o * count];
+    float* z_args = x_args + count;
+    for (Uint32 i = 0; i < count; i++) {
+      x_args[i] = x[i] * frequency + phases[o];
+      z_args[i] = z[i] * frequency * 1.3f - phases[o];
+    }
+    frequency *= 2.0f;
+  }
+  Uint32 lanes = 2 * GENERATOR_TERRAIN_OCTAVES * count;
+  SBI_SinCosBatch(tile->angles, tile->sin, tile->cos, lanes,
+                  SBI_MATH_ACCURATE);
+
+  for (Uint32 i = 0; i < count; i++) {
+    float height = 0.0f;
+    for (Uint32 o = 0; o < GENERATOR_TERRAIN_OCTAVES; o++) {
+      Uint32 lane = 2 * o * count + i;
+      height += amplitudes[o] * tile->sin[lane] * tile->cos[lane + count];
+    }
+    dest[i] = height * options->terrain_height;
+  }
+}
+
+static void generator_uniform(const GeneratorJob* job,
+                              GeneratorTile* tile,
+                              Uint64 first,
+                              Uint32 count) {
+  const SBI_GeneratorOptions* options = job->options;
+  for (Uint32 i = 0; i < count; i++) {
+    float* instance = job->instances[first + i];
+    for (Uint32 c = 0; c < 3; c++) {
+      instance[c] = (generator_unit(tile->words[i][c]) * 2.0f - 1.0f) *
+                    options->extent;
+    }
+    instance[3] = options->scale;
+  }
+
+  for (Uint32 i = 0; job->colors != NULL && i < count; i++) {
+    job->colors[first + i] = generator_id_color(job, first + i);
+  }
+}
+
+static void generator_clusters(const GeneratorJob* job,
+                               GeneratorTile* tile,
+                               Uint64 first,
+                               Uint32 count) {
+  const SBI_GeneratorOptions* options = job->options;
+  generator_gaussians(tile, count, 1, 2, tile->gauss[0], tile->gauss[1]);
+  generator_gaussians(tile, count, 3, 4, tile->gauss[2], tile->gauss[3]);
+
+  for (Uint32 i = 0; i < count; i++) {
+    Uint32 cluster = tile->words[i][0] % job->clusters_count;
+    const float* center = job->centers[cluster];
+    float* instance = job->instances[first + i];
+    for (Uint32 c = 0; c < 3; c++) {
+      instance[c] = center[c] + tile->gauss[c][i] * options->cluster_sigma;
+    }
+    instance[3] = options->scale;
+    if (job->colors != NULL) {
+      job->colors[first + i] = generator_id_color(job, cluster);
+    }
+  }
+}
+
+static void generator_galaxy(const GeneratorJob* job,
+                             GeneratorTile* tile,
+                             Uint64 first,
+                             Uint32 count) {
+  const SBI_GeneratorOptions* options = job->options;
+  float* radii = tile->gauss[2];
+  float* heights = tile->gauss[3];
+
+  // Exponential disk truncated at the extent, denser at the core
+  static const float falloff = 4.0f;
+  static const float truncation = 0.98168436f;  // 1 - e^-falloff
+  for (Uint32 i = 0; i < count; i++) {
+    radii[i] = 1.0f - generator_unit(tile->words[i][1]) * truncation;
+  }
+  SBI_LogBatch(radii, radii, count, SBI_MATH_ACCURATE);
+  generator_gaussians(tile, count, 2, 3, tile->gauss[0], tile->gauss[1]);
+
+  Uint32 arms_count = SDL_max(options->arms_count, 1);
+  for (Uint32 i = 0; i < count; i++) {
+    float radius_norm = -radii[i] / falloff;
+    Uint32 arm = tile->words[i][0] % arms_count;
+    tile->angles[i] = 2.0f * SDL_PI_F * (float)arm / (float)arms_count +
+                      options->arm_twist * radius_norm +
+                      tile->gauss[0][i] * options->arm_spread;
+    radii[i] = radius_norm;
+    heights[i] = tile->gauss[1][i] * options->thickness *
+                 (1.0f - 0.8f * radius_norm);
+  }
+  SBI_SinCosBatch(tile->angles, tile->sin, tile->cos, count,
+                  SBI_MATH_ACCURATE);
+
+  for (Uint32 i = 0; i < count; i++) {
+    float radius = radii[i] * options->extent;
+    float* instance = job->instances[first + i];
+    instance[0] = tile->cos[i] * radius;
+    instance[1] = heights[i];
+    instance[2] = tile->sin[i] * radius;
+    instance[3] = options->scale;
+  }
+
+  // Warm core fading to blue arms
+  for (Uint32 i = 0; job->colors != NULL && i < count; i++) {
+    job->colors[first + i] = generator_rgba(1.0f - 0.55f * radii[i],
+                                            0.9f - 0.3f * radii[i],
+                                            0.7f + 0.3f * radii[i]);
+  }
+}
+
+static void generator_terrain(const GeneratorJob* job,
+                              GeneratorTile* tile,
+                              Uint64 first,
+                              Uint32 count) {
+  const SBI_GeneratorOptions* options = job->options;
+  float* x = tile->gauss[0];
+  float* z = tile->gauss[1];
+  float* ground = tile->gauss[2];
+  for (Uint32 i = 0; i < count; i++) {
+    x[i] = (generator_unit(tile->words[i][0]) * 2.0f - 1.0f) * options->extent;
+    z[i] = (generator_unit(tile->words[i][2]) * 2.0f - 1.0f) * options->extent;
+  }
+  generator_terrain_heights(options, tile, x, z, count, ground);
+
+  for (Uint32 i = 0; i < count; i++) {
+    float* instance = job->instances[first + i];
+    instance[0] = x[i];
+    instance[1] = ground[i] + options->scale * 0.5f +
+                  generator_unit(tile->words[i][1]) * options->hover;
+    instance[2] = z[i];
+    instance[3] = options->scale;
+  }
+
+  // Grass in the valleys, snow on the peaks
+  float height = options->terrain_height;
+  for (Uint32 i = 0; job->colors != NULL && i < count; i++) {
+    float t = height > 0.0f ? ground[i] / height * 0.5f + 0.5f : 0.5f;
+    job->colors[first + i] = generator_rgba(
+        0.27f + 0.65f * t, 0.55f + 0.37f * t, 0.24f + 0.7f * t);
+  }
+}
+
+// Instances are generated a tile at a time so the transcendental functions
+// run through the batched kernels. Each kernel maps elements one to one,
+// the tile boundaries of a range do not change the results.
+static void generator_job(void* data, Uint32 worker, Uint64 begin,
+                          Uint64 end) {
+  GeneratorJob* job = data;
+  GeneratorTile* tile = &job->tiles[worker];
+  const SBI_GeneratorOptions* options = job->options;
+  Uint32 blocks = options->kind == SBI_GENERATOR_CLUSTERS ? 2 : 1;
+
+  for (Uint64 first = begin; first < end; first += GENERATOR_TILE) {
+    Uint32 count = (Uint32)SDL_min(end - first, GENERATOR_TILE);
+    for (Uint32 i = 0; i < count; i++) {
+      for (Uint32 b = 0; b < blocks; b++) {
+        SBI_GeneratorBlock(options, first + i, b,
+                           SBI_GENERATOR_DOMAIN_INSTANCE,
+                           &tile->words[i][b * 4]);
+      }
+    }
+
+    switch (options->kind) {
+      case SBI_GENERATOR_CLUSTERS:
+        generator_clusters(job, tile, first, count);
+        break;
+      case SBI_GENERATOR_GALAXY:
+        generator_galaxy(job, tile, first, count);
+        break;
+      case SBI_GENERATOR_TERRAIN:
+        generator_terrain(job, tile, first, count);
+        break;
+      default:
+        generator_uniform(job, tile, first, count);
+        break;
+    }
+  }
+}
+
+bool SBI_GeneratorRun(const SBI_GeneratorOptions* options,
+                      SBI_JobPool* pool,
+                      SBI_Vec4* instances,
+                      Uint32* colors,
+                      Uint64 count) {
+  if (count == 0) {
+    return true;
+  }
+
+  GeneratorJob* job = SDL_malloc(sizeof(GeneratorJob));
+  if (job == NULL) {
+    SDL_Log("Could not allocate memory for the generator");
+    return false;
+  }
+  job->options = options;
+  job->instances = instances;
+  job->colors = colors;
+  for (Uint32 h = 0; h < GENERATOR_PALETTE_SIZE; h++) {
+    job->palette[h] =
+        generator_hue_color((float)h / (float)GENERATOR_PALETTE_SIZE);
+  }
+
+  // Scattered centers, shrunk so most of each cluster stays in the box
+  job->clusters_count =
+      SDL_clamp(options->clusters_count, 1, GENERATOR_MAX_CLUSTERS);
+  for (Uint32 c = 0; c < job->clusters_count; c++) {
+    Uint32 words[4];
+    SBI_GeneratorBlock(options, c, 0, SBI_GENERATOR_DOMAIN_CLUSTER, words);
+    for (Uint32 k = 0; k < 3; k++) {
+      job->centers[c][k] =
+          (generator_unit(words[k]) * 2.0f - 1.0f) * options->extent * 0.7f;
+    }
+    job->centers[c][3] = 0.0f;
+  }
+
+  bool result = true;
+  if (pool != NULL) {
+    SBI_JobPoolRun(pool, generator_job, job, count);
+  } else if (count < SBI_GENERATOR_PARALLEL_MIN) {
+    generator_job(job, 0, 0, count);
+  } else {
+    SBI_JobPool local_pool;
+    result = SBI_JobPoolLoad(&local_pool, 0);
+    if (result) {
+      SBI_JobPoolRun(&local_pool, generator_job, job, count);
+    }
+    SBI_JobPoolDestroy(&local_pool);
+  }
+
+  SDL_free(job);
+  return result;
+}
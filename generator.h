@@ -0,0 +1,89 @@
+#ifndef SBI_GENERATOR_H
+#define SBI_GENERATOR_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "jobs.h"
+#include "xmath.h"
+
+#define SBI_GENERATOR_PARALLEL_MIN (65536)
+
+typedef enum {
+  SBI_GENERATOR_UNIFORM,
+  SBI_GENERATOR_CLUSTERS,
+  SBI_GENERATOR_GALAXY,
+  SBI_GENERATOR_TERRAIN,
+  SBI_GENERATOR_COUNT,
+} SBI_GeneratorKind;
+
+// Shape of a generated scene, every distribution fits in a box of
+// extent around the origin
+typedef struct {
+  SBI_GeneratorKind kind;
+  Uint64 seed;
+  float extent;
+  float scale;
+
+  // Gaussian clusters with centers spread over the box
+  Uint32 clusters_count;
+  float cluster_sigma;
+
+  // Spiral arms winding twist radians from the core to the edge, the disk
+  // is thickness high at the core and flattens outwards
+  Uint32 arms_count;
+  float arm_twist;
+  float arm_spread;
+  float thickness;
+
+  // Instances float up to hover over a heightfield of a few octaves
+  float terrain_height;
+  float terrain_frequency;
+  float hover;
+} SBI_GeneratorOptions;
+
+// Counter word 3 of the scene streams, it keeps the blocks drawn for
+// different purposes apart for the same index
+typedef enum {
+  SBI_GENERATOR_DOMAIN_INSTANCE,
+  SBI_GENERATOR_DOMAIN_CLUSTER,
+  SBI_GENERATOR_DOMAIN_ANIMATION,
+} SBI_GeneratorDomain;
+
+// Philox 4x32-10 state: the counter selects the block, the key the stream
+typedef struct {
+  Uint32 counter[4];
+  Uint32 key[2];
+} SBI_Philox;
+
+// Default options of a kind: a box of 10 around the origin with instances
+// of scale 0.5, the scene SBI_BillboardLoad used to scatter
+SBI_GeneratorOptions SBI_GeneratorDefaultOptions(SBI_GeneratorKind kind);
+
+// Name of a kind as given on the command line
+const char* SBI_GeneratorKindName(SBI_GeneratorKind kind);
+
+// Kind of a name, false when no kind matches
+bool SBI_GeneratorParseKind(const char* name, SBI_GeneratorKind* kind);
+
+// Four random words of a block, a pure function of the counter and key
+void SBI_PhiloxBlock(const SBI_Philox* philox, Uint32 out[4]);
+
+// Block of the scene stream of options->seed, one per (index, block,
+// domain)
+void SBI_GeneratorBlock(const SBI_GeneratorOptions* options,
+                        Uint64 index,
+                        Uint32 block,
+                        SBI_GeneratorDomain domain,
+                        Uint32 out[4]);
+
+// Write count positions (and RGBA8 colors unless NULL) split in ranges
+// over pool. Instance i only depends on the seed and i, so the output is
+// the same for any number of workers. Without a pool, counts from
+// SBI_GENERATOR_PARALLEL_MIN start one for the call.
+bool SBI_GeneratorRun(const SBI_GeneratorOptions* options,
+                      SBI_JobPool* pool,
+                      SBI_Vec4* instances,
+                      Uint32* colors,
+                      Uint64 count);
+
+#endif /* SBI_GENERATOR_H */
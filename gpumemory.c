@@ -0,0 +1,486 @@
+#include "gpumemory.h"
+
+#include <SDL3/SDL_bits.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define GPU_MEMORY_MAX_UNITS (0xFFFFFFFFu / SBI_GPU_MEMORY_ALIGNMENT)
+
+SBI_GPUMemoryOptions SBI_GPUMemoryDefaultOptions(void) {
+  return (SBI_GPUMemoryOptions){
+      .budgets = {0, 0},
+      .block_size = SBI_GPU_MEMORY_BLOCK_SIZE,
+  };
+}
+
+bool SBI_GPUMemoryLoad(SBI_GPUMemory* memory,
+                       SDL_GPUDevice* device,
+                       SBI_GPUMemoryOptions options) {
+  memory->device = device;
+  memory->options = options;
+  memory->free_range = SBI_GPU_MEMORY_NONE;
+  for (Uint32 p = 0; p < SBI_GPU_POOL_COUNT; p++) {
+    SBI_GPUMemoryPool* pool = &memory->pools[p];
+    pool->budget = options.budgets[p];
+    for (Uint32 fl = 0; fl < SBI_GPU_MEMORY_FL_COUNT; fl++) {
+      for (Uint32 sl = 0; sl < SBI_GPU_MEMORY_SL_COUNT; sl++) {
+        pool->heads[fl][sl] = SBI_GPU_MEMORY_NONE;
+      }
+    }
+  }
+  return true;
+}
+
+static inline Uint32 gpu_memory_lowest_bit(Uint32 bits) {
+  return (Uint32)SDL_MostSignificantBitIndex32(bits & (~bits + 1));
+}
+
+// Size class of a range: the power of two and its linear subdivision
+static void gpu_memory_mapping(Uint32 units, Uint32* fl, Uint32* sl) {
+  if (units < SBI_GPU_MEMORY_SL_COUNT) {
+    *fl = 0;
+    *sl = units;
+    return;
+  }
+
+  Uint32 msb = (Uint32)SDL_MostSignificantBitIndex32(units);
+  *fl = msb - SBI_GPU_MEMORY_SL_LOG2 + 1;
+  *sl = (units >> (msb - SBI_GPU_MEMORY_SL_LOG2)) ^ SBI_GPU_MEMORY_SL_COUNT;
+}
+
+static Uint32 gpu_memory_new_range(SBI_GPUMemory* memory) {
+  if (memory->free_range != SBI_GPU_MEMORY_NONE) {
+    Uint32 range = memory->free_range;
+    memory->free_range = memory->ranges[range].next;
+    return range;
+  }
+
+  if (memory->ranges_count == memory->ranges_capacity) {
+    Uint32 capacity = SDL_max(memory->ranges_capacity * 2, 256);
+    SBI_GPURange* ranges =
+        SDL_realloc(memory->ranges, sizeof(SBI_GPURange) * capacity);
+    if (ranges == NULL) {
+      return SBI_GPU_MEMORY_NONE;
+    }
+    memory->ranges = ranges;
+    memory->ranges_capacity = capacity;
+  }
+  return memory->ranges_count++;
+}
+
+static void gpu_memory_recycle_range(SBI_GPUMemory* memory, Uint32 range) {
+  memory->ranges[range].next = memory->free_range;
+  memory->free_range = range;
+}
+
+static void gpu_memory_insert_free(SBI_GPUMemory* memory,
+                                   SBI_GPUMemoryPool* pool,
+                                   Uint32 range) {
+  SBI_GPURange* r = &memory->ranges[range];
+  Uint32 fl = 0;
+  Uint32 sl = 0;
+  gpu_memory_mapping(r->size, &fl, &sl);
+
+  Uint32 head = pool->heads[fl][sl];
+  r->free = true;
+  r->prev_free = SBI_GPU_MEMORY_NONE;
+  r->next_free = head;
+  if (head != SBI_GPU_MEMORY_NONE) {
+    memory->ranges[head].prev_free = range;
+  }
+  pool->heads[fl][sl] = range;
+  pool->fl_bitmap |= 1u << fl;
+  pool->sl_bitmaps[fl] |= 1u << sl;
+}
+
+static void gpu_memory_remove_free(SBI_GPUMemory* memory,
+                                   SBI_GPUMemoryPool* pool,
+                                   Uint32 range) {
+  SBI_GPURange* r = &memory->ranges[range];
+  Uint32 fl = 0;
+  Uint32 sl = 0;
+  gpu_memory_mapping(r->size, &fl, &sl);
+
+  if (r->prev_free != SBI_GPU_MEMORY_NONE) {
+    memory->ranges[r->prev_free].next_free = r->next_free;
+  } else {
+    pool->heads[fl][sl] = r->next_free;
+  }
+  if (r->next_free != SBI_GPU_MEMORY_NONE) {
+    memory->ranges[r->next_free].prev_free = r->prev_free;
+  }
+  r->free = false;
+
+  if (pool->heads[fl][sl] == SBI_GPU_MEMORY_NONE) {
+    pool->sl_bitmaps[fl] &= ~(1u << sl);
+    if (pool->sl_bitmaps[fl] == 0) {
+      pool->fl_bitmap &= ~(1u << fl);
+    }
+  }
+}
+
+// First range of a class where every range fits units: the request is
+// rounded up to the next class, then the bitmaps give the smallest one
+static Uint32 gpu_memory_find_free(const SBI_GPUMemoryPool* pool,
+                                   Uint32 units) {
+  Uint64 rounded = units;
+  if (units >= SBI_GPU_MEMORY_SL_COUNT) {
+    Uint32 msb = (Uint32)SDL_MostSignificantBitIndex32(units);
+    rounded += (1ull << (msb - SBI_GPU_MEMORY_SL_LOG2)) - 1;
+  }
+  if (rounded > GPU_MEMORY_MAX_UNITS) {
+    return SBI_GPU_MEMORY_NONE;
+  }
+
+  Uint32 fl = 0;
+  Uint32 sl = 0;
+  gpu_memory_mapping((Uint32)rounded, &fl, &sl);
+  Uint32 sl_map = pool->sl_bitmaps[fl] & (~0u << sl);
+  if (sl_map == 0) {
+    Uint32 fl_map =
+        fl + 1 < SBI_GPU_MEMORY_FL_COUNT ? pool->fl_bitmap & (~0u << (fl + 1))
+                                         : 0;
+    if (fl_map == 0) {
+      return SBI_GPU_MEMORY_NONE;
+    }
+    fl = gpu_memory_lowest_bit(fl_map);
+    sl_map = pool->sl_bitmaps[fl];
+  }
+  return pool->heads[fl][gpu_memory_lowest_bit(sl_map)];
+}
+
+// Create a block of at least units within the budget, its only range is
+// returned free but out of the lists
+static Uint32 gpu_memory_add_block(SBI_GPUMemory* memory,
+                                   SBI_GPUPool pool_index,
+                                   Uint32 units) {
+  SBI_GPUMemoryPool* pool = &memory->pools[pool_index];
+  Uint32 block_units = SDL_max(
+      memory->options.block_size / SBI_GPU_MEMORY_ALIGNMENT, units);
+  Uint32 size = block_units * SBI_GPU_MEMORY_ALIGNMENT;
+  if (pool->blocks_count == SBI_GPU_MEMORY_MAX_BLOCKS ||
+      (pool->budget > 0 && pool->reserved_bytes + size > pool->budget)) {
+    return SBI_GPU_MEMORY_NONE;
+  }
+
+  Uint32 range = gpu_memory_new_range(memory);
+  if (range == SBI_GPU_MEMORY_NONE) {
+    return SBI_GPU_MEMORY_NONE;
+  }
+
+  SBI_GPUBlock* block = &pool->blocks[pool->blocks_count];
+  if (pool_index == SBI_GPU_POOL_STORAGE) {
+    SDL_GPUBufferCreateInfo buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+                 SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+        .size = size,
+    };
+    block->buffer = SDL_CreateGPUBuffer(memory->device, &buffer_create_info);
+  } else {
+    SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = size,
+    };
+    block->transfer_buffer =
+        SDL_CreateGPUTransferBuffer(memory->device, &transfer_create_info);
+  }
+  if (block->buffer == NULL && block->transfer_buffer == NULL) {
+    SDL_Log("Couldn't create GPU memory block: %s", SDL_GetError());
+    gpu_memory_recycle_range(memory, range);
+    return SBI_GPU_MEMORY_NONE;
+  }
+  block->size = block_units;
+
+  memory->ranges[range] = (SBI_GPURange){
+      .offset = 0,
+      .size = block_units,
+      .block = pool->blocks_count,
+      .prev = SBI_GPU_MEMORY_NONE,
+      .next = SBI_GPU_MEMORY_NONE,
+      .prev_free = SBI_GPU_MEMORY_NONE,
+      .next_free = SBI_GPU_MEMORY_NONE,
+      .free = true,
+  };
+  pool->blocks_count++;
+  pool->reserved_bytes += size;
+  return range;
+}
+
+bool SBI_GPUMemoryAlloc(SBI_GPUMemory* memory,
+                        SBI_GPUPool pool_index,
+                        Uint32 size,
+                        SBI_GPUAllocation* allocation) {
+  SBI_GPUMemoryPool* pool = &memory->pools[pool_index];
+  Uint64 units64 = ((Uint64)SDL_max(size, 1) + SBI_GPU_MEMORY_ALIGNMENT - 1) /
+                   SBI_GPU_MEMORY_ALIGNMENT;
+  if (units64 > GPU_MEMORY_MAX_UNITS) {
+    return false;
+  }
+  Uint32 units = (Uint32)units64;
+
+  // A new block is used as is, it may be too big for the rounded classes
+  Uint32 range = gpu_memory_find_free(pool, units);
+  if (range != SBI_GPU_MEMORY_NONE) {
+    gpu_memory_remove_free(memory, pool, range);
+  } else {
+    range = gpu_memory_add_block(memory, pool_index, units);
+    if (range == SBI_GPU_MEMORY_NONE) {
+      return false;
+    }
+    memory->ranges[range].free = false;
+  }
+
+  // Give the tail back, the new range follows this one in the block
+  if (memory->ranges[range].size > units) {
+    Uint32 tail = gpu_memory_new_range(memory);
+    if (tail != SBI_GPU_MEMORY_NONE) {
+      SBI_GPURange* r = &memory->ranges[range];
+      memory->ranges[tail] = (SBI_GPURange){
+          .offset = r->offset + units,
+          .size = r->size - units,
+          .block = r->block,
+          .prev = range,
+          .next = r->next,
+      };
+      if (r->next != SBI_GPU_MEMORY_NONE) {
+        memory->ranges[r->next].prev = tail;
+      }
+      r->next = tail;
+      r->size = units;
+      gpu_memory_insert_free(memory, pool, tail);
+    }
+  }
+
+  SBI_GPURange* r = &memory->ranges[range];
+  SBI_GPUBlock* block = &pool->blocks[r->block];
+  *allocation = (SBI_GPUAllocation){
+      .buffer = block->buffer,
+      .transfer_buffer = block->transfer_buffer,
+      .offset = r->offset * SBI_GPU_MEMORY_ALIGNMENT,
+      .size = SDL_max(size, 1),
+      .range = range,
+      .pool = pool_index,
+  };
+  pool->allocated_bytes += (Uint64)r->size * SBI_GPU_MEMORY_ALIGNMENT;
+  pool->allocations_count++;
+  return true;
+}
+
+// Merge a range with its free neighbours and put it back in the lists
+static void gpu_memory_release(SBI_GPUMemory* memory,
+                               SBI_GPUPool pool_index,
+                               Uint32 range) {
+  SBI_GPUMemoryPool* pool = &memory->pools[pool_index];
+  SBI_GPURange* r = &memory->ranges[range];
+  pool->allocated_bytes -= (Uint64)r->size * SBI_GPU_MEMORY_ALIGNMENT;
+  pool->allocations_count--;
+
+  Uint32 next = r->next;
+  if (next != SBI_GPU_MEMORY_NONE && memory->ranges[next].free) {
+    gpu_memory_remove_free(memory, pool, next);
+    r->size += memory->ranges[next].size;
+    r->next = memory->ranges[next].next;
+    if (r->next != SBI_GPU_MEMORY_NONE) {
+      memory->ranges[r->next].prev = range;
+    }
+    gpu_memory_recycle_range(memory, next);
+  }
+
+  Uint32 prev = r->prev;
+  if (prev != SBI_GPU_MEMORY_NONE && memory->ranges[prev].free) {
+    gpu_memory_remove_free(memory, pool, prev);
+    SBI_GPURange* p = &memory->ranges[prev];
+    p->size += r->size;
+    p->next = r->next;
+    if (p->next != SBI_GPU_MEMORY_NONE) {
+      memory->ranges[p->next].prev = prev;
+    }
+    gpu_memory_recycle_range(memory, range);
+    range = prev;
+  }
+
+  gpu_memory_insert_free(memory, pool, range);
+}
+
+static bool gpu_memory_defer(SBI_GPUMemory* memory,
+                             SBI_GPUPool pool,
+                             Uint32 range) {
+  if (memory->deferred_count == memory->deferred_capacity) {
+    Uint32 capacity = SDL_max(memory->deferred_capacity * 2, 256);
+    SBI_GPUDeferredFree* deferred =
+        SDL_realloc(memory->deferred, sizeof(SBI_GPUDeferredFree) * capacity);
+    if (deferred == NULL) {
+      SDL_Log("Could not allocate memory for deferred GPU frees");
+      return false;
+    }
+    memory->deferred = deferred;
+    memory->deferred_capacity = capacity;
+  }
+
+  memory->deferred[memory->deferred_count++] = (SBI_GPUDeferredFree){
+      .pool = pool,
+      .range = range,
+  };
+  memory->pools[pool].pending_bytes +=
+      (Uint64)memory->ranges[range].size * SBI_GPU_MEMORY_ALIGNMENT;
+  return true;
+}
+
+bool SBI_GPUMemoryAllocFrame(SBI_GPUMemory* memory,
+                             SBI_GPUPool pool,
+                             Uint32 size,
+                             SBI_GPUAllocation* allocation) {
+  if (!SBI_GPUMemoryAlloc(memory, pool, size, allocation)) {
+    return false;
+  }
+  if (!gpu_memory_defer(memory, pool, allocation->range)) {
+    // Nothing used it yet, it can be given back at once
+    gpu_memory_release(memory, pool, allocation->range);
+    return false;
+  }
+  return true;
+}
+
+void SBI_GPUMemoryFree(SBI_GPUMemory* memory, SBI_GPUAllocation* allocation) {
+  if (allocation->size == 0) {
+    return;
+  }
+
+  // Leak the range rather than recycle it under the GPU
+  gpu_memory_defer(memory, allocation->pool, allocation->range);
+  SDL_memset(allocation, 0, sizeof(SBI_GPUAllocation));
+}
+
+void* SBI_GPUMemoryMap(SBI_GPUMemory* memory,
+                       const SBI_GPUAllocation* allocation) {
+  Uint8* block =
+      SDL_MapGPUTransferBuffer(memory->device, allocation->transfer_buffer,
+                               false);
+  return block != NULL ? block + allocation->offset : NULL;
+}
+
+void SBI_GPUMemoryUnmap(SBI_GPUMemory* memory,
+                        const SBI_GPUAllocation* allocation) {
+  SDL_UnmapGPUTransferBuffer(memory->device, allocation->transfer_buffer);
+}
+
+static bool gpu_memory_frame_done(SBI_GPUMemory* memory,
+                                  const SBI_GPURetiredFrame* frame) {
+  if (frame->fence != NULL) {
+    return SDL_QueryGPUFence(memory->device, frame->fence);
+  }
+  return memory->frame - frame->frame >= SBI_GPU_MEMORY_FRAME_LAG;
+}
+
+// Release the frees of the oldest retired frame
+static void gpu_memory_retire_oldest(SBI_GPUMemory* memory, Uint32* first) {
+  SBI_GPURetiredFrame* frame = &memory->retired[0];
+  for (Uint32 i = 0; i < frame->count; i++) {
+    SBI_GPUDeferredFree* deferred = &memory->deferred[*first + i];
+    memory->pools[deferred->pool].pending_bytes -=
+        (Uint64)memory->ranges[deferred->range].size *
+        SBI_GPU_MEMORY_ALIGNMENT;
+    gpu_memory_release(memory, deferred->pool, deferred->range);
+  }
+  *first += frame->count;
+  if (frame->fence != NULL) {
+    SDL_ReleaseGPUFence(memory->device, frame->fence);
+  }
+
+  memory->retired_count--;
+  SDL_memmove(&memory->retired[0], &memory->retired[1],
+              sizeof(SBI_GPURetiredFrame) * memory->retired_count);
+}
+
+void SBI_GPUMemoryEndFrame(SBI_GPUMemory* memory, SDL_GPUFence* fence) {
+  Uint32 queued = 0;
+  for (Uint32 i = 0; i < memory->retired_count; i++) {
+    queued += memory->retired[i].count;
+  }
+
+  // Frames that freed nothing only have to give their fence back
+  Uint32 first = 0;
+  Uint32 count = memory->deferred_count - queued;
+  if (count > 0) {
+    if (memory->retired_count == SBI_GPU_MEMORY_MAX_FRAMES) {
+      SBI_GPURetiredFrame* oldest = &memory->retired[0];
+      if (oldest->fence != NULL) {
+        SDL_WaitForGPUFences(memory->device, true, &oldest->fence, 1);
+      }
+      gpu_memory_retire_oldest(memory, &first);
+    }
+    memory->retired[memory->retired_count++] = (SBI_GPURetiredFrame){
+        .fence = fence,
+        .frame = memory->frame,
+        .count = count,
+    };
+  } else if (fence != NULL) {
+    SDL_ReleaseGPUFence(memory->device, fence);
+  }
+  memory->frame++;
+
+  while (memory->retired_count > 0 &&
+         gpu_memory_frame_done(memory, &memory->retired[0])) {
+    gpu_memory_retire_oldest(memory, &first);
+  }
+
+  memory->deferred_count -= first;
+  SDL_memmove(memory->deferred, memory->deferred + first,
+              sizeof(SBI_GPUDeferredFree) * memory->deferred_count);
+}
+
+void SBI_GPUMemoryGetStats(const SBI_GPUMemory* memory,
+                           SBI_GPUPool pool_index,
+                           SBI_GPUMemoryStats* stats) {
+  const SBI_GPUMemoryPool* pool = &memory->pools[pool_index];
+  *stats = (SBI_GPUMemoryStats){
+      .budget_bytes = pool->budget,
+      .reserved_bytes = pool->reserved_bytes,
+      .allocated_bytes = pool->allocated_bytes,
+      .pending_bytes = pool->pending_bytes,
+      .blocks_count = pool->blocks_count,
+      .allocations_count = pool->allocations_count,
+  };
+
+  for (Uint32 fl = 0; fl < SBI_GPU_MEMORY_FL_COUNT; fl++) {
+    for (Uint32 sl = 0; sl < SBI_GPU_MEMORY_SL_COUNT; sl++) {
+      Uint32 range = pool->heads[fl][sl];
+      while (range != SBI_GPU_MEMORY_NONE) {
+        const SBI_GPURange* r = &memory->ranges[range];
+        Uint64 bytes = (Uint64)r->size * SBI_GPU_MEMORY_ALIGNMENT;
+        stats->free_bytes += bytes;
+        stats->largest_free_bytes = SDL_max(stats->largest_free_bytes, bytes);
+        stats->free_ranges_count++;
+        range = r->next_free;
+      }
+    }
+  }
+
+  // Share of the free memory that a single allocation can't use
+  if (stats->free_bytes > 0) {
+    stats->fragmentation = 1.0f - (float)stats->largest_free_bytes /
+                                      (float)stats->free_bytes;
+  }
+}
+
+void SBI_GPUMemoryDestroy(SBI_GPUMemory* memory) {
+  for (Uint32 i = 0; i < memory->retired_count; i++) {
+    SDL_GPUFence* fence = memory->retired[i].fence;
+    if (fence != NULL) {
+      SDL_WaitForGPUFences(memory->device, true, &fence, 1);
+      SDL_ReleaseGPUFence(memory->device, fence);
+    }
+  }
+
+  for (Uint32 p = 0; p < SBI_GPU_POOL_COUNT; p++) {
+    SBI_GPUMemoryPool* pool = &memory->pools[p];
+    for (Uint32 b = 0; b < pool->blocks_count; b++) {
+      SDL_ReleaseGPUBuffer(memory->device, pool->blocks[b].buffer);
+      SDL_ReleaseGPUTransferBuffer(memory->device,
+                                   pool->blocks[b].transfer_buffer);
+    }
+  }
+  SDL_free(memory->ranges);
+  SDL_free(memory->deferred);
+  SDL_memset(memory, 0, sizeof(SBI_GPUMemory));
+}
@@ -0,0 +1,169 @@
+#ifndef SBI_GPUMEMORY_H
+#define SBI_GPUMEMORY_H
+
+#include <SDL3/SDL_gpu.h>
+
+#define SBI_GPU_MEMORY_BLOCK_SIZE (64u * 1024u * 1024u)
+#define SBI_GPU_MEMORY_ALIGNMENT (256u)
+#define SBI_GPU_MEMORY_MAX_BLOCKS (64)
+#define SBI_GPU_MEMORY_MAX_FRAMES (8)
+#define SBI_GPU_MEMORY_FRAME_LAG (4)
+#define SBI_GPU_MEMORY_FL_COUNT (32)
+#define SBI_GPU_MEMORY_SL_LOG2 (4)
+#define SBI_GPU_MEMORY_SL_COUNT (1 << SBI_GPU_MEMORY_SL_LOG2)
+#define SBI_GPU_MEMORY_NONE (0xFFFFFFFFu)
+
+// Storage blocks are read by graphics and compute shaders, upload blocks
+// are transfer buffers mapped without cycling
+typedef enum {
+  SBI_GPU_POOL_STORAGE,
+  SBI_GPU_POOL_UPLOAD,
+  SBI_GPU_POOL_COUNT,
+} SBI_GPUPool;
+
+// A suballocation: shaders index the bound block from offset, which is a
+// multiple of SBI_GPU_MEMORY_ALIGNMENT, and copies start at it
+typedef struct {
+  SDL_GPUBuffer* buffer;
+  SDL_GPUTransferBuffer* transfer_buffer;
+  Uint32 offset;
+  Uint32 size;
+  Uint32 range;
+  SBI_GPUPool pool;
+} SBI_GPUAllocation;
+
+// Part of a block in units of SBI_GPU_MEMORY_ALIGNMENT, linked to its
+// neighbours in the block and, when free, to the ranges of its size class
+typedef struct {
+  Uint32 offset;
+  Uint32 size;
+  Uint32 block;
+  Uint32 prev;
+  Uint32 next;
+  Uint32 prev_free;
+  Uint32 next_free;
+  bool free;
+} SBI_GPURange;
+
+typedef struct {
+  SDL_GPUBuffer* buffer;
+  SDL_GPUTransferBuffer* transfer_buffer;
+  Uint32 size;
+} SBI_GPUBlock;
+
+// Two level segregated fit: free ranges are kept in lists by power of two
+// (first level) split in SBI_GPU_MEMORY_SL_COUNT linear classes (second
+// level), bitmaps find a fitting list in constant time
+typedef struct {
+  SBI_GPUBlock blocks[SBI_GPU_MEMORY_MAX_BLOCKS];
+  Uint32 blocks_count;
+  Uint32 fl_bitmap;
+  Uint32 sl_bitmaps[SBI_GPU_MEMORY_FL_COUNT];
+  Uint32 heads[SBI_GPU_MEMORY_FL_COUNT][SBI_GPU_MEMORY_SL_COUNT];
+  Uint64 budget;
+  Uint64 reserved_bytes;
+  Uint64 allocated_bytes;
+  Uint64 pending_bytes;
+  Uint32 allocations_count;
+} SBI_GPUMemoryPool;
+
+// Ranges freed while a frame was recorded
+typedef struct {
+  SBI_GPUPool pool;
+  Uint32 range;
+} SBI_GPUDeferredFree;
+
+// A submitted frame, its count frees follow those of the older frames in
+// the deferred list. Without a fence it retires SBI_GPU_MEMORY_FRAME_LAG
+// frames later, callers without fences keep fewer frames in flight.
+typedef struct {
+  SDL_GPUFence* fence;
+  Uint64 frame;
+  Uint32 count;
+} SBI_GPURetiredFrame;
+
+typedef struct {
+  Uint64 budget_bytes;
+  Uint64 reserved_bytes;
+  Uint64 allocated_bytes;
+  Uint64 pending_bytes;
+  Uint64 free_bytes;
+  Uint64 largest_free_bytes;
+  Uint32 blocks_count;
+  Uint32 allocations_count;
+  Uint32 free_ranges_count;
+  float fragmentation;
+} SBI_GPUMemoryStats;
+
+// Budget of each pool in bytes, zero leaves it unbounded
+typedef struct {
+  Uint64 budgets[SBI_GPU_POOL_COUNT];
+  Uint32 block_size;
+} SBI_GPUMemoryOptions;
+
+// Hands out ranges of a few large buffers per pool instead of a buffer per
+// object. Frees are deferred until the frame that last used the range is
+// done on the GPU, the ranges of a frame are recycled in bulk. Blocks are
+// kept until the memory is destroyed.
+typedef struct {
+  SDL_GPUDevice* device;
+  SBI_GPUMemoryOptions options;
+  SBI_GPUMemoryPool pools[SBI_GPU_POOL_COUNT];
+  SBI_GPURange* ranges;
+  Uint32 ranges_count;
+  Uint32 ranges_capacity;
+  Uint32 free_range;
+
+  // Frees of the frames in flight in submission order, then the current
+  SBI_GPUDeferredFree* deferred;
+  Uint32 deferred_count;
+  Uint32 deferred_capacity;
+  SBI_GPURetiredFrame retired[SBI_GPU_MEMORY_MAX_FRAMES];
+  Uint32 retired_count;
+  Uint64 frame;
+} SBI_GPUMemory;
+
+// Default options: 64MB blocks without budgets
+SBI_GPUMemoryOptions SBI_GPUMemoryDefaultOptions(void);
+
+bool SBI_GPUMemoryLoad(SBI_GPUMemory* memory,
+                       SDL_GPUDevice* device,
+                       SBI_GPUMemoryOptions options);
+
+// Suballocate size bytes, a new block is created when no free range fits
+// and the budget allows it. Fails without logging so callers can evict.
+bool SBI_GPUMemoryAlloc(SBI_GPUMemory* memory,
+                        SBI_GPUPool pool,
+                        Uint32 size,
+                        SBI_GPUAllocation* allocation);
+
+// Allocation only used by the frame being recorded, freed with it
+bool SBI_GPUMemoryAllocFrame(SBI_GPUMemory* memory,
+                             SBI_GPUPool pool,
+                             Uint32 size,
+                             SBI_GPUAllocation* allocation);
+
+// Release an allocation once the frame being recorded is done on the GPU,
+// the allocation is cleared
+void SBI_GPUMemoryFree(SBI_GPUMemory* memory, SBI_GPUAllocation* allocation);
+
+// Map an upload allocation, the other ranges of its block may be in use
+// so the block is never cycled. One allocation of a block at a time.
+void* SBI_GPUMemoryMap(SBI_GPUMemory* memory,
+                       const SBI_GPUAllocation* allocation);
+
+void SBI_GPUMemoryUnmap(SBI_GPUMemory* memory,
+                        const SBI_GPUAllocation* allocation);
+
+// Close the frame after its command buffer was submitted, the memory takes
+// the fence when given one. Recycles the frees of the finished frames.
+void SBI_GPUMemoryEndFrame(SBI_GPUMemory* memory, SDL_GPUFence* fence);
+
+void SBI_GPUMemoryGetStats(const SBI_GPUMemory* memory,
+                           SBI_GPUPool pool,
+                           SBI_GPUMemoryStats* stats);
+
+// Wait for the frames in flight and release every block
+void SBI_GPUMemoryDestroy(SBI_GPUMemory* memory);
+
+#endif /* SBI_GPUMEMORY_H */
@@ -1,4 +1,5 @@
 #include "grid.h"
+#include "memtrack.h"
 #include "shader.h"
 
 #include <SDL3/SDL_gpu.h>
@@ -9,7 +10,9 @@ typedef struct {
   SBI_ALIGN_MAT4 SBI_Mat4 pv_inv;
 } GridUniforms;
 
-bool SBI_GridLoad(SBI_Grid* grid, SDL_GPUDevice* device, SDL_Window* window) {
+static bool grid_load(SBI_Grid* grid,
+                      SDL_GPUDevice* device,
+                      SDL_Window* window) {
   grid->device = device;
   SBI_ShaderOptions vert_options = (SBI_ShaderOptions){
       .filename = "grid.vert",
@@ -75,6 +78,13 @@ bool SBI_GridLoad(SBI_Grid* grid, SDL_GPUDevice* device, SDL_Window* window) {
   return true;
 }
 
+bool SBI_GridLoad(SBI_Grid* grid, SDL_GPUDevice* device, SDL_Window* window) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_GRID);
+  bool result = grid_load(grid, device, window);
+  SBI_MemTrackPop(tag);
+  return result;
+}
+
 void SBI_GridDraw(SBI_Grid* grid,
                   const SBI_Mat4 proj,
                   const SBI_Mat4 view,
@@ -0,0 +1,324 @@
+#include "hierarchy.h"
+#include "billboard.h"
+#include "jobs.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+// Levels smaller than this are composed by the calling thread alone
+#define HIERARCHY_PARALLEL_MIN (4096)
+#define HIERARCHY_COMPONENTS (10)
+
+// A level being composed, job items are offsets from its first slot
+typedef struct {
+  SBI_Hierarchy* hierarchy;
+  Uint32 first;
+} HierarchyLevelJob;
+
+typedef struct {
+  SBI_Hierarchy* hierarchy;
+  SBI_Vec4* instances;
+} HierarchyExportJob;
+
+static bool hierarchy_alloc_arrays(SBI_XFormArrays* arrays, Uint32 count) {
+  float* data =
+      SDL_aligned_alloc(16, sizeof(float) * HIERARCHY_COMPONENTS * count);
+  if (data == NULL) {
+    return false;
+  }
+
+  // Identity: unit rotation and scale, zero position
+  for (Uint32 c = 0; c < HIERARCHY_COMPONENTS; c++) {
+    arrays->components[c] = data + (Uint64)c * count;
+    float value = c == 3 || c >= 7 ? 1.0f : 0.0f;
+    for (Uint32 i = 0; i < count; i++) {
+      arrays->components[c][i] = value;
+    }
+  }
+  return true;
+}
+
+// Depth of every node, the chain up to a known depth is kept in stack
+static bool hierarchy_depths(const Uint32* parents,
+                             Uint32 nodes_count,
+                             Uint32* depths,
+                             Uint32* stack) {
+  for (Uint32 i = 0; i < nodes_count; i++) {
+    depths[i] = SBI_HIERARCHY_NO_PARENT;
+  }
+
+  for (Uint32 n = 0; n < nodes_count; n++) {
+    Uint32 top = 0;
+    Uint32 node = n;
+    while (node != SBI_HIERARCHY_NO_PARENT) {
+      if (node >= nodes_count) {
+        SDL_Log("Hierarchy node %d has an invalid parent", stack[top - 1]);
+        return false;
+      }
+      if (depths[node] != SBI_HIERARCHY_NO_PARENT) {
+        break;
+      }
+      if (top == nodes_count) {
+        SDL_Log("Hierarchy node %d is part of a cycle", n);
+        return false;
+      }
+      stack[top++] = node;
+      node = parents[node];
+    }
+
+    Uint32 depth =
+        node == SBI_HIERARCHY_NO_PARENT ? 0 : depths[node] + 1;
+    while (top > 0) {
+      if (depth >= SBI_HIERARCHY_MAX_DEPTH) {
+        SDL_Log("Hierarchy is deeper than %d levels",
+                SBI_HIERARCHY_MAX_DEPTH);
+        return false;
+      }
+      depths[stack[--top]] = depth++;
+    }
+  }
+  return true;
+}
+
+bool SBI_HierarchyLoad(SBI_Hierarchy* hierarchy,
+                       const Uint32* parents,
+                       Uint32 nodes_count,
+                       Uint32 workers_count) {
+  hierarchy->nodes_count = nodes_count;
+  hierarchy->slots = SDL_malloc(sizeof(Uint32) * nodes_count);
+  hierarchy->nodes = SDL_malloc(sizeof(Uint32) * nodes_count);
+  hierarchy->parents = SDL_malloc(sizeof(Uint32) * nodes_count);
+  hierarchy->dirty = SDL_malloc(nodes_count);
+  hierarchy->changed = SDL_malloc(nodes_count);
+  if (hierarchy->slots == NULL || hierarchy->nodes == NULL ||
+      hierarchy->parents == NULL || hierarchy->dirty == NULL ||
+      hierarchy->changed == NULL ||
+      !hierarchy_alloc_arrays(&hierarchy->local, nodes_count) ||
+      !hierarchy_alloc_arrays(&hierarchy->world, nodes_count)) {
+    SDL_Log("Could not allocate memory for %d hierarchy nodes", nodes_count);
+    return false;
+  }
+
+  // Depths go to parents by slot and the walk uses nodes, both are
+  // overwritten by the sort below
+  Uint32* depths = hierarchy->parents;
+  if (!hierarchy_depths(parents, nodes_count, depths, hierarchy->nodes)) {
+    return false;
+  }
+
+  // Counting sort by depth, nodes keep their order inside a level
+  Uint32 cursors[SBI_HIERARCHY_MAX_DEPTH] = {0};
+  hierarchy->levels_count = 0;
+  for (Uint32 n = 0; n < nodes_count; n++) {
+    cursors[depths[n]]++;
+    hierarchy->levels_count = SDL_max(hierarchy->levels_count, depths[n] + 1);
+  }
+
+  Uint32 first = 0;
+  for (Uint32 d = 0; d < hierarchy->levels_count; d++) {
+    hierarchy->levels[d] = (SBI_HierarchyLevel){first, cursors[d]};
+    first += cursors[d];
+    cursors[d] = 0;
+  }
+
+  for (Uint32 n = 0; n < nodes_count; n++) {
+    SBI_HierarchyLevel* level = &hierarchy->levels[depths[n]];
+    Uint32 slot = level->first + cursors[depths[n]]++;
+    hierarchy->slots[n] = slot;
+    hierarchy->nodes[slot] = n;
+  }
+
+  for (Uint32 slot = 0; slot < nodes_count; slot++) {
+    Uint32 parent = parents[hierarchy->nodes[slot]];
+    hierarchy->parents[slot] = parent == SBI_HIERARCHY_NO_PARENT
+                                   ? SBI_HIERARCHY_NO_PARENT
+                                   : hierarchy->slots[parent];
+  }
+
+  SDL_memset(hierarchy->dirty, 1, nodes_count);
+  SDL_memset(hierarchy->changed, 0, nodes_count);
+  hierarchy->changed_count = 0;
+  hierarchy->any_dirty = true;
+
+  if (!SBI_JobPoolLoad(&hierarchy->pool, workers_count)) {
+    return false;
+  }
+
+  SDL_Log("Hierarchy of %d nodes in %d levels, %d workers", nodes_count,
+          hierarchy->levels_count, hierarchy->pool.workers_count);
+  return true;
+}
+
+void SBI_HierarchySetLocal(SBI_Hierarchy* hierarchy,
+                           Uint32 node,
+                           const SBI_XForm local) {
+  Uint32 slot = hierarchy->slots[node];
+  for (Uint32 c = 0; c < HIERARCHY_COMPONENTS; c++) {
+    hierarchy->local.components[c][slot] = local[c];
+  }
+  hierarchy->dirty[slot] = 1;
+  hierarchy->any_dirty = true;
+}
+
+void SBI_HierarchyGetWorld(const SBI_Hierarchy* hierarchy,
+                           Uint32 node,
+                           SBI_XForm world) {
+  Uint32 slot = hierarchy->slots[node];
+  for (Uint32 c = 0; c < HIERARCHY_COMPONENTS; c++) {
+    world[c] = hierarchy->world.components[c][slot];
+  }
+}
+
+// Roots copy their local transform, children compose it with the parent
+static void hierarchy_compose(SBI_Hierarchy* hierarchy,
+                              Uint64 first,
+                              Uint64 count) {
+  if (hierarchy->parents[first] != SBI_HIERARCHY_NO_PARENT) {
+    SBI_XFormComposeBatch(&hierarchy->local, hierarchy->parents,
+                          &hierarchy->world, first, count);
+    return;
+  }
+
+  for (Uint32 c = 0; c < HIERARCHY_COMPONENTS; c++) {
+    SDL_memcpy(&hierarchy->world.components[c][first],
+               &hierarchy->local.components[c][first],
+               sizeof(float) * count);
+  }
+}
+
+// Propagate the flags of the parents, then compose the runs of changed
+// slots of the range by batches
+static void hierarchy_level_job(void* data,
+                                Uint32 worker,
+                                Uint64 begin,
+                                Uint64 end) {
+  HierarchyLevelJob* job = data;
+  SBI_Hierarchy* hierarchy = job->hierarchy;
+  Uint64 first = job->first + begin;
+  Uint64 last = job->first + end;
+  Uint64 run = last;
+  Uint32 changed_count = 0;
+  for (Uint64 slot = first; slot <= last; slot++) {
+    bool changed = false;
+    if (slot < last) {
+      Uint32 parent = hierarchy->parents[slot];
+      changed = hierarchy->dirty[slot] != 0 ||
+                (parent != SBI_HIERARCHY_NO_PARENT &&
+                 hierarchy->changed[parent] != 0);
+      hierarchy->changed[slot] = changed;
+      hierarchy->dirty[slot] = 0;
+      changed_count += changed;
+    }
+
+    if (changed && run == last) {
+      run = slot;
+    } else if (!changed && run != last) {
+      hierarchy_compose(hierarchy, run, slot - run);
+      run = last;
+    }
+  }
+  hierarchy->changed_counts[worker] += changed_count;
+}
+
+void SBI_HierarchyUpdate(SBI_Hierarchy* hierarchy) {
+  // Nothing was set, only forget the changes of the last update
+  if (!hierarchy->any_dirty) {
+    if (hierarchy->changed_count > 0) {
+      SDL_memset(hierarchy->changed, 0, hierarchy->nodes_count);
+      hierarchy->changed_count = 0;
+    }
+    return;
+  }
+
+  SDL_memset(hierarchy->changed_counts, 0,
+             sizeof(hierarchy->changed_counts));
+  for (Uint32 d = 0; d < hierarchy->levels_count; d++) {
+    SBI_HierarchyLevel* level = &hierarchy->levels[d];
+    HierarchyLevelJob job = {
+        .hierarchy = hierarchy,
+        .first = level->first,
+    };
+    if (level->count >= HIERARCHY_PARALLEL_MIN) {
+      SBI_JobPoolRun(&hierarchy->pool, hierarchy_level_job, &job,
+                     level->count);
+    } else {
+      hierarchy_level_job(&job, 0, 0, level->count);
+    }
+  }
+
+  hierarchy->changed_count = 0;
+  for (Uint32 w = 0; w < SBI_JOB_MAX_WORKERS; w++) {
+    hierarchy->changed_count += hierarchy->changed_counts[w];
+  }
+  hierarchy->any_dirty = false;
+}
+
+static void hierarchy_export_job(void* data,
+                                 Uint32 worker,
+                                 Uint64 begin,
+                                 Uint64 end) {
+  HierarchyExportJob* job = data;
+  SBI_Hierarchy* hierarchy = job->hierarchy;
+  float* const* world = hierarchy->world.components;
+  for (Uint64 n = begin; n < end; n++) {
+    Uint32 slot = hierarchy->slots[n];
+    if (hierarchy->changed[slot] == 0) {
+      continue;
+    }
+
+    float* instance = job->instances[n];
+    instance[0] = world[4][slot];
+    instance[1] = world[5][slot];
+    instance[2] = world[6][slot];
+    instance[3] = world[7][slot];
+  }
+}
+
+void SBI_HierarchyExport(SBI_Hierarchy* hierarchy,
+                         SBI_Billboard* billboard,
+                         Uint64 first_instance) {
+  if (hierarchy->changed_count == 0 ||
+      first_instance >= billboard->instances_count) {
+    return;
+  }
+
+  Uint64 count = SDL_min(hierarchy->nodes_count,
+                         billboard->instances_count - first_instance);
+  HierarchyExportJob job = {
+      .hierarchy = hierarchy,
+      .instances = billboard->instances + first_instance,
+  };
+  SBI_JobPoolRun(&hierarchy->pool, hierarchy_export_job, &job, count);
+
+  if (hierarchy->changed_count == hierarchy->nodes_count) {
+    SBI_BillboardMarkDirty(billboard, SBI_BILLBOARD_STREAM_POSITION,
+                           first_instance, count);
+    return;
+  }
+
+  // Few changes stay sparse for the upload
+  Uint64 run = count;
+  for (Uint64 n = 0; n <= count; n++) {
+    bool changed = n < count && hierarchy->changed[hierarchy->slots[n]] != 0;
+    if (changed && run == count) {
+      run = n;
+    } else if (!changed && run != count) {
+      SBI_BillboardMarkDirty(billboard, SBI_BILLBOARD_STREAM_POSITION,
+                             first_instance + run, n - run);
+      run = count;
+    }
+  }
+}
+
+void SBI_HierarchyDestroy(SBI_Hierarchy* hierarchy) {
+  SBI_JobPoolDestroy(&hierarchy->pool);
+  SDL_aligned_free(hierarchy->local.components[0]);
+  SDL_aligned_free(hierarchy->world.components[0]);
+  SDL_free(hierarchy->changed);
+  SDL_free(hierarchy->dirty);
+  SDL_free(hierarchy->parents);
+  SDL_free(hierarchy->nodes);
+  SDL_free(hierarchy->slots);
+  SDL_memset(hierarchy, 0, sizeof(SBI_Hierarchy));
+}
@@ -0,0 +1,72 @@
+#ifndef SBI_HIERARCHY_H
+#define SBI_HIERARCHY_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "billboard.h"
+#include "jobs.h"
+#include "xmath.h"
+
+#define SBI_HIERARCHY_NO_PARENT (0xFFFFFFFFu)
+#define SBI_HIERARCHY_MAX_DEPTH (32)
+
+// Slots [first, first + count) hold the nodes of a depth
+typedef struct {
+  Uint32 first;
+  Uint32 count;
+} SBI_HierarchyLevel;
+
+// Transform tree sorted by depth: nodes live in slots level after level, so
+// every parent is composed before its children and the nodes of a level
+// are composed in parallel by batches. Transforms are stored as component
+// arrays by slot. Only the nodes set since the last update and their
+// subtrees are composed again, they are flagged as changed until the next.
+typedef struct {
+  SBI_JobPool pool;
+  Uint32 nodes_count;
+  Uint32* slots;
+  Uint32* nodes;
+  Uint32* parents;
+  Uint8* dirty;
+  Uint8* changed;
+  SBI_XFormArrays local;
+  SBI_XFormArrays world;
+  SBI_HierarchyLevel levels[SBI_HIERARCHY_MAX_DEPTH];
+  Uint32 levels_count;
+  Uint32 changed_counts[SBI_JOB_MAX_WORKERS];
+  Uint32 changed_count;
+  bool any_dirty;
+} SBI_Hierarchy;
+
+// Build the tree of nodes_count nodes, parents[node] is the parent node or
+// SBI_HIERARCHY_NO_PARENT for roots. Local transforms start as identity.
+// Fails on cycles and trees deeper than SBI_HIERARCHY_MAX_DEPTH. Zero
+// workers_count uses every logical core.
+bool SBI_HierarchyLoad(SBI_Hierarchy* hierarchy,
+                       const Uint32* parents,
+                       Uint32 nodes_count,
+                       Uint32 workers_count);
+
+// Set the transform of a node relative to its parent
+void SBI_HierarchySetLocal(SBI_Hierarchy* hierarchy,
+                           Uint32 node,
+                           const SBI_XForm local);
+
+// World transform of a node as of the last update
+void SBI_HierarchyGetWorld(const SBI_Hierarchy* hierarchy,
+                           Uint32 node,
+                           SBI_XForm world);
+
+// Compose the world transforms of the changed subtrees (fixed rate)
+void SBI_HierarchyUpdate(SBI_Hierarchy* hierarchy);
+
+// Write the changed nodes to instances [first_instance, + nodes_count) of
+// a set in node order: the world position and the x world scale as the
+// quad scale. Only the runs of changed instances are marked dirty.
+void SBI_HierarchyExport(SBI_Hierarchy* hierarchy,
+                         SBI_Billboard* billboard,
+                         Uint64 first_instance);
+
+void SBI_HierarchyDestroy(SBI_Hierarchy* hierarchy);
+
+#endif /* SBI_HIERARCHY_H */
@@ -0,0 +1,420 @@
+#include "hiz.h"
+#include "billboard.h"
+#include "shader.h"
+#include "view.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct {
+  SBI_ALIGN_MAT4 SBI_Mat4 pv;
+  SBI_ALIGN_VEC4 SBI_Vec4 pyramid_size;
+  Uint32 counts[4];
+  SBI_HiZLevel levels[SBI_HIZ_MAX_LEVELS];
+} HiZCullUniforms;
+
+typedef struct {
+  Sint32 region[4];
+  Uint32 source[4];
+  Uint32 target[4];
+} HiZDownsampleUniforms;
+
+// Each level halves the previous one rounding up, until a single texel
+static Uint32 hiz_compute_levels(Uint32 width,
+                                 Uint32 height,
+                                 SBI_HiZLevel* levels) {
+  Uint32 count = 0;
+  Uint32 offset = 0;
+  do {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    levels[count] = (SBI_HiZLevel){
+        .offset = offset,
+        .width = width,
+        .height = height,
+    };
+    offset += width * height;
+    count++;
+  } while ((width > 1 || height > 1) && count < SBI_HIZ_MAX_LEVELS);
+  return count;
+}
+
+static void hiz_release_targets(SBI_HiZ* hiz) {
+  SDL_ReleaseGPUTexture(hiz->device, hiz->depth);
+  SDL_ReleaseGPUBuffer(hiz->device, hiz->pyramid);
+  hiz->depth = NULL;
+  hiz->pyramid = NULL;
+  hiz->width = 0;
+  hiz->height = 0;
+  hiz->valid = false;
+}
+
+static void hiz_release_lists(SBI_HiZ* hiz) {
+  SDL_ReleaseGPUBuffer(hiz->device, hiz->visible_early);
+  SDL_ReleaseGPUBuffer(hiz->device, hiz->visible_late);
+  SDL_ReleaseGPUBuffer(hiz->device, hiz->occluded);
+  hiz->visible_early = NULL;
+  hiz->visible_late = NULL;
+  hiz->occluded = NULL;
+  hiz->capacity = 0;
+}
+
+bool SBI_HiZLoad(SBI_HiZ* hiz, SDL_GPUDevice* device) {
+  hiz->device = device;
+
+  SBI_ComputeOptions downsample_options = (SBI_ComputeOptions){
+      .filename = "hiz_downsample.comp",
+      .sampler_count = 1,
+      .readwrite_storage_buffer_count = 1,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_HIZ_DOWNSAMPLE_TILE,
+      .threadcount_y = SBI_HIZ_DOWNSAMPLE_TILE,
+      .threadcount_z = 1,
+  };
+  hiz->downsample_pipeline =
+      SBI_ComputePipelineLoad(device, downsample_options);
+  if (hiz->downsample_pipeline == NULL) {
+    SDL_Log("Couldn't create compute pipeline for Hi-Z downsample");
+    return false;
+  }
+
+  SBI_ComputeOptions cull_options = (SBI_ComputeOptions){
+      .filename = "hiz_cull.comp",
+      .readonly_storage_buffer_count = 2,
+      .readwrite_storage_buffer_count = 3,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_HIZ_CULL_GROUP_SIZE,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  hiz->cull_pipeline = SBI_ComputePipelineLoad(device, cull_options);
+  if (hiz->cull_pipeline == NULL) {
+    SDL_Log("Couldn't create compute pipeline for Hi-Z culling");
+    return false;
+  }
+
+  SDL_GPUSamplerCreateInfo sampler_create_info = {
+      .min_filter = SDL_GPU_FILTER_NEAREST,
+      .mag_filter = SDL_GPU_FILTER_NEAREST,
+      .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST,
+      .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+  };
+  hiz->sampler = SDL_CreateGPUSampler(device, &sampler_create_info);
+  if (hiz->sampler == NULL) {
+    SDL_Log("Couldn't create sampler for Hi-Z depth");
+    return false;
+  }
+
+  SDL_GPUBufferCreateInfo args_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_INDIRECT |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = sizeof(SBI_HiZArgs),
+  };
+  hiz->args = SDL_CreateGPUBuffer(device, &args_create_info);
+  if (hiz->args == NULL) {
+    SDL_Log("Couldn't create Hi-Z indirect arguments");
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo reset_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = sizeof(SBI_HiZArgs),
+  };
+  SDL_GPUTransferBufferCreateInfo stats_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+      .size = sizeof(SBI_HiZArgs),
+  };
+  hiz->reset_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &reset_create_info);
+  hiz->stats_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &stats_create_info);
+  if (hiz->reset_transfer_buffer == NULL ||
+      hiz->stats_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffers of Hi-Z");
+    return false;
+  }
+
+  // Both draws start empty every frame: 6 indices of the quad per instance
+  SBI_HiZArgs* reset =
+      SDL_MapGPUTransferBuffer(device, hiz->reset_transfer_buffer, false);
+  SDL_memset(reset, 0, sizeof(SBI_HiZArgs));
+  reset->early.num_indices = 6;
+  reset->late.num_indices = 6;
+  SDL_UnmapGPUTransferBuffer(device, hiz->reset_transfer_buffer);
+  return true;
+}
+
+bool SBI_HiZPrepare(SBI_HiZ* hiz,
+                    Uint32 width,
+                    Uint32 height,
+                    Uint32 instances_count) {
+  hiz->instances_count = instances_count;
+  if (hiz->capacity < instances_count) {
+    hiz_release_lists(hiz);
+
+    SDL_GPUBufferCreateInfo list_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+                 SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+                 SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+        .size = sizeof(Uint32) * SDL_max(instances_count, 1),
+    };
+    hiz->visible_early = SDL_CreateGPUBuffer(hiz->device, &list_create_info);
+    hiz->visible_late = SDL_CreateGPUBuffer(hiz->device, &list_create_info);
+    hiz->occluded = SDL_CreateGPUBuffer(hiz->device, &list_create_info);
+    if (hiz->visible_early == NULL || hiz->visible_late == NULL ||
+        hiz->occluded == NULL) {
+      SDL_Log("Couldn't create Hi-Z lists: %s", SDL_GetError());
+      hiz_release_lists(hiz);
+      return false;
+    }
+    hiz->capacity = instances_count;
+  }
+
+  if (hiz->depth != NULL && hiz->width == width && hiz->height == height) {
+    return true;
+  }
+
+  hiz_release_targets(hiz);
+
+  SDL_GPUTextureCreateInfo depth_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SBI_HIZ_DEPTH_FORMAT,
+      .usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET |
+               SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  hiz->depth = SDL_CreateGPUTexture(hiz->device, &depth_create_info);
+
+  // Sized for a view covering the whole target
+  SBI_HiZLevel levels[SBI_HIZ_MAX_LEVELS] = {0};
+  Uint32 levels_count = hiz_compute_levels(width, height, levels);
+  SBI_HiZLevel* last = &levels[levels_count - 1];
+  SDL_GPUBufferCreateInfo pyramid_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = sizeof(float) * (last->offset + last->width * last->height),
+  };
+  hiz->pyramid = SDL_CreateGPUBuffer(hiz->device, &pyramid_create_info);
+  if (hiz->depth == NULL || hiz->pyramid == NULL) {
+    SDL_Log("Couldn't create Hi-Z targets: %s", SDL_GetError());
+    hiz_release_targets(hiz);
+    return false;
+  }
+
+  hiz->width = width;
+  hiz->height = height;
+  return true;
+}
+
+void SBI_HiZCull(SBI_HiZ* hiz,
+                 SBI_Billboard* billboard,
+                 const SBI_View* view,
+                 float scale,
+                 SBI_HiZPhase phase,
+                 SDL_GPUCommandBuffer* cmd_buf) {
+  if (phase == SBI_HIZ_EARLY) {
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = hiz->reset_transfer_buffer,
+        .offset = 0,
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = hiz->args,
+        .offset = 0,
+        .size = sizeof(SBI_HiZArgs),
+    };
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+    SDL_EndGPUCopyPass(copy_pass);
+
+    // Same rectangle as the scissor that SBI_ViewBegin binds
+    SDL_Rect region = {
+        .x = (int)(view->scissor.x * scale),
+        .y = (int)(view->scissor.y * scale),
+        .w = (int)(view->scissor.w * scale),
+        .h = (int)(view->scissor.h * scale),
+    };
+    SDL_Rect bounds = {0, 0, (int)hiz->width, (int)hiz->height};
+    if (!SDL_GetRectIntersection(&region, &bounds, &hiz->region)) {
+      hiz->region = (SDL_Rect){0, 0, 1, 1};
+    }
+  }
+
+  HiZCullUniforms uniforms = {0};
+  SBI_Mat4Mul(view->camera.proj, view->camera.view, uniforms.pv);
+  uniforms.pyramid_size[0] = (float)hiz->pyramid_region.w;
+  uniforms.pyramid_size[1] = (float)hiz->pyramid_region.h;
+  uniforms.counts[0] = hiz->instances_count;
+  uniforms.counts[1] = phase;
+  uniforms.counts[2] = hiz->valid ? 1 : 0;
+  uniforms.counts[3] = hiz->levels_count;
+  SDL_memcpy(uniforms.levels, hiz->levels, sizeof(hiz->levels));
+
+  SDL_GPUStorageBufferReadWriteBinding bindings[3] = {
+      {.buffer = hiz->args},
+      {.buffer = phase == SBI_HIZ_EARLY ? hiz->visible_early
+                                        : hiz->visible_late},
+      {.buffer = hiz->occluded},
+  };
+  SDL_GPUBuffer* inputs[2] = {
+      billboard->streams[SBI_BILLBOARD_STREAM_POSITION].buffer,
+      hiz->pyramid,
+  };
+
+  // The late phase reads back its count from the arguments on the GPU
+  Uint32 groups = (hiz->instances_count + SBI_HIZ_CULL_GROUP_SIZE - 1) /
+                  SBI_HIZ_CULL_GROUP_SIZE;
+  SDL_GPUComputePass* compute_pass =
+      SDL_BeginGPUComputePass(cmd_buf, NULL, 0, bindings, 3);
+  SDL_BindGPUComputePipeline(compute_pass, hiz->cull_pipeline);
+  SDL_BindGPUComputeStorageBuffers(compute_pass, 0, inputs, 2);
+  SDL_PushGPUComputeUniformData(cmd_buf, 0, &uniforms,
+                                sizeof(HiZCullUniforms));
+  SDL_DispatchGPUCompute(compute_pass, SDL_max(groups, 1), 1, 1);
+  SDL_EndGPUComputePass(compute_pass);
+}
+
+SDL_GPURenderPass* SBI_HiZBeginPass(SBI_HiZ* hiz,
+                                    SDL_GPUTexture* color_texture,
+                                    SBI_HiZPhase phase,
+                                    SDL_GPUCommandBuffer* cmd_buf) {
+  SDL_GPUColorTargetInfo color_target_info = {
+      .texture = color_texture,
+      .load_op = SDL_GPU_LOADOP_LOAD,
+      .store_op = SDL_GPU_STOREOP_STORE,
+  };
+  SDL_GPUDepthStencilTargetInfo depth_target_info = {
+      .texture = hiz->depth,
+      .clear_depth = 1.0f,
+      .load_op = phase == SBI_HIZ_EARLY ? SDL_GPU_LOADOP_CLEAR
+                                        : SDL_GPU_LOADOP_LOAD,
+      .store_op = SDL_GPU_STOREOP_STORE,
+      .stencil_load_op = SDL_GPU_LOADOP_DONT_CARE,
+      .stencil_store_op = SDL_GPU_STOREOP_DONT_CARE,
+  };
+  return SDL_BeginGPURenderPass(cmd_buf, &color_target_info, 1,
+                                &depth_target_info);
+}
+
+void SBI_HiZDraw(SBI_HiZ* hiz,
+                 SBI_Billboard* billboard,
+                 SBI_View* view,
+                 SBI_HiZPhase phase,
+                 SDL_GPUCommandBuffer* cmd_buf,
+                 SDL_GPURenderPass* render_pass) {
+  SDL_GPUBuffer* visible =
+      phase == SBI_HIZ_EARLY ? hiz->visible_early : hiz->visible_late;
+  Uint32 offset = phase == SBI_HIZ_EARLY ? offsetof(SBI_HiZArgs, early)
+                                         : offsetof(SBI_HiZArgs, late);
+  SBI_BillboardDrawIndirect(billboard, visible, hiz->args, offset,
+                            view->camera.proj, view->camera.view,
+                            view->position, cmd_buf, render_pass);
+}
+
+void SBI_HiZBuild(SBI_HiZ* hiz, SDL_GPUCommandBuffer* cmd_buf) {
+  hiz->pyramid_region = hiz->region;
+  hiz->levels_count = hiz_compute_levels(hiz->region.w, hiz->region.h,
+                                         hiz->levels);
+
+  // One pass per level, each pass waits for the writes of the previous one
+  SDL_GPUTextureSamplerBinding depth_binding = {
+      .texture = hiz->depth,
+      .sampler = hiz->sampler,
+  };
+  SDL_GPUStorageBufferReadWriteBinding pyramid_binding = {
+      .buffer = hiz->pyramid,
+  };
+  for (Uint32 level = 0; level < hiz->levels_count; level++) {
+    HiZDownsampleUniforms uniforms = {
+        .region = {hiz->region.x, hiz->region.y, hiz->region.w,
+                   hiz->region.h},
+        .target = {hiz->levels[level].offset, hiz->levels[level].width,
+                   hiz->levels[level].height, 0},
+    };
+    if (level == 0) {
+      uniforms.source[1] = (Uint32)hiz->region.w;
+      uniforms.source[2] = (Uint32)hiz->region.h;
+      uniforms.source[3] = 1;
+    } else {
+      uniforms.source[0] = hiz->levels[level - 1].offset;
+      uniforms.source[1] = hiz->levels[level - 1].width;
+      uniforms.source[2] = hiz->levels[level - 1].height;
+    }
+
+    const SBI_HiZLevel* target = &hiz->levels[level];
+    Uint32 groups_x = (target->width + SBI_HIZ_DOWNSAMPLE_TILE - 1) /
+                      SBI_HIZ_DOWNSAMPLE_TILE;
+    Uint32 groups_y = (target->height + SBI_HIZ_DOWNSAMPLE_TILE - 1) /
+                      SBI_HIZ_DOWNSAMPLE_TILE;
+    SDL_GPUComputePass* compute_pass =
+        SDL_BeginGPUComputePass(cmd_buf, NULL, 0, &pyramid_binding, 1);
+    SDL_BindGPUComputePipeline(compute_pass, hiz->downsample_pipeline);
+    SDL_BindGPUComputeSamplers(compute_pass, 0, &depth_binding, 1);
+    SDL_PushGPUComputeUniformData(cmd_buf, 0, &uniforms,
+                                  sizeof(HiZDownsampleUniforms));
+    SDL_DispatchGPUCompute(compute_pass, groups_x, groups_y, 1);
+    SDL_EndGPUComputePass(compute_pass);
+  }
+
+  hiz->valid = true;
+}
+
+bool SBI_HiZReadStats(SBI_HiZ* hiz, SBI_HiZStats* stats) {
+  SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(hiz->device);
+  if (cmd_buf == NULL) {
+    SDL_Log("Could not acquire GPU command buffer: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+  SDL_GPUBufferRegion source = {
+      .buffer = hiz->args,
+      .offset = 0,
+      .size = sizeof(SBI_HiZArgs),
+  };
+  SDL_GPUTransferBufferLocation destination = {
+      .transfer_buffer = hiz->stats_transfer_buffer,
+      .offset = 0,
+  };
+  SDL_DownloadFromGPUBuffer(copy_pass, &source, &destination);
+  SDL_EndGPUCopyPass(copy_pass);
+
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+  SDL_WaitForGPUFences(hiz->device, true, &fence, 1);
+  SDL_ReleaseGPUFence(hiz->device, fence);
+
+  const SBI_HiZArgs* args =
+      SDL_MapGPUTransferBuffer(hiz->device, hiz->stats_transfer_buffer, false);
+  *stats = (SBI_HiZStats){
+      .tested = hiz->instances_count,
+      .drawn_early = args->early.num_instances,
+      .drawn_late = args->late.num_instances,
+      .occluded = args->occluded_count - args->late.num_instances,
+  };
+  SDL_UnmapGPUTransferBuffer(hiz->device, hiz->stats_transfer_buffer);
+  return true;
+}
+
+void SBI_HiZDestroy(SBI_HiZ* hiz) {
+  if (hiz->device == NULL) {
+    return;
+  }
+
+  hiz_release_targets(hiz);
+  hiz_release_lists(hiz);
+  SDL_ReleaseGPUBuffer(hiz->device, hiz->args);
+  SDL_ReleaseGPUTransferBuffer(hiz->device, hiz->reset_transfer_buffer);
+  SDL_ReleaseGPUTransferBuffer(hiz->device, hiz->stats_transfer_buffer);
+  SDL_ReleaseGPUSampler(hiz->device, hiz->sampler);
+  SDL_ReleaseGPUComputePipeline(hiz->device, hiz->downsample_pipeline);
+  SDL_ReleaseGPUComputePipeline(hiz->device, hiz->cull_pipeline);
+  SDL_memset(hiz, 0, sizeof(SBI_HiZ));
+}
@@ -0,0 +1,119 @@
+#ifndef SBI_HIZ_H
+#define SBI_HIZ_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_rect.h>
+
+#include "billboard.h"
+#include "view.h"
+
+#define SBI_HIZ_DEPTH_FORMAT SDL_GPU_TEXTUREFORMAT_D32_FLOAT
+#define SBI_HIZ_MAX_LEVELS (16)
+#define SBI_HIZ_CULL_GROUP_SIZE (64)
+#define SBI_HIZ_DOWNSAMPLE_TILE (8)
+
+// The early phase draws what survives the pyramid of the previous frame,
+// the late phase retests its occluded instances against the new depth
+typedef enum {
+  SBI_HIZ_EARLY,
+  SBI_HIZ_LATE,
+} SBI_HiZPhase;
+
+// Counters written by the culling passes, reset at the start of a frame
+typedef struct {
+  SDL_GPUIndexedIndirectDrawCommand early;
+  SDL_GPUIndexedIndirectDrawCommand late;
+  Uint32 occluded_count;
+  Uint32 padding[3];
+} SBI_HiZArgs;
+
+// A level of the pyramid inside the pyramid buffer, row major
+typedef struct {
+  Uint32 offset;
+  Uint32 width;
+  Uint32 height;
+  Uint32 padding;
+} SBI_HiZLevel;
+
+// Instances drawn by each phase in the last frame
+typedef struct {
+  Uint32 tested;
+  Uint32 drawn_early;
+  Uint32 drawn_late;
+  Uint32 occluded;
+} SBI_HiZStats;
+
+// Hierarchical-Z occlusion culling of a depth tested billboard set. A max
+// depth pyramid of the last frame rejects hidden instances in a compute
+// pass that writes an indirect draw of the survivors.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUComputePipeline* downsample_pipeline;
+  SDL_GPUComputePipeline* cull_pipeline;
+  SDL_GPUSampler* sampler;
+  SDL_GPUTexture* depth;
+  SDL_GPUBuffer* pyramid;
+  SDL_GPUBuffer* args;
+  SDL_GPUBuffer* visible_early;
+  SDL_GPUBuffer* visible_late;
+  SDL_GPUBuffer* occluded;
+  SDL_GPUTransferBuffer* reset_transfer_buffer;
+  SDL_GPUTransferBuffer* stats_transfer_buffer;
+  Uint32 width;
+  Uint32 height;
+  Uint32 capacity;
+  Uint32 instances_count;
+
+  // Region of the depth target covered by the view of the last cull, the
+  // pyramid keeps the levels of the last build
+  SDL_Rect region;
+  SDL_Rect pyramid_region;
+  SBI_HiZLevel levels[SBI_HIZ_MAX_LEVELS];
+  Uint32 levels_count;
+  bool valid;
+} SBI_HiZ;
+
+// Load the downsample and culling pipelines
+bool SBI_HiZLoad(SBI_HiZ* hiz, SDL_GPUDevice* device);
+
+// Make sure the depth target matches the scene target and the lists can
+// hold instances_count instances
+bool SBI_HiZPrepare(SBI_HiZ* hiz,
+                    Uint32 width,
+                    Uint32 height,
+                    Uint32 instances_count);
+
+// Cull the instances of billboard for a view in a compute pass, the early
+// phase also resets the indirect draws
+void SBI_HiZCull(SBI_HiZ* hiz,
+                 SBI_Billboard* billboard,
+                 const SBI_View* view,
+                 float scale,
+                 SBI_HiZPhase phase,
+                 SDL_GPUCommandBuffer* cmd_buf);
+
+// Begin a pass over color_texture and the depth target, cleared by the
+// early phase and kept by the late one
+SDL_GPURenderPass* SBI_HiZBeginPass(SBI_HiZ* hiz,
+                                    SDL_GPUTexture* color_texture,
+                                    SBI_HiZPhase phase,
+                                    SDL_GPUCommandBuffer* cmd_buf);
+
+// Draw the survivors of a phase
+void SBI_HiZDraw(SBI_HiZ* hiz,
+                 SBI_Billboard* billboard,
+                 SBI_View* view,
+                 SBI_HiZPhase phase,
+                 SDL_GPUCommandBuffer* cmd_buf,
+                 SDL_GPURenderPass* render_pass);
+
+// Rebuild the pyramid from the depth of the culled view region
+void SBI_HiZBuild(SBI_HiZ* hiz, SDL_GPUCommandBuffer* cmd_buf);
+
+// Wait for the GPU and read the counters of the last frame (slow)
+bool SBI_HiZReadStats(SBI_HiZ* hiz, SBI_HiZStats* stats);
+
+// Release the targets, lists and pipelines
+void SBI_HiZDestroy(SBI_HiZ* hiz);
+
+#endif /* SBI_HIZ_H */
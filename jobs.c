@@ -0,0 +1,125 @@
+#include "jobs.h"
+
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_log.h>
+
+static int job_worker_thread(void* data);
+
+static void job_run_range(SBI_JobPool* pool,
+                          SBI_JobFunc func,
+                          void* data,
+                          Uint64 count,
+                          Uint32 worker) {
+  Uint64 begin = count * worker / pool->workers_count;
+  Uint64 end = count * (worker + 1) / pool->workers_count;
+  if (begin < end) {
+    func(data, worker, begin, end);
+  }
+}
+
+bool SBI_JobPoolLoad(SBI_JobPool* pool, Uint32 workers_count) {
+  SDL_memset(pool, 0, sizeof(SBI_JobPool));
+  if (workers_count == 0) {
+    workers_count = (Uint32)SDL_GetNumLogicalCPUCores();
+  }
+  pool->workers_count = SDL_clamp(workers_count, 1, SBI_JOB_MAX_WORKERS);
+
+  pool->lock = SDL_CreateMutex();
+  pool->wake = SDL_CreateCondition();
+  pool->done = SDL_CreateCondition();
+  if (pool->lock == NULL || pool->wake == NULL || pool->done == NULL) {
+    SDL_Log("Couldn't create job pool sync objects: %s", SDL_GetError());
+    return false;
+  }
+
+  // Worker 0 is the thread calling SBI_JobPoolRun
+  for (Uint32 i = 1; i < pool->workers_count; i++) {
+    SBI_JobWorker* worker = &pool->workers[i];
+    worker->pool = pool;
+    worker->index = i;
+    worker->thread = SDL_CreateThread(job_worker_thread, "SBI_JobWorker",
+                                      worker);
+    if (worker->thread == NULL) {
+      SDL_Log("Couldn't create job worker: %s", SDL_GetError());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void SBI_JobPoolRun(SBI_JobPool* pool,
+                    SBI_JobFunc func,
+                    void* data,
+                    Uint64 count) {
+  if (pool->workers_count <= 1) {
+    job_run_range(pool, func, data, count, 0);
+    return;
+  }
+
+  SDL_LockMutex(pool->lock);
+  pool->func = func;
+  pool->data = data;
+  pool->count = count;
+  pool->remaining = pool->workers_count - 1;
+  pool->generation++;
+  SDL_BroadcastCondition(pool->wake);
+  SDL_UnlockMutex(pool->lock);
+
+  job_run_range(pool, func, data, count, 0);
+
+  SDL_LockMutex(pool->lock);
+  while (pool->remaining > 0) {
+    SDL_WaitCondition(pool->done, pool->lock);
+  }
+  SDL_UnlockMutex(pool->lock);
+}
+
+void SBI_JobPoolDestroy(SBI_JobPool* pool) {
+  if (pool->lock != NULL) {
+    SDL_LockMutex(pool->lock);
+    pool->quit = true;
+    SDL_BroadcastCondition(pool->wake);
+    SDL_UnlockMutex(pool->lock);
+  }
+
+  for (Uint32 i = 1; i < pool->workers_count; i++) {
+    if (pool->workers[i].thread != NULL) {
+      SDL_WaitThread(pool->workers[i].thread, NULL);
+    }
+  }
+
+  SDL_DestroyCondition(pool->done);
+  SDL_DestroyCondition(pool->wake);
+  SDL_DestroyMutex(pool->lock);
+  SDL_memset(pool, 0, sizeof(SBI_JobPool));
+}
+
+static int job_worker_thread(void* data) {
+  SBI_JobWorker* worker = data;
+  SBI_JobPool* pool = worker->pool;
+  Uint64 seen = 0;
+
+  SDL_LockMutex(pool->lock);
+  while (!pool->quit) {
+    if (pool->generation == seen) {
+      SDL_WaitCondition(pool->wake, pool->lock);
+      continue;
+    }
+
+    seen = pool->generation;
+    SBI_JobFunc func = pool->func;
+    void* job_data = pool->data;
+    Uint64 count = pool->count;
+    SDL_UnlockMutex(pool->lock);
+
+    job_run_range(pool, func, job_data, count, worker->index);
+
+    SDL_LockMutex(pool->lock);
+    if (--pool->remaining == 0) {
+      SDL_SignalCondition(pool->done);
+    }
+  }
+  SDL_UnlockMutex(pool->lock);
+  return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SBI_JOBS_H
+#define SBI_JOBS_H
+
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#define SBI_JOB_MAX_WORKERS (16)
+
+// Processes items [begin, end) of a job, worker is in [0, workers_count)
+typedef void (*SBI_JobFunc)(void* data, Uint32 worker, Uint64 begin,
+                            Uint64 end);
+
+typedef struct SBI_JobPool SBI_JobPool;
+
+typedef struct {
+  SBI_JobPool* pool;
+  SDL_Thread* thread;
+  Uint32 index;
+} SBI_JobWorker;
+
+// Fixed set of threads that split a range of items in equal parts, the
+// calling thread works as worker 0.
+struct SBI_JobPool {
+  SBI_JobWorker workers[SBI_JOB_MAX_WORKERS];
+  Uint32 workers_count;
+
+  // Current job, guarded by lock
+  SDL_Mutex* lock;
+  SDL_Condition* wake;
+  SDL_Condition* done;
+  SBI_JobFunc func;
+  void* data;
+  Uint64 count;
+  Uint64 generation;
+  Uint32 remaining;
+  bool quit;
+};
+
+// Start the workers, zero workers_count uses every logical core
+bool SBI_JobPoolLoad(SBI_JobPool* pool, Uint32 workers_count);
+
+// Split count items across the workers and wait for all of them. The split
+// only depends on count, so two runs over the same count give every worker
+// the same range.
+void SBI_JobPoolRun(SBI_JobPool* pool,
+                    SBI_JobFunc func,
+                    void* data,
+                    Uint64 count);
+
+// Stop and join the workers
+void SBI_JobPoolDestroy(SBI_JobPool* pool);
+
+#endif /* SBI_JOBS_H */
@@ -0,0 +1,257 @@
+#include "lights.h"
+#include "shader.h"
+#include "view.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct {
+  SBI_ALIGN_MAT4 SBI_Mat4 view;
+  SBI_ALIGN_VEC4 SBI_Vec4 projection;
+  Uint32 grid[4];
+  SBI_ALIGN_VEC4 SBI_Vec4 region;
+} LightsCullUniforms;
+
+static void lights_release_clusters(SBI_Lights* lights) {
+  SDL_ReleaseGPUBuffer(lights->device, lights->cluster_counts);
+  SDL_ReleaseGPUBuffer(lights->device, lights->cluster_lights);
+  lights->cluster_counts = NULL;
+  lights->cluster_lights = NULL;
+  lights->clusters_capacity = 0;
+  lights->width = 0;
+  lights->height = 0;
+}
+
+bool SBI_LightsLoad(SBI_Lights* lights,
+                    SDL_GPUDevice* device,
+                    Uint32 lights_count) {
+  lights->device = device;
+  lights->lights_count = SDL_min(lights_count, SBI_LIGHTS_MAX);
+  lights->ambient = 0.15f;
+  lights->dirty = true;
+
+  SBI_ComputeOptions cull_options = (SBI_ComputeOptions){
+      .filename = "lights_cull.comp",
+      .readonly_storage_buffer_count = 1,
+      .readwrite_storage_buffer_count = 2,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_LIGHTS_CULL_GROUP_SIZE,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  lights->cull_pipeline = SBI_ComputePipelineLoad(device, cull_options);
+  if (lights->cull_pipeline == NULL) {
+    SDL_Log("Couldn't create compute pipeline for light culling");
+    return false;
+  }
+
+  // Never empty, the lit shader binds the buffer even without lights
+  Uint32 size = sizeof(SBI_PointLight) * SDL_max(lights->lights_count, 1);
+  lights->lights = SDL_aligned_alloc(16, size);
+  if (lights->lights == NULL) {
+    SDL_Log("Could not allocate memory for %d lights", lights->lights_count);
+    return false;
+  }
+  SDL_memset(lights->lights, 0, size);
+
+  SDL_GPUBufferCreateInfo buffer_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+      .size = size,
+  };
+  lights->lights_buffer = SDL_CreateGPUBuffer(device, &buffer_create_info);
+  if (lights->lights_buffer == NULL) {
+    SDL_Log("Couldn't create buffer for lights");
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = size,
+  };
+  lights->upload_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &transfer_create_info);
+  if (lights->upload_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of lights");
+    return false;
+  }
+  return true;
+}
+
+void SBI_LightsMarkDirty(SBI_Lights* lights) {
+  lights->dirty = true;
+}
+
+bool SBI_LightsPrepare(SBI_Lights* lights, Uint32 width, Uint32 height) {
+  if (lights->cluster_counts != NULL && lights->width == width &&
+      lights->height == height) {
+    return true;
+  }
+
+  lights_release_clusters(lights);
+
+  Uint32 tiles_x = (width + SBI_LIGHTS_TILE_SIZE - 1) / SBI_LIGHTS_TILE_SIZE;
+  Uint32 tiles_y = (height + SBI_LIGHTS_TILE_SIZE - 1) / SBI_LIGHTS_TILE_SIZE;
+  Uint32 clusters = SDL_max(tiles_x * tiles_y * SBI_LIGHTS_SLICES, 1);
+
+  SDL_GPUBufferCreateInfo counts_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = sizeof(Uint32) * clusters,
+  };
+  SDL_GPUBufferCreateInfo lights_create_info = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = sizeof(Uint32) * clusters * SBI_LIGHTS_PER_CLUSTER,
+  };
+  lights->cluster_counts =
+      SDL_CreateGPUBuffer(lights->device, &counts_create_info);
+  lights->cluster_lights =
+      SDL_CreateGPUBuffer(lights->device, &lights_create_info);
+  if (lights->cluster_counts == NULL || lights->cluster_lights == NULL) {
+    SDL_Log("Couldn't create light clusters: %s", SDL_GetError());
+    lights_release_clusters(lights);
+    return false;
+  }
+
+  lights->width = width;
+  lights->height = height;
+  lights->clusters_capacity = clusters;
+  return true;
+}
+
+void SBI_LightsUpload(SBI_Lights* lights, SDL_GPUCommandBuffer* cmd_buf) {
+  if (!lights->dirty || lights->lights_count == 0) {
+    return;
+  }
+
+  Uint32 size = sizeof(SBI_PointLight) * lights->lights_count;
+  void* transfer_point = SDL_MapGPUTransferBuffer(
+      lights->device, lights->upload_transfer_buffer, true);
+  SDL_memcpy(transfer_point, lights->lights, size);
+  SDL_UnmapGPUTransferBuffer(lights->device, lights->upload_transfer_buffer);
+
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+  SDL_GPUTransferBufferLocation source = {
+      .transfer_buffer = lights->upload_transfer_buffer,
+      .offset = 0,
+  };
+  SDL_GPUBufferRegion destination = {
+      .buffer = lights->lights_buffer,
+      .offset = 0,
+      .size = size,
+  };
+  SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+  SDL_EndGPUCopyPass(copy_pass);
+  lights->dirty = false;
+}
+
+void SBI_LightsCull(SBI_Lights* lights,
+                    const SBI_View* view,
+                    float scale,
+                    SDL_GPUCommandBuffer* cmd_buf) {
+  const SBI_Camera* camera = &view->camera;
+
+  // Same rectangle as the scissor that SBI_ViewBegin binds
+  SDL_Rect region = {
+      .x = (int)(view->scissor.x * scale),
+      .y = (int)(view->scissor.y * scale),
+      .w = (int)(view->scissor.w * scale),
+      .h = (int)(view->scissor.h * scale),
+  };
+  SDL_Rect bounds = {0, 0, (int)lights->width, (int)lights->height};
+  if (!SDL_GetRectIntersection(&region, &bounds, &region)) {
+    region = (SDL_Rect){0, 0, 1, 1};
+  }
+
+  // Near and far planes from the perspective matrix, depth slices are
+  // spaced exponentially: slice = log(depth) * scale + bias
+  float near = camera->proj[14] / camera->proj[10];
+  float far = camera->proj[14] / (camera->proj[10] + 1.0f);
+  float log_ratio = SDL_logf(far / near);
+  float slice_scale = SBI_LIGHTS_SLICES / log_ratio;
+  float slice_bias = -SBI_LIGHTS_SLICES * SDL_logf(near) / log_ratio;
+
+  Uint32 tiles_x =
+      (region.w + SBI_LIGHTS_TILE_SIZE - 1) / SBI_LIGHTS_TILE_SIZE;
+  Uint32 tiles_y =
+      (region.h + SBI_LIGHTS_TILE_SIZE - 1) / SBI_LIGHTS_TILE_SIZE;
+
+  SBI_LightsParams* params = &lights->params;
+  params->region[0] = (float)region.x;
+  params->region[1] = (float)region.y;
+  params->region[2] = 1.0f / SBI_LIGHTS_TILE_SIZE;
+  params->grid[0] = tiles_x;
+  params->grid[1] = tiles_y;
+  params->grid[2] = SBI_LIGHTS_SLICES;
+  params->grid[3] = SBI_LIGHTS_PER_CLUSTER;
+  params->slicing[0] = slice_scale;
+  params->slicing[1] = slice_bias;
+  params->slicing[2] = near;
+  SBI_XFormGetPosition(camera->xform, params->view_pos);
+  params->view_pos[3] = lights->ambient;
+
+  // Forward is the negated third row of the view rotation
+  SBI_Vec3Make(-camera->view[2], -camera->view[6], -camera->view[10],
+               params->view_forward);
+
+  LightsCullUniforms uniforms = {0};
+  SDL_memcpy(uniforms.view, camera->view, sizeof(SBI_Mat4));
+  uniforms.projection[0] = camera->proj[0];
+  uniforms.projection[1] = camera->proj[5];
+  uniforms.projection[2] = slice_scale;
+  uniforms.projection[3] = slice_bias;
+  uniforms.grid[0] = tiles_x;
+  uniforms.grid[1] = tiles_y;
+  uniforms.grid[2] = SBI_LIGHTS_SLICES;
+  uniforms.grid[3] = lights->lights_count;
+  uniforms.region[0] = (float)region.x;
+  uniforms.region[1] = (float)region.y;
+  uniforms.region[2] = (float)region.w;
+  uniforms.region[3] = (float)region.h;
+
+  SDL_GPUStorageBufferReadWriteBinding bindings[2] = {
+      {.buffer = lights->cluster_counts},
+      {.buffer = lights->cluster_lights},
+  };
+
+  // A group per cluster, its threads split the lights between them
+  SDL_GPUComputePass* compute_pass =
+      SDL_BeginGPUComputePass(cmd_buf, NULL, 0, bindings, 2);
+  SDL_BindGPUComputePipeline(compute_pass, lights->cull_pipeline);
+  SDL_BindGPUComputeStorageBuffers(compute_pass, 0, &lights->lights_buffer, 1);
+  SDL_PushGPUComputeUniformData(cmd_buf, 0, &uniforms,
+                                sizeof(LightsCullUniforms));
+  SDL_DispatchGPUCompute(compute_pass, tiles_x, tiles_y, SBI_LIGHTS_SLICES);
+  SDL_EndGPUComputePass(compute_pass);
+}
+
+void SBI_LightsBind(const SBI_Lights* lights,
+                    Uint32 first_slot,
+                    SDL_GPUCommandBuffer* cmd_buf,
+                    SDL_GPURenderPass* render_pass) {
+  SDL_GPUBuffer* buffers[3] = {
+      lights->lights_buffer,
+      lights->cluster_counts,
+      lights->cluster_lights,
+  };
+  SDL_BindGPUFragmentStorageBuffers(render_pass, first_slot, buffers, 3);
+  SDL_PushGPUFragmentUniformData(cmd_buf, 0, &lights->params,
+                                 sizeof(SBI_LightsParams));
+}
+
+void SBI_LightsDestroy(SBI_Lights* lights) {
+  if (lights->device == NULL) {
+    return;
+  }
+
+  lights_release_clusters(lights);
+  SDL_ReleaseGPUComputePipeline(lights->device, lights->cull_pipeline);
+  SDL_ReleaseGPUBuffer(lights->device, lights->lights_buffer);
+  SDL_ReleaseGPUTransferBuffer(lights->device,
+                               lights->upload_transfer_buffer);
+  SDL_aligned_free(lights->lights);
+  SDL_memset(lights, 0, sizeof(SBI_Lights));
+}
@@ -0,0 +1,86 @@
+#ifndef SBI_LIGHTS_H
+#define SBI_LIGHTS_H
+
+#include <SDL3/SDL_gpu.h>
+
+#include "view.h"
+#include "xmath.h"
+
+#define SBI_LIGHTS_MAX (4096)
+#define SBI_LIGHTS_TILE_SIZE (32)
+#define SBI_LIGHTS_SLICES (16)
+#define SBI_LIGHTS_PER_CLUSTER (128)
+#define SBI_LIGHTS_CULL_GROUP_SIZE (64)
+
+// A point light with a smooth falloff that reaches zero at its radius
+typedef struct {
+  SBI_ALIGN_VEC4 SBI_Vec4 position;  // w: radius
+  SBI_ALIGN_VEC4 SBI_Vec4 color;     // w: intensity
+} SBI_PointLight;
+
+// Parameters of the cluster grid shared by the culling pass and the lit
+// fragment shader, the layout of the fragment uniforms
+typedef struct {
+  SBI_ALIGN_VEC4 SBI_Vec4 region;        // origin in pixels, 1/tile size
+  Uint32 grid[4];                        // tiles x, tiles y, slices
+  SBI_ALIGN_VEC4 SBI_Vec4 slicing;       // scale, bias of log(depth), near
+  SBI_ALIGN_VEC4 SBI_Vec4 view_pos;      // w: ambient light
+  SBI_ALIGN_VEC4 SBI_Vec4 view_forward;  // unit vector looking forward
+} SBI_LightsParams;
+
+// Clustered point lights: a compute pass bins the lights into screen tiles
+// split in exponential depth slices, each cluster keeps up to
+// SBI_LIGHTS_PER_CLUSTER light indices and drops the rest.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUComputePipeline* cull_pipeline;
+  SDL_GPUBuffer* lights_buffer;
+  SDL_GPUBuffer* cluster_counts;
+  SDL_GPUBuffer* cluster_lights;
+  SDL_GPUTransferBuffer* upload_transfer_buffer;
+  SBI_PointLight* lights;
+  Uint32 lights_count;
+  float ambient;
+  bool dirty;
+
+  // Clusters are allocated for a view covering the whole target
+  Uint32 width;
+  Uint32 height;
+  Uint32 clusters_capacity;
+  SBI_LightsParams params;
+} SBI_Lights;
+
+// Load the culling pipeline and room for lights_count lights (at most
+// SBI_LIGHTS_MAX), every light starts black at the origin
+bool SBI_LightsLoad(SBI_Lights* lights,
+                    SDL_GPUDevice* device,
+                    Uint32 lights_count);
+
+// Flag the lights as changed, writers of lights->lights must call it
+void SBI_LightsMarkDirty(SBI_Lights* lights);
+
+// Make sure the clusters cover a target of the given size
+bool SBI_LightsPrepare(SBI_Lights* lights, Uint32 width, Uint32 height);
+
+// Upload the lights when dirty, once per frame before any pass
+void SBI_LightsUpload(SBI_Lights* lights, SDL_GPUCommandBuffer* cmd_buf);
+
+// Bin the lights into the clusters of a view in a compute pass, the region
+// is the view scissor scaled like SBI_ViewBegin. Lit sets drawn after it
+// read the clusters of that view.
+void SBI_LightsCull(SBI_Lights* lights,
+                    const SBI_View* view,
+                    float scale,
+                    SDL_GPUCommandBuffer* cmd_buf);
+
+// Bind the clusters and their parameters to the fragment stage, storage
+// buffers start at first_slot
+void SBI_LightsBind(const SBI_Lights* lights,
+                    Uint32 first_slot,
+                    SDL_GPUCommandBuffer* cmd_buf,
+                    SDL_GPURenderPass* render_pass);
+
+// Release the lights, clusters and pipeline
+void SBI_LightsDestroy(SBI_Lights* lights);
+
+#endif /* SBI_LIGHTS_H */
@@ -10,6 +10,9 @@
 #include <SDL3/SDL_main.h>
 // clang-format on
 
+#include "bench.h"
+#include "capture.h"
+#include "memtrack.h"
 #include "simulation.h"
 
 #define GAME_CALLBACK __attribute__((unused))
@@ -18,12 +21,64 @@
 #define WINDOW_HEIGHT (800)
 #define FIXED_UPDATE_TIME (0.0333333333333f)
 #define FIXED_FRAME_TIME (0.0166666666667f)
+#define WORLD_EXTENT (1000.0f)
+#define WORLD_CHUNK_SIZE (25.0f)
+#define TELEMETRY_READ_INTERVAL (1000)
+
+// Write a random world of count billboards to be streamed with --world
+static bool bake_world(const char* path, Uint64 count) {
+  SBI_Vec4* instances = SDL_aligned_alloc(16, sizeof(SBI_Vec4) * count);
+  if (instances == NULL) {
+    SDL_Log("Could not allocate memory for %ld billboards", count);
+    return false;
+  }
+
+  for (Uint64 i = 0; i < count; i++) {
+    instances[i][0] = (SDL_randf() * 2.0f - 1.0f) * WORLD_EXTENT;
+    instances[i][1] = SDL_randf() * 20.0f;
+    instances[i][2] = (SDL_randf() * 2.0f - 1.0f) * WORLD_EXTENT;
+    instances[i][3] = 0.5f;
+  }
+
+  bool result =
+      SBI_ChunkWorldBake(path, instances, count, WORLD_CHUNK_SIZE);
+  SDL_aligned_free(instances);
+  return result;
+}
 
 GAME_CALLBACK SDL_AppResult SDL_AppInit(void** appstate,
                                         int argc,
                                         char** argv) {
-  (void)argc;
-  (void)argv;
+  // Track SDL allocations from the start: --mem-track [sites]
+  for (int i = 1; i < argc; i++) {
+    if (SDL_strcmp(argv[i], "--mem-track") == 0) {
+      bool sites = i + 1 < argc && SDL_strcmp(argv[i + 1], "sites") == 0;
+      if (!SBI_MemTrackInstall(sites)) {
+        return SDL_APP_FAILURE;
+      }
+    }
+  }
+
+  // Bake a streamed world and exit: --bake-world <dir> <count>
+  if (argc >= 4 && SDL_strcmp(argv[1], "--bake-world") == 0) {
+    bool baked = bake_world(argv[2], SDL_strtoull(argv[3], NULL, 10));
+    return baked ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+  }
+
+  // Bake a streamed sprite library and exit:
+  // --bake-sprites <dir> <count> <size>
+  if (argc >= 5 && SDL_strcmp(argv[1], "--bake-sprites") == 0) {
+    bool baked = SBI_SpriteLibraryBake(argv[2], (Uint32)SDL_atoi(argv[3]),
+                                       (Uint32)SDL_atoi(argv[4]));
+    return baked ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+  }
+
+  // Print the telemetry of a running instance: --telemetry-read [count]
+  if (argc >= 2 && SDL_strcmp(argv[1], "--telemetry-read") == 0) {
+    Uint32 count = argc >= 3 ? (Uint32)SDL_atoi(argv[2]) : 0;
+    bool read = SBI_TelemetryReadLoop(TELEMETRY_READ_INTERVAL, count);
+    return read ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+  }
 
   // Initialize SDL
   if (!SDL_Init(SDL_INIT_VIDEO)) {
@@ -38,16 +93,107 @@ GAME_CALLBACK SDL_AppResult SDL_AppInit(void** appstate,
   }
   SDL_memset(state, 0, sizeof(SBI_Simulation));
 
-  // Initialize SDL-specific attributes of game state
-  state->device =
-      SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, "vulkan");
-  if (state->device == NULL) {
-    SDL_Log("Could not create GPU device: %s", SDL_GetError());
-    return SDL_APP_FAILURE;
+  state->tick_time = FIXED_UPDATE_TIME;
+  state->scene = SBI_GeneratorDefaultOptions(SBI_GENERATOR_UNIFORM);
+
+  // Parse command line options
+  const char* bench_name = NULL;
+  const char* capture_path = NULL;
+  SBI_CaptureOptions capture_options = SBI_CaptureDefaultOptions(NULL, 0);
+  for (int i = 1; i < argc; i++) {
+    if (SDL_strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+      state->world_path = argv[++i];
+    } else if (SDL_strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+      state->sprites_path = argv[++i];
+    } else if (SDL_strcmp(argv[i], "--flock") == 0 && i + 1 < argc) {
+      state->flock_count = SDL_strtoull(argv[++i], NULL, 10);
+    } else if (SDL_strcmp(argv[i], "--attached") == 0 && i + 1 < argc) {
+      state->attached_count = SDL_strtoull(argv[++i], NULL, 10);
+    } else if (SDL_strcmp(argv[i], "--sim-thread") == 0) {
+      state->threaded = true;
+    } else if (SDL_strcmp(argv[i], "--quad-view") == 0) {
+      state->views_count = MAX_VIEWS;
+    } else if (SDL_strcmp(argv[i], "--billboard-mode") == 0 && i + 1 < argc) {
+      state->billboard_mode = SDL_atoi(argv[++i]) % SBI_BILLBOARD_MODE_COUNT;
+    } else if (SDL_strcmp(argv[i], "--transparency") == 0 && i + 1 < argc) {
+      const char* blend = argv[++i];
+      if (SDL_strcmp(blend, "sorted") == 0) {
+        state->billboard_blend = SBI_BILLBOARD_BLEND_SORTED;
+      } else if (SDL_strcmp(blend, "oit") == 0) {
+        state->billboard_blend = SBI_BILLBOARD_BLEND_OIT;
+      } else {
+        state->billboard_blend = SBI_BILLBOARD_BLEND_UNSORTED;
+      }
+    } else if (SDL_strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+      state->lights_count = (Uint32)SDL_atoi(argv[++i]);
+    } else if (SDL_strcmp(argv[i], "--telemetry") == 0) {
+      state->telemetry_enabled = true;
+    } else if (SDL_strcmp(argv[i], "--occlusion") == 0) {
+      state->occlusion = true;
+    } else if (SDL_strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+      const char* scene = argv[++i];
+      if (!SBI_GeneratorParseKind(scene, &state->scene.kind)) {
+        SDL_Log("Unknown scene %s, using uniform", scene);
+      }
+    } else if (SDL_strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      state->scene.seed = SDL_strtoull(argv[++i], NULL, 10);
+    } else if (SDL_strcmp(argv[i], "--animated") == 0) {
+      state->billboard_animated = true;
+    } else if (SDL_strcmp(argv[i], "--opacity") == 0 && i + 1 < argc) {
+      state->billboard_opacity = (float)SDL_atof(argv[++i]);
+    } else if (SDL_strcmp(argv[i], "--dynamic-resolution") == 0 &&
+               i + 1 < argc) {
+      // GPU frame budget in milliseconds
+      state->resolution_budget = (float)SDL_atof(argv[++i]) / 1000.0f;
+    } else if (SDL_strcmp(argv[i], "--software") == 0) {
+      state->software = true;
+    } else if (SDL_strcmp(argv[i], "--grid-native") == 0) {
+      state->grid_native = true;
+    } else if (SDL_strcmp(argv[i], "--debug-draw") == 0) {
+      state->debug_enabled = true;
+    } else if (SDL_strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+      // Particles spawned per second
+      state->particles_rate = (float)SDL_atof(argv[++i]);
+    } else if (SDL_strcmp(argv[i], "--on-demand") == 0) {
+      state->on_demand = true;
+    } else if (SDL_strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+      bench_name = argv[++i];
+    } else if (SDL_strcmp(argv[i], "--capture") == 0 && i + 2 < argc) {
+      // Render frames offline and exit: --capture <dir> <frames>
+      capture_path = argv[++i];
+      capture_options.frames_count = (Uint32)SDL_atoi(argv[++i]);
+    } else if (SDL_strcmp(argv[i], "--capture-format") == 0 &&
+               i + 1 < argc) {
+      const char* format = argv[++i];
+      if (SDL_strcmp(format, "raw") == 0) {
+        capture_options.format = SBI_CAPTURE_RAW;
+      } else if (SDL_strcmp(format, "png") == 0) {
+        capture_options.format = SBI_CAPTURE_PNG;
+      } else {
+        capture_options.format = SBI_CAPTURE_PPM;
+      }
+    } else if (SDL_strcmp(argv[i], "--capture-encoders") == 0 &&
+               i + 1 < argc) {
+      capture_options.encoders_count = (Uint32)SDL_atoi(argv[++i]);
+    }
+  }
+
+  // Initialize SDL-specific attributes of game state, the software
+  // rasterizer presents through the window surface instead of a GPU
+  if (!state->software) {
+    state->device =
+        SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, "vulkan");
+    if (state->device == NULL) {
+      SDL_Log("Could not create GPU device: %s", SDL_GetError());
+      return SDL_APP_FAILURE;
+    }
   }
 
+  // Captures never present, the window only provides the target format
+  SDL_WindowFlags window_flags =
+      capture_path != NULL ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE;
   state->window = SDL_CreateWindow(WINDOW_TITLE, WINDOW_WIDTH, WINDOW_HEIGHT,
-                                   SDL_WINDOW_RESIZABLE);
+                                   window_flags);
   if (state->window == NULL) {
     SDL_Log("Could not create window: %s", SDL_GetError());
     return SDL_APP_FAILURE;
@@ -55,7 +201,8 @@ GAME_CALLBACK SDL_AppResult SDL_AppInit(void** appstate,
   SDL_SetWindowPosition(state->window, SDL_WINDOWPOS_CENTERED,
                         SDL_WINDOWPOS_CENTERED);
 
-  if (!SDL_ClaimWindowForGPUDevice(state->device, state->window)) {
+  if (state->device != NULL &&
+      !SDL_ClaimWindowForGPUDevice(state->device, state->window)) {
     SDL_Log("Could not claim window for GPU device: %s", SDL_GetError());
     return SDL_APP_FAILURE;
   }
@@ -69,21 +216,57 @@ GAME_CALLBACK SDL_AppResult SDL_AppInit(void** appstate,
       .max_depth = 1.0f,
   };
 
-  if (!SBI_SimulationLoad(state)) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_SIMULATION);
+  bool loaded = SBI_SimulationLoad(state);
+  SBI_MemTrackPop(tag);
+  if (!loaded) {
     SDL_Log("Could not load game state");
     return SDL_APP_FAILURE;
   }
 
   *appstate = state;
+  if (bench_name != NULL) {
+    return SBI_BenchRun(state, bench_name) ? SDL_APP_SUCCESS
+                                           : SDL_APP_FAILURE;
+  }
+  if (capture_path != NULL) {
+    capture_options.path = capture_path;
+    return SBI_CaptureRun(state, capture_options) ? SDL_APP_SUCCESS
+                                                  : SDL_APP_FAILURE;
+  }
+
   return SDL_APP_CONTINUE;
 }
 
+// Block in the event queue instead of spinning: until any event when the
+// scene is idle, until the next update or frame otherwise. The events stay
+// queued for SDL_AppEvent.
+static void wait_next_iteration(SBI_Simulation* state) {
+  if (SBI_SimulationIdle(state)) {
+    SDL_WaitEvent(NULL);
+
+    // The idle time isn't simulated, the event is handled by the next tick
+    state->last_tick = SDL_GetPerformanceCounter();
+    state->cur_update_time = FIXED_UPDATE_TIME;
+    state->cur_frame_time = FIXED_FRAME_TIME;
+    return;
+  }
+
+  float wait = SDL_min(FIXED_UPDATE_TIME - state->cur_update_time,
+                       FIXED_FRAME_TIME - state->cur_frame_time);
+  if (wait > 0.0f) {
+    SDL_WaitEventTimeout(NULL, (Sint32)(wait * 1000.0f));
+  }
+}
+
 GAME_CALLBACK SDL_AppResult SDL_AppIterate(void* appstate) {
   SBI_Simulation* state = (SBI_Simulation*)appstate;
   Uint64 current_tick = SDL_GetPerformanceCounter();
   state->iter_delta_time = (float)(current_tick - state->last_tick) /
                            (float)SDL_GetPerformanceFrequency();
   state->last_tick = current_tick;
+  SBI_MemTrackFrameBegin();
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_SIMULATION);
   {
     state->cur_update_time += state->iter_delta_time;
     state->cur_frame_time += state->iter_delta_time;
@@ -94,12 +277,22 @@ GAME_CALLBACK SDL_AppResult SDL_AppIterate(void* appstate) {
     }
 
     if (state->cur_frame_time >= FIXED_FRAME_TIME) {
-      if (!SBI_SimulationRender(state, state->cur_frame_time)) {
+      // On demand, unchanged frames are neither recorded nor presented
+      if (SBI_SimulationNeedsRender(state) &&
+          !SBI_SimulationRender(state, state->cur_frame_time)) {
+        SBI_MemTrackPop(tag);
+        SBI_MemTrackFrameEnd();
         return SDL_APP_FAILURE;
       }
       state->cur_frame_time = 0.0f;
     }
   }
+  SBI_MemTrackPop(tag);
+  SBI_MemTrackFrameEnd();
+
+  if (state->on_demand) {
+    wait_next_iteration(state);
+  }
 
   return SDL_APP_CONTINUE;
 }
@@ -123,14 +316,22 @@ GAME_CALLBACK void SDL_AppQuit(void* appstate, SDL_AppResult result) {
     SDL_Log("Application quit with error: %d", result);
   }
 
+  if (state == NULL) {
+    SBI_MemTrackReport();
+    return;
+  }
+
   SBI_SimulationDestroy(state);
   if (state->window != NULL) {
-    SDL_ReleaseWindowFromGPUDevice(state->device, state->window);
+    if (state->device != NULL) {
+      SDL_ReleaseWindowFromGPUDevice(state->device, state->window);
+      SDL_DestroyGPUDevice(state->device);
+    }
     SDL_DestroyWindow(state->window);
-    SDL_DestroyGPUDevice(state->device);
     state->window = NULL;
     state->device = NULL;
   }
 
   SDL_free(state);
+  SBI_MemTrackReport();
 }
@@ -0,0 +1,391 @@
+#include "memtrack.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#include <stdlib.h>
+#endif
+
+// Size and tag of a live block, the table is keyed by address so blocks
+// allocated before the install are told apart without a header
+typedef struct {
+  void* ptr;
+  size_t size;
+  SBI_MemTrackTag tag;
+} MemTrackSlot;
+
+typedef struct {
+  SDL_malloc_func malloc_func;
+  SDL_calloc_func calloc_func;
+  SDL_realloc_func realloc_func;
+  SDL_free_func free_func;
+  bool installed;
+  bool capture_sites;
+
+  // Guarded by lock, a spinlock as any other lock would allocate
+  SDL_SpinLock lock;
+  MemTrackSlot* slots;
+  Uint64 slots_count;
+  Uint64 used_count;
+  Uint64 live_count;
+  SBI_MemTrackStats stats;
+  SBI_MemTrackSite sites[SBI_MEMTRACK_MAX_SITES];
+  Uint32 sites_count;
+  Uint64 dropped_count;
+  bool in_frame;
+
+  // Read without the lock to skip the stack walk out of the steady state
+  SDL_AtomicInt steady;
+} MemTrack;
+
+static MemTrack memtrack;
+static _Thread_local SBI_MemTrackTag memtrack_tag = SBI_MEMTRACK_OTHER;
+
+// Marks a removed slot, never the address of an allocation
+#define MEMTRACK_TOMBSTONE ((void*)&memtrack)
+
+static const char* memtrack_tag_names[SBI_MEMTRACK_TAG_COUNT] = {
+    "other", "billboard", "shader", "grid", "simulation",
+};
+
+static Uint64 memtrack_hash(const void* ptr) {
+  return ((Uint64)(uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ull;
+}
+
+static MemTrackSlot* memtrack_find(void* ptr) {
+  Uint64 mask = memtrack.slots_count - 1;
+  for (Uint64 i = memtrack_hash(ptr) & mask;; i = (i + 1) & mask) {
+    MemTrackSlot* slot = &memtrack.slots[i];
+    if (slot->ptr == ptr) {
+      return slot;
+    }
+    if (slot->ptr == NULL) {
+      return NULL;
+    }
+  }
+}
+
+// Rehash into a table twice the live blocks, drops the tombstones. The
+// table itself comes from the original functions.
+static bool memtrack_grow(void) {
+  Uint64 slots_count = SBI_MEMTRACK_INITIAL_SLOTS;
+  while (slots_count < memtrack.live_count * 4) {
+    slots_count *= 2;
+  }
+  MemTrackSlot* slots =
+      memtrack.calloc_func(slots_count, sizeof(MemTrackSlot));
+  if (slots == NULL) {
+    return false;
+  }
+
+  Uint64 mask = slots_count - 1;
+  for (Uint64 s = 0; s < memtrack.slots_count; s++) {
+    MemTrackSlot* old = &memtrack.slots[s];
+    if (old->ptr == NULL || old->ptr == MEMTRACK_TOMBSTONE) {
+      continue;
+    }
+    Uint64 i = memtrack_hash(old->ptr) & mask;
+    while (slots[i].ptr != NULL) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = *old;
+  }
+
+  memtrack.free_func(memtrack.slots);
+  memtrack.slots = slots;
+  memtrack.slots_count = slots_count;
+  memtrack.used_count = memtrack.live_count;
+  return true;
+}
+
+static void memtrack_record_site(void* site, SBI_MemTrackTag tag, size_t size) {
+  SBI_MemTrackSite* found = NULL;
+  for (Uint32 i = 0; i < memtrack.sites_count && found == NULL; i++) {
+    SBI_MemTrackSite* entry = &memtrack.sites[i];
+    if (entry->site == site && entry->tag == tag) {
+      found = entry;
+    }
+  }
+  if (found == NULL) {
+    if (memtrack.sites_count == SBI_MEMTRACK_MAX_SITES) {
+      memtrack.dropped_count++;
+      return;
+    }
+    found = &memtrack.sites[memtrack.sites_count++];
+    *found = (SBI_MemTrackSite){
+        .site = site,
+        .tag = tag,
+        .first_frame = memtrack.stats.frames_count,
+    };
+  }
+  found->allocations_count++;
+  found->bytes += size;
+}
+
+static void memtrack_insert(void* ptr,
+                            size_t size,
+                            SBI_MemTrackTag tag,
+                            void* site) {
+  SDL_LockSpinlock(&memtrack.lock);
+  if ((memtrack.used_count + 1) * 4 > memtrack.slots_count * 3 &&
+      !memtrack_grow()) {
+    // Untracked, released through the original functions like the blocks
+    // allocated before the install
+    SDL_UnlockSpinlock(&memtrack.lock);
+    return;
+  }
+
+  Uint64 mask = memtrack.slots_count - 1;
+  Uint64 i = memtrack_hash(ptr) & mask;
+  while (memtrack.slots[i].ptr != NULL &&
+         memtrack.slots[i].ptr != MEMTRACK_TOMBSTONE) {
+    i = (i + 1) & mask;
+  }
+  memtrack.used_count += memtrack.slots[i].ptr == NULL;
+  memtrack.live_count++;
+  memtrack.slots[i] = (MemTrackSlot){.ptr = ptr, .size = size, .tag = tag};
+
+  SBI_MemTrackStats* stats = &memtrack.stats;
+  SBI_MemTrackTagStats* tag_stats = &stats->tags[tag];
+  tag_stats->allocations_count++;
+  tag_stats->live_bytes += size;
+  tag_stats->peak_bytes = SDL_max(tag_stats->peak_bytes, tag_stats->live_bytes);
+  stats->live_bytes += size;
+  stats->peak_bytes = SDL_max(stats->peak_bytes, stats->live_bytes);
+  if (memtrack.in_frame) {
+    stats->frame_allocations++;
+    if (SDL_GetAtomicInt(&memtrack.steady)) {
+      stats->steady_allocations++;
+      memtrack_record_site(site, tag, size);
+    }
+  }
+  SDL_UnlockSpinlock(&memtrack.lock);
+}
+
+// Forget a block, returns whether it was tracked
+static bool memtrack_remove(void* ptr, MemTrackSlot* removed) {
+  SDL_LockSpinlock(&memtrack.lock);
+  MemTrackSlot* slot = memtrack_find(ptr);
+  if (slot != NULL) {
+    *removed = *slot;
+    slot->ptr = MEMTRACK_TOMBSTONE;
+    memtrack.live_count--;
+
+    SBI_MemTrackTagStats* tag_stats = &memtrack.stats.tags[removed->tag];
+    tag_stats->frees_count++;
+    tag_stats->live_bytes -= removed->size;
+    memtrack.stats.live_bytes -= removed->size;
+  }
+  SDL_UnlockSpinlock(&memtrack.lock);
+  return slot != NULL;
+}
+
+// Caller of SDL_malloc, frames are this function, the hook and SDL
+#if defined(__GLIBC__)
+__attribute__((noinline)) static void* memtrack_site(void) {
+  if (!memtrack.capture_sites || !SDL_GetAtomicInt(&memtrack.steady)) {
+    return NULL;
+  }
+  void* frames[4] = {0};
+  return backtrace(frames, 4) == 4 ? frames[3] : NULL;
+}
+#else
+static void* memtrack_site(void) {
+  return NULL;
+}
+#endif
+
+static void* memtrack_malloc(size_t size) {
+  void* site = memtrack_site();
+  void* ptr = memtrack.malloc_func(size);
+  if (ptr != NULL) {
+    memtrack_insert(ptr, size, memtrack_tag, site);
+  }
+  return ptr;
+}
+
+static void* memtrack_calloc(size_t count, size_t size) {
+  void* site = memtrack_site();
+  void* ptr = memtrack.calloc_func(count, size);
+  if (ptr != NULL) {
+    memtrack_insert(ptr, count * size, memtrack_tag, site);
+  }
+  return ptr;
+}
+
+// A resized block keeps the tag it was allocated with
+static void* memtrack_realloc(void* ptr, size_t size) {
+  void* site = memtrack_site();
+  MemTrackSlot removed = {.tag = memtrack_tag};
+  bool tracked = ptr != NULL && memtrack_remove(ptr, &removed);
+  void* resized = memtrack.realloc_func(ptr, size);
+  if (resized != NULL) {
+    memtrack_insert(resized, size, removed.tag, site);
+  } else if (tracked) {
+    memtrack_insert(ptr, removed.size, removed.tag, NULL);
+  }
+  return resized;
+}
+
+static void memtrack_free(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  MemTrackSlot removed = {0};
+  memtrack_remove(ptr, &removed);
+  memtrack.free_func(ptr);
+}
+
+bool SBI_MemTrackInstall(bool capture_sites) {
+  if (memtrack.installed) {
+    return true;
+  }
+
+  SDL_GetMemoryFunctions(&memtrack.malloc_func, &memtrack.calloc_func,
+                         &memtrack.realloc_func, &memtrack.free_func);
+  memtrack.slots_count = SBI_MEMTRACK_INITIAL_SLOTS;
+  memtrack.slots =
+      memtrack.calloc_func(memtrack.slots_count, sizeof(MemTrackSlot));
+  if (memtrack.slots == NULL) {
+    SDL_Log("Could not allocate the allocation tracker table");
+    return false;
+  }
+
+#if defined(__GLIBC__)
+  // The first walk loads the unwinder, keep it out of the frame loop
+  void* frames[4] = {0};
+  backtrace(frames, 4);
+  memtrack.capture_sites = capture_sites;
+#else
+  if (capture_sites) {
+    SDL_Log("Allocation call sites need glibc, tracking without them");
+  }
+#endif
+
+  if (!SDL_SetMemoryFunctions(memtrack_malloc, memtrack_calloc,
+                              memtrack_realloc, memtrack_free)) {
+    SDL_Log("Could not install the allocation tracker: %s", SDL_GetError());
+    memtrack.free_func(memtrack.slots);
+    memtrack.slots = NULL;
+    return false;
+  }
+  memtrack.installed = true;
+  return true;
+}
+
+bool SBI_MemTrackInstalled(void) {
+  return memtrack.installed;
+}
+
+SBI_MemTrackTag SBI_MemTrackPush(SBI_MemTrackTag tag) {
+  SBI_MemTrackTag previous = memtrack_tag;
+  memtrack_tag = tag;
+  return previous;
+}
+
+void SBI_MemTrackPop(SBI_MemTrackTag previous) {
+  memtrack_tag = previous;
+}
+
+void SBI_MemTrackFrameBegin(void) {
+  if (!memtrack.installed) {
+    return;
+  }
+  SDL_LockSpinlock(&memtrack.lock);
+  memtrack.stats.frame_allocations = 0;
+  memtrack.in_frame = true;
+  SDL_SetAtomicInt(&memtrack.steady, memtrack.stats.frames_count >=
+                                         SBI_MEMTRACK_WARMUP_FRAMES);
+  SDL_UnlockSpinlock(&memtrack.lock);
+}
+
+void SBI_MemTrackFrameEnd(void) {
+  if (!memtrack.installed) {
+    return;
+  }
+  SDL_LockSpinlock(&memtrack.lock);
+  SBI_MemTrackStats* stats = &memtrack.stats;
+  memtrack.in_frame = false;
+  SDL_SetAtomicInt(&memtrack.steady, 0);
+  stats->max_frame_allocations =
+      SDL_max(stats->max_frame_allocations, stats->frame_allocations);
+  stats->frames_count++;
+  SDL_UnlockSpinlock(&memtrack.lock);
+}
+
+void SBI_MemTrackGetStats(SBI_MemTrackStats* stats) {
+  SDL_LockSpinlock(&memtrack.lock);
+  *stats = memtrack.stats;
+  SDL_UnlockSpinlock(&memtrack.lock);
+}
+
+void SBI_MemTrackReport(void) {
+  if (!memtrack.installed) {
+    return;
+  }
+
+  // Copied out of the lock, logging allocates
+  SBI_MemTrackStats stats = {0};
+  SBI_MemTrackSite sites[SBI_MEMTRACK_MAX_SITES] = {0};
+  SDL_LockSpinlock(&memtrack.lock);
+  stats = memtrack.stats;
+  Uint32 sites_count = memtrack.sites_count;
+  Uint64 dropped_count = memtrack.dropped_count;
+  SDL_memcpy(sites, memtrack.sites, sizeof(SBI_MemTrackSite) * sites_count);
+  SDL_UnlockSpinlock(&memtrack.lock);
+
+  SDL_Log("Allocations: %" SDL_PRIu64 " bytes live, %" SDL_PRIu64
+          " bytes peak, %" SDL_PRIu64 " frames, at most %d per frame",
+          stats.live_bytes, stats.peak_bytes, stats.frames_count,
+          stats.max_frame_allocations);
+  for (Uint32 t = 0; t < SBI_MEMTRACK_TAG_COUNT; t++) {
+    const SBI_MemTrackTagStats* tag = &stats.tags[t];
+    SDL_Log("  %-10s %12" SDL_PRIu64 " live %12" SDL_PRIu64
+            " peak %10" SDL_PRIu64 " allocs %10" SDL_PRIu64 " frees",
+            memtrack_tag_names[t], tag->live_bytes, tag->peak_bytes,
+            tag->allocations_count, tag->frees_count);
+  }
+
+  if (stats.steady_allocations == 0) {
+    SDL_Log("No allocation in the steady state frame loop (after %d frames)",
+            SBI_MEMTRACK_WARMUP_FRAMES);
+    return;
+  }
+
+  SDL_Log("WARNING: %" SDL_PRIu64 " allocations in the steady state frame "
+          "loop (after %d frames)",
+          stats.steady_allocations, SBI_MEMTRACK_WARMUP_FRAMES);
+  char** symbols = NULL;
+#if defined(__GLIBC__)
+  void* addresses[SBI_MEMTRACK_MAX_SITES] = {0};
+  for (Uint32 i = 0; i < sites_count; i++) {
+    addresses[i] = sites[i].site;
+  }
+  if (memtrack.capture_sites && sites_count > 0) {
+    symbols = backtrace_symbols(addresses, (int)sites_count);
+  }
+#endif
+  for (Uint32 i = 0; i < sites_count; i++) {
+    const SBI_MemTrackSite* site = &sites[i];
+    const char* name = symbols != NULL ? symbols[i] : "unknown site";
+    SDL_Log("  %-10s %10" SDL_PRIu64 " allocs %12" SDL_PRIu64
+            " bytes from frame %" SDL_PRIu64 " at %s",
+            memtrack_tag_names[site->tag], site->allocations_count,
+            site->bytes, site->first_frame, name);
+  }
+  if (dropped_count > 0) {
+    SDL_Log("  %" SDL_PRIu64 " allocations from more than %d sites",
+            dropped_count, SBI_MEMTRACK_MAX_SITES);
+  }
+#if defined(__GLIBC__)
+  // backtrace_symbols allocates with the C library, not through SDL
+  free(symbols);
+#endif
+}
+
+const char* SBI_MemTrackTagName(SBI_MemTrackTag tag) {
+  return tag < SBI_MEMTRACK_TAG_COUNT ? memtrack_tag_names[tag] : "unknown";
+}
@@ -0,0 +1,74 @@
+#ifndef SBI_MEMTRACK_H
+#define SBI_MEMTRACK_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#define SBI_MEMTRACK_WARMUP_FRAMES (120)
+#define SBI_MEMTRACK_MAX_SITES (64)
+#define SBI_MEMTRACK_INITIAL_SLOTS (4096)
+
+// Subsystem charged with the allocations of a thread, set by
+// SBI_MemTrackPush around its entry points
+typedef enum {
+  SBI_MEMTRACK_OTHER,
+  SBI_MEMTRACK_BILLBOARD,
+  SBI_MEMTRACK_SHADER,
+  SBI_MEMTRACK_GRID,
+  SBI_MEMTRACK_SIMULATION,
+  SBI_MEMTRACK_TAG_COUNT,
+} SBI_MemTrackTag;
+
+typedef struct {
+  Uint64 live_bytes;
+  Uint64 peak_bytes;
+  Uint64 allocations_count;
+  Uint64 frees_count;
+} SBI_MemTrackTagStats;
+
+// An allocation site seen in the steady state frame loop, the site is the
+// caller of SDL_malloc when call sites are captured and NULL otherwise
+typedef struct {
+  void* site;
+  SBI_MemTrackTag tag;
+  Uint64 allocations_count;
+  Uint64 bytes;
+  Uint64 first_frame;
+} SBI_MemTrackSite;
+
+typedef struct {
+  SBI_MemTrackTagStats tags[SBI_MEMTRACK_TAG_COUNT];
+  Uint64 live_bytes;
+  Uint64 peak_bytes;
+  Uint64 frames_count;
+  Uint32 frame_allocations;
+  Uint32 max_frame_allocations;
+  Uint64 steady_allocations;
+} SBI_MemTrackStats;
+
+// Route every SDL allocation through the tracker, before SDL_Init. Blocks
+// allocated before are released through the original functions, unseen.
+// Call sites cost a stack walk per allocation and need glibc.
+bool SBI_MemTrackInstall(bool capture_sites);
+
+// Whether the tracker is installed
+bool SBI_MemTrackInstalled(void);
+
+// Charge the allocations of the calling thread to tag, returns the tag to
+// restore with SBI_MemTrackPop
+SBI_MemTrackTag SBI_MemTrackPush(SBI_MemTrackTag tag);
+void SBI_MemTrackPop(SBI_MemTrackTag previous);
+
+// Bracket an iteration of the frame loop, allocations of any thread in
+// between count for the frame. After SBI_MEMTRACK_WARMUP_FRAMES frames
+// they are recorded as steady state allocations.
+void SBI_MemTrackFrameBegin(void);
+void SBI_MemTrackFrameEnd(void);
+
+void SBI_MemTrackGetStats(SBI_MemTrackStats* stats);
+
+// Log the counters of every tag and the steady state allocation sites
+void SBI_MemTrackReport(void);
+
+const char* SBI_MemTrackTagName(SBI_MemTrackTag tag);
+
+#endif /* SBI_MEMTRACK_H */
@@ -0,0 +1,180 @@
+#include "oit.h"
+#include "shader.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+
+static void oit_release_targets(SBI_OIT* oit);
+
+bool SBI_OITLoad(SBI_OIT* oit, SDL_GPUDevice* device, SDL_Window* window) {
+  oit->device = device;
+  SBI_ShaderOptions vert_options = (SBI_ShaderOptions){
+      .filename = "oit_resolve.vert",
+      .stage = SDL_GPU_SHADERSTAGE_VERTEX,
+      .sampler_count = 0,
+      .uniform_buffer_count = 0,
+      .storage_buffer_count = 0,
+      .storage_texture_count = 0,
+  };
+  SDL_GPUShader* vert_shader = SBI_ShaderLoad(device, vert_options);
+  if (vert_shader == NULL) {
+    return false;
+  }
+
+  SBI_ShaderOptions frag_options = (SBI_ShaderOptions){
+      .filename = "oit_resolve.frag",
+      .stage = SDL_GPU_SHADERSTAGE_FRAGMENT,
+      .sampler_count = 2,
+      .uniform_buffer_count = 0,
+      .storage_buffer_count = 0,
+      .storage_texture_count = 0,
+  };
+  SDL_GPUShader* frag_shader = SBI_ShaderLoad(device, frag_options);
+  if (frag_shader == NULL) {
+    return false;
+  }
+
+  SDL_GPUGraphicsPipelineTargetInfo color_target_info = {
+      .num_color_targets = 1,
+      .color_target_descriptions = (SDL_GPUColorTargetDescription[]){{
+          .format = SDL_GetGPUSwapchainTextureFormat(device, window),
+          .blend_state =
+              (SDL_GPUColorTargetBlendState){
+                  .enable_blend = true,
+                  .src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
+                  .dst_color_blendfactor =
+                      SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                  .color_blend_op = SDL_GPU_BLENDOP_ADD,
+                  .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+                  .dst_alpha_blendfactor =
+                      SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                  .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+              },
+      }},
+  };
+
+  SDL_GPUGraphicsPipelineCreateInfo pipeline_create_info = {
+      .target_info = color_target_info,
+      .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+      .vertex_shader = vert_shader,
+      .fragment_shader = frag_shader,
+  };
+  oit->resolve_pipeline =
+      SDL_CreateGPUGraphicsPipeline(device, &pipeline_create_info);
+
+  SDL_ReleaseGPUShader(device, vert_shader);
+  SDL_ReleaseGPUShader(device, frag_shader);
+
+  if (oit->resolve_pipeline == NULL) {
+    SDL_Log("Couldn't create graphics pipeline for OIT resolve");
+    return false;
+  }
+
+  SDL_GPUSamplerCreateInfo sampler_create_info = {
+      .min_filter = SDL_GPU_FILTER_NEAREST,
+      .mag_filter = SDL_GPU_FILTER_NEAREST,
+      .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST,
+      .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+      .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+  };
+  oit->sampler = SDL_CreateGPUSampler(device, &sampler_create_info);
+  if (oit->sampler == NULL) {
+    SDL_Log("Couldn't create sampler for OIT resolve");
+    return false;
+  }
+
+  return true;
+}
+
+bool SBI_OITPrepare(SBI_OIT* oit, Uint32 width, Uint32 height) {
+  if (oit->accum != NULL && oit->width == width && oit->height == height) {
+    return true;
+  }
+
+  oit_release_targets(oit);
+
+  SDL_GPUTextureCreateInfo accum_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SBI_OIT_ACCUM_FORMAT,
+      .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  SDL_GPUTextureCreateInfo reveal_create_info = accum_create_info;
+  reveal_create_info.format = SBI_OIT_REVEAL_FORMAT;
+
+  oit->accum = SDL_CreateGPUTexture(oit->device, &accum_create_info);
+  oit->reveal = SDL_CreateGPUTexture(oit->device, &reveal_create_info);
+  if (oit->accum == NULL || oit->reveal == NULL) {
+    SDL_Log("Couldn't create OIT targets: %s", SDL_GetError());
+    oit_release_targets(oit);
+    return false;
+  }
+
+  oit->width = width;
+  oit->height = height;
+  return true;
+}
+
+SDL_GPURenderPass* SBI_OITBeginAccumulation(SBI_OIT* oit,
+                                            SDL_GPUCommandBuffer* cmd_buf) {
+  SDL_GPUColorTargetInfo color_target_infos[2] = {
+      {
+          .texture = oit->accum,
+          .clear_color = (SDL_FColor){0.0f, 0.0f, 0.0f, 0.0f},
+          .load_op = SDL_GPU_LOADOP_CLEAR,
+          .store_op = SDL_GPU_STOREOP_STORE,
+      },
+      {
+          .texture = oit->reveal,
+          .clear_color = (SDL_FColor){1.0f, 1.0f, 1.0f, 1.0f},
+          .load_op = SDL_GPU_LOADOP_CLEAR,
+          .store_op = SDL_GPU_STOREOP_STORE,
+      },
+  };
+
+  return SDL_BeginGPURenderPass(cmd_buf, color_target_infos, 2, NULL);
+}
+
+void SBI_OITResolve(SBI_OIT* oit, SDL_GPURenderPass* render_pass) {
+  SDL_GPUTextureSamplerBinding bindings[2] = {
+      {.texture = oit->accum, .sampler = oit->sampler},
+      {.texture = oit->reveal, .sampler = oit->sampler},
+  };
+
+  SDL_BindGPUGraphicsPipeline(render_pass, oit->resolve_pipeline);
+  SDL_BindGPUFragmentSamplers(render_pass, 0, bindings, 2);
+  SDL_DrawGPUPrimitives(render_pass, 3, 1, 0, 0);
+}
+
+void SBI_OITDestroy(SBI_OIT* oit) {
+  oit_release_targets(oit);
+  if (oit->sampler != NULL) {
+    SDL_ReleaseGPUSampler(oit->device, oit->sampler);
+    oit->sampler = NULL;
+  }
+
+  if (oit->resolve_pipeline != NULL) {
+    SDL_ReleaseGPUGraphicsPipeline(oit->device, oit->resolve_pipeline);
+    oit->resolve_pipeline = NULL;
+  }
+}
+
+static void oit_release_targets(SBI_OIT* oit) {
+  if (oit->accum != NULL) {
+    SDL_ReleaseGPUTexture(oit->device, oit->accum);
+    oit->accum = NULL;
+  }
+
+  if (oit->reveal != NULL) {
+    SDL_ReleaseGPUTexture(oit->device, oit->reveal);
+    oit->reveal = NULL;
+  }
+
+  oit->width = 0;
+  oit->height = 0;
+}
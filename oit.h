@@ -0,0 +1,38 @@
+#ifndef SBI_OIT_H
+#define SBI_OIT_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_video.h>
+
+#define SBI_OIT_ACCUM_FORMAT SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT
+#define SBI_OIT_REVEAL_FORMAT SDL_GPU_TEXTUREFORMAT_R16_FLOAT
+
+// Weighted blended order-independent transparency: an accumulation and a
+// revealage target filled in one unsorted pass and resolved over the scene.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUGraphicsPipeline* resolve_pipeline;
+  SDL_GPUSampler* sampler;
+  SDL_GPUTexture* accum;
+  SDL_GPUTexture* reveal;
+  Uint32 width;
+  Uint32 height;
+} SBI_OIT;
+
+// Load the resolve pipeline, targets are created on the first prepare
+bool SBI_OITLoad(SBI_OIT* oit, SDL_GPUDevice* device, SDL_Window* window);
+
+// Make sure the targets match the size of the scene target
+bool SBI_OITPrepare(SBI_OIT* oit, Uint32 width, Uint32 height);
+
+// Begin the accumulation pass with cleared targets
+SDL_GPURenderPass* SBI_OITBeginAccumulation(SBI_OIT* oit,
+                                            SDL_GPUCommandBuffer* cmd_buf);
+
+// Composite the accumulated transparency over the scene render pass
+void SBI_OITResolve(SBI_OIT* oit, SDL_GPURenderPass* render_pass);
+
+// Release the targets and the resolve pipeline
+void SBI_OITDestroy(SBI_OIT* oit);
+
+#endif /* SBI_OIT_H */
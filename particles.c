@@ -0,0 +1,407 @@
+#include "particles.h"
+#include "billboard.h"
+#include "shader.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+// Bytes of the Particle struct of the shaders
+#define PARTICLES_PARTICLE_SIZE (48)
+
+typedef struct {
+  Uint32 counts[4];
+} ParticlesKickoffUniforms;
+
+typedef struct {
+  SBI_ALIGN_VEC4 SBI_Vec4 position_radius;
+  SBI_ALIGN_VEC4 SBI_Vec4 velocity_spread;
+  SBI_ALIGN_VEC4 SBI_Vec4 life_scale;
+  Uint32 spawns[4];
+} ParticlesEmitterUniforms;
+
+typedef struct {
+  Uint32 counts[4];
+  ParticlesEmitterUniforms emitters[SBI_PARTICLES_MAX_EMITTERS];
+} ParticlesEmitUniforms;
+
+typedef struct {
+  SBI_ALIGN_VEC4 SBI_Vec4 time;
+  Uint32 counts[4];
+} ParticlesSimulateUniforms;
+
+static bool particles_load_pipelines(SBI_Particles* particles) {
+  SBI_ComputeOptions kickoff_options = (SBI_ComputeOptions){
+      .filename = "particles_kickoff.comp",
+      .readwrite_storage_buffer_count = 2,
+      .uniform_buffer_count = 1,
+      .threadcount_x = 1,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  SBI_ComputeOptions emit_options = (SBI_ComputeOptions){
+      .filename = "particles_emit.comp",
+      .readwrite_storage_buffer_count = 3,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_PARTICLES_GROUP_SIZE,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  SBI_ComputeOptions simulate_options = (SBI_ComputeOptions){
+      .filename = "particles_simulate.comp",
+      .readwrite_storage_buffer_count = 7,
+      .uniform_buffer_count = 1,
+      .threadcount_x = SBI_PARTICLES_GROUP_SIZE,
+      .threadcount_y = 1,
+      .threadcount_z = 1,
+  };
+  particles->kickoff_pipeline =
+      SBI_ComputePipelineLoad(particles->device, kickoff_options);
+  particles->emit_pipeline =
+      SBI_ComputePipelineLoad(particles->device, emit_options);
+  particles->simulate_pipeline =
+      SBI_ComputePipelineLoad(particles->device, simulate_options);
+  if (particles->kickoff_pipeline == NULL ||
+      particles->emit_pipeline == NULL ||
+      particles->simulate_pipeline == NULL) {
+    SDL_Log("Couldn't create compute pipelines for particles");
+    return false;
+  }
+  return true;
+}
+
+static SDL_GPUBuffer* particles_create_buffer(SDL_GPUDevice* device,
+                                              SDL_GPUBufferUsageFlags usage,
+                                              Uint32 size) {
+  SDL_GPUBufferCreateInfo buffer_create_info = {
+      .usage = usage | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = size,
+  };
+  return SDL_CreateGPUBuffer(device, &buffer_create_info);
+}
+
+// Every particle starts dead and every index free
+static bool particles_upload_initial(SBI_Particles* particles) {
+  Uint32 particles_size = PARTICLES_PARTICLE_SIZE * particles->capacity;
+  Uint32 free_list_size = sizeof(Uint32) * particles->capacity;
+  Uint32 args_offset = particles_size + free_list_size;
+  Uint32 counters_offset = args_offset + sizeof(SBI_ParticlesArgs);
+  SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = counters_offset + sizeof(SBI_ParticlesCounters),
+  };
+  SDL_GPUTransferBuffer* transfer_buffer =
+      SDL_CreateGPUTransferBuffer(particles->device, &transfer_create_info);
+  if (transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of particles");
+    return false;
+  }
+
+  Uint8* transfer_point =
+      SDL_MapGPUTransferBuffer(particles->device, transfer_buffer, false);
+  SDL_memset(transfer_point, 0, particles_size);
+  Uint32* free_list = (Uint32*)(transfer_point + particles_size);
+  for (Uint32 i = 0; i < particles->capacity; i++) {
+    free_list[i] = i;
+  }
+  SBI_ParticlesArgs args = {
+      .draw = {.num_indices = 6},
+      .emit_dispatch = {.groupcount_x = 0, .groupcount_y = 1,
+                        .groupcount_z = 1},
+  };
+  SBI_ParticlesCounters counters = {
+      .free_count = particles->capacity,
+  };
+  SDL_memcpy(transfer_point + args_offset, &args, sizeof(args));
+  SDL_memcpy(transfer_point + counters_offset, &counters, sizeof(counters));
+  SDL_UnmapGPUTransferBuffer(particles->device, transfer_buffer);
+
+  struct {
+    SDL_GPUBuffer* buffer;
+    Uint32 offset;
+    Uint32 size;
+  } regions[] = {
+      {particles->particles, 0, particles_size},
+      {particles->free_list, particles_size, free_list_size},
+      {particles->args, args_offset, sizeof(SBI_ParticlesArgs)},
+      {particles->counters, counters_offset, sizeof(SBI_ParticlesCounters)},
+  };
+
+  SDL_GPUCommandBuffer* upload_cmd_buf =
+      SDL_AcquireGPUCommandBuffer(particles->device);
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buf);
+  for (Uint32 i = 0; i < SDL_arraysize(regions); i++) {
+    SDL_GPUTransferBufferLocation source = {
+        .transfer_buffer = transfer_buffer,
+        .offset = regions[i].offset,
+    };
+    SDL_GPUBufferRegion destination = {
+        .buffer = regions[i].buffer,
+        .offset = 0,
+        .size = regions[i].size,
+    };
+    SDL_UploadToGPUBuffer(copy_pass, &source, &destination, false);
+  }
+  SDL_EndGPUCopyPass(copy_pass);
+  SDL_SubmitGPUCommandBuffer(upload_cmd_buf);
+
+  // Released once the upload completes
+  SDL_ReleaseGPUTransferBuffer(particles->device, transfer_buffer);
+  return true;
+}
+
+bool SBI_ParticlesLoad(SBI_Particles* particles,
+                       SDL_GPUDevice* device,
+                       Uint32 capacity) {
+  particles->device = device;
+  particles->capacity = SDL_max(capacity, 1);
+  if (!particles_load_pipelines(particles)) {
+    return false;
+  }
+
+  Uint32 count = particles->capacity;
+  SDL_GPUBufferUsageFlags drawn = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+  particles->particles =
+      particles_create_buffer(device, 0, PARTICLES_PARTICLE_SIZE * count);
+  particles->free_list =
+      particles_create_buffer(device, 0, sizeof(Uint32) * count);
+  particles->alive =
+      particles_create_buffer(device, drawn, sizeof(Uint32) * count);
+  particles->instances =
+      particles_create_buffer(device, drawn, sizeof(SBI_Vec4) * count);
+  particles->colors =
+      particles_create_buffer(device, drawn, sizeof(Uint32) * count);
+  particles->args = particles_create_buffer(
+      device, SDL_GPU_BUFFERUSAGE_INDIRECT, sizeof(SBI_ParticlesArgs));
+  particles->counters =
+      particles_create_buffer(device, 0, sizeof(SBI_ParticlesCounters));
+  if (particles->particles == NULL || particles->free_list == NULL ||
+      particles->alive == NULL || particles->instances == NULL ||
+      particles->colors == NULL || particles->args == NULL ||
+      particles->counters == NULL) {
+    SDL_Log("Couldn't create buffers for %d particles: %s", count,
+            SDL_GetError());
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo stats_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+      .size = sizeof(SBI_ParticlesArgs) + sizeof(SBI_ParticlesCounters),
+  };
+  particles->stats_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &stats_create_info);
+  if (particles->stats_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of particle stats");
+    return false;
+  }
+
+  return particles_upload_initial(particles);
+}
+
+Uint32 SBI_ParticlesAddEmitter(SBI_Particles* particles,
+                               const SBI_ParticleEmitter* emitter) {
+  if (particles->emitters_count == SBI_PARTICLES_MAX_EMITTERS) {
+    return SBI_PARTICLES_NO_EMITTER;
+  }
+
+  Uint32 index = particles->emitters_count++;
+  particles->emitters[index] = *emitter;
+  particles->accumulators[index] = 0.0f;
+  particles->bursts[index] = 0;
+  return index;
+}
+
+void SBI_ParticlesSetEmitter(SBI_Particles* particles,
+                             Uint32 emitter,
+                             const SBI_ParticleEmitter* params) {
+  if (emitter < particles->emitters_count) {
+    particles->emitters[emitter] = *params;
+  }
+}
+
+void SBI_ParticlesBurst(SBI_Particles* particles,
+                        Uint32 emitter,
+                        Uint32 count) {
+  if (emitter < particles->emitters_count) {
+    particles->bursts[emitter] += count;
+  }
+}
+
+void SBI_ParticlesUpdate(SBI_Particles* particles,
+                         float dt,
+                         SDL_GPUCommandBuffer* cmd_buf) {
+  // Rates accumulate the fractions of a particle between frames, the
+  // emitters take consecutive spawns of the frame
+  ParticlesEmitUniforms emit = {0};
+  Uint32 spawns_count = 0;
+  for (Uint32 e = 0; e < particles->emitters_count; e++) {
+    const SBI_ParticleEmitter* emitter = &particles->emitters[e];
+    particles->accumulators[e] += emitter->rate * dt;
+    Uint32 count = (Uint32)particles->accumulators[e];
+    particles->accumulators[e] -= (float)count;
+    count = SDL_min(count + particles->bursts[e],
+                    particles->capacity - spawns_count);
+    particles->bursts[e] = 0;
+
+    ParticlesEmitterUniforms* uniforms = &emit.emitters[e];
+    SBI_Vec3Copy(emitter->position, uniforms->position_radius);
+    uniforms->position_radius[3] = emitter->radius;
+    SBI_Vec3Copy(emitter->velocity, uniforms->velocity_spread);
+    uniforms->velocity_spread[3] = emitter->spread;
+
+    // A spawned particle must reach age >= life to return its index, the
+    // simulation skips lives <= 0 as dead slots
+    float life_min = SDL_max(emitter->life_min, SBI_PARTICLES_MIN_LIFE);
+    uniforms->life_scale[0] = life_min;
+    uniforms->life_scale[1] = SDL_max(emitter->life_max, life_min);
+    uniforms->life_scale[2] = emitter->scale;
+    uniforms->life_scale[3] = emitter->gravity;
+    uniforms->spawns[0] = spawns_count;
+    uniforms->spawns[1] = count;
+    uniforms->spawns[2] = emitter->color;
+    spawns_count += count;
+  }
+  emit.counts[0] = particles->emitters_count;
+  emit.counts[1] = particles->frame++;
+  particles->spawned_count += spawns_count;
+
+  // Kickoff: clamp the spawns to the free list, size the emit dispatch
+  ParticlesKickoffUniforms kickoff = {.counts = {spawns_count, 0, 0, 0}};
+  SDL_GPUStorageBufferReadWriteBinding kickoff_bindings[2] = {
+      {.buffer = particles->args},
+      {.buffer = particles->counters},
+  };
+  SDL_GPUComputePass* compute_pass =
+      SDL_BeginGPUComputePass(cmd_buf, NULL, 0, kickoff_bindings, 2);
+  SDL_BindGPUComputePipeline(compute_pass, particles->kickoff_pipeline);
+  SDL_PushGPUComputeUniformData(cmd_buf, 0, &kickoff,
+                                sizeof(ParticlesKickoffUniforms));
+  SDL_DispatchGPUCompute(compute_pass, 1, 1, 1);
+  SDL_EndGPUComputePass(compute_pass);
+
+  // Emit: one thread per spawn that found a free index
+  SDL_GPUStorageBufferReadWriteBinding emit_bindings[3] = {
+      {.buffer = particles->counters},
+      {.buffer = particles->particles},
+      {.buffer = particles->free_list},
+  };
+  compute_pass = SDL_BeginGPUComputePass(cmd_buf, NULL, 0, emit_bindings, 3);
+  SDL_BindGPUComputePipeline(compute_pass, particles->emit_pipeline);
+  SDL_PushGPUComputeUniformData(cmd_buf, 0, &emit,
+                                sizeof(ParticlesEmitUniforms));
+  SDL_DispatchGPUComputeIndirect(compute_pass, particles->args,
+                                 offsetof(SBI_ParticlesArgs, emit_dispatch));
+  SDL_EndGPUComputePass(compute_pass);
+
+  // Simulate: age every slot, free the expired and list the alive
+  ParticlesSimulateUniforms simulate = {
+      .time = {dt, 0.0f, 0.0f, 0.0f},
+      .counts = {particles->capacity, 0, 0, 0},
+  };
+  SDL_GPUStorageBufferReadWriteBinding simulate_bindings[7] = {
+      {.buffer = particles->args},      {.buffer = particles->counters},
+      {.buffer = particles->particles}, {.buffer = particles->free_list},
+      {.buffer = particles->alive},     {.buffer = particles->instances},
+      {.buffer = particles->colors},
+  };
+  Uint32 groups = (particles->capacity + SBI_PARTICLES_GROUP_SIZE - 1) /
+                  SBI_PARTICLES_GROUP_SIZE;
+  compute_pass =
+      SDL_BeginGPUComputePass(cmd_buf, NULL, 0, simulate_bindings, 7);
+  SDL_BindGPUComputePipeline(compute_pass, particles->simulate_pipeline);
+  SDL_PushGPUComputeUniformData(cmd_buf, 0, &simulate,
+                                sizeof(ParticlesSimulateUniforms));
+  SDL_DispatchGPUCompute(compute_pass, groups, 1, 1);
+  SDL_EndGPUComputePass(compute_pass);
+}
+
+void SBI_ParticlesDraw(SBI_Particles* particles,
+                       SBI_Billboard* billboard,
+                       const SBI_Mat4 proj,
+                       const SBI_Mat4 view,
+                       const SBI_Vec3 view_pos,
+                       SDL_GPUCommandBuffer* cmd_buf,
+                       SDL_GPURenderPass* render_pass) {
+  SBI_BillboardDrawBufferIndirect(billboard, particles->instances,
+                                  particles->colors, particles->alive,
+                                  particles->args,
+                                  offsetof(SBI_ParticlesArgs, draw), proj,
+                                  view, view_pos, cmd_buf, render_pass);
+}
+
+bool SBI_ParticlesReadStats(SBI_Particles* particles,
+                            SBI_ParticlesStats* stats) {
+  SDL_GPUCommandBuffer* cmd_buf =
+      SDL_AcquireGPUCommandBuffer(particles->device);
+  if (cmd_buf == NULL) {
+    SDL_Log("Could not acquire GPU command buffer: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+  SDL_GPUBufferRegion args_source = {
+      .buffer = particles->args,
+      .offset = 0,
+      .size = sizeof(SBI_ParticlesArgs),
+  };
+  SDL_GPUBufferRegion counters_source = {
+      .buffer = particles->counters,
+      .offset = 0,
+      .size = sizeof(SBI_ParticlesCounters),
+  };
+  SDL_GPUTransferBufferLocation args_destination = {
+      .transfer_buffer = particles->stats_transfer_buffer,
+      .offset = 0,
+  };
+  SDL_GPUTransferBufferLocation counters_destination = {
+      .transfer_buffer = particles->stats_transfer_buffer,
+      .offset = sizeof(SBI_ParticlesArgs),
+  };
+  SDL_DownloadFromGPUBuffer(copy_pass, &args_source, &args_destination);
+  SDL_DownloadFromGPUBuffer(copy_pass, &counters_source,
+                            &counters_destination);
+  SDL_EndGPUCopyPass(copy_pass);
+
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
+  SDL_WaitForGPUFences(particles->device, true, &fence, 1);
+  SDL_ReleaseGPUFence(particles->device, fence);
+
+  const Uint8* data = SDL_MapGPUTransferBuffer(
+      particles->device, particles->stats_transfer_buffer, false);
+  SBI_ParticlesArgs args = {0};
+  SBI_ParticlesCounters counters = {0};
+  SDL_memcpy(&args, data, sizeof(args));
+  SDL_memcpy(&counters, data + sizeof(args), sizeof(counters));
+  SDL_UnmapGPUTransferBuffer(particles->device,
+                             particles->stats_transfer_buffer);
+
+  *stats = (SBI_ParticlesStats){
+      .capacity = particles->capacity,
+      .alive = args.draw.num_instances,
+      .free = counters.free_count,
+  };
+  return true;
+}
+
+void SBI_ParticlesDestroy(SBI_Particles* particles) {
+  if (particles->device == NULL) {
+    return;
+  }
+
+  SDL_ReleaseGPUComputePipeline(particles->device, particles->kickoff_pipeline);
+  SDL_ReleaseGPUComputePipeline(particles->device, particles->emit_pipeline);
+  SDL_ReleaseGPUComputePipeline(particles->device,
+                                particles->simulate_pipeline);
+  SDL_ReleaseGPUBuffer(particles->device, particles->particles);
+  SDL_ReleaseGPUBuffer(particles->device, particles->free_list);
+  SDL_ReleaseGPUBuffer(particles->device, particles->alive);
+  SDL_ReleaseGPUBuffer(particles->device, particles->instances);
+  SDL_ReleaseGPUBuffer(particles->device, particles->colors);
+  SDL_ReleaseGPUBuffer(particles->device, particles->args);
+  SDL_ReleaseGPUBuffer(particles->device, particles->counters);
+  SDL_ReleaseGPUTransferBuffer(particles->device,
+                               particles->stats_transfer_buffer);
+  SDL_memset(particles, 0, sizeof(SBI_Particles));
+}
@@ -0,0 +1,119 @@
+#ifndef SBI_PARTICLES_H
+#define SBI_PARTICLES_H
+
+#include <SDL3/SDL_gpu.h>
+
+#include "billboard.h"
+#include "xmath.h"
+
+#define SBI_PARTICLES_MAX_EMITTERS (16)
+#define SBI_PARTICLES_GROUP_SIZE (64)
+#define SBI_PARTICLES_NO_EMITTER (0xFFFFFFFFu)
+#define SBI_PARTICLES_MIN_LIFE (1e-4f)
+
+// Spawn parameters of an emitter: particles start in a sphere of radius
+// around position with velocity plus a random vector of length spread,
+// live between life_min and life_max seconds (at least
+// SBI_PARTICLES_MIN_LIFE) and fall with gravity
+typedef struct {
+  SBI_ALIGN_VEC3 SBI_Vec3 position;
+  float radius;
+  SBI_ALIGN_VEC3 SBI_Vec3 velocity;
+  float spread;
+  float rate;
+  float life_min;
+  float life_max;
+  float scale;
+  float gravity;
+  Uint32 color;
+} SBI_ParticleEmitter;
+
+// Written by the compute passes: the indexed indirect draw of the alive
+// list and the indirect dispatch of the emit pass
+typedef struct {
+  SDL_GPUIndexedIndirectDrawCommand draw;
+  SDL_GPUIndirectDispatchCommand emit_dispatch;
+} SBI_ParticlesArgs;
+
+// Kept apart from the arguments, the emit pass changes them while its
+// dispatch reads the arguments
+typedef struct {
+  Uint32 free_count;
+  Uint32 emit_count;
+  Uint32 padding[2];
+} SBI_ParticlesCounters;
+
+typedef struct {
+  Uint32 capacity;
+  Uint32 alive;
+  Uint32 free;
+} SBI_ParticlesStats;
+
+// Short lived billboards that live on the GPU. Every frame a compute pass
+// takes the spawns of the emitters from a free index list, another ages
+// every particle, gives the expired ones back to the free list and appends
+// the others to the alive list drawn with the billboard pipeline. The CPU
+// only sends the emitter parameters and spawn counts.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUComputePipeline* kickoff_pipeline;
+  SDL_GPUComputePipeline* emit_pipeline;
+  SDL_GPUComputePipeline* simulate_pipeline;
+  SDL_GPUBuffer* particles;
+  SDL_GPUBuffer* free_list;
+  SDL_GPUBuffer* alive;
+  SDL_GPUBuffer* instances;
+  SDL_GPUBuffer* colors;
+  SDL_GPUBuffer* args;
+  SDL_GPUBuffer* counters;
+  SDL_GPUTransferBuffer* stats_transfer_buffer;
+  Uint32 capacity;
+
+  SBI_ParticleEmitter emitters[SBI_PARTICLES_MAX_EMITTERS];
+  float accumulators[SBI_PARTICLES_MAX_EMITTERS];
+  Uint32 bursts[SBI_PARTICLES_MAX_EMITTERS];
+  Uint32 emitters_count;
+  Uint32 frame;
+  Uint64 spawned_count;
+} SBI_Particles;
+
+// Create the buffers of capacity particles, all of them free
+bool SBI_ParticlesLoad(SBI_Particles* particles,
+                       SDL_GPUDevice* device,
+                       Uint32 capacity);
+
+// Add an emitter, SBI_PARTICLES_NO_EMITTER when all are taken
+Uint32 SBI_ParticlesAddEmitter(SBI_Particles* particles,
+                               const SBI_ParticleEmitter* emitter);
+
+// Change the parameters of an emitter, its particles keep theirs
+void SBI_ParticlesSetEmitter(SBI_Particles* particles,
+                             Uint32 emitter,
+                             const SBI_ParticleEmitter* params);
+
+// Spawn count particles of an emitter in the next update, on top of its
+// rate
+void SBI_ParticlesBurst(SBI_Particles* particles, Uint32 emitter, Uint32 count);
+
+// Spawn, age and kill the particles in compute passes, before any render
+// pass. Spawns beyond the free particles are dropped.
+void SBI_ParticlesUpdate(SBI_Particles* particles,
+                         float dt,
+                         SDL_GPUCommandBuffer* cmd_buf);
+
+// Draw the alive particles with the pipeline of billboard
+void SBI_ParticlesDraw(SBI_Particles* particles,
+                       SBI_Billboard* billboard,
+                       const SBI_Mat4 proj,
+                       const SBI_Mat4 view,
+                       const SBI_Vec3 view_pos,
+                       SDL_GPUCommandBuffer* cmd_buf,
+                       SDL_GPURenderPass* render_pass);
+
+// Wait for the GPU and read the counters of the last update (slow)
+bool SBI_ParticlesReadStats(SBI_Particles* particles,
+                            SBI_ParticlesStats* stats);
+
+void SBI_ParticlesDestroy(SBI_Particles* particles);
+
+#endif /* SBI_PARTICLES_H */
@@ -0,0 +1,115 @@
+#include "resolution.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define RESOLUTION_SMOOTHING (0.1f)
+#define RESOLUTION_MAX_STEP (0.05f)
+#define RESOLUTION_QUANTUM (1.0f / 64.0f)
+
+void SBI_DynamicResolutionLoad(SBI_DynamicResolution* resolution,
+                               SDL_GPUDevice* device,
+                               SDL_Window* window,
+                               float budget) {
+  SDL_memset(resolution, 0, sizeof(SBI_DynamicResolution));
+  resolution->device = device;
+  resolution->format = SDL_GetGPUSwapchainTextureFormat(device, window);
+  resolution->scale = 1.0f;
+  resolution->min_scale = 0.5f;
+  resolution->max_scale = 1.0f;
+  resolution->budget = budget;
+  resolution->frame_time = budget;
+  resolution->enabled = true;
+}
+
+bool SBI_DynamicResolutionPrepare(SBI_DynamicResolution* resolution,
+                                  Uint32 width,
+                                  Uint32 height) {
+  if (resolution->target != NULL && resolution->target_w == width &&
+      resolution->target_h == height) {
+    return true;
+  }
+
+  SBI_DynamicResolutionResize(resolution);
+
+  // Allocated at full size, scaling only shrinks the rendered region
+  SDL_GPUTextureCreateInfo texture_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = resolution->format,
+      .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  resolution->target =
+      SDL_CreateGPUTexture(resolution->device, &texture_create_info);
+  if (resolution->target == NULL) {
+    SDL_Log("Couldn't create dynamic resolution target: %s", SDL_GetError());
+    return false;
+  }
+
+  resolution->target_w = width;
+  resolution->target_h = height;
+  return true;
+}
+
+void SBI_DynamicResolutionResize(SBI_DynamicResolution* resolution) {
+  if (resolution->target != NULL) {
+    SDL_ReleaseGPUTexture(resolution->device, resolution->target);
+    resolution->target = NULL;
+  }
+  resolution->target_w = 0;
+  resolution->target_h = 0;
+}
+
+void SBI_DynamicResolutionBlit(SBI_DynamicResolution* resolution,
+                               SDL_GPUCommandBuffer* cmd_buf,
+                               SDL_GPUTexture* swapchain_texture,
+                               Uint32 width,
+                               Uint32 height) {
+  SDL_GPUBlitInfo blit_info = {
+      .source =
+          (SDL_GPUBlitRegion){
+              .texture = resolution->target,
+              .w = SDL_max((Uint32)(resolution->target_w * resolution->scale),
+                           1),
+              .h = SDL_max((Uint32)(resolution->target_h * resolution->scale),
+                           1),
+          },
+      .destination =
+          (SDL_GPUBlitRegion){
+              .texture = swapchain_texture,
+              .w = width,
+              .h = height,
+          },
+      .load_op = SDL_GPU_LOADOP_DONT_CARE,
+      .filter = SDL_GPU_FILTER_LINEAR,
+  };
+  SDL_BlitGPUTexture(cmd_buf, &blit_info);
+}
+
+void SBI_DynamicResolutionUpdate(SBI_DynamicResolution* resolution,
+                                 float frame_time) {
+  resolution->frame_time +=
+      (frame_time - resolution->frame_time) * RESOLUTION_SMOOTHING;
+  if (resolution->frame_time <= 0.0f) {
+    return;
+  }
+
+  // Cost follows the pixel count, which is the square of the scale
+  float ratio = resolution->budget / resolution->frame_time;
+  float ideal = resolution->scale * SDL_sqrtf(ratio);
+  float step = SDL_clamp(ideal - resolution->scale, -RESOLUTION_MAX_STEP,
+                         RESOLUTION_MAX_STEP);
+  float scale = resolution->scale + step;
+  scale = SDL_roundf(scale / RESOLUTION_QUANTUM) * RESOLUTION_QUANTUM;
+  resolution->scale =
+      SDL_clamp(scale, resolution->min_scale, resolution->max_scale);
+}
+
+void SBI_DynamicResolutionDestroy(SBI_DynamicResolution* resolution) {
+  SBI_DynamicResolutionResize(resolution);
+}
@@ -0,0 +1,53 @@
+#ifndef SBI_RESOLUTION_H
+#define SBI_RESOLUTION_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_video.h>
+
+// Renders the scene into a scaled offscreen target that is upscaled to the
+// swapchain, the scale follows the measured GPU frame time.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUTexture* target;
+  SDL_GPUTextureFormat format;
+  Uint32 target_w;
+  Uint32 target_h;
+
+  float scale;
+  float min_scale;
+  float max_scale;
+  float budget;
+  float frame_time;
+  bool enabled;
+  bool grid_native;
+} SBI_DynamicResolution;
+
+// Prepare the controller to hold budget seconds of GPU time per frame
+void SBI_DynamicResolutionLoad(SBI_DynamicResolution* resolution,
+                               SDL_GPUDevice* device,
+                               SDL_Window* window,
+                               float budget);
+
+// Make sure the offscreen target matches the swapchain size
+bool SBI_DynamicResolutionPrepare(SBI_DynamicResolution* resolution,
+                                  Uint32 width,
+                                  Uint32 height);
+
+// Drop the offscreen target, recreated on the next prepare
+void SBI_DynamicResolutionResize(SBI_DynamicResolution* resolution);
+
+// Upscale the rendered region of the target to the swapchain
+void SBI_DynamicResolutionBlit(SBI_DynamicResolution* resolution,
+                               SDL_GPUCommandBuffer* cmd_buf,
+                               SDL_GPUTexture* swapchain_texture,
+                               Uint32 width,
+                               Uint32 height);
+
+// Feed a measured GPU frame time and adjust the scale for the next frame
+void SBI_DynamicResolutionUpdate(SBI_DynamicResolution* resolution,
+                                 float frame_time);
+
+// Release the offscreen target
+void SBI_DynamicResolutionDestroy(SBI_DynamicResolution* resolution);
+
+#endif /* SBI_RESOLUTION_H */
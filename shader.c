@@ -1,11 +1,12 @@
 #include "shader.h"
+#include "memtrack.h"
 
 #include <SDL3/SDL_filesystem.h>
 #include <SDL3/SDL_gpu.h>
 #include <SDL3/SDL_log.h>
 
-SDL_GPUShader *SBI_ShaderLoad(SDL_GPUDevice *device,
-                              SBI_ShaderOptions options) {
+static SDL_GPUShader *shader_load(SDL_GPUDevice *device,
+                                  SBI_ShaderOptions options) {
   char full_path[512] = {0};
   SDL_snprintf(full_path, sizeof(full_path), "%sassets/shaders/%s.spv",
                SDL_GetBasePath(), options.filename);
@@ -38,3 +39,59 @@ SDL_GPUShader *SBI_ShaderLoad(SDL_GPUDevice *device,
   SDL_free(code_data);
   return shader;
 }
+
+static SDL_GPUComputePipeline *compute_pipeline_load(
+    SDL_GPUDevice *device, SBI_ComputeOptions options) {
+  char full_path[512] = {0};
+  SDL_snprintf(full_path, sizeof(full_path), "%sassets/shaders/%s.spv",
+               SDL_GetBasePath(), options.filename);
+  SDL_GPUShaderFormat supported_formats = SDL_GetGPUShaderFormats(device);
+  if (!(supported_formats & SDL_GPU_SHADERFORMAT_SPIRV)) {
+    SDL_Log("GPU device doesn't support SPIR-V shader format");
+    return NULL;
+  }
+
+  size_t code_size;
+  void *code_data = SDL_LoadFile(full_path, &code_size);
+  if (code_data == NULL) {
+    SDL_Log("Couldn't load compute shader code: %s", SDL_GetError());
+    return NULL;
+  }
+
+  SDL_GPUComputePipelineCreateInfo pipeline_create_info = {
+      .code = code_data,
+      .code_size = code_size,
+      .entrypoint = "main",
+      .format = SDL_GPU_SHADERFORMAT_SPIRV,
+      .num_samplers = options.sampler_count,
+      .num_readonly_storage_textures = options.readonly_storage_texture_count,
+      .num_readonly_storage_buffers = options.readonly_storage_buffer_count,
+      .num_readwrite_storage_textures = options.readwrite_storage_texture_count,
+      .num_readwrite_storage_buffers = options.readwrite_storage_buffer_count,
+      .num_uniform_buffers = options.uniform_buffer_count,
+      .threadcount_x = options.threadcount_x,
+      .threadcount_y = options.threadcount_y,
+      .threadcount_z = options.threadcount_z,
+  };
+  SDL_GPUComputePipeline *pipeline =
+      SDL_CreateGPUComputePipeline(device, &pipeline_create_info);
+  SDL_Log("Loaded compute shader: %s", full_path);
+  SDL_free(code_data);
+  return pipeline;
+}
+
+SDL_GPUShader *SBI_ShaderLoad(SDL_GPUDevice *device,
+                              SBI_ShaderOptions options) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_SHADER);
+  SDL_GPUShader *shader = shader_load(device, options);
+  SBI_MemTrackPop(tag);
+  return shader;
+}
+
+SDL_GPUComputePipeline *SBI_ComputePipelineLoad(SDL_GPUDevice *device,
+                                                SBI_ComputeOptions options) {
+  SBI_MemTrackTag tag = SBI_MemTrackPush(SBI_MEMTRACK_SHADER);
+  SDL_GPUComputePipeline *pipeline = compute_pipeline_load(device, options);
+  SBI_MemTrackPop(tag);
+  return pipeline;
+}
@@ -16,4 +16,22 @@ typedef struct {
 // Load a shader from a SPV file.
 SDL_GPUShader* SBI_ShaderLoad(SDL_GPUDevice* device, SBI_ShaderOptions options);
 
+// Compute pipeline options, resource counts and workgroup size.
+typedef struct {
+  const char* filename;
+  Uint32 sampler_count;
+  Uint32 readonly_storage_texture_count;
+  Uint32 readonly_storage_buffer_count;
+  Uint32 readwrite_storage_texture_count;
+  Uint32 readwrite_storage_buffer_count;
+  Uint32 uniform_buffer_count;
+  Uint32 threadcount_x;
+  Uint32 threadcount_y;
+  Uint32 threadcount_z;
+} SBI_ComputeOptions;
+
+// Load a compute pipeline from a SPV file.
+SDL_GPUComputePipeline* SBI_ComputePipelineLoad(SDL_GPUDevice* device,
+                                                SBI_ComputeOptions options);
+
 #endif /* SBI_SHADER_H */
@@ -0,0 +1,201 @@
+#include "simthread.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+static int sim_thread(void* data);
+
+static float sim_lerp(float a, float b, float t) {
+  return a + (b - a) * t;
+}
+
+static void sim_publish(SBI_TripleBuffer* buffer) {
+  // The exchange is a full barrier, the slot writes are visible before it
+  int previous =
+      SDL_SetAtomicInt(&buffer->middle, (int)buffer->back | SBI_SNAPSHOT_FRESH);
+  buffer->back = (Uint32)previous & SBI_SNAPSHOT_INDEX_MASK;
+}
+
+bool SBI_SimThreadLoad(SBI_SimThread* sim,
+                       const SBI_Camera* camera,
+                       const SBI_Vec4* instances,
+                       Uint64 instances_count,
+                       SBI_Flock* flock,
+                       float tick_time) {
+  SDL_memset(sim, 0, sizeof(SBI_SimThread));
+  sim->camera = *camera;
+  sim->flock = flock;
+  sim->instances_count = instances_count;
+  sim->tick_time = tick_time;
+
+  size_t bytes = sizeof(SBI_Vec4) * instances_count;
+  sim->instances = SDL_aligned_alloc(16, bytes);
+  if (sim->instances == NULL) {
+    SDL_Log("Could not allocate memory for %ld simulated instances",
+            instances_count);
+    return false;
+  }
+  SDL_memcpy(sim->instances, instances, bytes);
+
+  // Every slot starts as the initial state so the reader never sees garbage
+  for (Uint32 i = 0; i < 3; i++) {
+    SBI_Snapshot* slot = &sim->snapshots.slots[i];
+    slot->instances = SDL_aligned_alloc(16, bytes);
+    slot->previous_instances = SDL_aligned_alloc(16, bytes);
+    if (slot->instances == NULL || slot->previous_instances == NULL) {
+      SDL_Log("Could not allocate memory for simulation snapshots");
+      return false;
+    }
+
+    SDL_memcpy(slot->instances, instances, bytes);
+    SDL_memcpy(slot->previous_instances, instances, bytes);
+    slot->camera = *camera;
+    slot->previous_camera = *camera;
+    slot->time = SDL_GetPerformanceCounter();
+  }
+  sim->snapshots.front = 0;
+  sim->snapshots.back = 1;
+  SDL_SetAtomicInt(&sim->snapshots.middle, 2);
+
+  sim->thread = SDL_CreateThread(sim_thread, "SBI_Simulation", sim);
+  if (sim->thread == NULL) {
+    SDL_Log("Couldn't create simulation thread: %s", SDL_GetError());
+    return false;
+  }
+
+  return true;
+}
+
+bool SBI_SimThreadPushEvent(SBI_SimThread* sim, const SDL_Event* event) {
+  SBI_InputQueue* queue = &sim->input;
+  Uint32 tail = SDL_GetAtomicU32(&queue->tail);
+  Uint32 head = SDL_GetAtomicU32(&queue->head);
+  if (tail - head == SBI_INPUT_QUEUE_SIZE) {
+    return false;
+  }
+
+  queue->events[tail % SBI_INPUT_QUEUE_SIZE] = *event;
+  SDL_MemoryBarrierRelease();
+  SDL_SetAtomicU32(&queue->tail, tail + 1);
+  return true;
+}
+
+const SBI_Snapshot* SBI_SimThreadAcquire(SBI_SimThread* sim) {
+  SBI_TripleBuffer* buffer = &sim->snapshots;
+  if (SDL_GetAtomicInt(&buffer->middle) & SBI_SNAPSHOT_FRESH) {
+    // Only the writer touches middle meanwhile, and it keeps it fresh
+    int previous = SDL_SetAtomicInt(&buffer->middle, (int)buffer->front);
+    buffer->front = (Uint32)previous & SBI_SNAPSHOT_INDEX_MASK;
+  }
+
+  return &buffer->slots[buffer->front];
+}
+
+void SBI_SimThreadInterpolate(const SBI_SimThread* sim,
+                              const SBI_Snapshot* snapshot,
+                              Uint64 now,
+                              SBI_Camera* camera,
+                              SBI_Vec4* instances) {
+  // Render one tick behind, blending toward the latest tick as time passes
+  float elapsed = now > snapshot->time
+                      ? (float)(now - snapshot->time) /
+                            (float)SDL_GetPerformanceFrequency()
+                      : 0.0f;
+  float t = SDL_clamp(elapsed / sim->tick_time, 0.0f, 1.0f);
+
+  const SBI_Camera* from = &snapshot->previous_camera;
+  const SBI_Camera* to = &snapshot->camera;
+  camera->azimuth = sim_lerp(from->azimuth, to->azimuth, t);
+  camera->polar = sim_lerp(from->polar, to->polar, t);
+  camera->radius = sim_lerp(from->radius, to->radius, t);
+  camera->target_radius = to->target_radius;
+  for (Uint32 c = 0; c < 3; c++) {
+    camera->orbit_point[c] =
+        sim_lerp(from->orbit_point[c], to->orbit_point[c], t);
+  }
+  SBI_CameraApplyOrbit(camera);
+
+  for (Uint64 i = 0; i < sim->instances_count; i++) {
+    const float* a = snapshot->previous_instances[i];
+    const float* b = snapshot->instances[i];
+    instances[i][0] = sim_lerp(a[0], b[0], t);
+    instances[i][1] = sim_lerp(a[1], b[1], t);
+    instances[i][2] = sim_lerp(a[2], b[2], t);
+    instances[i][3] = b[3];
+  }
+}
+
+void SBI_SimThreadDestroy(SBI_SimThread* sim) {
+  if (sim->thread != NULL) {
+    SDL_SetAtomicInt(&sim->quit, 1);
+    SDL_WaitThread(sim->thread, NULL);
+    sim->thread = NULL;
+  }
+
+  for (Uint32 i = 0; i < 3; i++) {
+    SDL_aligned_free(sim->snapshots.slots[i].instances);
+    SDL_aligned_free(sim->snapshots.slots[i].previous_instances);
+  }
+  SDL_aligned_free(sim->instances);
+  SDL_memset(sim, 0, sizeof(SBI_SimThread));
+}
+
+static void sim_drain_input(SBI_SimThread* sim) {
+  SBI_InputQueue* queue = &sim->input;
+  Uint32 head = SDL_GetAtomicU32(&queue->head);
+  Uint32 tail = SDL_GetAtomicU32(&queue->tail);
+  SDL_MemoryBarrierAcquire();
+  for (; head != tail; head++) {
+    SBI_CameraInputEvent(&sim->camera_input,
+                         &queue->events[head % SBI_INPUT_QUEUE_SIZE]);
+  }
+  SDL_SetAtomicU32(&queue->head, head);
+}
+
+static int sim_thread(void* data) {
+  SBI_SimThread* sim = data;
+  size_t bytes = sizeof(SBI_Vec4) * sim->instances_count;
+  Uint64 tick_ns = (Uint64)(sim->tick_time * (float)SDL_NS_PER_SECOND);
+  Uint64 next_tick = SDL_GetTicksNS();
+
+  while (!SDL_GetAtomicInt(&sim->quit)) {
+    sim_drain_input(sim);
+
+    SBI_Snapshot* slot = &sim->snapshots.slots[sim->snapshots.back];
+    slot->previous_camera = sim->camera;
+    SDL_memcpy(slot->previous_instances, sim->instances, bytes);
+
+    Uint64 camera_version = sim->camera.version;
+    SBI_CameraStep(&sim->camera, &sim->camera_input, sim->tick_time);
+    sim->camera_input.orbit_x = 0.0f;
+    sim->camera_input.orbit_y = 0.0f;
+    sim->camera_input.wheel = 0.0f;
+    if (sim->flock != NULL) {
+      SBI_FlockUpdate(sim->flock, sim->instances, sim->tick_time);
+    }
+
+    slot->camera = sim->camera;
+    SDL_memcpy(slot->instances, sim->instances, bytes);
+    // The tick after a move still blends from the moved state
+    bool moved = sim->flock != NULL || sim->camera.version != camera_version;
+    if (moved || sim->moved) {
+      sim->version++;
+    }
+    sim->moved = moved;
+    slot->version = sim->version;
+    slot->tick = ++sim->tick;
+    slot->time = SDL_GetPerformanceCounter();
+    sim_publish(&sim->snapshots);
+
+    // Fixed rate, a late tick runs right away instead of piling up
+    next_tick += tick_ns;
+    Uint64 now = SDL_GetTicksNS();
+    if (now < next_tick) {
+      SDL_DelayNS(next_tick - now);
+    } else {
+      next_tick = now;
+    }
+  }
+
+  return 0;
+}
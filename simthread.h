@@ -0,0 +1,94 @@
+#ifndef SBI_SIMTHREAD_H
+#define SBI_SIMTHREAD_H
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_events.h>
+#include <SDL3/SDL_thread.h>
+
+#include "camera.h"
+#include "flock.h"
+#include "xmath.h"
+
+#define SBI_INPUT_QUEUE_SIZE (256)
+#define SBI_SNAPSHOT_FRESH (4)
+#define SBI_SNAPSHOT_INDEX_MASK (3)
+
+// State published by the simulation thread at the end of a tick, with the
+// state at the start of the tick to interpolate from
+typedef struct {
+  SBI_Camera camera;
+  SBI_Camera previous_camera;
+  SBI_Vec4* instances;
+  SBI_Vec4* previous_instances;
+  Uint64 tick;
+  Uint64 time;
+  // Bumped by every tick that blends between two different states
+  Uint64 version;
+} SBI_Snapshot;
+
+// Lock-free triple buffer: the writer fills back, swaps it with middle and
+// marks it fresh; the reader swaps front with a fresh middle. Neither side
+// ever waits and the reader always gets the latest complete snapshot.
+typedef struct {
+  SBI_Snapshot slots[3];
+  SDL_AtomicInt middle;
+  Uint32 back;
+  Uint32 front;
+} SBI_TripleBuffer;
+
+// Lock-free single producer (main thread) single consumer (simulation
+// thread) ring of input events
+typedef struct {
+  SDL_Event events[SBI_INPUT_QUEUE_SIZE];
+  SDL_AtomicU32 head;
+  SDL_AtomicU32 tail;
+} SBI_InputQueue;
+
+// Runs the fixed rate simulation of the camera and the instances on its
+// own thread, the render thread only reads published snapshots.
+typedef struct {
+  SDL_Thread* thread;
+  SDL_AtomicInt quit;
+  SBI_TripleBuffer snapshots;
+  SBI_InputQueue input;
+
+  // Owned by the simulation thread
+  SBI_Camera camera;
+  SBI_CameraInput camera_input;
+  SBI_Flock* flock;
+  SBI_Vec4* instances;
+  Uint64 instances_count;
+  float tick_time;
+  Uint64 tick;
+  Uint64 version;
+  bool moved;
+} SBI_SimThread;
+
+// Copy the initial camera and instances and start the thread. The flock,
+// when given, is only touched by the simulation thread from now on.
+bool SBI_SimThreadLoad(SBI_SimThread* sim,
+                       const SBI_Camera* camera,
+                       const SBI_Vec4* instances,
+                       Uint64 instances_count,
+                       SBI_Flock* flock,
+                       float tick_time);
+
+// Forward an input event to the simulation thread (main thread only)
+bool SBI_SimThreadPushEvent(SBI_SimThread* sim, const SDL_Event* event);
+
+// Latest complete snapshot, stays valid until the next acquire (render
+// thread only)
+const SBI_Snapshot* SBI_SimThreadAcquire(SBI_SimThread* sim);
+
+// Blend the last two ticks of a snapshot at time now into the orbit of
+// camera and into instances
+void SBI_SimThreadInterpolate(const SBI_SimThread* sim,
+                              const SBI_Snapshot* snapshot,
+                              Uint64 now,
+                              SBI_Camera* camera,
+                              SBI_Vec4* instances);
+
+// Stop the thread and release the snapshots
+void SBI_SimThreadDestroy(SBI_SimThread* sim);
+
+#endif /* SBI_SIMTHREAD_H */
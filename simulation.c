@@ -1,30 +1,367 @@
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mouse.h>
 #include <SDL3/SDL_timer.h>
 
 #include "billboard.h"
 #include "simulation.h"
 
+// Each group is a vehicle with two labels above it and an icon attached to
+// the first label, the labels are placed once relative to their parents
+static bool simulation_load_attached(SBI_Simulation* state) {
+  Uint32 nodes_count = (Uint32)state->attached_count * ATTACHED_NODES;
+  Uint32* parents = SDL_malloc(sizeof(Uint32) * nodes_count);
+  if (parents == NULL) {
+    SDL_Log("Could not allocate memory for %d attached nodes", nodes_count);
+    return false;
+  }
+  for (Uint32 n = 0; n < nodes_count; n += ATTACHED_NODES) {
+    parents[n] = SBI_HIERARCHY_NO_PARENT;
+    parents[n + 1] = n;
+    parents[n + 2] = n;
+    parents[n + 3] = n + 1;
+  }
+  bool loaded = SBI_HierarchyLoad(&state->hierarchy, parents, nodes_count, 0);
+  SDL_free(parents);
+  if (!loaded) {
+    return false;
+  }
+
+  SBI_ALIGN_XFORM SBI_XForm labels[3] = {
+      {0.0f, 0.0f, 0.0f, 1.0f, -0.5f, 1.5f, 0.0f, 0.5f, 0.5f, 0.5f},
+      {0.0f, 0.0f, 0.0f, 1.0f, 0.5f, 1.5f, 0.0f, 0.5f, 0.5f, 0.5f},
+      {0.0f, 0.0f, 0.0f, 1.0f, 1.5f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f},
+  };
+  for (Uint32 n = 0; n < nodes_count; n += ATTACHED_NODES) {
+    for (Uint32 i = 0; i < 3; i++) {
+      SBI_HierarchySetLocal(&state->hierarchy, n + 1 + i, labels[i]);
+    }
+  }
+  return true;
+}
+
+// Drive the vehicles along circles and spin the first label, the rest of
+// each group follows through the hierarchy
+static void simulation_update_attached(SBI_Simulation* state, float dt) {
+  state->attached_time += dt;
+  Uint32 side = (Uint32)SDL_ceilf(SDL_sqrtf((float)state->attached_count));
+  float offset = (float)(side - 1) * ATTACHED_SPACING * 0.5f;
+  SBI_ALIGN_VEC3 SBI_Vec3 up = {0.0f, 1.0f, 0.0f};
+  SBI_ALIGN_XFORM SBI_XForm root = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                    0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+  SBI_ALIGN_XFORM SBI_XForm label = {0.0f, 0.0f, 0.0f, 1.0f, -0.5f,
+                                     1.5f, 0.0f, 0.5f, 0.5f, 0.5f};
+  for (Uint32 g = 0; g < (Uint32)state->attached_count; g++) {
+    Uint32 node = g * ATTACHED_NODES;
+    float angle = state->attached_time + (float)g * 0.1f;
+    SBI_QuatMakeAxisAngle(up, -angle, root);
+    root[4] = (float)(g % side) * ATTACHED_SPACING - offset +
+              SDL_cosf(angle) * ATTACHED_RADIUS;
+    root[6] = (float)(g / side) * ATTACHED_SPACING - offset +
+              SDL_sinf(angle) * ATTACHED_RADIUS;
+    SBI_HierarchySetLocal(&state->hierarchy, node, root);
+
+    SBI_QuatMakeAxisAngle(up, angle * 4.0f, label);
+    SBI_HierarchySetLocal(&state->hierarchy, node + 1, label);
+  }
+
+  SBI_HierarchyUpdate(&state->hierarchy);
+  SBI_HierarchyExport(&state->hierarchy, &state->billboard, 0);
+}
+
+// Fountains on a ring around the set, each spawning its share of the rate
+static bool simulation_load_particles(SBI_Simulation* state) {
+  float rate = state->particles_rate / PARTICLE_EMITTERS;
+  Uint32 capacity = (Uint32)(state->particles_rate * PARTICLE_LIFE_MAX *
+                             1.25f) + SBI_PARTICLES_GROUP_SIZE;
+  if (!SBI_ParticlesLoad(&state->particles, state->device, capacity)) {
+    return false;
+  }
+
+  // RGBA8, red in the low byte
+  static const Uint32 colors[PARTICLE_EMITTERS] = {
+      0xFF40A0FF,
+      0xFFFFC840,
+      0xFF60FFA0,
+      0xFFC860FF,
+  };
+  for (Uint32 e = 0; e < PARTICLE_EMITTERS; e++) {
+    float angle = 2.0f * SDL_PI_F * (float)e / PARTICLE_EMITTERS;
+    SBI_ParticleEmitter emitter = {
+        .position = {SDL_cosf(angle) * PARTICLE_RING_RADIUS, 0.0f,
+                     SDL_sinf(angle) * PARTICLE_RING_RADIUS},
+        .radius = 0.25f,
+        .velocity = {0.0f, 6.0f, 0.0f},
+        .spread = 1.5f,
+        .rate = rate,
+        .life_min = PARTICLE_LIFE_MIN,
+        .life_max = PARTICLE_LIFE_MAX,
+        .scale = 0.08f,
+        .gravity = 4.0f,
+        .color = colors[e],
+    };
+    SBI_ParticlesAddEmitter(&state->particles, &emitter);
+  }
+
+  SDL_Log("Spawning %.0f particles per second, %d at most",
+          state->particles_rate, capacity);
+  return true;
+}
+
+// Sum of the versions of what a frame shows, any change bumps it
+static Uint64 simulation_version(const SBI_Simulation* state) {
+  Uint64 version = state->billboard.version;
+  for (Uint32 i = 0; i < state->views_count; i++) {
+    version += state->views[i].camera.version;
+  }
+  return version;
+}
+
+// Whether the frames change with time alone, without any input
+static bool simulation_animating(const SBI_Simulation* state) {
+  return state->billboard_animated || state->flock_count > 0 ||
+         state->attached_count > 0 || state->particles_rate > 0.0f;
+}
+
 bool SBI_SimulationLoad(SBI_Simulation* state) {
-  SBI_CameraLoad(&state->camera, state->viewport.w / state->viewport.h);
-  if (!SBI_GridLoad(&state->grid, state->device, state->window)) {
+  float w = state->viewport.w;
+  float h = state->viewport.h;
+  if (state->views_count == MAX_VIEWS) {
+    // Perspective, top, side and follow cameras in a 2x2 layout
+    SBI_ViewLoad(&state->views[0], SBI_VIEW_ORBIT,
+                 (SDL_FRect){0.0f, 0.0f, 0.5f, 0.5f}, w, h);
+    SBI_ViewLoad(&state->views[1], SBI_VIEW_TOP,
+                 (SDL_FRect){0.5f, 0.0f, 0.5f, 0.5f}, w, h);
+    SBI_ViewLoad(&state->views[2], SBI_VIEW_SIDE,
+                 (SDL_FRect){0.0f, 0.5f, 0.5f, 0.5f}, w, h);
+    SBI_ViewLoad(&state->views[3], SBI_VIEW_FOLLOW,
+                 (SDL_FRect){0.5f, 0.5f, 0.5f, 0.5f}, w, h);
+  } else {
+    state->views_count = 1;
+    SBI_ViewLoad(&state->views[0], SBI_VIEW_ORBIT,
+                 (SDL_FRect){0.0f, 0.0f, 1.0f, 1.0f}, w, h);
+  }
+
+  // The software rasterizer draws the grid and the set of the GPU path,
+  // nothing that only exists on the GPU
+  if (state->software) {
+    if (state->billboard_blend == SBI_BILLBOARD_BLEND_OIT) {
+      SDL_Log("Software rendering sorts the billboards instead of OIT");
+      state->billboard_blend = SBI_BILLBOARD_BLEND_SORTED;
+    }
+    if (state->occlusion || state->lights_count > 0 ||
+        state->world_path != NULL || state->sprites_path != NULL ||
+        state->resolution_budget > 0.0f || state->debug_enabled ||
+        state->particles_rate > 0.0f) {
+      SDL_Log("Software rendering has no occlusion culling, lights, "
+              "streamed world or sprites, dynamic resolution, debug draw nor "
+              "particles");
+      state->occlusion = false;
+      state->lights_count = 0;
+      state->world_path = NULL;
+      state->sprites_path = NULL;
+      state->resolution_budget = 0.0f;
+      state->debug_enabled = false;
+      state->particles_rate = 0.0f;
+    }
+    if (!SBI_SoftRasterLoad(&state->soft_raster, 0)) {
+      return false;
+    }
+  } else if (!SBI_GridLoad(&state->grid, state->device, state->window) ||
+             !SBI_GPUMemoryLoad(&state->gpu_memory, state->device,
+                                SBI_GPUMemoryDefaultOptions())) {
+    return false;
+  }
+
+  if (state->particles_rate > 0.0f && !simulation_load_particles(state)) {
+    return false;
+  }
+
+  if (state->debug_enabled &&
+      !SBI_DebugDrawLoad(&state->debug_draw, state->device,
+                         &state->gpu_memory, state->window,
+                         SBI_DEBUG_DRAW_CAPACITY)) {
+    return false;
+  }
+
+  // Attached groups are composed on the main thread and own the set
+  if (state->attached_count > 0 &&
+      (state->flock_count > 0 || state->threaded)) {
+    SDL_Log("Attached groups need the flock and the simulation thread off");
+    state->attached_count = 0;
+  }
+
+  // Each agent of the flock or attached node is a billboard instance
+  Uint64 billboard_count = BILLBOARD_COUNT;
+  if (state->flock_count > 0) {
+    billboard_count = state->flock_count;
+  } else if (state->attached_count > 0) {
+    billboard_count = state->attached_count * ATTACHED_NODES;
+  }
+  SBI_BillboardOptions billboard_options =
+      SBI_BillboardDefaultOptions(billboard_count);
+  billboard_options.mode = state->billboard_mode;
+  billboard_options.blend = state->billboard_blend;
+  billboard_options.generator = state->scene;
+  if (state->billboard_opacity > 0.0f) {
+    billboard_options.opacity = state->billboard_opacity;
+  }
+  if (state->billboard_animated) {
+    billboard_options.animated = true;
+    billboard_options.atlas_columns = BILLBOARD_ATLAS_COLUMNS;
+    billboard_options.atlas_rows = BILLBOARD_ATLAS_ROWS;
+  }
+
+  // Occlusion culling needs opaque world sized quads seen from one view
+  if (state->occlusion &&
+      (state->views_count > 1 ||
+       state->billboard_blend != SBI_BILLBOARD_BLEND_UNSORTED ||
+       state->billboard_mode == SBI_BILLBOARD_FIXED_SCALE)) {
+    SDL_Log("Occlusion culling needs a single view of opaque billboards");
+    state->occlusion = false;
+  }
+  billboard_options.depth_test = state->occlusion;
+
+  // The clusters are binned for the main view only
+  if (state->lights_count > 0 &&
+      (state->views_count > 1 ||
+       state->billboard_blend == SBI_BILLBOARD_BLEND_OIT)) {
+    SDL_Log("Lights need a single view of billboards without OIT");
+    state->lights_count = 0;
+  }
+  if (state->lights_count > 0) {
+    Uint32 lights_count = SDL_min(state->lights_count, billboard_count);
+    if (!SBI_LightsLoad(&state->lights, state->device, lights_count)) {
+      return false;
+    }
+    state->lights_count = state->lights.lights_count;
+    billboard_options.lights = &state->lights;
+  }
+
+  SDL_GPUDevice* billboard_device = state->software ? NULL : state->device;
+  if (!SBI_BillboardLoad(&state->billboard, billboard_device, state->window,
+                         billboard_options)) {
+    return false;
+  }
+
+  if (state->billboard_blend == SBI_BILLBOARD_BLEND_OIT &&
+      !SBI_OITLoad(&state->oit, state->device, state->window)) {
     return false;
   }
 
-  if (!SBI_BillboardLoad(&state->billboard, state->device, state->window,
-                         BILLBOARD_COUNT)) {
+  if (state->occlusion && !SBI_HiZLoad(&state->hiz, state->device)) {
     return false;
   }
 
+  if (state->flock_count > 0) {
+    SBI_FlockOptions flock_options =
+        SBI_FlockDefaultOptions(state->flock_count);
+    if (!SBI_FlockLoad(&state->flock, flock_options)) {
+      return false;
+    }
+    SBI_FlockSpawn(&state->flock, state->billboard.instances);
+    SBI_BillboardMarkDirty(&state->billboard, SBI_BILLBOARD_STREAM_POSITION, 0,
+                           state->billboard.instances_count);
+  }
+  if (state->attached_count > 0) {
+    if (!simulation_load_attached(state)) {
+      return false;
+    }
+    simulation_update_attached(state, 0.0f);
+  }
+  SBI_SimulationPlaceLights(state);
+
+  if (state->resolution_budget > 0.0f) {
+    SBI_DynamicResolutionLoad(&state->resolution, state->device, state->window,
+                              state->resolution_budget);
+    state->resolution.grid_native = state->grid_native;
+  }
+
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamerOptions chunk_options =
+        SBI_ChunkStreamerDefaultOptions(state->world_path);
+    if (!SBI_ChunkStreamerLoad(&state->chunks, state->device,
+                               &state->gpu_memory, chunk_options)) {
+      return false;
+    }
+  }
+
+  if (state->sprites_path != NULL) {
+    SBI_SpriteStreamerOptions sprite_options =
+        SBI_SpriteStreamerDefaultOptions(state->sprites_path);
+    if (!SBI_SpriteStreamerLoad(&state->sprites, state->device,
+                                sprite_options)) {
+      return false;
+    }
+  }
+
+  if (state->telemetry_enabled && !SBI_TelemetryLoad(&state->telemetry)) {
+    return false;
+  }
+
+  // The main camera and the instances move on the simulation thread
+  if (state->threaded) {
+    SBI_Flock* flock = state->flock_count > 0 ? &state->flock : NULL;
+    if (!SBI_SimThreadLoad(&state->sim_thread, &state->views[0].camera,
+                           state->billboard.instances,
+                           state->billboard.instances_count, flock,
+                           state->tick_time)) {
+      return false;
+    }
+  }
+
+  // Animated scenes change every frame, on demand they render as usual
+  if (state->on_demand && simulation_animating(state)) {
+    SDL_Log("Rendering on demand only idles static scenes");
+  }
+  state->redraw = true;
   return true;
 }
 
+// Forward camera controls to the simulation thread, window state still
+// belongs to the main thread
+static void simulation_forward_event(SBI_Simulation* state, SDL_Event* event) {
+  switch (event->type) {
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+      if (event->button.button == SDL_BUTTON_MIDDLE) {
+        SDL_CaptureMouse(event->button.down);
+        SDL_SetWindowRelativeMouseMode(state->window, event->button.down);
+      }
+      // Fall through, the simulation tracks the button too
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+    case SDL_EVENT_MOUSE_MOTION:
+    case SDL_EVENT_MOUSE_WHEEL:
+      if (!SBI_SimThreadPushEvent(&state->sim_thread, event)) {
+        SDL_Log("Simulation input queue is full, dropping event");
+      }
+      break;
+    default:
+      break;
+  }
+}
+
 void SBI_SimulationEvent(SBI_Simulation* state, SDL_Event* event) {
+  if (state->threaded) {
+    simulation_forward_event(state, event);
+  }
+
   switch (event->type) {
     case SDL_EVENT_WINDOW_RESIZED:
       state->viewport.w = (float)event->window.data1;
       state->viewport.h = (float)event->window.data2;
-      SBI_CameraViewportResize(&state->camera,
-                               state->viewport.w / state->viewport.h);
+      for (Uint32 i = 0; i < state->views_count; i++) {
+        SBI_ViewResize(&state->views[i], state->viewport.w,
+                       state->viewport.h);
+      }
+      SBI_DynamicResolutionResize(&state->resolution);
+      state->redraw = true;
+      break;
+    case SDL_EVENT_WINDOW_EXPOSED:
+    case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+    case SDL_EVENT_WINDOW_RESTORED:
+      // The compositor lost the presented frame
+      state->redraw = true;
       break;
     case SDL_EVENT_MOUSE_WHEEL:
       state->relative_mouse_wheel = -event->wheel.y;
@@ -34,31 +371,345 @@ void SBI_SimulationEvent(SBI_Simulation* state, SDL_Event* event) {
 }
 
 void SBI_SimulationUpdate(SBI_Simulation* state, float dt) {
-  {
-    SBI_CameraUpdate(&state->camera, state->window, state->relative_mouse_wheel,
-                     dt);
+  Uint64 start_tick = SDL_GetPerformanceCounter();
+  Uint64 version = simulation_version(state);
+
+  // Threaded: the camera and instances are interpolated from snapshots, a
+  // snapshot that moved something bumps the camera version to redraw it
+  SBI_Camera* camera = &state->views[0].camera;
+  if (state->threaded) {
+    const SBI_Snapshot* snapshot = SBI_SimThreadAcquire(&state->sim_thread);
+    if (snapshot->version != state->snapshot_version) {
+      state->snapshot_version = snapshot->version;
+      camera->version++;
+    }
+  } else {
+    SBI_CameraUpdate(camera, state->window, state->relative_mouse_wheel, dt);
+  }
+
+  if (state->flock_count > 0 && !state->threaded) {
+    SBI_FlockUpdate(&state->flock, state->billboard.instances, dt);
+    SBI_BillboardMarkDirty(&state->billboard, SBI_BILLBOARD_STREAM_POSITION, 0,
+                           state->billboard.instances_count);
+  }
+  if (state->attached_count > 0) {
+    simulation_update_attached(state, dt);
+  }
+
+  // Secondary views track the main orbit point or the first billboard
+  for (Uint32 i = 1; i < state->views_count; i++) {
+    SBI_View* view = &state->views[i];
+    if (view->mode == SBI_VIEW_FOLLOW && state->billboard.instances_count > 0) {
+      SBI_ViewTrack(view, state->billboard.instances[0]);
+    } else {
+      SBI_ViewTrack(view, camera->orbit_point);
+    }
+  }
+
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamerUpdate(&state->chunks, camera, dt);
+  }
+  if (state->sprites_path != NULL) {
+    SBI_SpriteStreamerFeedback(&state->sprites, state->billboard.instances,
+                               NULL, state->billboard.instances_count, camera,
+                               state->viewport.h);
+    SBI_SpriteStreamerUpdate(&state->sprites);
   }
   state->relative_mouse_wheel = 0.0f;
+  state->streaming = (state->world_path != NULL &&
+                      !SBI_ChunkStreamerSettled(&state->chunks)) ||
+                     (state->sprites_path != NULL &&
+                      !SBI_SpriteStreamerSettled(&state->sprites));
+  state->settled = version == simulation_version(state) &&
+                   !simulation_animating(state) && !state->streaming;
+  state->update_time = (float)(SDL_GetPerformanceCounter() - start_tick) /
+                       (float)SDL_GetPerformanceFrequency();
 }
 
-bool SBI_SimulationRender(SBI_Simulation* state, float dt) {
-  SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(state->device);
-  if (cmd_buf == NULL) {
-    SDL_Log("Could not acquire GPU command buffer: %s", SDL_GetError());
+static void simulation_draw_instances(SBI_Simulation* state,
+                                      SBI_View* view,
+                                      SDL_GPUCommandBuffer* cmd_buf,
+                                      SDL_GPURenderPass* render_pass) {
+  SBI_Camera* camera = &view->camera;
+
+  // Draw the billboard
+  SBI_BillboardDraw(&state->billboard, camera->proj, camera->view,
+                    view->position, cmd_buf, render_pass);
+
+  // Draw the streamed world chunks that are resident
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamerDraw(&state->chunks, &state->billboard, camera->proj,
+                          camera->view, view->position, cmd_buf, render_pass);
+  }
+
+  if (state->particles_rate > 0.0f) {
+    SBI_ParticlesDraw(&state->particles, &state->billboard, camera->proj,
+                      camera->view, view->position, cmd_buf, render_pass);
+  }
+}
+
+// Fill the OIT targets with the transparent instances of every view
+static void simulation_accumulate_views(SBI_Simulation* state,
+                                        SDL_GPUCommandBuffer* cmd_buf,
+                                        SDL_GPURenderPass* render_pass,
+                                        float scale) {
+  for (Uint32 i = 0; i < state->views_count; i++) {
+    SBI_View* view = &state->views[i];
+    SBI_ViewBegin(view, render_pass, scale);
+    simulation_draw_instances(state, view, cmd_buf, render_pass);
+  }
+}
+
+// Draw the instances that survive the culling of the main view in two
+// phases, the late one recovers what the pyramid of the last frame hid
+static void simulation_draw_culled(SBI_Simulation* state,
+                                   SDL_GPUCommandBuffer* cmd_buf,
+                                   SDL_GPUTexture* target,
+                                   float scale) {
+  static const SBI_HiZPhase phases[] = {SBI_HIZ_EARLY, SBI_HIZ_LATE};
+  SBI_View* view = &state->views[0];
+  for (Uint32 i = 0; i < SDL_arraysize(phases); i++) {
+    SBI_HiZCull(&state->hiz, &state->billboard, view, scale, phases[i],
+                cmd_buf);
+
+    SDL_GPURenderPass* render_pass =
+        SBI_HiZBeginPass(&state->hiz, target, phases[i], cmd_buf);
+    SBI_ViewBegin(view, render_pass, scale);
+    SBI_HiZDraw(&state->hiz, &state->billboard, view, phases[i], cmd_buf,
+                render_pass);
+
+    // Streamed chunks are depth tested occluders, but never culled, nor
+    // are the particles
+    SBI_Camera* camera = &view->camera;
+    if (phases[i] == SBI_HIZ_EARLY && state->world_path != NULL) {
+      SBI_ChunkStreamerDraw(&state->chunks, &state->billboard, camera->proj,
+                            camera->view, view->position, cmd_buf,
+                            render_pass);
+    }
+    if (phases[i] == SBI_HIZ_EARLY && state->particles_rate > 0.0f) {
+      SBI_ParticlesDraw(&state->particles, &state->billboard, camera->proj,
+                        camera->view, view->position, cmd_buf, render_pass);
+    }
+    SDL_EndGPURenderPass(render_pass);
+
+    SBI_HiZBuild(&state->hiz, cmd_buf);
+  }
+}
+
+static void simulation_draw_views(SBI_Simulation* state,
+                                  SDL_GPUCommandBuffer* cmd_buf,
+                                  SDL_GPURenderPass* render_pass,
+                                  float scale,
+                                  bool draw_grid) {
+  bool oit = state->billboard.blend == SBI_BILLBOARD_BLEND_OIT;
+  for (Uint32 i = 0; i < state->views_count; i++) {
+    SBI_View* view = &state->views[i];
+    SBI_ViewBegin(view, render_pass, scale);
+
+    // Get the camera where we are going to be drawing everything
+    SBI_Camera* camera = &view->camera;
+
+    // Composite the accumulated instances, covers only the view viewport
+    if (oit) {
+      SBI_OITResolve(&state->oit, render_pass);
+    }
+
+    // Draw the grid
+    if (draw_grid) {
+      SBI_GridDraw(&state->grid, camera->proj, camera->view, cmd_buf,
+                   render_pass);
+    }
+
+    if (!oit && !state->occlusion) {
+      simulation_draw_instances(state, view, cmd_buf, render_pass);
+    }
+  }
+}
+
+// CPU side of a frame shared by both backends
+static void simulation_prepare_frame(SBI_Simulation* state, float dt) {
+  // Take the latest simulation tick without waiting for the thread
+  if (state->threaded) {
+    const SBI_Snapshot* snapshot = SBI_SimThreadAcquire(&state->sim_thread);
+    SBI_SimThreadInterpolate(&state->sim_thread, snapshot,
+                             SDL_GetPerformanceCounter(),
+                             &state->views[0].camera,
+                             state->billboard.instances);
+    if (state->flock_count > 0) {
+      SBI_BillboardMarkDirty(&state->billboard, SBI_BILLBOARD_STREAM_POSITION,
+                             0, state->billboard.instances_count);
+    }
+  }
+
+  // Animated sets only need the new time, the frames are picked on the GPU
+  state->billboard.time += dt;
+
+  // Lights follow their instances when something moves them
+  if (state->threaded || state->flock_count > 0 ||
+      state->attached_count > 0) {
+    SBI_SimulationPlaceLights(state);
+  }
+
+  // Sorted sets are ordered back to front from the main camera
+  if (state->billboard.blend == SBI_BILLBOARD_BLEND_SORTED) {
+    SBI_ALIGN_VEC3 SBI_Vec3 eye = {0};
+    SBI_XFormGetPosition(state->views[0].camera.xform, eye);
+    SBI_BillboardSort(&state->billboard, eye);
+  }
+}
+
+// Draw every view on the CPU and copy the frame to the window surface
+static bool simulation_render_software(SBI_Simulation* state, float dt) {
+  Uint64 start_tick = SDL_GetPerformanceCounter();
+  simulation_prepare_frame(state, dt);
+
+  int width = 0;
+  int height = 0;
+  SDL_GetWindowSizeInPixels(state->window, &width, &height);
+  SBI_SoftRaster* raster = &state->soft_raster;
+  if (!SBI_SoftRasterPrepare(raster, (Uint32)width, (Uint32)height)) {
     return false;
   }
 
-  // Get window swap chain texture
-  SDL_GPUTexture* swapchain_texture = NULL;
-  if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmd_buf, state->window,
-                                             &swapchain_texture, NULL, NULL)) {
-    SDL_Log("Could not acquire swap chain texture: %s", SDL_GetError());
+  SBI_SoftRasterBegin(raster, (SDL_FColor){0.2f, 0.2f, 0.2f, 1.0f});
+  for (Uint32 i = 0; i < state->views_count; i++) {
+    SBI_View* view = &state->views[i];
+    SBI_Camera* camera = &view->camera;
+
+    // Same region and eye position as SBI_ViewBegin
+    SBI_XFormGetPosition(camera->xform, view->position);
+    SBI_SoftRasterViewport(raster, view->scissor);
+    SBI_SoftGridDraw(raster, camera->proj, camera->view);
+    SBI_SoftBillboardDraw(raster, &state->billboard, camera->proj,
+                          camera->view, view->position);
+  }
+  SBI_SoftRasterEnd(raster);
+
+  Uint64 present_tick = SDL_GetPerformanceCounter();
+  if (!SBI_SoftRasterPresent(raster, state->window)) {
+    return false;
   }
 
+  if (state->telemetry_enabled) {
+    float ms_per_tick = 1000.0f / (float)SDL_GetPerformanceFrequency();
+    SBI_TelemetrySample sample = {
+        .frame_ms = dt * 1000.0f,
+        .update_ms = state->update_time * 1000.0f,
+        .render_ms = (float)(present_tick - start_tick) * ms_per_tick,
+        .instances_count = state->billboard.instances_count,
+        .draws_count = raster->commands_count,
+    };
+    SBI_TelemetryPublish(&state->telemetry, &sample);
+  }
+  return true;
+}
+
+// Bounds of the set and of the resident chunks, the lights and the main
+// camera frustum as seen from the other views
+static void simulation_debug_draw(SBI_Simulation* state) {
+  SBI_DebugDraw* debug = &state->debug_draw;
+  SBI_ALIGN_XFORM SBI_XForm origin = {0};
+  SBI_XFormIdentity(origin);
+  SBI_DebugDrawAxis(debug, origin, 1.0f, SBI_DEBUG_DRAW_OVERLAY);
+
+  if (state->billboard.instances_count > 0) {
+    SBI_DebugDrawAABB(debug, state->billboard.bounds_min,
+                      state->billboard.bounds_max,
+                      SBI_DEBUG_COLOR(255, 255, 0, 255),
+                      SBI_DEBUG_DRAW_DEPTH);
+  }
+
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamer* chunks = &state->chunks;
+    for (Uint32 i = 0; i < chunks->chunks_count; i++) {
+      if (chunks->entries[i].state == SBI_CHUNK_RESIDENT) {
+        SBI_DebugDrawAABB(debug, chunks->infos[i].min, chunks->infos[i].max,
+                          SBI_DEBUG_COLOR(0, 255, 255, 255),
+                          SBI_DEBUG_DRAW_DEPTH);
+      }
+    }
+  }
+
+  for (Uint32 i = 0; i < state->lights_count; i++) {
+    const SBI_PointLight* light = &state->lights.lights[i];
+    SBI_DebugDrawSphere(debug, light->position, light->position[3],
+                        SBI_DEBUG_COLOR(255, 128, 0, 255),
+                        SBI_DEBUG_DRAW_OVERLAY);
+  }
+
+  if (state->views_count > 1) {
+    SBI_Camera* camera = &state->views[0].camera;
+    SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+    SBI_Mat4Mul(camera->proj, camera->view, pv);
+    SBI_DebugDrawFrustum(debug, pv, SBI_DEBUG_COLOR(255, 255, 255, 255),
+                         SBI_DEBUG_DRAW_DEPTH);
+  }
+}
+
+// Upload the frame and record the scene into target, nothing is drawn
+// without one. The caller submits cmd_buf, also when this fails.
+static bool simulation_record_frame(SBI_Simulation* state,
+                                    float dt,
+                                    SDL_GPUCommandBuffer* cmd_buf,
+                                    SDL_GPUTexture* target,
+                                    Uint32 width,
+                                    Uint32 height,
+                                    Uint64* upload_ticks) {
+  simulation_prepare_frame(state, dt);
+
+  // Upload instances once per frame, every view draws from the same buffers
+  Uint64 upload_tick = SDL_GetPerformanceCounter();
+  SBI_BillboardUpload(&state->billboard, cmd_buf);
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamerUpload(&state->chunks, cmd_buf);
+  }
+  if (state->sprites_path != NULL) {
+    SBI_SpriteStreamerUpload(&state->sprites, cmd_buf);
+  }
+  if (state->lights_count > 0) {
+    SBI_LightsUpload(&state->lights, cmd_buf);
+  }
+  if (state->particles_rate > 0.0f) {
+    SBI_ParticlesUpdate(&state->particles, dt, cmd_buf);
+  }
+  if (state->debug_enabled) {
+    simulation_debug_draw(state);
+    SBI_DebugDrawUpload(&state->debug_draw, cmd_buf);
+  }
+  *upload_ticks = SDL_GetPerformanceCounter() - upload_tick;
+
   // Render when we have a texture
-  if (swapchain_texture != NULL) {
+  SBI_DynamicResolution* resolution = &state->resolution;
+  if (target != NULL) {
+    // Scene goes to the scaled target when dynamic resolution is on
+    bool scaled = resolution->enabled &&
+                  SBI_DynamicResolutionPrepare(resolution, width,
+                                               height);
+    float scale = scaled ? resolution->scale : 1.0f;
+    bool grid_native = scaled && resolution->grid_native;
+
+    // Bin the lights before any pass shades the instances
+    if (state->lights_count > 0) {
+      if (!SBI_LightsPrepare(&state->lights, width, height)) {
+        return false;
+      }
+      SBI_LightsCull(&state->lights, &state->views[0], scale, cmd_buf);
+    }
+
+    // Transparent instances go in one unsorted pass to the OIT targets
+    if (state->billboard.blend == SBI_BILLBOARD_BLEND_OIT) {
+      if (!SBI_OITPrepare(&state->oit, width, height)) {
+        return false;
+      }
+
+      SDL_GPURenderPass* accum_pass =
+          SBI_OITBeginAccumulation(&state->oit, cmd_buf);
+      simulation_accumulate_views(state, cmd_buf, accum_pass, scale);
+      SDL_EndGPURenderPass(accum_pass);
+    }
+
     SDL_GPUColorTargetInfo color_target_info = {
-        .texture = swapchain_texture,
+        .texture = scaled ? resolution->target : target,
         .clear_color = (SDL_FColor){0.2f, 0.2f, 0.2f, 1.0f},
         .load_op = SDL_GPU_LOADOP_CLEAR,
         .store_op = SDL_GPU_STOREOP_STORE,
@@ -66,32 +717,190 @@ bool SBI_SimulationRender(SBI_Simulation* state, float dt) {
 
     SDL_GPURenderPass* render_pass =
         SDL_BeginGPURenderPass(cmd_buf, &color_target_info, 1, NULL);
-    {
-      SDL_SetGPUViewport(render_pass, &state->viewport);
+    simulation_draw_views(state, cmd_buf, render_pass, scale, !grid_native);
+    SDL_EndGPURenderPass(render_pass);
 
-      // Get the camera where we are going to be drawing everything
-      SBI_Camera* camera = &state->camera;
+    // Opaque instances are drawn over the grid with depth and culling
+    if (state->occlusion) {
+      if (!SBI_HiZPrepare(&state->hiz, width, height,
+                          (Uint32)state->billboard.instances_count)) {
+        return false;
+      }
+      simulation_draw_culled(state, cmd_buf, color_target_info.texture,
+                             scale);
+    }
 
-      // Draw the grid
-      SBI_GridDraw(&state->grid, camera->proj, camera->view, cmd_buf,
-                   render_pass);
+    // Debug primitives are hidden by the scene only when it has depth
+    if (state->debug_enabled) {
+      SDL_GPUTexture* scene_depth = state->occlusion ? state->hiz.depth : NULL;
+      if (scene_depth == NULL &&
+          !SBI_DebugDrawPrepare(&state->debug_draw, width, height)) {
+        return false;
+      }
+      SBI_DebugDrawRender(&state->debug_draw, state->views,
+                          state->views_count, scale,
+                          color_target_info.texture, scene_depth, cmd_buf);
+    }
 
-      // Draw the billboard
-      SBI_ALIGN_VEC3 SBI_Vec3 view_pos = {0};
-      SBI_XFormGetPosition(camera->xform, view_pos);
-      SBI_BillboardDraw(&state->billboard, camera->proj, camera->view, view_pos,
-                        cmd_buf, render_pass);
+    if (scaled) {
+      SBI_DynamicResolutionBlit(resolution, cmd_buf, target,
+                                width, height);
     }
-    SDL_EndGPURenderPass(render_pass);
+
+    // Composite the grid over the upscaled scene at native resolution
+    if (grid_native) {
+      SDL_GPUColorTargetInfo overlay_target_info = {
+          .texture = target,
+          .load_op = SDL_GPU_LOADOP_LOAD,
+          .store_op = SDL_GPU_STOREOP_STORE,
+      };
+
+      render_pass =
+          SDL_BeginGPURenderPass(cmd_buf, &overlay_target_info, 1, NULL);
+      for (Uint32 i = 0; i < state->views_count; i++) {
+        SBI_View* view = &state->views[i];
+        SBI_ViewBegin(view, render_pass, 1.0f);
+        SBI_GridDraw(&state->grid, view->camera.proj, view->camera.view,
+                     cmd_buf, render_pass);
+      }
+      SDL_EndGPURenderPass(render_pass);
+    }
+  }
+  return true;
+}
+
+bool SBI_SimulationNeedsRender(const SBI_Simulation* state) {
+  return !state->on_demand || state->redraw ||
+         state->rendered_version != simulation_version(state) ||
+         simulation_animating(state) || state->streaming;
+}
+
+bool SBI_SimulationIdle(SBI_Simulation* state) {
+  return state->on_demand && state->settled &&
+         !SBI_SimulationNeedsRender(state);
+}
+
+bool SBI_SimulationRender(SBI_Simulation* state, float dt) {
+  state->rendered_version = simulation_version(state);
+  state->redraw = false;
+  if (state->software) {
+    return simulation_render_software(state, dt);
+  }
+
+  Uint64 start_tick = SDL_GetPerformanceCounter();
+  SDL_GPUCommandBuffer* cmd_buf = SDL_AcquireGPUCommandBuffer(state->device);
+  if (cmd_buf == NULL) {
+    SDL_Log("Could not acquire GPU command buffer: %s", SDL_GetError());
+    return false;
   }
 
+  // Get window swap chain texture
+  SDL_GPUTexture* swapchain_texture = NULL;
+  Uint32 swapchain_w = 0;
+  Uint32 swapchain_h = 0;
+  if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmd_buf, state->window,
+                                             &swapchain_texture, &swapchain_w,
+                                             &swapchain_h)) {
+    SDL_Log("Could not acquire swap chain texture: %s", SDL_GetError());
+  }
+
+  Uint64 upload_ticks = 0;
+  if (!simulation_record_frame(state, dt, cmd_buf, swapchain_texture,
+                               swapchain_w, swapchain_h, &upload_ticks)) {
+    // The swapchain is acquired, the buffer can't be cancelled
+    SDL_SubmitGPUCommandBuffer(cmd_buf);
+    return false;
+  }
+
+  // The wait on the fence approximates the GPU time of the frame
+  Uint64 submit_tick = SDL_GetPerformanceCounter();
   SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd_buf);
   SDL_WaitForGPUFences(state->device, true, &fence, 1);
-  SDL_ReleaseGPUFence(state->device, fence);
+  SBI_GPUMemoryEndFrame(&state->gpu_memory, fence);
+  float gpu_time = (float)(SDL_GetPerformanceCounter() - submit_tick) /
+                   (float)SDL_GetPerformanceFrequency();
+  SBI_DynamicResolution* resolution = &state->resolution;
+  if (resolution->enabled && swapchain_texture != NULL) {
+    SBI_DynamicResolutionUpdate(resolution, gpu_time);
+  }
+
+  if (state->telemetry_enabled) {
+    float ms_per_tick = 1000.0f / (float)SDL_GetPerformanceFrequency();
+    SBI_TelemetrySample sample = {
+        .frame_ms = dt * 1000.0f,
+        .update_ms = state->update_time * 1000.0f,
+        .render_ms = (float)(submit_tick - start_tick) * ms_per_tick,
+        .upload_ms = (float)upload_ticks * ms_per_tick,
+        .fence_ms = gpu_time * 1000.0f,
+        .instances_count = state->billboard.instances_count,
+        .uploaded_bytes = state->billboard.uploaded_bytes,
+        .draws_count = state->billboard.draws_count,
+    };
+    SBI_TelemetryPublish(&state->telemetry, &sample);
+  }
   return true;
 }
 
+bool SBI_SimulationRenderTarget(SBI_Simulation* state,
+                                float dt,
+                                SDL_GPUCommandBuffer* cmd_buf,
+                                SDL_GPUTexture* target,
+                                Uint32 width,
+                                Uint32 height) {
+  Uint64 upload_ticks = 0;
+  return simulation_record_frame(state, dt, cmd_buf, target, width, height,
+                                 &upload_ticks);
+}
+
+void SBI_SimulationPlaceLights(SBI_Simulation* state) {
+  SBI_Lights* lights = &state->lights;
+  SBI_Billboard* billboard = &state->billboard;
+  if (state->lights_count == 0 || billboard->instances_count == 0) {
+    return;
+  }
+
+  // A light takes the position and the color of its instance
+  Uint64 stride = billboard->instances_count / lights->lights_count;
+  for (Uint32 i = 0; i < lights->lights_count; i++) {
+    Uint64 index = i * SDL_max(stride, 1);
+    Uint32 color = billboard->colors[index];
+    SBI_PointLight* light = &lights->lights[i];
+    SBI_Vec3Copy(billboard->instances[index], light->position);
+    light->position[3] = LIGHT_RADIUS;
+    for (Uint32 c = 0; c < 3; c++) {
+      light->color[c] = (float)((color >> (c * 8)) & 0xFF) / 255.0f;
+    }
+    light->color[3] = LIGHT_INTENSITY;
+  }
+  SBI_LightsMarkDirty(lights);
+}
+
 void SBI_SimulationDestroy(SBI_Simulation* state) {
-  SBI_GridDestroy(&state->grid);
+  if (state->threaded) {
+    SBI_SimThreadDestroy(&state->sim_thread);
+  }
+  if (state->software) {
+    SBI_SoftRasterDestroy(&state->soft_raster);
+  } else {
+    SBI_GridDestroy(&state->grid);
+  }
   SBI_BillboardDestroy(&state->billboard);
+  SBI_DebugDrawDestroy(&state->debug_draw);
+  SBI_DynamicResolutionDestroy(&state->resolution);
+  SBI_OITDestroy(&state->oit);
+  SBI_HiZDestroy(&state->hiz);
+  SBI_LightsDestroy(&state->lights);
+  SBI_TelemetryDestroy(&state->telemetry);
+  if (state->flock_count > 0) {
+    SBI_FlockDestroy(&state->flock);
+  }
+  SBI_HierarchyDestroy(&state->hierarchy);
+  SBI_ParticlesDestroy(&state->particles);
+  if (state->world_path != NULL) {
+    SBI_ChunkStreamerDestroy(&state->chunks);
+  }
+  if (state->sprites_path != NULL) {
+    SBI_SpriteStreamerDestroy(&state->sprites);
+  }
+  SBI_GPUMemoryDestroy(&state->gpu_memory);
 }
@@ -8,19 +8,89 @@
 
 #include "billboard.h"
 #include "camera.h"
+#include "chunks.h"
+#include "debugdraw.h"
+#include "flock.h"
+#include "generator.h"
+#include "gpumemory.h"
 #include "grid.h"
+#include "hierarchy.h"
+#include "hiz.h"
+#include "lights.h"
+#include "oit.h"
+#include "particles.h"
+#include "resolution.h"
 #include "shader.h"
+#include "simthread.h"
+#include "softraster.h"
+#include "sprites.h"
+#include "telemetry.h"
+#include "view.h"
 
 #define BILLBOARD_COUNT (10)
+#define MAX_VIEWS (4)
+#define BILLBOARD_ATLAS_COLUMNS (4)
+#define BILLBOARD_ATLAS_ROWS (4)
+#define LIGHT_RADIUS (1.5f)
+#define LIGHT_INTENSITY (1.5f)
+#define ATTACHED_NODES (4)
+#define ATTACHED_SPACING (8.0f)
+#define ATTACHED_RADIUS (2.0f)
+#define PARTICLE_EMITTERS (4)
+#define PARTICLE_LIFE_MIN (1.0f)
+#define PARTICLE_LIFE_MAX (2.0f)
+#define PARTICLE_RING_RADIUS (6.0f)
 
 // Global values for the simulation
 typedef struct {
   SDL_Window* window;
   SDL_GPUDevice* device;
   SDL_GPUViewport viewport;
-  SBI_Camera camera;
+  SBI_GPUMemory gpu_memory;
+  SBI_View views[MAX_VIEWS];
+  Uint32 views_count;
   SBI_Grid grid;
+  SBI_DebugDraw debug_draw;
+  bool debug_enabled;
   SBI_Billboard billboard;
+  SBI_BillboardMode billboard_mode;
+  SBI_BillboardBlend billboard_blend;
+  float billboard_opacity;
+  bool billboard_animated;
+  SBI_GeneratorOptions scene;
+  SBI_OIT oit;
+  SBI_HiZ hiz;
+  bool occlusion;
+  SBI_Lights lights;
+  Uint32 lights_count;
+  SBI_Telemetry telemetry;
+  bool telemetry_enabled;
+  SBI_SoftRaster soft_raster;
+  bool software;
+  float update_time;
+  SBI_Flock flock;
+  Uint64 flock_count;
+  SBI_Hierarchy hierarchy;
+  Uint64 attached_count;
+  float attached_time;
+  SBI_Particles particles;
+  float particles_rate;
+  SBI_SimThread sim_thread;
+  bool threaded;
+  Uint64 snapshot_version;
+  float tick_time;
+  SBI_ChunkStreamer chunks;
+  SBI_DynamicResolution resolution;
+  float resolution_budget;
+  bool grid_native;
+  const char* world_path;
+  SBI_SpriteStreamer sprites;
+  const char* sprites_path;
+  bool on_demand;
+  bool redraw;
+  bool settled;
+  bool streaming;
+  Uint64 rendered_version;
   Uint64 last_tick;
   float iter_delta_time;
   float cur_frame_time;
@@ -37,9 +107,30 @@ void SBI_SimulationEvent(SBI_Simulation* state, SDL_Event* event);
 // Update the simulation (fixed rate).
 void SBI_SimulationUpdate(SBI_Simulation* state, float dt);
 
+// Whether a frame would differ from the presented one or the window needs
+// to be presented again. Always true unless rendering on demand.
+bool SBI_SimulationNeedsRender(const SBI_Simulation* state);
+
+// Whether nothing changes until the next event: the last update moved
+// nothing and the presented frame is current (on demand only)
+bool SBI_SimulationIdle(SBI_Simulation* state);
+
 // Render the simulation (fixed rate).
 bool SBI_SimulationRender(SBI_Simulation* state, float dt);
 
+// Record a frame into target instead of the swapchain, the target must
+// have the swapchain format. The caller submits cmd_buf, also when this
+// fails. Dynamic resolution keeps its current scale.
+bool SBI_SimulationRenderTarget(SBI_Simulation* state,
+                                float dt,
+                                SDL_GPUCommandBuffer* cmd_buf,
+                                SDL_GPUTexture* target,
+                                Uint32 width,
+                                Uint32 height);
+
+// Move the lights to the instances that carry them, spread over the set
+void SBI_SimulationPlaceLights(SBI_Simulation* state);
+
 // Release the resources creates by the simulation.
 void SBI_SimulationDestroy(SBI_Simulation* state);
 
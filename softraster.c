@@ -0,0 +1,775 @@
+#include "softraster.h"
+
+#include <SDL3/SDL_intrin.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+// Corners closer than this to the eye plane cull their billboard, quads
+// are never clipped against the near plane
+#define SOFT_NEAR_W (1e-3f)
+
+// Scale of the plane coordinates of the grid, as in grid.frag
+#define SOFT_GRID_SCALE (10.0f)
+
+// Edges are evaluated for 4 pixels of a row at once, mapped to SSE2 when
+// available and to plain loops otherwise, like the kernels of xmath_batch.c
+#if defined(SDL_SSE2_INTRINSICS)
+typedef __m128 Lanes;
+
+static inline Lanes lanes_set(float x) {
+  return _mm_set1_ps(x);
+}
+
+static inline Lanes lanes_make(float a, float b, float c, float d) {
+  return _mm_setr_ps(a, b, c, d);
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b) {
+  return _mm_add_ps(a, b);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b) {
+  return _mm_mul_ps(a, b);
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b) {
+  return _mm_min_ps(a, b);
+}
+
+// Bit i is set when lane i is zero or positive
+static inline Uint32 lanes_nonnegative(Lanes a) {
+  return (Uint32)_mm_movemask_ps(_mm_cmpge_ps(a, _mm_setzero_ps()));
+}
+#else
+typedef struct {
+  float v[4];
+} Lanes;
+
+#define LANES_MAP(type, expr)   \
+  type r;                       \
+  for (int i = 0; i < 4; i++) { \
+    r.v[i] = (expr);            \
+  }                             \
+  return r
+
+static inline Lanes lanes_set(float x) {
+  LANES_MAP(Lanes, x);
+}
+
+static inline Lanes lanes_make(float a, float b, float c, float d) {
+  return (Lanes){{a, b, c, d}};
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] + b.v[i]);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] * b.v[i]);
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] < b.v[i] ? a.v[i] : b.v[i]);
+}
+
+static inline Uint32 lanes_nonnegative(Lanes a) {
+  Uint32 mask = 0;
+  for (int i = 0; i < 4; i++) {
+    mask |= (a.v[i] >= 0.0f ? 1u : 0u) << i;
+  }
+  return mask;
+}
+#endif
+
+// Setup of the instances of one billboard draw, shared by the workers
+typedef struct {
+  SBI_SoftRaster* raster;
+  const SBI_Billboard* billboard;
+  const SBI_BillboardSortKey* order;
+  Uint32 command;
+  SDL_Rect viewport;
+  SBI_ALIGN_MAT4 SBI_Mat4 pv;
+  SBI_ALIGN_VEC3 SBI_Vec3 view_pos;
+  SBI_ALIGN_VEC3 SBI_Vec3 view_right;
+  SBI_ALIGN_VEC3 SBI_Vec3 view_up;
+  float aspect;
+} SoftBillboardJob;
+
+// Make room for one more item of a growable array, doubling its capacity
+static bool soft_reserve(void** items,
+                         Uint32* capacity,
+                         Uint32 count,
+                         size_t item_size) {
+  if (count < *capacity) {
+    return true;
+  }
+
+  Uint32 new_capacity = SDL_max(*capacity * 2, 64);
+  void* new_items = SDL_realloc(*items, item_size * new_capacity);
+  if (new_items == NULL) {
+    return false;
+  }
+  *items = new_items;
+  *capacity = new_capacity;
+  return true;
+}
+
+static void soft_release_bins(SBI_SoftRaster* raster) {
+  Uint32 tiles = raster->tiles_x * raster->tiles_y;
+  for (Uint32 w = 0; w < SBI_JOB_MAX_WORKERS; w++) {
+    SBI_SoftWorker* worker = &raster->workers[w];
+    for (Uint32 t = 0; worker->bins != NULL && t < tiles; t++) {
+      SDL_free(worker->bins[t].indices);
+    }
+    SDL_free(worker->bins);
+    worker->bins = NULL;
+  }
+}
+
+static void soft_release_target(SBI_SoftRaster* raster) {
+  soft_release_bins(raster);
+  SDL_DestroySurface(raster->surface);
+  SDL_aligned_free(raster->pixels);
+  raster->surface = NULL;
+  raster->pixels = NULL;
+  raster->width = 0;
+  raster->height = 0;
+  raster->stride = 0;
+  raster->tiles_x = 0;
+  raster->tiles_y = 0;
+}
+
+bool SBI_SoftRasterLoad(SBI_SoftRaster* raster, Uint32 workers_count) {
+  SDL_memset(raster, 0, sizeof(SBI_SoftRaster));
+  return SBI_JobPoolLoad(&raster->pool, workers_count);
+}
+
+bool SBI_SoftRasterPrepare(SBI_SoftRaster* raster,
+                           Uint32 width,
+                           Uint32 height) {
+  width = SDL_max(width, 1);
+  height = SDL_max(height, 1);
+  if (raster->pixels != NULL && raster->width == width &&
+      raster->height == height) {
+    return true;
+  }
+
+  soft_release_target(raster);
+
+  Uint32 stride = (width + 3) & ~3u;
+  raster->pixels = SDL_aligned_alloc(16, sizeof(Uint32) * stride * height);
+  if (raster->pixels == NULL) {
+    SDL_Log("Could not allocate a %dx%d software framebuffer", width,
+            height);
+    return false;
+  }
+
+  raster->surface =
+      SDL_CreateSurfaceFrom((int)width, (int)height, SDL_PIXELFORMAT_XRGB8888,
+                            raster->pixels, (int)(stride * sizeof(Uint32)));
+  if (raster->surface == NULL) {
+    SDL_Log("Couldn't create software framebuffer surface: %s",
+            SDL_GetError());
+    soft_release_target(raster);
+    return false;
+  }
+
+  raster->width = width;
+  raster->height = height;
+  raster->stride = stride;
+  raster->tiles_x = (width + SBI_SOFT_TILE_SIZE - 1) / SBI_SOFT_TILE_SIZE;
+  raster->tiles_y = (height + SBI_SOFT_TILE_SIZE - 1) / SBI_SOFT_TILE_SIZE;
+
+  // Every worker bins into its own lists, no locks while binning
+  Uint32 tiles = raster->tiles_x * raster->tiles_y;
+  for (Uint32 w = 0; w < raster->pool.workers_count; w++) {
+    raster->workers[w].bins = SDL_calloc(tiles, sizeof(SBI_SoftBin));
+    if (raster->workers[w].bins == NULL) {
+      SDL_Log("Could not allocate memory for %d software tiles", tiles);
+      soft_release_target(raster);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Pack a color to XRGB8888, components are clamped to 0..1
+static Uint32 soft_pack_color(float r, float g, float b) {
+  Uint32 rb = (Uint32)(SDL_clamp(r, 0.0f, 1.0f) * 255.0f + 0.5f);
+  Uint32 gb = (Uint32)(SDL_clamp(g, 0.0f, 1.0f) * 255.0f + 0.5f);
+  Uint32 bb = (Uint32)(SDL_clamp(b, 0.0f, 1.0f) * 255.0f + 0.5f);
+  return (rb << 16) | (gb << 8) | bb;
+}
+
+void SBI_SoftRasterBegin(SBI_SoftRaster* raster, SDL_FColor clear_color) {
+  raster->clear_color =
+      soft_pack_color(clear_color.r, clear_color.g, clear_color.b);
+  raster->viewport = (SDL_Rect){0, 0, (int)raster->width,
+                                (int)raster->height};
+  raster->commands_count = 0;
+  for (Uint32 w = 0; w < raster->pool.workers_count; w++) {
+    SBI_SoftWorker* worker = &raster->workers[w];
+    worker->quads_count = 0;
+    for (Uint32 t = 0; t < raster->tiles_x * raster->tiles_y; t++) {
+      worker->bins[t].count = 0;
+    }
+  }
+}
+
+void SBI_SoftRasterViewport(SBI_SoftRaster* raster, SDL_Rect viewport) {
+  SDL_Rect bounds = {0, 0, (int)raster->width, (int)raster->height};
+  if (!SDL_GetRectIntersection(&viewport, &bounds, &raster->viewport)) {
+    raster->viewport = (SDL_Rect){0, 0, 0, 0};
+  }
+}
+
+// Record a draw in the current viewport, NULL when there is no room left
+static SBI_SoftCommand* soft_push_command(SBI_SoftRaster* raster,
+                                          SBI_SoftCommandType type,
+                                          const SBI_Mat4 proj,
+                                          const SBI_Mat4 view) {
+  if (raster->commands_count >= SBI_SOFT_MAX_COMMANDS) {
+    SDL_Log("Software frame is full, dropping a draw");
+    return NULL;
+  }
+
+  if (raster->viewport.w <= 0 || raster->viewport.h <= 0) {
+    return NULL;
+  }
+
+  SBI_SoftCommand* command = &raster->commands[raster->commands_count++];
+  command->type = type;
+  command->viewport = raster->viewport;
+  SBI_Mat4Mul(proj, view, command->pv);
+  SBI_Mat4Invert(command->pv, command->pv_inv);
+  return command;
+}
+
+void SBI_SoftGridDraw(SBI_SoftRaster* raster,
+                      const SBI_Mat4 proj,
+                      const SBI_Mat4 view) {
+  soft_push_command(raster, SBI_SOFT_COMMAND_GRID, proj, view);
+}
+
+// Project the corners of an instance like the vertex shader of its mode
+// and turn them into a screen quad, false when nothing is visible
+static bool soft_setup_quad(const SoftBillboardJob* job,
+                            Uint64 index,
+                            SBI_SoftQuad* quad) {
+  static const float corners[4][2] = {
+      {-1.0f, +1.0f},
+      {-1.0f, -1.0f},
+      {+1.0f, -1.0f},
+      {+1.0f, +1.0f},
+  };
+  const SBI_Billboard* billboard = job->billboard;
+  const float* instance = billboard->instances[index];
+  float scale = instance[3];
+
+  SBI_ALIGN_VEC4 SBI_Vec4 clip[4];
+  if (billboard->mode == SBI_BILLBOARD_FIXED_SCALE) {
+    // Offset in clip space so the size doesn't change with the distance
+    SBI_ALIGN_VEC4 SBI_Vec4 center = {instance[0], instance[1], instance[2],
+                                      1.0f};
+    SBI_Mat4TransformVec4(job->pv, center, clip[0]);
+    for (Uint32 k = 0; k < 4; k++) {
+      SDL_memcpy(clip[k], clip[0], sizeof(SBI_Vec4));
+      clip[k][0] += corners[k][0] * scale * job->aspect * clip[k][3];
+      clip[k][1] += corners[k][1] * scale * clip[k][3];
+    }
+  } else {
+    SBI_ALIGN_VEC3 SBI_Vec3 right = {0};
+    SBI_ALIGN_VEC3 SBI_Vec3 up = {0};
+    if (billboard->mode == SBI_BILLBOARD_SCREEN) {
+      SBI_Vec3Copy(job->view_right, right);
+      SBI_Vec3Copy(job->view_up, up);
+    } else {
+      SBI_ALIGN_VEC3 SBI_Vec3 f = {0};
+      SBI_Vec3Sub(job->view_pos, instance, f);
+      float len_xz = SDL_max(f[0] * f[0] + f[2] * f[2], 1e-12f);
+      SBI_Vec3Make(f[2], 0.0f, -f[0], right);
+      SBI_Vec3Scale(right, 1.0f / SDL_sqrtf(len_xz), right);
+      if (billboard->mode == SBI_BILLBOARD_CYLINDRICAL) {
+        SBI_Vec3Make(0.0f, 1.0f, 0.0f, up);
+      } else {
+        float len = SDL_max(SBI_Vec3Dot(f, f), 1e-12f);
+        SBI_Vec3Scale(f, 1.0f / SDL_sqrtf(len), f);
+        SBI_Vec3Cross(f, right, up);
+      }
+    }
+
+    for (Uint32 k = 0; k < 4; k++) {
+      SBI_ALIGN_VEC4 SBI_Vec4 world = {0.0f, 0.0f, 0.0f, 1.0f};
+      for (Uint32 c = 0; c < 3; c++) {
+        world[c] = instance[c] + right[c] * corners[k][0] * scale +
+                   up[c] * corners[k][1] * scale;
+      }
+      SBI_Mat4TransformVec4(job->pv, world, clip[k]);
+    }
+  }
+
+  // Viewport transform of the corners, y grows down the framebuffer
+  const SDL_Rect* viewport = &job->viewport;
+  float xs[4];
+  float ys[4];
+  bool beyond_far = true;
+  for (Uint32 k = 0; k < 4; k++) {
+    if (clip[k][3] <= SOFT_NEAR_W) {
+      return false;
+    }
+    float inv_w = 1.0f / clip[k][3];
+    xs[k] = viewport->x + (clip[k][0] * inv_w * 0.5f + 0.5f) * viewport->w;
+    ys[k] = viewport->y + (0.5f - clip[k][1] * inv_w * 0.5f) * viewport->h;
+    beyond_far = beyond_far && clip[k][2] > clip[k][3];
+  }
+  if (beyond_far) {
+    return false;
+  }
+
+  // Pixels whose center may be inside, clamped before the conversion
+  float min_x = SDL_min(SDL_min(xs[0], xs[1]), SDL_min(xs[2], xs[3]));
+  float max_x = SDL_max(SDL_max(xs[0], xs[1]), SDL_max(xs[2], xs[3]));
+  float min_y = SDL_min(SDL_min(ys[0], ys[1]), SDL_min(ys[2], ys[3]));
+  float max_y = SDL_max(SDL_max(ys[0], ys[1]), SDL_max(ys[2], ys[3]));
+  quad->min_x = (Sint32)SDL_floorf(SDL_max(min_x, (float)viewport->x));
+  quad->min_y = (Sint32)SDL_floorf(SDL_max(min_y, (float)viewport->y));
+  quad->max_x = (Sint32)SDL_floorf(
+      SDL_min(max_x, (float)(viewport->x + viewport->w - 1)));
+  quad->max_y = (Sint32)SDL_floorf(
+      SDL_min(max_y, (float)(viewport->y + viewport->h - 1)));
+  if (quad->min_x > quad->max_x || quad->min_y > quad->max_y) {
+    return false;
+  }
+
+  // Edge k goes from corner k to the next one, flipped so that the
+  // inside is positive whatever the winding on screen
+  float area = 0.0f;
+  for (Uint32 k = 0; k < 4; k++) {
+    Uint32 next = (k + 1) % 4;
+    quad->edges[k][0] = ys[k] - ys[next];
+    quad->edges[k][1] = xs[next] - xs[k];
+    quad->edges[k][2] = xs[k] * ys[next] - xs[next] * ys[k];
+    area += quad->edges[k][2];
+  }
+  if (SDL_fabsf(area) < 1e-6f) {
+    return false;
+  }
+  for (Uint32 k = 0; area < 0.0f && k < 4; k++) {
+    quad->edges[k][0] = -quad->edges[k][0];
+    quad->edges[k][1] = -quad->edges[k][1];
+    quad->edges[k][2] = -quad->edges[k][2];
+  }
+
+  // RGBA8 with red in the lowest byte, premultiplied like billboard.frag
+  Uint32 packed = billboard->colors[index];
+  float alpha = (float)(packed >> 24) / 255.0f * billboard->opacity;
+  quad->alpha = (Uint32)(SDL_clamp(alpha, 0.0f, 1.0f) * 255.0f + 0.5f);
+  if (quad->alpha == 0) {
+    return false;
+  }
+  Uint32 r = (packed & 0xFF) * quad->alpha / 255;
+  Uint32 g = ((packed >> 8) & 0xFF) * quad->alpha / 255;
+  Uint32 b = ((packed >> 16) & 0xFF) * quad->alpha / 255;
+  quad->color = (r << 16) | (g << 8) | b;
+  quad->command = job->command;
+  return true;
+}
+
+// Project and bin a range of instances, each worker keeps them in order
+static void soft_setup_job(void* data, Uint32 w, Uint64 begin, Uint64 end) {
+  const SoftBillboardJob* job = data;
+  SBI_SoftRaster* raster = job->raster;
+  SBI_SoftWorker* worker = &raster->workers[w];
+
+  for (Uint64 i = begin; i < end; i++) {
+    Uint64 index = job->order != NULL ? job->order[i].index : i;
+    if (!soft_reserve((void**)&worker->quads, &worker->quads_capacity,
+                      worker->quads_count, sizeof(SBI_SoftQuad))) {
+      worker->failed = true;
+      return;
+    }
+
+    SBI_SoftQuad* quad = &worker->quads[worker->quads_count];
+    if (!soft_setup_quad(job, index, quad)) {
+      continue;
+    }
+
+    Uint32 quad_index = worker->quads_count++;
+    Uint32 tile_x0 = (Uint32)quad->min_x / SBI_SOFT_TILE_SIZE;
+    Uint32 tile_x1 = (Uint32)quad->max_x / SBI_SOFT_TILE_SIZE;
+    Uint32 tile_y0 = (Uint32)quad->min_y / SBI_SOFT_TILE_SIZE;
+    Uint32 tile_y1 = (Uint32)quad->max_y / SBI_SOFT_TILE_SIZE;
+    for (Uint32 ty = tile_y0; ty <= tile_y1; ty++) {
+      for (Uint32 tx = tile_x0; tx <= tile_x1; tx++) {
+        SBI_SoftBin* bin = &worker->bins[ty * raster->tiles_x + tx];
+        if (!soft_reserve((void**)&bin->indices, &bin->capacity, bin->count,
+                          sizeof(Uint32))) {
+          worker->failed = true;
+          return;
+        }
+        bin->indices[bin->count++] = quad_index;
+      }
+    }
+  }
+}
+
+void SBI_SoftBillboardDraw(SBI_SoftRaster* raster,
+                           const SBI_Billboard* billboard,
+                           const SBI_Mat4 proj,
+                           const SBI_Mat4 view,
+                           const SBI_Vec3 view_pos) {
+  if (billboard->instances_count == 0) {
+    return;
+  }
+
+  SBI_SoftCommand* command =
+      soft_push_command(raster, SBI_SOFT_COMMAND_BILLBOARD, proj, view);
+  if (command == NULL) {
+    return;
+  }
+
+  SoftBillboardJob job = {
+      .raster = raster,
+      .billboard = billboard,
+      .command = raster->commands_count - 1,
+      .viewport = command->viewport,
+      .aspect = proj[5] != 0.0f ? proj[0] / proj[5] : 1.0f,
+  };
+  SDL_memcpy(job.pv, command->pv, sizeof(SBI_Mat4));
+  SBI_Vec3Copy(view_pos, job.view_pos);
+
+  // Camera axes are the rows of the view rotation, used by the screen mode
+  SBI_Vec3Make(view[0], view[4], view[8], job.view_right);
+  SBI_Vec3Make(view[1], view[5], view[9], job.view_up);
+
+  // Sort keys hold the back to front order once the set has been sorted
+  if (billboard->blend == SBI_BILLBOARD_BLEND_SORTED &&
+      (billboard->sorted || billboard->gpu_sorted)) {
+    job.order = billboard->sort_keys;
+  }
+
+  SBI_JobPoolRun(&raster->pool, soft_setup_job, &job,
+                 billboard->instances_count);
+
+  for (Uint32 w = 0; w < raster->pool.workers_count; w++) {
+    if (raster->workers[w].failed) {
+      SDL_Log("Could not allocate memory to bin billboards, some are missing");
+      raster->workers[w].failed = false;
+    }
+  }
+}
+
+// Tile being shaded. The draws are replayed front to back, each pixel
+// keeps the transmittance left by the layers in front of it (255: none),
+// so pixels and tiles that are already opaque skip the rest.
+typedef struct {
+  SDL_Rect rect;
+  Uint32 open;
+  Uint8 transmit[SBI_SOFT_TILE_SIZE * SBI_SOFT_TILE_SIZE];
+} SoftTile;
+
+// Scale the channels of a color by t / 255, red and blue in the same word
+static inline Uint32 soft_scale(Uint32 color, Uint32 t) {
+  Uint32 rb = (color & 0xFF00FFu) * t + 0x800080u;
+  Uint32 g = (color & 0x00FF00u) * t + 0x008000u;
+  rb = ((rb + ((rb >> 8) & 0xFF00FFu)) >> 8) & 0xFF00FFu;
+  g = ((g + ((g >> 8) & 0x00FF00u)) >> 8) & 0x00FF00u;
+  return rb | g;
+}
+
+// Sum of the channels of two colors, saturated like a UNORM target
+static inline Uint32 soft_add(Uint32 a, Uint32 b) {
+  Uint32 rb = (a & 0xFF00FFu) + (b & 0xFF00FFu);
+  Uint32 g = (a & 0x00FF00u) + (b & 0x00FF00u);
+  Uint32 rb_carry = rb & 0x01000100u;
+  Uint32 g_carry = g & 0x00010000u;
+  rb = (rb | (rb_carry - (rb_carry >> 8))) & 0xFF00FFu;
+  g = (g | (g_carry - (g_carry >> 8))) & 0x00FF00u;
+  return rb | g;
+}
+
+// Add a layer behind the ones already in a pixel, the same result as
+// blending it before them with ONE, ONE_MINUS_SRC_ALPHA
+static inline void soft_under(SoftTile* tile,
+                              Uint32* color,
+                              Uint8* transmit,
+                              Uint32 src,
+                              Uint32 alpha) {
+  Uint32 t = *transmit;
+  *color = soft_add(*color, t == 255 ? src : soft_scale(src, t));
+  t = (t * (255 - alpha) + 127) / 255;
+  *transmit = (Uint8)t;
+  tile->open -= t == 0 ? 1 : 0;
+}
+
+// Add a quad behind the pixels of a tile, 4 pixels per step
+static void soft_shade_quad(SBI_SoftRaster* raster,
+                            SoftTile* tile,
+                            const SBI_SoftQuad* quad) {
+  Sint32 x0 = SDL_max(quad->min_x, tile->rect.x);
+  Sint32 y0 = SDL_max(quad->min_y, tile->rect.y);
+  Sint32 x1 = SDL_min(quad->max_x, tile->rect.x + tile->rect.w - 1);
+  Sint32 y1 = SDL_min(quad->max_y, tile->rect.y + tile->rect.h - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  // Steps start on a multiple of 4, the padding of the rows covers the end
+  Sint32 start = x0 & ~3;
+  Lanes centers = lanes_add(lanes_set((float)start),
+                            lanes_make(0.5f, 1.5f, 2.5f, 3.5f));
+  Lanes a[4];
+  Lanes step[4];
+  for (Uint32 k = 0; k < 4; k++) {
+    a[k] = lanes_set(quad->edges[k][0]);
+    step[k] = lanes_set(quad->edges[k][0] * 4.0f);
+  }
+
+  for (Sint32 y = y0; y <= y1; y++) {
+    float center_y = (float)y + 0.5f;
+    Lanes e[4];
+    for (Uint32 k = 0; k < 4; k++) {
+      float row = quad->edges[k][1] * center_y + quad->edges[k][2];
+      e[k] = lanes_add(lanes_mul(a[k], centers), lanes_set(row));
+    }
+
+    Uint32* pixels = raster->pixels + (Uint64)y * raster->stride;
+    Uint8* transmit = tile->transmit +
+                      (y - tile->rect.y) * SBI_SOFT_TILE_SIZE - tile->rect.x;
+    for (Sint32 x = start; x <= x1; x += 4) {
+      Lanes inside = lanes_min(lanes_min(e[0], e[1]), lanes_min(e[2], e[3]));
+      for (Uint32 k = 0; k < 4; k++) {
+        e[k] = lanes_add(e[k], step[k]);
+      }
+
+      // Nothing to add behind 4 opaque pixels
+      Uint32 seen = 0;
+      SDL_memcpy(&seen, transmit + x, sizeof(Uint32));
+      if (seen == 0) {
+        continue;
+      }
+
+      // Lanes out of the bounds of the quad in the tile
+      Uint32 mask = lanes_nonnegative(inside);
+      if (x < x0) {
+        mask &= (0xFu << (x0 - x)) & 0xFu;
+      }
+      if (x + 3 > x1) {
+        mask &= 0xFu >> (x + 3 - x1);
+      }
+
+      for (Uint32 i = 0; mask != 0 && i < 4; i++) {
+        if (((mask >> i) & 1) && transmit[x + i] != 0) {
+          soft_under(tile, &pixels[x + i], &transmit[x + i], quad->color,
+                     quad->alpha);
+        }
+      }
+    }
+  }
+}
+
+// Point of the y = 0 plane seen through each pixel of a row, from the near
+// and far points of the pixel like grid.vert. t <= 0 above the horizon.
+static void soft_grid_row(const SBI_SoftCommand* command,
+                          Sint32 x0,
+                          Sint32 count,
+                          Sint32 y,
+                          float* plane_x,
+                          float* plane_z,
+                          float* plane_t) {
+  const float* m = command->pv_inv;
+  const SDL_Rect* viewport = &command->viewport;
+  float ndc_y = 1.0f - ((float)y + 0.5f - viewport->y) / viewport->h * 2.0f;
+  for (Sint32 i = 0; i < count; i++) {
+    float ndc_x =
+        ((float)(x0 + i) + 0.5f - viewport->x) / viewport->w * 2.0f - 1.0f;
+    float near[4];
+    float far[4];
+    for (Uint32 r = 0; r < 4; r++) {
+      float base = m[r] * ndc_x + m[4 + r] * ndc_y + m[12 + r];
+      near[r] = base + m[8 + r] * 0.01f;
+      far[r] = base + m[8 + r];
+    }
+    for (Uint32 r = 0; r < 3; r++) {
+      near[r] /= near[3];
+      far[r] /= far[3];
+    }
+
+    float t = -near[1] / (far[1] - near[1]);
+    plane_x[i] = near[0] + t * (far[0] - near[0]);
+    plane_z[i] = near[2] + t * (far[2] - near[2]);
+    plane_t[i] = t;
+  }
+}
+
+// Distance to the nearest line of a coordinate, in line widths
+static inline float soft_grid_line(float coord, float der) {
+  float f = coord - 0.5f;
+  return SDL_fabsf(f - SDL_floorf(f) - 0.5f) / der;
+}
+
+// Port of grid.frag, the derivatives are the differences with the next
+// pixel of the row and of the column
+static void soft_shade_grid(SBI_SoftRaster* raster,
+                            SoftTile* tile,
+                            const SBI_SoftCommand* command) {
+  SDL_Rect area = {0};
+  if (!SDL_GetRectIntersection(&tile->rect, &command->viewport, &area)) {
+    return;
+  }
+
+  float rows[2][3][SBI_SOFT_TILE_SIZE + 1];
+  Uint32 current = 0;
+  Sint32 count = area.w + 1;
+  soft_grid_row(command, area.x, count, area.y, rows[0][0], rows[0][1],
+                rows[0][2]);
+
+  for (Sint32 y = area.y; y < area.y + area.h; y++) {
+    float(*row)[SBI_SOFT_TILE_SIZE + 1] = rows[current];
+    float(*next)[SBI_SOFT_TILE_SIZE + 1] = rows[current ^ 1];
+    soft_grid_row(command, area.x, count, y + 1, next[0], next[1], next[2]);
+    current ^= 1;
+
+    Uint32* pixels = raster->pixels + (Uint64)y * raster->stride;
+    Uint8* transmit = tile->transmit +
+                      (y - tile->rect.y) * SBI_SOFT_TILE_SIZE - tile->rect.x;
+    for (Sint32 x = area.x; x < area.x + area.w; x++) {
+      Sint32 i = x - area.x;
+      if (row[2][i] <= 0.0f || transmit[x] == 0) {
+        continue;
+      }
+
+      // fwidth of the scaled plane coordinates
+      float der_x = (SDL_fabsf(row[0][i + 1] - row[0][i]) +
+                     SDL_fabsf(next[0][i] - row[0][i])) *
+                    SOFT_GRID_SCALE;
+      float der_z = (SDL_fabsf(row[1][i + 1] - row[1][i]) +
+                     SDL_fabsf(next[1][i] - row[1][i])) *
+                    SOFT_GRID_SCALE;
+      float line =
+          SDL_min(soft_grid_line(row[0][i] * SOFT_GRID_SCALE, der_x),
+                  soft_grid_line(row[1][i] * SOFT_GRID_SCALE, der_z));
+      float alpha = 1.0f - SDL_min(line, 1.0f);
+
+      float r = 0.2f;
+      float b = 0.2f;
+      float min_x = SDL_min(der_x, 1.0f) * 0.1f;
+      float min_z = SDL_min(der_z, 1.0f) * 0.1f;
+      if (row[0][i] > -min_x && row[0][i] < min_x) {
+        b = 1.0f;
+      }
+      if (row[1][i] > -min_z && row[1][i] < min_z) {
+        r = 1.0f;
+      }
+
+      // The color is not premultiplied, as the GPU blends it
+      soft_under(tile, &pixels[x], &transmit[x], soft_pack_color(r, 0.2f, b),
+                 (Uint32)(alpha * 255.0f + 0.5f));
+    }
+  }
+}
+
+// Shade a range of tiles, the draws are replayed from the last one and
+// the quads of a draw from the last worker, the reverse of their order
+static void soft_raster_job(void* data, Uint32 w, Uint64 begin, Uint64 end) {
+  SBI_SoftRaster* raster = data;
+  SoftTile tile;
+  for (Uint64 t = begin; t < end; t++) {
+    Uint32 tx = (Uint32)(t % raster->tiles_x);
+    Uint32 ty = (Uint32)(t / raster->tiles_x);
+    tile.rect.x = (int)(tx * SBI_SOFT_TILE_SIZE);
+    tile.rect.y = (int)(ty * SBI_SOFT_TILE_SIZE);
+    tile.rect.w = SDL_min(SBI_SOFT_TILE_SIZE, (int)raster->width - tile.rect.x);
+    tile.rect.h =
+        SDL_min(SBI_SOFT_TILE_SIZE, (int)raster->height - tile.rect.y);
+    tile.open = (Uint32)(tile.rect.w * tile.rect.h);
+    SDL_memset(tile.transmit, 255, sizeof(tile.transmit));
+    for (Sint32 y = tile.rect.y; y < tile.rect.y + tile.rect.h; y++) {
+      Uint32* pixels = raster->pixels + (Uint64)y * raster->stride;
+      SDL_memset(pixels + tile.rect.x, 0, sizeof(Uint32) * tile.rect.w);
+    }
+
+    Uint32 cursors[SBI_JOB_MAX_WORKERS] = {0};
+    for (Uint32 i = 0; i < raster->pool.workers_count; i++) {
+      cursors[i] = raster->workers[i].bins[t].count;
+    }
+
+    for (Uint32 c = raster->commands_count; c > 0 && tile.open > 0; c--) {
+      const SBI_SoftCommand* command = &raster->commands[c - 1];
+      if (command->type == SBI_SOFT_COMMAND_GRID) {
+        soft_shade_grid(raster, &tile, command);
+        continue;
+      }
+
+      for (Uint32 i = raster->pool.workers_count; i > 0; i--) {
+        const SBI_SoftWorker* worker = &raster->workers[i - 1];
+        const Uint32* indices = worker->bins[t].indices;
+        Uint32* cursor = &cursors[i - 1];
+        while (*cursor > 0 && tile.open > 0) {
+          const SBI_SoftQuad* quad = &worker->quads[indices[*cursor - 1]];
+          if (quad->command != c - 1) {
+            break;
+          }
+          soft_shade_quad(raster, &tile, quad);
+          (*cursor)--;
+        }
+      }
+    }
+
+    // The clear color shows through what is left
+    for (Sint32 y = tile.rect.y; y < tile.rect.y + tile.rect.h; y++) {
+      Uint32* pixels = raster->pixels + (Uint64)y * raster->stride;
+      const Uint8* transmit = tile.transmit +
+                              (y - tile.rect.y) * SBI_SOFT_TILE_SIZE -
+                              tile.rect.x;
+      for (Sint32 x = tile.rect.x; x < tile.rect.x + tile.rect.w; x++) {
+        if (transmit[x] != 0) {
+          pixels[x] = soft_add(pixels[x],
+                               soft_scale(raster->clear_color, transmit[x]));
+        }
+      }
+    }
+  }
+}
+
+void SBI_SoftRasterEnd(SBI_SoftRaster* raster) {
+  SBI_JobPoolRun(&raster->pool, soft_raster_job, raster,
+                 raster->tiles_x * raster->tiles_y);
+}
+
+bool SBI_SoftRasterPresent(SBI_SoftRaster* raster, SDL_Window* window) {
+  SDL_Surface* window_surface = SDL_GetWindowSurface(window);
+  if (window_surface == NULL) {
+    SDL_Log("Couldn't get window surface: %s", SDL_GetError());
+    return false;
+  }
+
+  // Converts the format when the window doesn't use XRGB8888
+  if (!SDL_BlitSurface(raster->surface, NULL, window_surface, NULL) ||
+      !SDL_UpdateWindowSurface(window)) {
+    SDL_Log("Couldn't present software frame: %s", SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+bool SBI_SoftRasterSave(SBI_SoftRaster* raster, const char* path) {
+  if (!SDL_SaveBMP(raster->surface, path)) {
+    SDL_Log("Couldn't save software frame to %s: %s", path, SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+void SBI_SoftRasterDestroy(SBI_SoftRaster* raster) {
+  if (raster->pool.workers_count == 0) {
+    return;
+  }
+
+  soft_release_target(raster);
+  for (Uint32 w = 0; w < SBI_JOB_MAX_WORKERS; w++) {
+    SDL_free(raster->workers[w].quads);
+  }
+  SBI_JobPoolDestroy(&raster->pool);
+  SDL_memset(raster, 0, sizeof(SBI_SoftRaster));
+}
@@ -0,0 +1,118 @@
+#ifndef SBI_SOFTRASTER_H
+#define SBI_SOFTRASTER_H
+
+#include <SDL3/SDL_rect.h>
+#include <SDL3/SDL_surface.h>
+#include <SDL3/SDL_video.h>
+
+#include "billboard.h"
+#include "jobs.h"
+#include "xmath.h"
+
+#define SBI_SOFT_TILE_SIZE (64)
+#define SBI_SOFT_MAX_COMMANDS (32)
+
+typedef enum {
+  SBI_SOFT_COMMAND_GRID,
+  SBI_SOFT_COMMAND_BILLBOARD,
+} SBI_SoftCommandType;
+
+// A recorded draw, billboard draws are already set up and binned
+typedef struct {
+  SBI_SoftCommandType type;
+  SDL_Rect viewport;
+  SBI_ALIGN_MAT4 SBI_Mat4 pv;
+  SBI_ALIGN_MAT4 SBI_Mat4 pv_inv;
+} SBI_SoftCommand;
+
+// A billboard projected to the screen: a convex quad with one color in
+// premultiplied XRGB8888 plus alpha, edges as a*x + b*y + c >= 0 inside
+typedef struct {
+  float edges[4][3];
+  Sint32 min_x;
+  Sint32 min_y;
+  Sint32 max_x;
+  Sint32 max_y;
+  Uint32 color;
+  Uint32 alpha;
+  Uint32 command;
+} SBI_SoftQuad;
+
+// Quads indices of a worker overlapping a tile, in draw order
+typedef struct {
+  Uint32* indices;
+  Uint32 count;
+  Uint32 capacity;
+} SBI_SoftBin;
+
+// Quads and bins written by one worker during the setup of the draws
+typedef struct {
+  SBI_SoftQuad* quads;
+  Uint32 quads_count;
+  Uint32 quads_capacity;
+  SBI_SoftBin* bins;
+  bool failed;
+} SBI_SoftWorker;
+
+// CPU backend of the scene for hosts without a GPU. Draws are recorded
+// between begin and end: billboards are projected and binned into tiles
+// by the workers, then every tile is shaded by one worker, 4 pixels at a
+// time, replaying the draws in order. Rows are padded to a multiple of 4
+// pixels so the last step of a row never leaves it.
+typedef struct {
+  SBI_JobPool pool;
+  SBI_SoftWorker workers[SBI_JOB_MAX_WORKERS];
+  Uint32* pixels;
+  SDL_Surface* surface;
+  Uint32 width;
+  Uint32 height;
+  Uint32 stride;
+  Uint32 tiles_x;
+  Uint32 tiles_y;
+  Uint32 clear_color;
+  SDL_Rect viewport;
+  SBI_SoftCommand commands[SBI_SOFT_MAX_COMMANDS];
+  Uint32 commands_count;
+} SBI_SoftRaster;
+
+// Start the workers, zero workers_count uses every logical core
+bool SBI_SoftRasterLoad(SBI_SoftRaster* raster, Uint32 workers_count);
+
+// Make sure the framebuffer and tiles match the target size
+bool SBI_SoftRasterPrepare(SBI_SoftRaster* raster,
+                           Uint32 width,
+                           Uint32 height);
+
+// Start recording a frame that clears to an opaque color
+void SBI_SoftRasterBegin(SBI_SoftRaster* raster, SDL_FColor clear_color);
+
+// Region of the framebuffer of the next draws, like the view scissor
+void SBI_SoftRasterViewport(SBI_SoftRaster* raster, SDL_Rect viewport);
+
+// Draw the debug grid, the same plane as SBI_GridDraw
+void SBI_SoftGridDraw(SBI_SoftRaster* raster,
+                      const SBI_Mat4 proj,
+                      const SBI_Mat4 view);
+
+// Draw the instances of a billboard set in its mode, from the CPU copies
+// of the streams (sorted sets follow their last sort). Instances crossing
+// the near plane are skipped and sprite sheets are not sampled.
+void SBI_SoftBillboardDraw(SBI_SoftRaster* raster,
+                           const SBI_Billboard* billboard,
+                           const SBI_Mat4 proj,
+                           const SBI_Mat4 view,
+                           const SBI_Vec3 view_pos);
+
+// Shade every tile with the recorded draws
+void SBI_SoftRasterEnd(SBI_SoftRaster* raster);
+
+// Copy the framebuffer to the surface of a window
+bool SBI_SoftRasterPresent(SBI_SoftRaster* raster, SDL_Window* window);
+
+// Write the framebuffer as a BMP image
+bool SBI_SoftRasterSave(SBI_SoftRaster* raster, const char* path);
+
+// Stop the workers and release the framebuffer and bins
+void SBI_SoftRasterDestroy(SBI_SoftRaster* raster);
+
+#endif /* SBI_SOFTRASTER_H */
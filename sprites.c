@@ -0,0 +1,865 @@
+#include "sprites.h"
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define SPRITES_TAIL_BATCH (16u * 1024u * 1024u)
+
+static int compare_ranks(const void* a, const void* b) {
+  const SBI_SpriteRank* ra = a;
+  const SBI_SpriteRank* rb = b;
+  if (ra->missing != rb->missing) {
+    return ra->missing > rb->missing ? -1 : 1;
+  }
+  return ra->sprite < rb->sprite ? -1 : (ra->sprite > rb->sprite ? 1 : 0);
+}
+
+static int sprite_io_thread(void* data);
+static void sprites_drain_completed(SBI_SpriteStreamer* streamer);
+
+static Uint32 sprites_level_size(const SBI_SpriteInfo* info, Uint32 level) {
+  return SDL_max(info->size >> level, 1);
+}
+
+static Uint32 sprites_level_bytes(const SBI_SpriteInfo* info, Uint32 level) {
+  Uint32 size = sprites_level_size(info, level);
+  return size * size * 4;
+}
+
+static Uint32 sprites_align(Uint32 bytes) {
+  return (bytes + SBI_SPRITE_UPLOAD_ALIGNMENT - 1) &
+         ~(SBI_SPRITE_UPLOAD_ALIGNMENT - 1);
+}
+
+// Finest level a sprite wants, the pass in progress counts as soon as it
+// asks for more
+static Uint32 sprites_wanted(const SBI_SpriteEntry* entry) {
+  return SDL_min(entry->wanted_level, entry->sweep_level);
+}
+
+SBI_SpriteStreamerOptions SBI_SpriteStreamerDefaultOptions(const char* path) {
+  return (SBI_SpriteStreamerOptions){
+      .path = path,
+      .host_budget = 64ull * 1024ull * 1024ull,
+      .vram_budget = 256ull * 1024ull * 1024ull,
+      .upload_budget = 8u * 1024u * 1024u,
+      .feedback_budget = 262144,
+      .lod_bias = 0.0f,
+  };
+}
+
+// Soft disk in the hue of the sprite with rings every few texels, the
+// rings blur away in the coarse levels
+static void sprites_generate(Uint8* texels, Uint32 size, Uint32 sprite) {
+  float hue = (float)(Uint32)(sprite * 0x9E3779B9u) / 4294967296.0f;
+  float tint[3];
+  for (Uint32 c = 0; c < 3; c++) {
+    float phase = hue + (float)c / 3.0f;
+    tint[c] = 0.6f + 0.4f * SDL_cosf(2.0f * SDL_PI_F * phase);
+  }
+
+  float half = (float)size * 0.5f;
+  for (Uint32 y = 0; y < size; y++) {
+    for (Uint32 x = 0; x < size; x++) {
+      float dx = ((float)x + 0.5f - half) / half;
+      float dy = ((float)y + 0.5f - half) / half;
+      float r = SDL_sqrtf(dx * dx + dy * dy);
+      float alpha = SDL_clamp((1.0f - r) * 8.0f, 0.0f, 1.0f);
+      float ring = (Uint32)(r * (float)size / 8.0f) % 2 == 0 ? 1.0f : 0.7f;
+      Uint8* texel = &texels[(y * size + x) * 4];
+      for (Uint32 c = 0; c < 3; c++) {
+        texel[c] = (Uint8)(tint[c] * ring * alpha * 255.0f);
+      }
+      texel[3] = (Uint8)(alpha * 255.0f);
+    }
+  }
+}
+
+// Box filter of a level into the next one
+static void sprites_downsample(const Uint8* src, Uint32 size, Uint8* dst) {
+  Uint32 half = SDL_max(size / 2, 1);
+  for (Uint32 y = 0; y < half; y++) {
+    for (Uint32 x = 0; x < half; x++) {
+      for (Uint32 c = 0; c < 4; c++) {
+        Uint32 x0 = SDL_min(x * 2, size - 1);
+        Uint32 x1 = SDL_min(x * 2 + 1, size - 1);
+        Uint32 y0 = SDL_min(y * 2, size - 1);
+        Uint32 y1 = SDL_min(y * 2 + 1, size - 1);
+        Uint32 sum = src[(y0 * size + x0) * 4 + c] +
+                     src[(y0 * size + x1) * 4 + c] +
+                     src[(y1 * size + x0) * 4 + c] +
+                     src[(y1 * size + x1) * 4 + c];
+        dst[(y * half + x) * 4 + c] = (Uint8)((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+bool SBI_SpriteLibraryBake(const char* path, Uint32 count, Uint32 size) {
+  char index_path[512] = {0};
+  char data_path[512] = {0};
+  SDL_snprintf(index_path, sizeof(index_path), "%s/%s", path,
+               SBI_SPRITE_INDEX_FILE);
+  SDL_snprintf(data_path, sizeof(data_path), "%s/%s", path,
+               SBI_SPRITE_DATA_FILE);
+
+  Uint32 levels_count = 1;
+  while (levels_count < SBI_SPRITE_MAX_LEVELS && (size >> levels_count) > 0) {
+    levels_count++;
+  }
+  if (size == 0 || (size & (size - 1)) != 0 || (size >> levels_count) > 0) {
+    SDL_Log("Sprite size must be a power of two up to %d",
+            1 << (SBI_SPRITE_MAX_LEVELS - 1));
+    return false;
+  }
+
+  if (!SDL_CreateDirectory(path)) {
+    SDL_Log("Could not create sprite library directory: %s", SDL_GetError());
+    return false;
+  }
+
+  size_t level_bytes = (size_t)size * size * 4;
+  Uint8* levels[2] = {SDL_malloc(level_bytes), SDL_malloc(level_bytes)};
+  SBI_SpriteInfo* infos = SDL_calloc(SDL_max(count, 1), sizeof(SBI_SpriteInfo));
+  bool result = false;
+  SDL_IOStream* data_file = NULL;
+  SDL_IOStream* index_file = NULL;
+  if (levels[0] == NULL || levels[1] == NULL || infos == NULL) {
+    SDL_Log("Could not allocate memory to bake %d sprites", count);
+    goto cleanup;
+  }
+
+  data_file = SDL_IOFromFile(data_path, "wb");
+  if (data_file == NULL) {
+    SDL_Log("Could not open sprite data file: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  Uint64 offset = 0;
+  for (Uint32 s = 0; s < count; s++) {
+    SBI_SpriteInfo* info = &infos[s];
+    info->size = size;
+    info->levels_count = levels_count;
+    sprites_generate(levels[0], size, s);
+    for (Uint32 l = 0; l < levels_count; l++) {
+      Uint8* level = levels[l % 2];
+      size_t bytes = sprites_level_bytes(info, l);
+      if (SDL_WriteIO(data_file, level, bytes) != bytes) {
+        SDL_Log("Could not write sprite data: %s", SDL_GetError());
+        goto cleanup;
+      }
+      info->offsets[l] = offset;
+      offset += bytes;
+      if (l + 1 < levels_count) {
+        sprites_downsample(level, sprites_level_size(info, l),
+                           levels[(l + 1) % 2]);
+      }
+    }
+  }
+
+  index_file = SDL_IOFromFile(index_path, "wb");
+  if (index_file == NULL) {
+    SDL_Log("Could not open sprite index file: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  SBI_SpriteIndexHeader header = {
+      .magic = SBI_SPRITE_MAGIC,
+      .version = SBI_SPRITE_VERSION,
+      .sprites_count = count,
+  };
+  size_t infos_bytes = sizeof(SBI_SpriteInfo) * count;
+  if (SDL_WriteIO(index_file, &header, sizeof(header)) != sizeof(header) ||
+      SDL_WriteIO(index_file, infos, infos_bytes) != infos_bytes) {
+    SDL_Log("Could not write sprite index: %s", SDL_GetError());
+    goto cleanup;
+  }
+
+  SDL_Log("Baked %d sprites of %d texels (%" SDL_PRIu64 " bytes) at %s",
+          count, size, offset, path);
+  result = true;
+
+cleanup:
+  if (index_file != NULL) {
+    SDL_CloseIO(index_file);
+  }
+  if (data_file != NULL) {
+    SDL_CloseIO(data_file);
+  }
+  SDL_free(infos);
+  SDL_free(levels[0]);
+  SDL_free(levels[1]);
+  return result;
+}
+
+// Texture of levels [first_level, levels_count) of a sprite
+static SDL_GPUTexture* sprites_create_texture(SBI_SpriteStreamer* streamer,
+                                              Uint32 sprite,
+                                              Uint32 first_level) {
+  const SBI_SpriteInfo* info = &streamer->infos[sprite];
+  Uint32 size = sprites_level_size(info, first_level);
+  SDL_GPUTextureCreateInfo texture_create_info = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SBI_SPRITE_FORMAT,
+      .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = size,
+      .height = size,
+      .layer_count_or_depth = 1,
+      .num_levels = info->levels_count - first_level,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  SDL_GPUTexture* texture =
+      SDL_CreateGPUTexture(streamer->device, &texture_create_info);
+  if (texture == NULL) {
+    SDL_Log("Couldn't create texture of sprite %d: %s", sprite,
+            SDL_GetError());
+  }
+  return texture;
+}
+
+static void sprites_upload_level(SDL_GPUCopyPass* copy_pass,
+                                 SDL_GPUTransferBuffer* transfer_buffer,
+                                 Uint32 offset,
+                                 SDL_GPUTexture* texture,
+                                 Uint32 mip_level,
+                                 Uint32 size) {
+  SDL_GPUTextureTransferInfo source = {
+      .transfer_buffer = transfer_buffer,
+      .offset = offset,
+      .pixels_per_row = size,
+      .rows_per_layer = size,
+  };
+  SDL_GPUTextureRegion destination = {
+      .texture = texture,
+      .mip_level = mip_level,
+      .w = size,
+      .h = size,
+      .d = 1,
+  };
+  SDL_UploadToGPUTexture(copy_pass, &source, &destination, false);
+}
+
+// Move a sprite to a texture starting at first_level, the levels both
+// textures hold are copied on the GPU and the old one is released once
+// the frames sampling it are done
+static bool sprites_move(SBI_SpriteStreamer* streamer,
+                         SDL_GPUCopyPass* copy_pass,
+                         Uint32 sprite,
+                         Uint32 first_level,
+                         SDL_GPUTexture** moved) {
+  SBI_SpriteEntry* entry = &streamer->entries[sprite];
+  const SBI_SpriteInfo* info = &streamer->infos[sprite];
+  SDL_GPUTexture* texture = sprites_create_texture(streamer, sprite,
+                                                   first_level);
+  if (texture == NULL) {
+    return false;
+  }
+
+  Uint32 shared_first = SDL_max(first_level, entry->resident_level);
+  for (Uint32 l = shared_first; l < info->levels_count; l++) {
+    Uint32 size = sprites_level_size(info, l);
+    SDL_GPUTextureLocation source = {
+        .texture = entry->texture,
+        .mip_level = l - entry->resident_level,
+    };
+    SDL_GPUTextureLocation destination = {
+        .texture = texture,
+        .mip_level = l - first_level,
+    };
+    SDL_CopyGPUTextureToTexture(copy_pass, &source, &destination, size, size,
+                                1, false);
+  }
+
+  SDL_ReleaseGPUTexture(streamer->device, entry->texture);
+  entry->texture = texture;
+  entry->resident_level = first_level;
+  *moved = texture;
+  return true;
+}
+
+// Upload the tail of every sprite, batched in transfer buffers of
+// SPRITES_TAIL_BATCH bytes
+static bool sprites_load_tails(SBI_SpriteStreamer* streamer) {
+  SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = SPRITES_TAIL_BATCH,
+  };
+  SDL_GPUTransferBuffer* transfer_buffer =
+      SDL_CreateGPUTransferBuffer(streamer->device, &transfer_create_info);
+  Uint8* tail = SDL_malloc(SPRITES_TAIL_BATCH);
+  if (transfer_buffer == NULL || tail == NULL) {
+    SDL_Log("Couldn't create the staging of the sprite tails");
+    SDL_ReleaseGPUTransferBuffer(streamer->device, transfer_buffer);
+    SDL_free(tail);
+    return false;
+  }
+
+  bool result = true;
+  SDL_GPUCommandBuffer* cmd_buf = NULL;
+  SDL_GPUCopyPass* copy_pass = NULL;
+  Uint8* transfer_point = NULL;
+  Uint32 transfer_offset = 0;
+  for (Uint32 s = 0; s < streamer->sprites_count && result; s++) {
+    const SBI_SpriteInfo* info = &streamer->infos[s];
+    SBI_SpriteEntry* entry = &streamer->entries[s];
+    Uint32 tail_level = 0;
+    while (tail_level + 1 < info->levels_count &&
+           sprites_level_size(info, tail_level) > SBI_SPRITE_TAIL_SIZE) {
+      tail_level++;
+    }
+
+    Uint32 read_bytes = 0;
+    Uint32 staged_bytes = 0;
+    for (Uint32 l = tail_level; l < info->levels_count; l++) {
+      read_bytes += sprites_level_bytes(info, l);
+      staged_bytes += sprites_align(sprites_level_bytes(info, l));
+    }
+
+    // Flush the batch when the tail does not fit
+    if (transfer_point != NULL &&
+        transfer_offset + staged_bytes > SPRITES_TAIL_BATCH) {
+      SDL_UnmapGPUTransferBuffer(streamer->device, transfer_buffer);
+      SDL_EndGPUCopyPass(copy_pass);
+      SDL_SubmitGPUCommandBuffer(cmd_buf);
+      transfer_point = NULL;
+      transfer_offset = 0;
+    }
+    if (transfer_point == NULL) {
+      cmd_buf = SDL_AcquireGPUCommandBuffer(streamer->device);
+      if (cmd_buf == NULL) {
+        SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+        result = false;
+        break;
+      }
+      transfer_point =
+          SDL_MapGPUTransferBuffer(streamer->device, transfer_buffer, true);
+      copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    }
+
+    entry->texture = sprites_create_texture(streamer, s, tail_level);
+    if (entry->texture == NULL || read_bytes > SPRITES_TAIL_BATCH ||
+        SDL_SeekIO(streamer->data_file, (Sint64)info->offsets[tail_level],
+                   SDL_IO_SEEK_SET) < 0 ||
+        SDL_ReadIO(streamer->data_file, tail, read_bytes) != read_bytes) {
+      SDL_Log("Couldn't load the tail of sprite %d: %s", s, SDL_GetError());
+      result = false;
+      break;
+    }
+
+    Uint32 read_offset = 0;
+    for (Uint32 l = tail_level; l < info->levels_count; l++) {
+      Uint32 bytes = sprites_level_bytes(info, l);
+      SDL_memcpy(transfer_point + transfer_offset, tail + read_offset, bytes);
+      sprites_upload_level(copy_pass, transfer_buffer, transfer_offset,
+                           entry->texture, l - tail_level,
+                           sprites_level_size(info, l));
+      read_offset += bytes;
+      transfer_offset += sprites_align(bytes);
+    }
+
+    entry->resident_level = tail_level;
+    entry->tail_level = tail_level;
+    entry->wanted_level = tail_level;
+    entry->sweep_level = tail_level;
+    streamer->tail_bytes += read_bytes;
+  }
+
+  if (transfer_point != NULL) {
+    SDL_UnmapGPUTransferBuffer(streamer->device, transfer_buffer);
+    SDL_EndGPUCopyPass(copy_pass);
+    SDL_SubmitGPUCommandBuffer(cmd_buf);
+  }
+
+  // Released once the uploads complete
+  SDL_ReleaseGPUTransferBuffer(streamer->device, transfer_buffer);
+  SDL_free(tail);
+  streamer->resident_bytes = streamer->tail_bytes;
+  return result;
+}
+
+bool SBI_SpriteStreamerLoad(SBI_SpriteStreamer* streamer,
+                            SDL_GPUDevice* device,
+                            SBI_SpriteStreamerOptions options) {
+  char index_path[512] = {0};
+  char data_path[512] = {0};
+  SDL_snprintf(index_path, sizeof(index_path), "%s/%s", options.path,
+               SBI_SPRITE_INDEX_FILE);
+  SDL_snprintf(data_path, sizeof(data_path), "%s/%s", options.path,
+               SBI_SPRITE_DATA_FILE);
+
+  SDL_memset(streamer, 0, sizeof(SBI_SpriteStreamer));
+  streamer->device = device;
+  streamer->options = options;
+  streamer->loading = -1;
+
+  size_t index_size = 0;
+  Uint8* index_data = SDL_LoadFile(index_path, &index_size);
+  if (index_data == NULL) {
+    SDL_Log("Couldn't load sprite index: %s", SDL_GetError());
+    return false;
+  }
+
+  SBI_SpriteIndexHeader header = {0};
+  if (index_size >= sizeof(header)) {
+    SDL_memcpy(&header, index_data, sizeof(header));
+  }
+  if (header.magic != SBI_SPRITE_MAGIC ||
+      header.version != SBI_SPRITE_VERSION ||
+      index_size <
+          sizeof(header) + sizeof(SBI_SpriteInfo) * header.sprites_count) {
+    SDL_Log("Invalid sprite index: %s", index_path);
+    SDL_free(index_data);
+    return false;
+  }
+
+  Uint32 count = header.sprites_count;
+  streamer->sprites_count = count;
+  streamer->infos = SDL_malloc(sizeof(SBI_SpriteInfo) * SDL_max(count, 1));
+  streamer->entries = SDL_calloc(SDL_max(count, 1), sizeof(SBI_SpriteEntry));
+  streamer->ranks = SDL_malloc(sizeof(SBI_SpriteRank) * SDL_max(count, 1));
+  streamer->pending =
+      SDL_malloc(sizeof(SBI_SpriteLoad) * SDL_max(count, 1));
+  streamer->completed =
+      SDL_malloc(sizeof(SBI_SpriteLoad) * SDL_max(count, 1));
+  if (streamer->infos == NULL || streamer->entries == NULL ||
+      streamer->ranks == NULL || streamer->pending == NULL ||
+      streamer->completed == NULL) {
+    SDL_Log("Could not allocate memory for %d sprites", count);
+    SDL_free(index_data);
+    return false;
+  }
+
+  SDL_memcpy(streamer->infos, index_data + sizeof(header),
+             sizeof(SBI_SpriteInfo) * count);
+  SDL_free(index_data);
+
+  // The staging holds the largest level even when it exceeds the budget
+  Uint32 largest = 0;
+  for (Uint32 s = 0; s < count; s++) {
+    const SBI_SpriteInfo* info = &streamer->infos[s];
+    if (info->levels_count == 0 || info->levels_count > SBI_SPRITE_MAX_LEVELS ||
+        (info->size >> (info->levels_count - 1)) == 0) {
+      SDL_Log("Invalid sprite %d in %s", s, index_path);
+      return false;
+    }
+    largest = SDL_max(largest, sprites_align(sprites_level_bytes(info, 0)));
+  }
+  streamer->options.upload_budget = SDL_max(options.upload_budget, largest);
+
+  streamer->data_file = SDL_IOFromFile(data_path, "rb");
+  if (streamer->data_file == NULL) {
+    SDL_Log("Couldn't open sprite data: %s", SDL_GetError());
+    return false;
+  }
+
+  if (!sprites_load_tails(streamer)) {
+    return false;
+  }
+
+  SDL_GPUTransferBufferCreateInfo upload_transfer_buffer_create_info = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+      .size = streamer->options.upload_budget,
+  };
+  streamer->upload_transfer_buffer =
+      SDL_CreateGPUTransferBuffer(device, &upload_transfer_buffer_create_info);
+  if (streamer->upload_transfer_buffer == NULL) {
+    SDL_Log("Couldn't create transfer buffer of sprites");
+    return false;
+  }
+
+  streamer->lock = SDL_CreateMutex();
+  streamer->wake = SDL_CreateCondition();
+  if (streamer->lock == NULL || streamer->wake == NULL) {
+    SDL_Log("Couldn't create sprite streamer sync objects: %s",
+            SDL_GetError());
+    return false;
+  }
+
+  streamer->io_thread =
+      SDL_CreateThread(sprite_io_thread, "SBI_SpriteIO", streamer);
+  if (streamer->io_thread == NULL) {
+    SDL_Log("Couldn't create sprite I/O thread: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_Log("Streaming %d sprites, %" SDL_PRIu64 " bytes of tails resident, "
+          "%" SDL_PRIu64 " bytes of VRAM",
+          count, streamer->tail_bytes, options.vram_budget);
+  return true;
+}
+
+void SBI_SpriteStreamerFeedback(SBI_SpriteStreamer* streamer,
+                                const SBI_Vec4* instances,
+                                const Uint32* sprites,
+                                Uint64 instances_count,
+                                const SBI_Camera* camera,
+                                float viewport_height) {
+  if (instances_count == 0 || streamer->sprites_count == 0) {
+    return;
+  }
+
+  SBI_ALIGN_MAT4 SBI_Mat4 pv = {0};
+  SBI_Frustum frustum = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 eye = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 min = {0};
+  SBI_ALIGN_VEC3 SBI_Vec3 max = {0};
+  SBI_Mat4Mul(camera->proj, camera->view, pv);
+  SBI_FrustumFromMat4(pv, frustum);
+  SBI_XFormGetPosition(camera->xform, eye);
+
+  // Pixels covered by a unit of world at unit distance
+  float pixels_per_unit = camera->proj[5] * viewport_height * 0.5f;
+  Uint64 budget = SDL_min(streamer->options.feedback_budget, instances_count);
+  for (Uint64 n = 0; n < budget; n++) {
+    Uint64 i = streamer->feedback_cursor++ % instances_count;
+
+    // A full pass over the instances ended, its levels become the wanted
+    if (i == 0) {
+      for (Uint32 s = 0; s < streamer->sprites_count; s++) {
+        SBI_SpriteEntry* entry = &streamer->entries[s];
+        entry->wanted_level = entry->sweep_level;
+        entry->sweep_level = entry->tail_level;
+      }
+    }
+
+    const float* instance = instances[i];
+    float scale = instance[3];
+    for (Uint32 c = 0; c < 3; c++) {
+      min[c] = instance[c] - scale;
+      max[c] = instance[c] + scale;
+    }
+    if (!SBI_FrustumTestAABB(frustum, min, max)) {
+      continue;
+    }
+
+    Uint32 sprite = (Uint32)((sprites != NULL ? sprites[i] : i) %
+                             streamer->sprites_count);
+    SBI_SpriteEntry* entry = &streamer->entries[sprite];
+    const SBI_SpriteInfo* info = &streamer->infos[sprite];
+    float dx = instance[0] - eye[0];
+    float dy = instance[1] - eye[1];
+    float dz = instance[2] - eye[2];
+    float distance = SDL_sqrtf(dx * dx + dy * dy + dz * dz);
+    float pixels = 2.0f * scale * pixels_per_unit / SDL_max(distance, 1e-3f);
+
+    // Level whose texels match the covered pixels
+    float lod = SDL_logf((float)info->size / SDL_max(pixels, 1e-3f)) *
+                    1.44269504f +
+                streamer->options.lod_bias;
+    Uint32 level = lod <= 0.0f ? 0 : (Uint32)lod;
+    entry->sweep_level = SDL_min(entry->sweep_level,
+                                 SDL_min(level, entry->tail_level));
+    entry->last_used = streamer->frame;
+  }
+  streamer->frame++;
+}
+
+void SBI_SpriteStreamerUpdate(SBI_SpriteStreamer* streamer) {
+  sprites_drain_completed(streamer);
+
+  // Rank the sprites missing levels, read or not
+  streamer->ranks_count = 0;
+  Uint64 host_bytes = 0;
+  for (Uint32 s = 0; s < streamer->sprites_count; s++) {
+    SBI_SpriteEntry* entry = &streamer->entries[s];
+    Uint32 wanted = sprites_wanted(entry);
+    if (entry->data != NULL && wanted >= entry->resident_level) {
+      SDL_free(entry->data);
+      entry->data = NULL;
+    }
+    if (entry->data != NULL) {
+      host_bytes +=
+          sprites_level_bytes(&streamer->infos[s], entry->resident_level - 1);
+    }
+
+    if (wanted < entry->resident_level) {
+      streamer->ranks[streamer->ranks_count++] = (SBI_SpriteRank){
+          .missing = entry->resident_level - wanted,
+          .sprite = s,
+      };
+    }
+  }
+  SDL_qsort(streamer->ranks, streamer->ranks_count, sizeof(SBI_SpriteRank),
+            compare_ranks);
+
+  // Replace the I/O queue with the next level of the ranked sprites
+  SDL_LockMutex(streamer->lock);
+  {
+    for (Uint32 i = streamer->pending_head; i < streamer->pending_count; i++) {
+      streamer->entries[streamer->pending[i].sprite].queued = false;
+    }
+
+    host_bytes += streamer->loading_bytes;
+    streamer->pending_head = 0;
+    streamer->pending_count = 0;
+    for (Uint32 r = 0; r < streamer->ranks_count; r++) {
+      Uint32 sprite = streamer->ranks[r].sprite;
+      SBI_SpriteEntry* entry = &streamer->entries[sprite];
+      if (entry->data != NULL || entry->queued || sprite == streamer->loading) {
+        continue;
+      }
+
+      Uint64 bytes = sprites_level_bytes(&streamer->infos[sprite],
+                                         entry->resident_level - 1);
+      if (host_bytes + bytes > streamer->options.host_budget) {
+        break;
+      }
+
+      entry->queued = true;
+      streamer->pending[streamer->pending_count++] = (SBI_SpriteLoad){
+          .sprite = sprite,
+          .level = entry->resident_level - 1,
+      };
+      host_bytes += bytes;
+    }
+    streamer->host_bytes = host_bytes;
+
+    if (streamer->pending_count > 0) {
+      SDL_SignalCondition(streamer->wake);
+    }
+  }
+  SDL_UnlockMutex(streamer->lock);
+}
+
+// Drop the finest level of the least recently used sprite holding more
+// than it wants, never the tail nor keep
+static bool sprites_evict(SBI_SpriteStreamer* streamer,
+                          SDL_GPUCopyPass* copy_pass,
+                          Uint32 keep) {
+  Sint64 best = -1;
+  for (Uint32 s = 0; s < streamer->sprites_count; s++) {
+    const SBI_SpriteEntry* entry = &streamer->entries[s];
+    if (s == keep || entry->resident_level >= entry->tail_level ||
+        entry->resident_level >= sprites_wanted(entry)) {
+      continue;
+    }
+
+    if (best < 0 || entry->last_used < streamer->entries[best].last_used) {
+      best = s;
+    }
+  }
+
+  if (best < 0) {
+    return false;
+  }
+
+  SBI_SpriteEntry* entry = &streamer->entries[best];
+  const SBI_SpriteInfo* info = &streamer->infos[best];
+  Uint32 level = entry->resident_level;
+  SDL_GPUTexture* texture = NULL;
+  if (!sprites_move(streamer, copy_pass, (Uint32)best, level + 1, &texture)) {
+    return false;
+  }
+
+  // A read level is finer than the new resident one, it waits for a
+  // request again
+  if (entry->data != NULL) {
+    SDL_free(entry->data);
+    entry->data = NULL;
+  }
+  streamer->resident_bytes -= sprites_level_bytes(info, level);
+  streamer->evicted_count++;
+  return true;
+}
+
+void SBI_SpriteStreamerUpload(SBI_SpriteStreamer* streamer,
+                              SDL_GPUCommandBuffer* cmd_buf) {
+  sprites_drain_completed(streamer);
+  streamer->uploaded_bytes = 0;
+  streamer->promoted_count = 0;
+  streamer->evicted_count = 0;
+
+  Uint8* transfer_point = NULL;
+  SDL_GPUCopyPass* copy_pass = NULL;
+  Uint32 transfer_offset = 0;
+  for (Uint32 r = 0; r < streamer->ranks_count; r++) {
+    Uint32 sprite = streamer->ranks[r].sprite;
+    SBI_SpriteEntry* entry = &streamer->entries[sprite];
+    const SBI_SpriteInfo* info = &streamer->infos[sprite];
+    if (entry->data == NULL) {
+      continue;
+    }
+
+    Uint32 level = entry->resident_level - 1;
+    Uint32 bytes = sprites_level_bytes(info, level);
+    if (transfer_offset + bytes > streamer->options.upload_budget) {
+      break;
+    }
+
+    if (copy_pass == NULL) {
+      transfer_point = SDL_MapGPUTransferBuffer(
+          streamer->device, streamer->upload_transfer_buffer, true);
+      copy_pass = SDL_BeginGPUCopyPass(cmd_buf);
+    }
+
+    bool fits = true;
+    while (fits &&
+           streamer->resident_bytes + bytes > streamer->options.vram_budget) {
+      fits = sprites_evict(streamer, copy_pass, sprite);
+    }
+    SDL_GPUTexture* texture = NULL;
+    if (!fits || !sprites_move(streamer, copy_pass, sprite, level, &texture)) {
+      break;
+    }
+
+    SDL_memcpy(transfer_point + transfer_offset, entry->data, bytes);
+    sprites_upload_level(copy_pass, streamer->upload_transfer_buffer,
+                         transfer_offset, texture, 0,
+                         sprites_level_size(info, level));
+    transfer_offset += sprites_align(bytes);
+
+    SDL_free(entry->data);
+    entry->data = NULL;
+    streamer->resident_bytes += bytes;
+    streamer->uploaded_bytes += bytes;
+    streamer->promoted_count++;
+  }
+
+  if (copy_pass != NULL) {
+    SDL_UnmapGPUTransferBuffer(streamer->device,
+                               streamer->upload_transfer_buffer);
+    SDL_EndGPUCopyPass(copy_pass);
+  }
+}
+
+bool SBI_SpriteStreamerSettled(SBI_SpriteStreamer* streamer) {
+  SDL_LockMutex(streamer->lock);
+  bool settled = streamer->pending_head >= streamer->pending_count &&
+                 streamer->loading < 0 && streamer->completed_count == 0;
+  SDL_UnlockMutex(streamer->lock);
+
+  for (Uint32 r = 0; settled && r < streamer->ranks_count; r++) {
+    settled = streamer->entries[streamer->ranks[r].sprite].data == NULL;
+  }
+  return settled;
+}
+
+SDL_GPUTexture* SBI_SpriteStreamerTexture(const SBI_SpriteStreamer* streamer,
+                                          Uint32 sprite,
+                                          Uint32* first_level) {
+  const SBI_SpriteEntry* entry = &streamer->entries[sprite];
+  *first_level = entry->resident_level;
+  return entry->texture;
+}
+
+void SBI_SpriteStreamerGetStats(const SBI_SpriteStreamer* streamer,
+                                SBI_SpriteStreamerStats* stats) {
+  SDL_memset(stats, 0, sizeof(SBI_SpriteStreamerStats));
+  stats->sprites_count = streamer->sprites_count;
+  for (Uint32 s = 0; s < streamer->sprites_count; s++) {
+    const SBI_SpriteEntry* entry = &streamer->entries[s];
+    stats->wanted_count += entry->resident_level <= sprites_wanted(entry);
+    stats->queued_count += entry->queued || entry->data != NULL;
+  }
+  stats->resident_bytes = streamer->resident_bytes;
+  stats->tail_bytes = streamer->tail_bytes;
+  stats->uploaded_bytes = streamer->uploaded_bytes;
+  stats->promoted_count = streamer->promoted_count;
+  stats->evicted_count = streamer->evicted_count;
+}
+
+void SBI_SpriteStreamerDestroy(SBI_SpriteStreamer* streamer) {
+  if (streamer->io_thread != NULL) {
+    SDL_LockMutex(streamer->lock);
+    streamer->quit = true;
+    SDL_SignalCondition(streamer->wake);
+    SDL_UnlockMutex(streamer->lock);
+    SDL_WaitThread(streamer->io_thread, NULL);
+    streamer->io_thread = NULL;
+  }
+
+  if (streamer->completed != NULL && streamer->lock != NULL) {
+    sprites_drain_completed(streamer);
+  }
+
+  if (streamer->entries != NULL) {
+    for (Uint32 s = 0; s < streamer->sprites_count; s++) {
+      SDL_ReleaseGPUTexture(streamer->device, streamer->entries[s].texture);
+      SDL_free(streamer->entries[s].data);
+    }
+  }
+
+  if (streamer->upload_transfer_buffer != NULL) {
+    SDL_ReleaseGPUTransferBuffer(streamer->device,
+                                 streamer->upload_transfer_buffer);
+  }
+
+  if (streamer->data_file != NULL) {
+    SDL_CloseIO(streamer->data_file);
+  }
+
+  SDL_DestroyCondition(streamer->wake);
+  SDL_DestroyMutex(streamer->lock);
+  SDL_free(streamer->completed);
+  SDL_free(streamer->pending);
+  SDL_free(streamer->ranks);
+  SDL_free(streamer->entries);
+  SDL_free(streamer->infos);
+  SDL_memset(streamer, 0, sizeof(SBI_SpriteStreamer));
+}
+
+static int sprite_io_thread(void* data) {
+  SBI_SpriteStreamer* streamer = data;
+
+  SDL_LockMutex(streamer->lock);
+  while (!streamer->quit) {
+    if (streamer->pending_head >= streamer->pending_count) {
+      SDL_WaitCondition(streamer->wake, streamer->lock);
+      continue;
+    }
+
+    SBI_SpriteLoad load = streamer->pending[streamer->pending_head++];
+    const SBI_SpriteInfo* info = &streamer->infos[load.sprite];
+    Uint32 sprite = load.sprite;
+    Uint32 level = load.level;
+    size_t bytes = sprites_level_bytes(info, level);
+    streamer->loading = sprite;
+    streamer->loading_bytes = bytes;
+    SDL_UnlockMutex(streamer->lock);
+
+    // Read outside of the lock so the main thread never waits on I/O
+    Uint8* level_data = SDL_malloc(bytes);
+    if (level_data != NULL &&
+        (SDL_SeekIO(streamer->data_file, (Sint64)info->offsets[level],
+                    SDL_IO_SEEK_SET) < 0 ||
+         SDL_ReadIO(streamer->data_file, level_data, bytes) != bytes)) {
+      SDL_Log("Couldn't read level %d of sprite %d: %s", level, sprite,
+              SDL_GetError());
+      SDL_free(level_data);
+      level_data = NULL;
+    }
+
+    SDL_LockMutex(streamer->lock);
+    streamer->loading = -1;
+    streamer->loading_bytes = 0;
+    if (level_data != NULL) {
+      streamer->completed[streamer->completed_count++] = (SBI_SpriteLoad){
+          .sprite = sprite,
+          .level = level,
+          .data = level_data,
+      };
+    }
+  }
+  SDL_UnlockMutex(streamer->lock);
+  return 0;
+}
+
+// Keep the read levels that are still the next finer one of their sprite
+static void sprites_drain_completed(SBI_SpriteStreamer* streamer) {
+  SDL_LockMutex(streamer->lock);
+  for (Uint32 i = 0; i < streamer->completed_count; i++) {
+    SBI_SpriteLoad* load = &streamer->completed[i];
+    SBI_SpriteEntry* entry = &streamer->entries[load->sprite];
+    entry->queued = false;
+    if (entry->data != NULL || load->level + 1 != entry->resident_level) {
+      SDL_free(load->data);
+      continue;
+    }
+    entry->data = load->data;
+  }
+  streamer->completed_count = 0;
+  SDL_UnlockMutex(streamer->lock);
+}
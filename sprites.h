@@ -0,0 +1,178 @@
+#ifndef SBI_SPRITES_H
+#define SBI_SPRITES_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#include "camera.h"
+#include "xmath.h"
+
+#define SBI_SPRITE_MAGIC SDL_FOURCC('S', 'B', 'S', 'P')
+#define SBI_SPRITE_VERSION (1)
+#define SBI_SPRITE_INDEX_FILE "index.bin"
+#define SBI_SPRITE_DATA_FILE "mips.bin"
+#define SBI_SPRITE_FORMAT SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM
+#define SBI_SPRITE_MAX_LEVELS (16)
+#define SBI_SPRITE_TAIL_SIZE (32)
+#define SBI_SPRITE_UPLOAD_ALIGNMENT (512)
+
+// Header of the sprite index file, followed by sprites_count
+// SBI_SpriteInfo
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  Uint32 sprites_count;
+  Uint32 padding;
+} SBI_SpriteIndexHeader;
+
+// On-disk description of a square RGBA8 sprite, level l is size >> l
+// texels wide and starts at offsets[l] of the data file. Levels are stored
+// finest first so the tail of every sprite is one contiguous read.
+typedef struct {
+  Uint32 size;
+  Uint32 levels_count;
+  Uint64 offsets[SBI_SPRITE_MAX_LEVELS];
+} SBI_SpriteInfo;
+
+// Runtime state of a sprite, only touched by the main thread. The texture
+// holds levels [resident_level, levels_count) of the sprite, the levels of
+// tail_level and coarser are always resident.
+typedef struct {
+  SDL_GPUTexture* texture;
+  Uint32 resident_level;
+  Uint32 tail_level;
+  Uint32 wanted_level;
+  Uint32 sweep_level;
+  Uint64 last_used;
+
+  // The next finer level, read by the I/O thread and waiting for upload
+  Uint8* data;
+  bool queued;
+} SBI_SpriteEntry;
+
+// Sprite candidate ordered by the levels it is missing (higher first)
+typedef struct {
+  Uint32 missing;
+  Uint32 sprite;
+} SBI_SpriteRank;
+
+// A level queued for or read by the I/O thread
+typedef struct {
+  Uint32 sprite;
+  Uint32 level;
+  Uint8* data;
+} SBI_SpriteLoad;
+
+// Budgets and tuning of the sprite streamer. feedback_budget instances are
+// measured per frame, a sprite wants the level whose texels match the
+// pixels it covers plus lod_bias.
+typedef struct {
+  const char* path;
+  Uint64 host_budget;
+  Uint64 vram_budget;
+  Uint32 upload_budget;
+  Uint32 feedback_budget;
+  float lod_bias;
+} SBI_SpriteStreamerOptions;
+
+typedef struct {
+  Uint32 sprites_count;
+  Uint32 wanted_count;
+  Uint32 queued_count;
+  Uint64 resident_bytes;
+  Uint64 tail_bytes;
+  Uint64 uploaded_bytes;
+  Uint32 promoted_count;
+  Uint32 evicted_count;
+} SBI_SpriteStreamerStats;
+
+// Pages the mip levels of a sprite library from disk as the feedback of the
+// frames asks for them. Finer levels are read by a background thread and
+// uploaded within a per frame budget, the least recently used levels above
+// the tail are dropped to stay under the VRAM budget. Without sparse
+// textures a sprite changes its resident levels by moving to a new texture,
+// the kept levels are copied on the GPU.
+typedef struct {
+  SDL_GPUDevice* device;
+  SDL_GPUTransferBuffer* upload_transfer_buffer;
+  SBI_SpriteStreamerOptions options;
+
+  SBI_SpriteInfo* infos;
+  SBI_SpriteEntry* entries;
+  SBI_SpriteRank* ranks;
+  Uint32 sprites_count;
+  Uint32 ranks_count;
+  Uint64 feedback_cursor;
+  Uint64 frame;
+  Uint64 resident_bytes;
+  Uint64 tail_bytes;
+  Uint64 host_bytes;
+
+  // Counters of the last upload
+  Uint64 uploaded_bytes;
+  Uint32 promoted_count;
+  Uint32 evicted_count;
+
+  // Shared with the I/O thread, guarded by lock
+  SDL_Thread* io_thread;
+  SDL_Mutex* lock;
+  SDL_Condition* wake;
+  SDL_IOStream* data_file;
+  SBI_SpriteLoad* pending;
+  Uint32 pending_head;
+  Uint32 pending_count;
+  SBI_SpriteLoad* completed;
+  Uint32 completed_count;
+  Sint64 loading;
+  Uint64 loading_bytes;
+  bool quit;
+} SBI_SpriteStreamer;
+
+// Default options for a sprite library stored at path
+SBI_SpriteStreamerOptions SBI_SpriteStreamerDefaultOptions(const char* path);
+
+// Write count generated sprites of size texels (a power of two) with their
+// mip chains to a library dir
+bool SBI_SpriteLibraryBake(const char* path, Uint32 count, Uint32 size);
+
+// Open a library, upload the tail of every sprite and start the
+// background I/O thread
+bool SBI_SpriteStreamerLoad(SBI_SpriteStreamer* streamer,
+                            SDL_GPUDevice* device,
+                            SBI_SpriteStreamerOptions options);
+
+// Measure the pixels covered by the next feedback_budget instances seen
+// from camera, instance i shows sprite sprites[i] (i modulo the sprites
+// without ids). A sprite wants the finest level asked over the last full
+// pass over the instances.
+void SBI_SpriteStreamerFeedback(SBI_SpriteStreamer* streamer,
+                                const SBI_Vec4* instances,
+                                const Uint32* sprites,
+                                Uint64 instances_count,
+                                const SBI_Camera* camera,
+                                float viewport_height);
+
+// Queue the next finer level of the sprites missing the most levels
+void SBI_SpriteStreamerUpdate(SBI_SpriteStreamer* streamer);
+
+// Upload the read levels within the upload budget, before any render pass.
+// Drops levels nobody wants to make room for them.
+void SBI_SpriteStreamerUpload(SBI_SpriteStreamer* streamer,
+                              SDL_GPUCommandBuffer* cmd_buf);
+
+// Whether the I/O thread has no work and nothing waits for an upload
+bool SBI_SpriteStreamerSettled(SBI_SpriteStreamer* streamer);
+
+// Texture of a sprite, its level 0 is level first_level of the sprite
+SDL_GPUTexture* SBI_SpriteStreamerTexture(const SBI_SpriteStreamer* streamer,
+                                          Uint32 sprite,
+                                          Uint32* first_level);
+
+void SBI_SpriteStreamerGetStats(const SBI_SpriteStreamer* streamer,
+                                SBI_SpriteStreamerStats* stats);
+
+// Stop the I/O thread and release every texture
+void SBI_SpriteStreamerDestroy(SBI_SpriteStreamer* streamer);
+
+#endif /* SBI_SPRITES_H */
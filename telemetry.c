@@ -0,0 +1,294 @@
+#include "telemetry.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Upper bound of each frame time bucket, the last bucket has none
+static const float telemetry_bucket_bounds[SBI_TELEMETRY_BUCKETS] = {
+    1.0f, 2.0f, 4.0f, 8.0f, 12.0f, 16.7f, 20.0f, 25.0f, 33.4f, 50.0f, 100.0f,
+    0.0f,
+};
+
+static Uint32 telemetry_bucket(float frame_ms) {
+  for (Uint32 b = 0; b < SBI_TELEMETRY_BUCKETS - 1; b++) {
+    if (frame_ms < telemetry_bucket_bounds[b]) {
+      return b;
+    }
+  }
+  return SBI_TELEMETRY_BUCKETS - 1;
+}
+
+static bool telemetry_listen(SBI_Telemetry* telemetry) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  SDL_strlcpy(address.sun_path, SBI_TELEMETRY_SOCKET_PATH,
+              sizeof(address.sun_path));
+
+  telemetry->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (telemetry->listen_fd < 0 ||
+      fcntl(telemetry->listen_fd, F_SETFL, O_NONBLOCK) != 0) {
+    SDL_Log("Couldn't create telemetry socket: %s", strerror(errno));
+    if (telemetry->listen_fd >= 0) {
+      close(telemetry->listen_fd);
+    }
+    telemetry->listen_fd = -1;
+    return false;
+  }
+
+  // A crashed instance leaves its socket file behind
+  unlink(SBI_TELEMETRY_SOCKET_PATH);
+  if (bind(telemetry->listen_fd, (struct sockaddr*)&address,
+           sizeof(address)) != 0 ||
+      listen(telemetry->listen_fd, SBI_TELEMETRY_MAX_CLIENTS) != 0) {
+    SDL_Log("Couldn't listen on %s: %s", SBI_TELEMETRY_SOCKET_PATH,
+            strerror(errno));
+    close(telemetry->listen_fd);
+    telemetry->listen_fd = -1;
+    return false;
+  }
+  return true;
+}
+
+bool SBI_TelemetryLoad(SBI_Telemetry* telemetry) {
+  SDL_memset(telemetry, 0, sizeof(SBI_Telemetry));
+  telemetry->listen_fd = -1;
+
+  int fd = shm_open(SBI_TELEMETRY_SHM_NAME, O_CREAT | O_RDWR, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(SBI_TelemetryBlock)) != 0) {
+    SDL_Log("Couldn't create telemetry block: %s", strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  // The mapping stays valid once the descriptor is closed
+  void* block = mmap(NULL, sizeof(SBI_TelemetryBlock),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED) {
+    SDL_Log("Couldn't map telemetry block: %s", strerror(errno));
+    return false;
+  }
+
+  telemetry->block = block;
+  SDL_memset(telemetry->block, 0, sizeof(SBI_TelemetryBlock));
+  SDL_memcpy(telemetry->block->bucket_bounds, telemetry_bucket_bounds,
+             sizeof(telemetry_bucket_bounds));
+  telemetry->block->version = SBI_TELEMETRY_VERSION;
+  SDL_MemoryBarrierRelease();
+  telemetry->block->magic = SBI_TELEMETRY_MAGIC;
+
+  return telemetry_listen(telemetry);
+}
+
+// Take pending connections, readers only wait for the next attempt
+static void telemetry_accept(SBI_Telemetry* telemetry) {
+  while (telemetry->clients_count < SBI_TELEMETRY_MAX_CLIENTS) {
+    int client = accept(telemetry->listen_fd, NULL, NULL);
+    if (client < 0) {
+      return;
+    }
+
+    // Sends never wait for a slow reader
+    if (fcntl(client, F_SETFL, O_NONBLOCK) != 0) {
+      close(client);
+      continue;
+    }
+    telemetry->clients[telemetry->clients_count++] = client;
+  }
+}
+
+// A client that can't take a whole line is dropped, a partial line would
+// break the framing of the stream
+static void telemetry_send(SBI_Telemetry* telemetry, Uint32 length) {
+  Uint32 i = 0;
+  while (i < telemetry->clients_count) {
+    ssize_t sent = send(telemetry->clients[i], telemetry->line, length,
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent == (ssize_t)length) {
+      i++;
+      continue;
+    }
+
+    close(telemetry->clients[i]);
+    telemetry->clients[i] = telemetry->clients[--telemetry->clients_count];
+  }
+}
+
+void SBI_TelemetryPublish(SBI_Telemetry* telemetry,
+                          SBI_TelemetrySample* sample) {
+  if (telemetry->block == NULL) {
+    return;
+  }
+
+  telemetry->histogram[telemetry_bucket(sample->frame_ms)]++;
+  sample->frame = telemetry->frames++;
+  SDL_memcpy(sample->histogram, telemetry->histogram,
+             sizeof(telemetry->histogram));
+
+  // Odd while the sample is being written, the barriers pair with the
+  // acquire barrier of the reader
+  SBI_TelemetryBlock* block = telemetry->block;
+  Uint32 sequence = SDL_GetAtomicU32(&block->sequence);
+  SDL_SetAtomicU32(&block->sequence, sequence + 1);
+  SDL_MemoryBarrierRelease();
+  SDL_memcpy(&block->sample, sample, sizeof(SBI_TelemetrySample));
+  SDL_MemoryBarrierRelease();
+  SDL_SetAtomicU32(&block->sequence, sequence + 2);
+
+  if (telemetry->listen_fd >= 0 &&
+      sample->frame % SBI_TELEMETRY_ACCEPT_FRAMES == 0) {
+    telemetry_accept(telemetry);
+  }
+
+  // Nothing is formatted without a client
+  if (telemetry->clients_count > 0) {
+    Uint32 length = SBI_TelemetryFormat(sample, telemetry_bucket_bounds,
+                                        telemetry->line,
+                                        sizeof(telemetry->line));
+    if (length > 0) {
+      telemetry_send(telemetry, length);
+    }
+  }
+}
+
+// Append to a line, length grows past size once the line doesn't fit
+static void telemetry_append(char* dest,
+                             Uint32 size,
+                             Uint32* length,
+                             SDL_PRINTF_FORMAT_STRING const char* fmt,
+                             ...) {
+  if (*length >= size) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int written = SDL_vsnprintf(dest + *length, size - *length, fmt, args);
+  va_end(args);
+  *length = written < 0 ? size : *length + (Uint32)written;
+}
+
+Uint32 SBI_TelemetryFormat(const SBI_TelemetrySample* sample,
+                           const float* bucket_bounds,
+                           char* dest,
+                           Uint32 size) {
+  Uint32 length = 0;
+  telemetry_append(dest, size, &length,
+                   "{\"frame\":%" SDL_PRIu64 ",\"frame_ms\":%.3f,"
+                   "\"update_ms\":%.3f,\"render_ms\":%.3f,"
+                   "\"upload_ms\":%.3f,\"fence_ms\":%.3f,",
+                   sample->frame, sample->frame_ms, sample->update_ms,
+                   sample->render_ms, sample->upload_ms, sample->fence_ms);
+  telemetry_append(dest, size, &length,
+                   "\"instances\":%" SDL_PRIu64 ",\"uploaded_bytes\":%"
+                   SDL_PRIu64 ",\"draws\":%u,",
+                   sample->instances_count, sample->uploaded_bytes,
+                   sample->draws_count);
+
+  // The last bucket is open, it has no bound
+  telemetry_append(dest, size, &length, "\"histogram_bounds_ms\":[");
+  for (Uint32 b = 0; b < SBI_TELEMETRY_BUCKETS - 1; b++) {
+    telemetry_append(dest, size, &length, b > 0 ? ",%.1f" : "%.1f",
+                     bucket_bounds[b]);
+  }
+  telemetry_append(dest, size, &length, "],\"histogram\":[");
+  for (Uint32 b = 0; b < SBI_TELEMETRY_BUCKETS; b++) {
+    telemetry_append(dest, size, &length, b > 0 ? ",%u" : "%u",
+                     sample->histogram[b]);
+  }
+  telemetry_append(dest, size, &length, "]}\n");
+
+  return length < size ? length : 0;
+}
+
+// Copy the sample once the writer isn't in the middle of it
+static bool telemetry_read_sample(const SBI_TelemetryBlock* block,
+                                  SBI_TelemetrySample* sample) {
+  SDL_AtomicU32* sequence = (SDL_AtomicU32*)&block->sequence;
+  for (Uint32 attempt = 0; attempt < 1000; attempt++) {
+    Uint32 before = SDL_GetAtomicU32(sequence);
+    if (before & 1) {
+      continue;
+    }
+
+    SDL_memcpy(sample, &block->sample, sizeof(SBI_TelemetrySample));
+    SDL_MemoryBarrierAcquire();
+    if (SDL_GetAtomicU32(sequence) == before) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SBI_TelemetryReadLoop(Uint32 interval_ms, Uint32 count) {
+  int fd = shm_open(SBI_TELEMETRY_SHM_NAME, O_RDONLY, 0);
+  if (fd < 0) {
+    SDL_Log("No telemetry published at %s: %s", SBI_TELEMETRY_SHM_NAME,
+            strerror(errno));
+    return false;
+  }
+
+  const SBI_TelemetryBlock* block =
+      mmap(NULL, sizeof(SBI_TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED) {
+    SDL_Log("Couldn't map telemetry block: %s", strerror(errno));
+    return false;
+  }
+
+  if (block->magic != SBI_TELEMETRY_MAGIC ||
+      block->version != SBI_TELEMETRY_VERSION) {
+    SDL_Log("Telemetry block has an unknown layout");
+    munmap((void*)block, sizeof(SBI_TelemetryBlock));
+    return false;
+  }
+
+  char line[SBI_TELEMETRY_LINE_SIZE];
+  SBI_TelemetrySample sample = {0};
+  for (Uint32 i = 0; count == 0 || i < count; i++) {
+    if (telemetry_read_sample(block, &sample) &&
+        SBI_TelemetryFormat(&sample, block->bucket_bounds, line,
+                            sizeof(line)) > 0) {
+      fputs(line, stdout);
+      fflush(stdout);
+    }
+    SDL_Delay(interval_ms);
+  }
+
+  munmap((void*)block, sizeof(SBI_TelemetryBlock));
+  return true;
+}
+
+void SBI_TelemetryDestroy(SBI_Telemetry* telemetry) {
+  if (telemetry->block == NULL) {
+    return;
+  }
+
+  for (Uint32 i = 0; i < telemetry->clients_count; i++) {
+    close(telemetry->clients[i]);
+  }
+  telemetry->clients_count = 0;
+
+  if (telemetry->listen_fd >= 0) {
+    close(telemetry->listen_fd);
+    unlink(SBI_TELEMETRY_SOCKET_PATH);
+    telemetry->listen_fd = -1;
+  }
+
+  munmap(telemetry->block, sizeof(SBI_TelemetryBlock));
+  shm_unlink(SBI_TELEMETRY_SHM_NAME);
+  telemetry->block = NULL;
+}
@@ -0,0 +1,77 @@
+#ifndef SBI_TELEMETRY_H
+#define SBI_TELEMETRY_H
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_stdinc.h>
+
+#define SBI_TELEMETRY_SHM_NAME ("/simplebillboard-telemetry")
+#define SBI_TELEMETRY_SOCKET_PATH ("/tmp/simplebillboard-telemetry.sock")
+#define SBI_TELEMETRY_MAGIC (0x53424954u)
+#define SBI_TELEMETRY_VERSION (1)
+#define SBI_TELEMETRY_BUCKETS (12)
+#define SBI_TELEMETRY_MAX_CLIENTS (4)
+#define SBI_TELEMETRY_ACCEPT_FRAMES (30)
+#define SBI_TELEMETRY_LINE_SIZE (1024)
+
+// Measures of the last rendered frame, times in milliseconds. The
+// histogram counts every frame since the start by frame time.
+typedef struct {
+  Uint64 frame;
+  float frame_ms;
+  float update_ms;
+  float render_ms;
+  float upload_ms;
+  float fence_ms;
+  Uint64 instances_count;
+  Uint64 uploaded_bytes;
+  Uint32 draws_count;
+  Uint32 histogram[SBI_TELEMETRY_BUCKETS];
+} SBI_TelemetrySample;
+
+// Layout of the shared memory block. The writer makes the sequence odd
+// while it copies a sample, readers retry until they see the same even
+// sequence before and after their copy.
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  SDL_AtomicU32 sequence;
+  float bucket_bounds[SBI_TELEMETRY_BUCKETS];
+  SBI_TelemetrySample sample;
+} SBI_TelemetryBlock;
+
+// Telemetry published once per frame to a shared memory block and to the
+// clients of a UNIX socket as JSON lines. Without clients a frame costs a
+// copy into the block and a non-blocking accept every
+// SBI_TELEMETRY_ACCEPT_FRAMES frames.
+typedef struct {
+  SBI_TelemetryBlock* block;
+  int listen_fd;
+  int clients[SBI_TELEMETRY_MAX_CLIENTS];
+  Uint32 clients_count;
+  Uint32 histogram[SBI_TELEMETRY_BUCKETS];
+  Uint64 frames;
+  char line[SBI_TELEMETRY_LINE_SIZE];
+} SBI_Telemetry;
+
+// Create the shared memory block and start listening on the socket
+bool SBI_TelemetryLoad(SBI_Telemetry* telemetry);
+
+// Publish the measures of a frame, fills the frame number and histogram
+void SBI_TelemetryPublish(SBI_Telemetry* telemetry,
+                          SBI_TelemetrySample* sample);
+
+// Format a sample as a single JSON line ending with a new line, returns
+// the length of the line or 0 when it doesn't fit
+Uint32 SBI_TelemetryFormat(const SBI_TelemetrySample* sample,
+                           const float* bucket_bounds,
+                           char* dest,
+                           Uint32 size);
+
+// Print the block of a running instance as JSON lines to the standard
+// output every interval_ms, until count lines (0: forever)
+bool SBI_TelemetryReadLoop(Uint32 interval_ms, Uint32 count);
+
+// Close the socket and its clients and remove the shared memory block
+void SBI_TelemetryDestroy(SBI_Telemetry* telemetry);
+
+#endif /* SBI_TELEMETRY_H */
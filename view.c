@@ -0,0 +1,89 @@
+#include "view.h"
+#include "camera.h"
+#include "xmath.h"
+
+#include <SDL3/SDL_gpu.h>
+
+void SBI_ViewLoad(SBI_View* view,
+                  SBI_ViewMode mode,
+                  SDL_FRect region,
+                  float window_w,
+                  float window_h) {
+  view->mode = mode;
+  view->region = region;
+  SBI_CameraLoad(&view->camera, 1.0f);
+  SBI_ViewResize(view, window_w, window_h);
+
+  switch (mode) {
+    case SBI_VIEW_TOP:
+      view->camera.polar = 89.0f;
+      view->camera.azimuth = 90.0f;
+      view->camera.radius = 30.0f;
+      break;
+    case SBI_VIEW_SIDE:
+      view->camera.polar = 0.0f;
+      view->camera.azimuth = 90.0f;
+      view->camera.radius = 30.0f;
+      break;
+    case SBI_VIEW_FOLLOW:
+      view->camera.polar = 30.0f;
+      view->camera.radius = 5.0f;
+      break;
+    default:
+      break;
+  }
+  view->camera.target_radius = view->camera.radius;
+  SBI_CameraApplyOrbit(&view->camera);
+}
+
+void SBI_ViewResize(SBI_View* view, float window_w, float window_h) {
+  view->viewport = (SDL_GPUViewport){
+      .x = view->region.x * window_w,
+      .y = view->region.y * window_h,
+      .w = view->region.w * window_w,
+      .h = view->region.h * window_h,
+      .min_depth = 0.0f,
+      .max_depth = 1.0f,
+  };
+  view->scissor = (SDL_Rect){
+      .x = (int)view->viewport.x,
+      .y = (int)view->viewport.y,
+      .w = (int)view->viewport.w,
+      .h = (int)view->viewport.h,
+  };
+
+  if (view->viewport.h > 0.0f) {
+    SBI_CameraViewportResize(&view->camera,
+                             view->viewport.w / view->viewport.h);
+  }
+}
+
+void SBI_ViewTrack(SBI_View* view, const SBI_Vec3 target) {
+  if (view->mode == SBI_VIEW_ORBIT) {
+    return;
+  }
+
+  SBI_Vec3Copy(target, view->camera.orbit_point);
+  SBI_CameraApplyOrbit(&view->camera);
+}
+
+void SBI_ViewBegin(SBI_View* view,
+                   SDL_GPURenderPass* render_pass,
+                   float scale) {
+  SDL_GPUViewport viewport = view->viewport;
+  viewport.x *= scale;
+  viewport.y *= scale;
+  viewport.w *= scale;
+  viewport.h *= scale;
+
+  SDL_Rect scissor = {
+      .x = (int)(view->scissor.x * scale),
+      .y = (int)(view->scissor.y * scale),
+      .w = (int)(view->scissor.w * scale),
+      .h = (int)(view->scissor.h * scale),
+  };
+
+  SDL_SetGPUViewport(render_pass, &viewport);
+  SDL_SetGPUScissor(render_pass, &scissor);
+  SBI_XFormGetPosition(view->camera.xform, view->position);
+}
@@ -0,0 +1,46 @@
+#ifndef SBI_VIEW_H
+#define SBI_VIEW_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_rect.h>
+
+#include "camera.h"
+#include "xmath.h"
+
+typedef enum {
+  SBI_VIEW_ORBIT,
+  SBI_VIEW_TOP,
+  SBI_VIEW_SIDE,
+  SBI_VIEW_FOLLOW,
+} SBI_ViewMode;
+
+// A camera rendered into a normalized region of the window
+typedef struct {
+  SBI_Camera camera;
+  SBI_ViewMode mode;
+  SDL_FRect region;
+  SDL_GPUViewport viewport;
+  SDL_Rect scissor;
+  SBI_ALIGN_VEC3 SBI_Vec3 position;
+} SBI_View;
+
+// Load a view covering region (0..1) of a window of the given size
+void SBI_ViewLoad(SBI_View* view,
+                  SBI_ViewMode mode,
+                  SDL_FRect region,
+                  float window_w,
+                  float window_h);
+
+// Recompute viewport, scissor and aspect after the window was resized
+void SBI_ViewResize(SBI_View* view, float window_w, float window_h);
+
+// Move a non-interactive view to look at target (orbit views are skipped)
+void SBI_ViewTrack(SBI_View* view, const SBI_Vec3 target);
+
+// Bind the view region, scaled for render targets smaller than the window,
+// to the render pass and cache its eye position
+void SBI_ViewBegin(SBI_View* view,
+                   SDL_GPURenderPass* render_pass,
+                   float scale);
+
+#endif /* SBI_VIEW_H */
@@ -118,6 +118,17 @@ void SBI_QuatInvert(const SBI_Quat src, SBI_Quat dest) {
   dest[3] = src[3] * recip;
 }
 
+void SBI_QuatMul(const SBI_Quat a, const SBI_Quat b, SBI_Quat dest) {
+  float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+  float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+  float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+  float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+  dest[0] = x;
+  dest[1] = y;
+  dest[2] = z;
+  dest[3] = w;
+}
+
 void SBI_QuatMakeAxisAngle(const SBI_Vec3 axis, float angle, SBI_Quat dest) {
   SBI_ALIGN_VEC3 SBI_Vec3 n_axis = {0};
   float l = SBI_Vec3Len(axis);
@@ -447,6 +458,71 @@ void SBI_XFormToView(const SBI_XForm xform, SBI_Mat4 view) {
   SBI_Vec3Negate(&view[WX], &view[WX]);
 }
 
+void SBI_XFormToModel(const SBI_XForm xform, SBI_Mat4 model) {
+  // The rotation matrix is the inverse one of the view, axes are its rows
+  SBI_ALIGN_MAT4 SBI_Mat4 rotation = {0};
+  SBI_QuatToMat4(xform, rotation);
+  for (Uint32 c = 0; c < 3; c++) {
+    for (Uint32 r = 0; r < 3; r++) {
+      model[c * 4 + r] = rotation[r * 4 + c] * xform[7 + c];
+    }
+  }
+
+  model[XW] = 0.0f;
+  model[YW] = 0.0f;
+  model[ZW] = 0.0f;
+  model[WX] = xform[4];
+  model[WY] = xform[5];
+  model[WZ] = xform[6];
+  model[WW] = 1.0f;
+}
+
 void SBI_XFormGetPosition(const SBI_XForm xform, SBI_Vec3 position) {
   SBI_Vec3Copy(&xform[4], position);
 }
+
+void SBI_FrustumFromMat4(const SBI_Mat4 pv, SBI_Frustum dest) {
+  for (Uint32 i = 0; i < 4; i++) {
+    float r0 = pv[i * 4 + 0];
+    float r1 = pv[i * 4 + 1];
+    float r2 = pv[i * 4 + 2];
+    float r3 = pv[i * 4 + 3];
+    dest[0 + i] = r3 + r0;   // left
+    dest[4 + i] = r3 - r0;   // right
+    dest[8 + i] = r3 + r1;   // bottom
+    dest[12 + i] = r3 - r1;  // top
+    dest[16 + i] = r2;       // near
+    dest[20 + i] = r3 - r2;  // far
+  }
+
+  for (Uint32 p = 0; p < 6; p++) {
+    float* plane = &dest[p * 4];
+    float l = SBI_Vec3Len(plane);
+    if (l < SDL_FLT_EPSILON) {
+      continue;
+    }
+
+    plane[0] /= l;
+    plane[1] /= l;
+    plane[2] /= l;
+    plane[3] /= l;
+  }
+}
+
+bool SBI_FrustumTestAABB(const SBI_Frustum frustum,
+                         const SBI_Vec3 min,
+                         const SBI_Vec3 max) {
+  for (Uint32 p = 0; p < 6; p++) {
+    const float* plane = &frustum[p * 4];
+
+    // Test the corner furthest along the plane normal
+    float x = plane[0] >= 0.0f ? max[0] : min[0];
+    float y = plane[1] >= 0.0f ? max[1] : min[1];
+    float z = plane[2] >= 0.0f ? max[2] : min[2];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -30,6 +30,15 @@ typedef float SBI_Mat4[16];
 typedef float SBI_XForm[10];
 // TODO(cedmundo): Add API to get the pointers of rot,pos,sca
 
+// Frustum as six planes (nx,ny,nz,d): left,right,bottom,top,near,far
+typedef float SBI_Frustum[24];
+
+// Transforms as one array per SBI_XForm component (structure of arrays):
+// rotation ijkr in 0..3, position in 4..6 and scale in 7..9
+typedef struct {
+  float* components[10];
+} SBI_XFormArrays;
+
 // Makes a new Vec3 using scalar components
 void SBI_Vec3Make(float x, float y, float z, SBI_Vec3 dest);
 
@@ -132,5 +141,77 @@ void SBI_XFormToModel(const SBI_XForm xform, SBI_Mat4 model);
 // Get the position of a transform
 void SBI_XFormGetPosition(const SBI_XForm xform, SBI_Vec3 position);
 
+// Extract the frustum planes of a projection-view matrix (0..1 depth)
+void SBI_FrustumFromMat4(const SBI_Mat4 pv, SBI_Frustum dest);
+
+// Test if an axis aligned box is at least partially inside the frustum
+bool SBI_FrustumTestAABB(const SBI_Frustum frustum,
+                         const SBI_Vec3 min,
+                         const SBI_Vec3 max);
+
+// Precision of the batched kernels, errors measured over the whole domain
+// of each kernel against double precision libm
+typedef enum {
+  SBI_MATH_ACCURATE,
+  SBI_MATH_FAST,
+} SBI_MathTier;
+
+// Sine and cosine of count angles in radians, |x| <= 1e5.
+// Accurate: max abs error 9.3e-8 (|x| <= 1e3), 9.6e-7 (|x| <= 1e5).
+// Fast: max abs error 1.3e-5 (|x| <= 1e3), 1.7e-5 (|x| <= 1e5).
+void SBI_SinCosBatch(const float* x,
+                     float* sin_dest,
+                     float* cos_dest,
+                     Uint64 count,
+                     SBI_MathTier tier);
+
+// e^x of count values, saturates outside of [-87.3, 88].
+// Accurate: max rel error 1.2e-7. Fast: max rel error 5.5e-6.
+void SBI_ExpBatch(const float* x,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier);
+
+// Natural logarithm of count positive normal values.
+// Accurate: max abs error 7e-8 in [0.5, 2], 3.9e-6 overall.
+// Fast: max abs error 1.4e-6 in [0.5, 2], 5.1e-6 overall.
+void SBI_LogBatch(const float* x,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier);
+
+// x^y as e^(y*log(x)) for positive x, the error of the log is scaled by
+// |y*log(x)|. Accurate: max rel error 2.4e-6 for |y*log(x)| <= 10.
+// Fast: max rel error 4.2e-5 for |y*log(x)| <= 10.
+void SBI_PowBatch(const float* x,
+                  const float* y,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier);
+
+// Normalize count vectors with a reciprocal square root estimate, zero
+// vectors stay zero. Accurate: max rel error 5e-6. Fast: 2e-3.
+void SBI_Vec3NormalizeBatch(const SBI_Vec3* src,
+                            SBI_Vec3* dest,
+                            Uint64 count,
+                            SBI_MathTier tier);
+
+// Rotate count vectors by their unit quaternions, SBI_QuatTransformVec3
+// over arrays
+void SBI_QuatTransformVec3Batch(const SBI_Quat* q,
+                                const SBI_Vec3* v,
+                                SBI_Vec3* dest,
+                                Uint64 count);
+
+// World transforms of the children [first, first + count) of a hierarchy:
+// world[i] = world[parents[i]] * local[i], what multiplying the matrices of
+// SBI_XFormToModel gives for uniform scales. Non uniform scales are
+// multiplied per axis (no shear). Parents must be outside of the range.
+void SBI_XFormComposeBatch(const SBI_XFormArrays* local,
+                           const Uint32* parents,
+                           SBI_XFormArrays* world,
+                           Uint64 first,
+                           Uint64 count);
+
 #define SBI_Rads(x) ((x)*0.01745329f)
 #endif /* SBI_XMATH_H */
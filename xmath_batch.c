@@ -0,0 +1,631 @@
+#include "xmath.h"
+#include <SDL3/SDL_intrin.h>
+#include <SDL3/SDL_stdinc.h>
+
+// Kernels are written once over 4 lanes, mapped to SSE2 when available and
+// to plain loops (left to the auto-vectorizer) otherwise.
+#if defined(SDL_SSE2_INTRINSICS)
+typedef __m128 Lanes;
+typedef __m128i LanesInt;
+
+static inline Lanes lanes_set(float x) {
+  return _mm_set1_ps(x);
+}
+
+static inline Lanes lanes_load(const float* src) {
+  return _mm_loadu_ps(src);
+}
+
+static inline Lanes lanes_gather(const float* src, const Uint32* indices) {
+  return _mm_setr_ps(src[indices[0]], src[indices[1]], src[indices[2]],
+                     src[indices[3]]);
+}
+
+static inline void lanes_store(float* dest, Lanes a) {
+  _mm_storeu_ps(dest, a);
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b) {
+  return _mm_add_ps(a, b);
+}
+
+static inline Lanes lanes_sub(Lanes a, Lanes b) {
+  return _mm_sub_ps(a, b);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b) {
+  return _mm_mul_ps(a, b);
+}
+
+static inline Lanes lanes_div(Lanes a, Lanes b) {
+  return _mm_div_ps(a, b);
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b) {
+  return _mm_min_ps(a, b);
+}
+
+static inline Lanes lanes_max(Lanes a, Lanes b) {
+  return _mm_max_ps(a, b);
+}
+
+static inline Lanes lanes_rsqrt(Lanes a) {
+  return _mm_rsqrt_ps(a);
+}
+
+// Nearest integer, SSE rounds to even by default
+static inline LanesInt lanes_round(Lanes a) {
+  return _mm_cvtps_epi32(a);
+}
+
+static inline Lanes lanes_from_int(LanesInt a) {
+  return _mm_cvtepi32_ps(a);
+}
+
+static inline LanesInt lanes_int_set(Sint32 x) {
+  return _mm_set1_epi32(x);
+}
+
+static inline LanesInt lanes_int_add(LanesInt a, LanesInt b) {
+  return _mm_add_epi32(a, b);
+}
+
+static inline LanesInt lanes_int_and(LanesInt a, LanesInt b) {
+  return _mm_and_si128(a, b);
+}
+
+static inline LanesInt lanes_int_xor(LanesInt a, LanesInt b) {
+  return _mm_xor_si128(a, b);
+}
+
+static inline LanesInt lanes_int_shl(LanesInt a, int bits) {
+  return _mm_slli_epi32(a, bits);
+}
+
+static inline LanesInt lanes_int_shr(LanesInt a, int bits) {
+  return _mm_srli_epi32(a, bits);
+}
+
+static inline LanesInt lanes_int_eq(LanesInt a, LanesInt b) {
+  return _mm_cmpeq_epi32(a, b);
+}
+
+static inline LanesInt lanes_bits(Lanes a) {
+  return _mm_castps_si128(a);
+}
+
+static inline Lanes lanes_from_bits(LanesInt a) {
+  return _mm_castsi128_ps(a);
+}
+
+// Lanes of a where mask is set, b elsewhere
+static inline Lanes lanes_select(LanesInt mask, Lanes a, Lanes b) {
+  Lanes m = _mm_castsi128_ps(mask);
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+static inline LanesInt lanes_greater(Lanes a, Lanes b) {
+  return _mm_castps_si128(_mm_cmpgt_ps(a, b));
+}
+#else
+typedef struct {
+  float v[4];
+} Lanes;
+
+typedef struct {
+  Sint32 v[4];
+} LanesInt;
+
+#define LANES_MAP(type, expr)   \
+  type r;                       \
+  for (int i = 0; i < 4; i++) { \
+    r.v[i] = (expr);            \
+  }                             \
+  return r
+
+static inline Lanes lanes_set(float x) {
+  LANES_MAP(Lanes, x);
+}
+
+static inline Lanes lanes_load(const float* src) {
+  LANES_MAP(Lanes, src[i]);
+}
+
+static inline Lanes lanes_gather(const float* src, const Uint32* indices) {
+  LANES_MAP(Lanes, src[indices[i]]);
+}
+
+static inline void lanes_store(float* dest, Lanes a) {
+  for (int i = 0; i < 4; i++) {
+    dest[i] = a.v[i];
+  }
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] + b.v[i]);
+}
+
+static inline Lanes lanes_sub(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] - b.v[i]);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] * b.v[i]);
+}
+
+static inline Lanes lanes_div(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] / b.v[i]);
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] < b.v[i] ? a.v[i] : b.v[i]);
+}
+
+static inline Lanes lanes_max(Lanes a, Lanes b) {
+  LANES_MAP(Lanes, a.v[i] > b.v[i] ? a.v[i] : b.v[i]);
+}
+
+static inline float lanes_rsqrt_estimate(float x) {
+  // Bit trick estimate plus a Newton step, about 12 bits like SSE rsqrt
+  union {
+    float f;
+    Uint32 u;
+  } bits = {x};
+  bits.u = 0x5f375a86u - (bits.u >> 1);
+  return bits.f * (1.5f - 0.5f * x * bits.f * bits.f);
+}
+
+static inline Lanes lanes_rsqrt(Lanes a) {
+  LANES_MAP(Lanes, lanes_rsqrt_estimate(a.v[i]));
+}
+
+static inline LanesInt lanes_round(Lanes a) {
+  LANES_MAP(LanesInt, (Sint32)SDL_lroundf(a.v[i]));
+}
+
+static inline Lanes lanes_from_int(LanesInt a) {
+  LANES_MAP(Lanes, (float)a.v[i]);
+}
+
+static inline LanesInt lanes_int_set(Sint32 x) {
+  LANES_MAP(LanesInt, x);
+}
+
+static inline LanesInt lanes_int_add(LanesInt a, LanesInt b) {
+  LANES_MAP(LanesInt, a.v[i] + b.v[i]);
+}
+
+static inline LanesInt lanes_int_and(LanesInt a, LanesInt b) {
+  LANES_MAP(LanesInt, a.v[i] & b.v[i]);
+}
+
+static inline LanesInt lanes_int_xor(LanesInt a, LanesInt b) {
+  LANES_MAP(LanesInt, a.v[i] ^ b.v[i]);
+}
+
+static inline LanesInt lanes_int_shl(LanesInt a, int bits) {
+  LANES_MAP(LanesInt, (Sint32)((Uint32)a.v[i] << bits));
+}
+
+static inline LanesInt lanes_int_shr(LanesInt a, int bits) {
+  LANES_MAP(LanesInt, (Sint32)((Uint32)a.v[i] >> bits));
+}
+
+static inline LanesInt lanes_int_eq(LanesInt a, LanesInt b) {
+  LANES_MAP(LanesInt, a.v[i] == b.v[i] ? -1 : 0);
+}
+
+static inline LanesInt lanes_bits(Lanes a) {
+  LanesInt r;
+  SDL_memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+static inline Lanes lanes_from_bits(LanesInt a) {
+  Lanes r;
+  SDL_memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+static inline Lanes lanes_select(LanesInt mask, Lanes a, Lanes b) {
+  LANES_MAP(Lanes, mask.v[i] ? a.v[i] : b.v[i]);
+}
+
+static inline LanesInt lanes_greater(Lanes a, Lanes b) {
+  LANES_MAP(LanesInt, a.v[i] > b.v[i] ? -1 : 0);
+}
+#endif
+
+// pi/2 split in three parts (Cody-Waite) for an exact range reduction
+#define PIO2_HI (1.5703125f)
+#define PIO2_MID (4.837512969970703125e-4f)
+#define PIO2_LO (7.54978995489188216e-8f)
+#define TWO_OVER_PI (0.636619772367581343f)
+
+// ln(2) split in two parts, the high part has few mantissa bits
+#define LN2_HI (0.693359375f)
+#define LN2_LO (-2.12194440e-4f)
+#define LOG2_E (1.44269504088896341f)
+#define SQRT_2 (1.41421356237309505f)
+
+#define EXP_MIN (-87.3f)
+#define EXP_MAX (88.0f)
+
+static void lanes_sincos(Lanes x, bool fast, Lanes* sin_x, Lanes* cos_x) {
+  // x = j*pi/2 + r with r in [-pi/4, pi/4]
+  LanesInt j = lanes_round(lanes_mul(x, lanes_set(TWO_OVER_PI)));
+  Lanes jf = lanes_from_int(j);
+  Lanes r = lanes_sub(x, lanes_mul(jf, lanes_set(PIO2_HI)));
+  r = lanes_sub(r, lanes_mul(jf, lanes_set(PIO2_MID)));
+  r = lanes_sub(r, lanes_mul(jf, lanes_set(PIO2_LO)));
+  Lanes r2 = lanes_mul(r, r);
+
+  Lanes s;
+  Lanes c;
+  if (fast) {
+    // Minimax of degree 5 and 4 over [-pi/4, pi/4]
+    s = lanes_add(lanes_set(-1.666283789e-1f),
+                  lanes_mul(r2, lanes_set(8.153082229e-3f)));
+    c = lanes_add(lanes_set(-4.997766548e-1f),
+                  lanes_mul(r2, lanes_set(4.048978628e-2f)));
+    s = lanes_add(r, lanes_mul(lanes_mul(r, r2), s));
+    c = lanes_add(lanes_set(1.0f), lanes_mul(r2, c));
+  } else {
+    // Degree 7 and 8 (Cephes sinf/cosf)
+    s = lanes_add(lanes_set(8.3321608736e-3f),
+                  lanes_mul(r2, lanes_set(-1.9515295891e-4f)));
+    s = lanes_add(lanes_set(-1.6666654611e-1f), lanes_mul(r2, s));
+    s = lanes_add(r, lanes_mul(lanes_mul(r, r2), s));
+    c = lanes_add(lanes_set(-1.388731625493765e-3f),
+                  lanes_mul(r2, lanes_set(2.443315711809948e-5f)));
+    c = lanes_add(lanes_set(4.166664568298827e-2f), lanes_mul(r2, c));
+    c = lanes_mul(lanes_mul(r2, r2), c);
+    c = lanes_add(lanes_sub(lanes_set(1.0f), lanes_mul(r2, lanes_set(0.5f))),
+                  c);
+  }
+
+  // Odd quadrants swap sin and cos, the sign follows bit 1 of the quadrant
+  LanesInt odd = lanes_int_eq(lanes_int_and(j, lanes_int_set(1)),
+                              lanes_int_set(1));
+  Lanes sin_r = lanes_select(odd, c, s);
+  Lanes cos_r = lanes_select(odd, s, c);
+  LanesInt sin_sign = lanes_int_shl(lanes_int_and(j, lanes_int_set(2)), 30);
+  LanesInt cos_sign = lanes_int_shl(
+      lanes_int_and(lanes_int_add(j, lanes_int_set(1)), lanes_int_set(2)),
+      30);
+  *sin_x = lanes_from_bits(lanes_int_xor(lanes_bits(sin_r), sin_sign));
+  *cos_x = lanes_from_bits(lanes_int_xor(lanes_bits(cos_r), cos_sign));
+}
+
+static Lanes lanes_exp(Lanes x, bool fast) {
+  x = lanes_min(lanes_max(x, lanes_set(EXP_MIN)), lanes_set(EXP_MAX));
+
+  // x = j*ln(2) + r with r in [-ln(2)/2, ln(2)/2]
+  LanesInt j = lanes_round(lanes_mul(x, lanes_set(LOG2_E)));
+  Lanes jf = lanes_from_int(j);
+  Lanes r = lanes_sub(x, lanes_mul(jf, lanes_set(LN2_HI)));
+  r = lanes_sub(r, lanes_mul(jf, lanes_set(LN2_LO)));
+  Lanes r2 = lanes_mul(r, r);
+
+  Lanes p;
+  if (fast) {
+    // Minimax of degree 4
+    p = lanes_add(lanes_set(1.675337729e-1f),
+                  lanes_mul(r, lanes_set(4.127687363e-2f)));
+    p = lanes_add(lanes_set(5.000510903e-1f), lanes_mul(r, p));
+  } else {
+    // Degree 7 (Cephes expf)
+    p = lanes_add(lanes_set(1.3981999507e-3f),
+                  lanes_mul(r, lanes_set(1.9875691500e-4f)));
+    p = lanes_add(lanes_set(8.3334519073e-3f), lanes_mul(r, p));
+    p = lanes_add(lanes_set(4.1665795894e-2f), lanes_mul(r, p));
+    p = lanes_add(lanes_set(1.6666665459e-1f), lanes_mul(r, p));
+    p = lanes_add(lanes_set(5.0000001201e-1f), lanes_mul(r, p));
+  }
+  p = lanes_add(lanes_add(lanes_set(1.0f), r), lanes_mul(r2, p));
+
+  // Multiply by 2^j building the exponent bits directly
+  LanesInt scale = lanes_int_shl(lanes_int_add(j, lanes_int_set(127)), 23);
+  return lanes_mul(p, lanes_from_bits(scale));
+}
+
+static Lanes lanes_log(Lanes x, bool fast) {
+  // x = m * 2^e with m in [sqrt(2)/2, sqrt(2))
+  LanesInt bits = lanes_bits(x);
+  LanesInt e = lanes_int_add(lanes_int_shr(bits, 23), lanes_int_set(-127));
+  Lanes m = lanes_from_bits(
+      lanes_int_add(lanes_int_and(bits, lanes_int_set(0x007FFFFF)),
+                    lanes_int_set(0x3F800000)));
+  LanesInt big = lanes_greater(m, lanes_set(SQRT_2));
+  m = lanes_select(big, lanes_mul(m, lanes_set(0.5f)), m);
+  e = lanes_int_add(e, lanes_int_and(big, lanes_int_set(1)));
+
+  // log(m) = 2*atanh(t) with t = (m - 1) / (m + 1), |t| <= 0.172
+  Lanes t = lanes_div(lanes_sub(m, lanes_set(1.0f)),
+                      lanes_add(m, lanes_set(1.0f)));
+  Lanes t2 = lanes_mul(t, t);
+  Lanes p;
+  if (fast) {
+    p = lanes_add(lanes_set(1.0f / 3.0f), lanes_mul(t2, lanes_set(0.2f)));
+  } else {
+    p = lanes_add(lanes_set(1.0f / 7.0f),
+                  lanes_mul(t2, lanes_set(1.0f / 9.0f)));
+    p = lanes_add(lanes_set(0.2f), lanes_mul(t2, p));
+    p = lanes_add(lanes_set(1.0f / 3.0f), lanes_mul(t2, p));
+  }
+  Lanes log_m = lanes_mul(lanes_add(t, t),
+                          lanes_add(lanes_set(1.0f), lanes_mul(t2, p)));
+
+  Lanes ef = lanes_from_int(e);
+  Lanes result = lanes_add(lanes_mul(ef, lanes_set(LN2_LO)), log_m);
+  return lanes_add(lanes_mul(ef, lanes_set(LN2_HI)), result);
+}
+
+// Load the n (at most 4) floats of a block, missing lanes get pad
+static inline Lanes batch_load(const float* src, Uint64 n, float pad) {
+  if (n == 4) {
+    return lanes_load(src);
+  }
+  float in[4] = {pad, pad, pad, pad};
+  SDL_memcpy(in, src, sizeof(float) * n);
+  return lanes_load(in);
+}
+
+// Store the n (at most 4) valid lanes of a block
+static inline void batch_store(float* dest, Uint64 n, Lanes a) {
+  if (n == 4) {
+    lanes_store(dest, a);
+    return;
+  }
+  float out[4];
+  lanes_store(out, a);
+  SDL_memcpy(dest, out, sizeof(float) * n);
+}
+
+// Run a kernel over blocks of 4, the last block holds the n < 4 remaining
+// items and goes through batch_load and batch_store with padding, so the
+// tail runs the same lane code as the full blocks
+#define BATCH_FOR_EACH(count, i, n, body)        \
+  for (Uint64 i = 0; i < (count); i += 4) {      \
+    Uint64 n = SDL_min((count) - i, 4);          \
+    body                                         \
+  }
+
+void SBI_SinCosBatch(const float* x,
+                     float* sin_dest,
+                     float* cos_dest,
+                     Uint64 count,
+                     SBI_MathTier tier) {
+  bool fast = tier == SBI_MATH_FAST;
+  Lanes s;
+  Lanes c;
+  BATCH_FOR_EACH(count, i, n, {
+    lanes_sincos(batch_load(&x[i], n, 0.0f), fast, &s, &c);
+    batch_store(&sin_dest[i], n, s);
+    batch_store(&cos_dest[i], n, c);
+  })
+}
+
+void SBI_ExpBatch(const float* x,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier) {
+  bool fast = tier == SBI_MATH_FAST;
+  BATCH_FOR_EACH(count, i, n, {
+    batch_store(&dest[i], n, lanes_exp(batch_load(&x[i], n, 0.0f), fast));
+  })
+}
+
+void SBI_LogBatch(const float* x,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier) {
+  bool fast = tier == SBI_MATH_FAST;
+  BATCH_FOR_EACH(count, i, n, {
+    batch_store(&dest[i], n, lanes_log(batch_load(&x[i], n, 1.0f), fast));
+  })
+}
+
+void SBI_PowBatch(const float* x,
+                  const float* y,
+                  float* dest,
+                  Uint64 count,
+                  SBI_MathTier tier) {
+  bool fast = tier == SBI_MATH_FAST;
+  BATCH_FOR_EACH(count, i, n, {
+    Lanes l = lanes_mul(batch_load(&y[i], n, 0.0f),
+                        lanes_log(batch_load(&x[i], n, 1.0f), fast));
+    batch_store(&dest[i], n, lanes_exp(l, fast));
+  })
+}
+
+// Reciprocal lengths of 4 vectors from their squared lengths
+static Lanes lanes_inv_len(Lanes len_sq, bool fast) {
+  // Zero vectors get a huge finite scale and stay zero
+  Lanes l = lanes_max(len_sq, lanes_set(1e-30f));
+  Lanes inv = lanes_rsqrt(l);
+  if (!fast) {
+    // One Newton step: y * (1.5 - 0.5 * x * y^2)
+    Lanes half_l = lanes_mul(l, lanes_set(0.5f));
+    Lanes y2 = lanes_mul(inv, inv);
+    inv = lanes_mul(inv, lanes_sub(lanes_set(1.5f), lanes_mul(half_l, y2)));
+  }
+  return inv;
+}
+
+void SBI_Vec3NormalizeBatch(const SBI_Vec3* src,
+                            SBI_Vec3* dest,
+                            Uint64 count,
+                            SBI_MathTier tier) {
+  bool fast = tier == SBI_MATH_FAST;
+  Uint64 tail = count & ~(Uint64)3;
+
+  // 4 packed vectors are 3 lanes: x0y0z0x1 y1z1x2y2 z2x3y3z3
+  for (Uint64 i = 0; i < tail; i += 4) {
+    const float* in = src[i];
+    float* out = dest[i];
+    Lanes a = lanes_load(&in[0]);
+    Lanes b = lanes_load(&in[4]);
+    Lanes c = lanes_load(&in[8]);
+
+    float sq[12];
+    lanes_store(&sq[0], lanes_mul(a, a));
+    lanes_store(&sq[4], lanes_mul(b, b));
+    lanes_store(&sq[8], lanes_mul(c, c));
+    float len_sq[4] = {
+        sq[0] + sq[1] + sq[2],
+        sq[3] + sq[4] + sq[5],
+        sq[6] + sq[7] + sq[8],
+        sq[9] + sq[10] + sq[11],
+    };
+
+    float inv[4];
+    lanes_store(inv, lanes_inv_len(lanes_load(len_sq), fast));
+    float scale[12] = {
+        inv[0], inv[0], inv[0], inv[1], inv[1], inv[1],
+        inv[2], inv[2], inv[2], inv[3], inv[3], inv[3],
+    };
+    lanes_store(&out[0], lanes_mul(a, lanes_load(&scale[0])));
+    lanes_store(&out[4], lanes_mul(b, lanes_load(&scale[4])));
+    lanes_store(&out[8], lanes_mul(c, lanes_load(&scale[8])));
+  }
+
+  if (tail < count) {
+    float len_sq[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (Uint64 k = tail; k < count; k++) {
+      const float* v = src[k];
+      len_sq[k - tail] = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    }
+
+    float inv[4];
+    lanes_store(inv, lanes_inv_len(lanes_load(len_sq), fast));
+    for (Uint64 k = tail; k < count; k++) {
+      const float* v = src[k];
+      dest[k][0] = v[0] * inv[k - tail];
+      dest[k][1] = v[1] * inv[k - tail];
+      dest[k][2] = v[2] * inv[k - tail];
+    }
+  }
+}
+
+// Rotate 4 vectors by 4 unit quaternions: v + 2w(q x v) + 2q x (q x v)
+static void lanes_rotate(const Lanes q[4], const Lanes v[3], Lanes dest[3]) {
+  Lanes t[3] = {
+      lanes_sub(lanes_mul(q[1], v[2]), lanes_mul(q[2], v[1])),
+      lanes_sub(lanes_mul(q[2], v[0]), lanes_mul(q[0], v[2])),
+      lanes_sub(lanes_mul(q[0], v[1]), lanes_mul(q[1], v[0])),
+  };
+  Lanes two = lanes_set(2.0f);
+  for (int c = 0; c < 3; c++) {
+    t[c] = lanes_mul(t[c], two);
+  }
+
+  Lanes u[3] = {
+      lanes_sub(lanes_mul(q[1], t[2]), lanes_mul(q[2], t[1])),
+      lanes_sub(lanes_mul(q[2], t[0]), lanes_mul(q[0], t[2])),
+      lanes_sub(lanes_mul(q[0], t[1]), lanes_mul(q[1], t[0])),
+  };
+  for (int c = 0; c < 3; c++) {
+    dest[c] = lanes_add(lanes_add(v[c], lanes_mul(q[3], t[c])), u[c]);
+  }
+}
+
+// Parent times child for 4 transforms given as SBI_XForm components
+static void lanes_compose(const Lanes p[10], const Lanes l[10], Lanes w[10]) {
+  // Hamilton product of the rotations, ijkr
+  w[0] = lanes_add(lanes_add(lanes_mul(p[3], l[0]), lanes_mul(p[0], l[3])),
+                   lanes_sub(lanes_mul(p[1], l[2]), lanes_mul(p[2], l[1])));
+  w[1] = lanes_add(lanes_sub(lanes_mul(p[3], l[1]), lanes_mul(p[0], l[2])),
+                   lanes_add(lanes_mul(p[1], l[3]), lanes_mul(p[2], l[0])));
+  w[2] = lanes_add(lanes_add(lanes_mul(p[3], l[2]), lanes_mul(p[0], l[1])),
+                   lanes_sub(lanes_mul(p[2], l[3]), lanes_mul(p[1], l[0])));
+  w[3] = lanes_sub(lanes_sub(lanes_mul(p[3], l[3]), lanes_mul(p[0], l[0])),
+                   lanes_add(lanes_mul(p[1], l[1]), lanes_mul(p[2], l[2])));
+
+  // The child position is scaled and rotated into the parent
+  Lanes scaled[3];
+  Lanes rotated[3];
+  for (int c = 0; c < 3; c++) {
+    scaled[c] = lanes_mul(p[7 + c], l[4 + c]);
+  }
+  lanes_rotate(p, scaled, rotated);
+  for (int c = 0; c < 3; c++) {
+    w[4 + c] = lanes_add(p[4 + c], rotated[c]);
+    w[7 + c] = lanes_mul(p[7 + c], l[7 + c]);
+  }
+}
+
+void SBI_QuatTransformVec3Batch(const SBI_Quat* q,
+                                const SBI_Vec3* v,
+                                SBI_Vec3* dest,
+                                Uint64 count) {
+  // Transposed into one lane per quaternion, padded with identities
+  for (Uint64 i = 0; i < count; i += 4) {
+    Uint64 n = SDL_min(count - i, 4);
+    float qt[4][4] = {{0}, {0}, {0}, {1.0f, 1.0f, 1.0f, 1.0f}};
+    float vt[3][4] = {{0}};
+    for (Uint64 k = 0; k < n; k++) {
+      for (int c = 0; c < 4; c++) {
+        qt[c][k] = q[i + k][c];
+      }
+      for (int c = 0; c < 3; c++) {
+        vt[c][k] = v[i + k][c];
+      }
+    }
+
+    Lanes ql[4] = {lanes_load(qt[0]), lanes_load(qt[1]), lanes_load(qt[2]),
+                   lanes_load(qt[3])};
+    Lanes vl[3] = {lanes_load(vt[0]), lanes_load(vt[1]), lanes_load(vt[2])};
+    Lanes out[3];
+    lanes_rotate(ql, vl, out);
+    for (int c = 0; c < 3; c++) {
+      lanes_store(vt[c], out[c]);
+    }
+    for (Uint64 k = 0; k < n; k++) {
+      for (int c = 0; c < 3; c++) {
+        dest[i + k][c] = vt[c][k];
+      }
+    }
+  }
+}
+
+void SBI_XFormComposeBatch(const SBI_XFormArrays* local,
+                           const Uint32* parents,
+                           SBI_XFormArrays* world,
+                           Uint64 first,
+                           Uint64 count) {
+  Lanes p[10];
+  Lanes l[10];
+  Lanes w[10];
+  Uint64 end = first + count;
+  Uint64 tail = first + (count & ~(Uint64)3);
+  for (Uint64 i = first; i < tail; i += 4) {
+    for (int c = 0; c < 10; c++) {
+      p[c] = lanes_gather(world->components[c], &parents[i]);
+      l[c] = lanes_load(&local->components[c][i]);
+    }
+    lanes_compose(p, l, w);
+    for (int c = 0; c < 10; c++) {
+      lanes_store(&world->components[c][i], w[c]);
+    }
+  }
+
+  if (tail < end) {
+    Uint32 indices[4] = {0};
+    float in[4] = {0};
+    float out[4];
+    SDL_memcpy(indices, &parents[tail], sizeof(Uint32) * (end - tail));
+    for (int c = 0; c < 10; c++) {
+      SDL_memcpy(in, &local->components[c][tail],
+                 sizeof(float) * (end - tail));
+      p[c] = lanes_gather(world->components[c], indices);
+      l[c] = lanes_load(in);
+    }
+    lanes_compose(p, l, w);
+    for (int c = 0; c < 10; c++) {
+      lanes_store(out, w[c]);
+      SDL_memcpy(&world->components[c][tail], out,
+                 sizeof(float) * (end - tail));
+    }
+  }
+}